@@ -31,6 +31,7 @@ LOCAL_SRC_FILES := \
     os/core/hostIntf.c \
     os/core/hostIntfI2c.c \
     os/core/hostIntfSpi.c \
+    os/core/logToken.c \
     os/core/nanohubCommand.c \
     os/core/nanohub_chre.c \
     os/core/osApi.c \
@@ -92,7 +93,7 @@ LOCAL_STATIC_LIBRARIES := \
     libnanomath_os \
     libnanolibc_os \
 
-LOCAL_OBJCOPY_SECT_cortexm4 := .data .text
+LOCAL_OBJCOPY_SECT_cortexm4 := .data .text .logstr
 
 include $(BUILD_NANOHUB_OS_EXECUTABLE)
 
@@ -74,5 +74,6 @@ NANO_VARIANT_OSCFG_SRC_FILES_$(my_variant) :=               \
     os/drivers/st_hts221/hts221.c                           \
     os/drivers/st_lps22hb/lps22hb.c                         \
     os/drivers/st_lsm6dsm/st_lsm6dsm.c                      \
+    os/drivers/sensor_agg/sensor_agg.c                      \
     os/drivers/tilt_detection/tilt_detection.c              \
     os/drivers/window_orientation/window_orientation.c      \
@@ -47,3 +47,8 @@ NANO_VARIANT_CFLAGS_$(my_variant)  := -DHEAP_SIZE=102400
 NANO_VARIANT_C_INCLUDES_$(my_variant) := device/google/contexthub/firmware/variant/linux/inc
 
 NANO_VARIANT_NO_BOOTLOADER_$(my_variant) := true
+
+# this is relative to NANOHUB_OS_PATH
+NANO_VARIANT_OSCFG_SRC_FILES_$(my_variant) :=               \
+    os/drivers/trace_replay/trace_replay.c                  \
+
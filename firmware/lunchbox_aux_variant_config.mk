@@ -82,6 +82,7 @@ NANO_VARIANT_OSCFG_SRC_FILES_$(my_variant) :=               \
     os/drivers/hall/hall.c                                  \
     os/drivers/orientation/orientation.c                    \
     os/drivers/rohm_rpr0521/rohm_rpr0521.c                  \
+    os/drivers/sensor_agg/sensor_agg.c                      \
     os/drivers/tilt_detection/tilt_detection.c              \
     os/drivers/vsync/vsync.c                                \
     os/drivers/window_orientation/window_orientation.c      \
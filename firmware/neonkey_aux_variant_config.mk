@@ -76,5 +76,6 @@ NANO_VARIANT_OSCFG_SRC_FILES_$(my_variant) :=               \
     os/drivers/orientation/orientation.c                    \
     os/drivers/rohm_rpr0521/rohm_rpr0521.c                  \
     os/drivers/si_si7034/si7034a10.c                        \
+    os/drivers/sensor_agg/sensor_agg.c                      \
     os/drivers/tilt_detection/tilt_detection.c              \
     os/drivers/window_orientation/window_orientation.c      \
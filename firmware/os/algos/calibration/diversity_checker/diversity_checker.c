@@ -23,11 +23,140 @@
 
 #include "common/math/vec.h"
 
+// Limit on the spatial hash cell coordinates, keeps the float to int
+// conversion defined for any input.
+#define DIVERSE_MAX_CELL (1.0e6f)
+
+// Returns the spatial hash cell coordinate of 'v' (floor(v * inv_cell_size)),
+// and in 'upper' whether 'v' lies in the upper half of that cell.
+static int32_t diversityCheckerCell(float v, float inv_cell_size, bool* upper) {
+  float c = v * inv_cell_size;
+  c = (c > DIVERSE_MAX_CELL) ? DIVERSE_MAX_CELL : c;
+  c = (c < -DIVERSE_MAX_CELL) ? -DIVERSE_MAX_CELL : c;
+  int32_t i = (int32_t)c;
+  i -= (c < (float)i);
+  *upper = (c - (float)i) >= 0.5f;
+  return i;
+}
+
+// Returns the spatial hash bucket of cell (i, j, k).
+static size_t diversityCheckerBucket(int32_t i, int32_t j, int32_t k) {
+  const uint32_t h = ((uint32_t)i * 73856093u) ^ ((uint32_t)j * 19349663u) ^
+                     ((uint32_t)k * 83492791u);
+  return h & (DIVERSE_HASH_SIZE - 1);
+}
+
+// Adds the stored point at 'index' to the spatial hash.
+static void diversityCheckerHashInsert(struct DiversityChecker* diverse_data,
+                                       size_t index) {
+  const float* p = &diverse_data->diverse_data[index * THREE_AXIS_DATA_DIM];
+  bool upper;
+  const size_t b = diversityCheckerBucket(
+      diversityCheckerCell(p[0], diverse_data->inv_cell_size, &upper),
+      diversityCheckerCell(p[1], diverse_data->inv_cell_size, &upper),
+      diversityCheckerCell(p[2], diverse_data->inv_cell_size, &upper));
+  diverse_data->hash_next[index] = diverse_data->hash_head[b];
+  diverse_data->hash_head[b] = (uint16_t)index;
+}
+
+// Rebuilds the spatial hash, needed whenever the threshold changes.
+static void diversityCheckerHashRebuild(struct DiversityChecker* diverse_data) {
+  size_t i;
+  memset(diverse_data->hash_head, 0xFF, sizeof(diverse_data->hash_head));
+  for (i = 0; i < diverse_data->num_points; ++i) {
+    diversityCheckerHashInsert(diverse_data, i);
+  }
+}
+
+// Returns whether a stored point is closer than the threshold to 'vec'.
+static bool diversityCheckerFindClose(
+    const struct DiversityChecker* diverse_data, const float* vec) {
+  if (diverse_data->inv_cell_size <= 0.0f) {
+    // A zero threshold, nothing can be closer than that.
+    return false;
+  }
+
+  // A point closer than the threshold (half a cell) is in this cell or the
+  // neighbouring one on the side of the cell that 'vec' is in, on each axis.
+  int32_t cell[THREE_AXIS_DATA_DIM][2];
+  size_t axis;
+  for (axis = 0; axis < THREE_AXIS_DATA_DIM; ++axis) {
+    bool upper;
+    cell[axis][0] =
+        diversityCheckerCell(vec[axis], diverse_data->inv_cell_size, &upper);
+    cell[axis][1] = upper ? cell[axis][0] + 1 : cell[axis][0] - 1;
+  }
+
+  size_t n;
+  for (n = 0; n < 8; ++n) {
+    size_t i = diverse_data->hash_head[diversityCheckerBucket(
+        cell[0][n & 1], cell[1][(n >> 1) & 1], cell[2][(n >> 2) & 1])];
+    for (; i != DIVERSE_NO_INDEX; i = diverse_data->hash_next[i]) {
+      float vec_diff[THREE_AXIS_DATA_DIM];
+      vecSub(vec_diff, &diverse_data->diverse_data[i * THREE_AXIS_DATA_DIM],
+             vec, THREE_AXIS_DATA_DIM);
+      if (vecNormSquared(vec_diff, THREE_AXIS_DATA_DIM) <
+          diverse_data->threshold) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Updates the bounding box and sphere with the stored point at 'index'.
+static void diversityCheckerBoundInsert(struct DiversityChecker* diverse_data,
+                                        size_t index) {
+  const float* p = &diverse_data->diverse_data[index * THREE_AXIS_DATA_DIM];
+  float vec_diff[THREE_AXIS_DATA_DIM];
+  bool grown = (index == 0);
+  size_t axis, i;
+
+  for (axis = 0; axis < THREE_AXIS_DATA_DIM; ++axis) {
+    if (index == 0 || p[axis] < diverse_data->bound_min[axis]) {
+      diverse_data->bound_min[axis] = p[axis];
+      grown = true;
+    }
+    if (index == 0 || p[axis] > diverse_data->bound_max[axis]) {
+      diverse_data->bound_max[axis] = p[axis];
+      grown = true;
+    }
+  }
+
+  if (!grown) {
+    // The center stays, only the new point may extend the radius.
+    vecSub(vec_diff, p, diverse_data->bound_center, THREE_AXIS_DATA_DIM);
+    const float r = vecNorm(vec_diff, THREE_AXIS_DATA_DIM);
+    if (r > diverse_data->bound_radius) {
+      diverse_data->bound_radius = r;
+    }
+    return;
+  }
+
+  // The box moved: re-centers the sphere and finds its radius again.
+  for (axis = 0; axis < THREE_AXIS_DATA_DIM; ++axis) {
+    diverse_data->bound_center[axis] =
+        0.5f * (diverse_data->bound_min[axis] + diverse_data->bound_max[axis]);
+  }
+  diverse_data->bound_radius = 0.0f;
+  for (i = 0; i <= index; ++i) {
+    vecSub(vec_diff, &diverse_data->diverse_data[i * THREE_AXIS_DATA_DIM],
+           diverse_data->bound_center, THREE_AXIS_DATA_DIM);
+    const float r = vecNorm(vec_diff, THREE_AXIS_DATA_DIM);
+    if (r > diverse_data->bound_radius) {
+      diverse_data->bound_radius = r;
+    }
+  }
+}
+
 // Struct initialization.
 void diversityCheckerInit(struct DiversityChecker* diverse_data,
                           const struct DiversityCheckerParameters* parameters) {
   ASSERT_NOT_NULL(diverse_data);
 
+  // Setting the data and counters to zero.
+  diversityCheckerReset(diverse_data);
+
   // Initialize parameters.
   diverse_data->threshold_tuning_param_sq =
       (parameters->threshold_tuning_param * parameters->threshold_tuning_param);
@@ -50,9 +179,6 @@ void diversityCheckerInit(struct DiversityChecker* diverse_data,
   diverse_data->var_threshold = parameters->var_threshold;
   diverse_data->max_min_threshold = parameters->max_min_threshold;
 
-  // Setting the rest to zero.
-  diversityCheckerReset(diverse_data);
-
   // Debug Messages
 #ifdef DIVERSE_DEBUG_ENABLE
   memset(&diverse_data->diversity_dbg, 0, sizeof(diverse_data->diversity_dbg));
@@ -69,6 +195,9 @@ void diversityCheckerReset(struct DiversityChecker* diverse_data) {
   diverse_data->num_points = 0;
   diverse_data->num_max_dist_violations = 0;
   diverse_data->data_full = false;
+
+  // Emptying the spatial hash.
+  memset(diverse_data->hash_head, 0xFF, sizeof(diverse_data->hash_head));
 }
 
 bool diversityCheckerFindNearestPoint(struct DiversityChecker* diverse_data,
@@ -79,31 +208,36 @@ bool diversityCheckerFindNearestPoint(struct DiversityChecker* diverse_data,
   // Result vector for vector difference.
   float vec_diff[THREE_AXIS_DATA_DIM];
 
-  // normSquared result (k)
-  float norm_squared_result;
+  // Every stored point is within bound_radius of bound_center, so unless that
+  // sphere reaches beyond max_distance from 'vec' no point can be too far.
+  if (diverse_data->num_points == 0) {
+    return true;
+  }
+  vecSub(vec_diff, vec, diverse_data->bound_center, THREE_AXIS_DATA_DIM);
+  const float bound =
+      vecNorm(vec_diff, THREE_AXIS_DATA_DIM) + diverse_data->bound_radius;
+  if (bound * bound <= diverse_data->max_distance) {
+    return !diversityCheckerFindClose(diverse_data, vec);
+  }
 
+  // Otherwise the scan in storage order is needed anyway: the data is rejected
+  // at the first stored point that is either closer than the threshold or
+  // farther than max_distance; only the latter counts as a max_distance
+  // violation. The hash would only add its lookup in front of it.
   size_t i;
-
-  // Running over all existing data points
   for (i = 0; i < diverse_data->num_points; ++i) {
-    // v = v1 - v2;
     vecSub(vec_diff, &diverse_data->diverse_data[i * THREE_AXIS_DATA_DIM], vec,
            THREE_AXIS_DATA_DIM);
-
-    // k = |v|^2
-    norm_squared_result = vecNormSquared(vec_diff, THREE_AXIS_DATA_DIM);
-
-    // if k < Threshold then leave the function.
-    if (norm_squared_result < diverse_data->threshold) {
+    const float norm = vecNormSquared(vec_diff, THREE_AXIS_DATA_DIM);
+    if (norm < diverse_data->threshold) {
       return false;
     }
-
-    // if k > max_distance, count and leave the function.
-    if (norm_squared_result > diverse_data->max_distance) {
+    if (norm > diverse_data->max_distance) {
       diverse_data->num_max_dist_violations++;
       return false;
     }
   }
+
   return true;
 }
 
@@ -125,6 +259,10 @@ void diversityCheckerUpdate(struct DiversityChecker* diverse_data, float x,
                ->diverse_data[diverse_data->num_points * THREE_AXIS_DATA_DIM],
           vec, sizeof(float) * THREE_AXIS_DATA_DIM);
 
+      // Adds it to the spatial hash and bound.
+      diversityCheckerHashInsert(diverse_data, diverse_data->num_points);
+      diversityCheckerBoundInsert(diverse_data, diverse_data->num_points);
+
       // Count new data point.
       diverse_data->num_points++;
 
@@ -212,5 +350,10 @@ void diversityCheckerLocalFieldUpdate(struct DiversityChecker* diverse_data,
     // Updating max distance based on the local field information.
     diverse_data->max_distance = diverse_data->max_distance_tuning_param_sq *
                                  (local_field * local_field);
+
+    // Resizing the spatial hash cells to the new threshold.
+    const float cell_size = 2.0f * sqrtf(diverse_data->threshold);
+    diverse_data->inv_cell_size = (cell_size > 0.0f) ? 1.0f / cell_size : 0.0f;
+    diversityCheckerHashRebuild(diverse_data);
   }
 }
@@ -58,7 +58,20 @@ extern "C" {
 #endif
 
 #define THREE_AXIS_DATA_DIM (3)   // data is three-dimensional.
+#ifndef NUM_DIVERSE_VECTORS
 #define NUM_DIVERSE_VECTORS (30)  // Storing 30 data points.
+#endif
+
+// Number of spatial hash buckets (power of two) used to find stored points
+// near a new one.
+#define DIVERSE_HASH_SIZE (64)
+
+// Marks the end of a spatial hash bucket chain.
+#define DIVERSE_NO_INDEX (0xFFFF)
+
+#if NUM_DIVERSE_VECTORS >= DIVERSE_NO_INDEX
+#error "NUM_DIVERSE_VECTORS does not fit the spatial hash index."
+#endif
 
 // Debug Messages
 #ifdef DIVERSE_DEBUG_ENABLE
@@ -112,6 +125,24 @@ struct DiversityChecker {
   // Data full bit.
   bool data_full;
 
+  // Spatial hash over the stored points. Cells are cubes with twice the side
+  // of the threshold distance, so that any point closer than the threshold
+  // lies in one of the 8 cells nearest to the new point. 'hash_head' holds
+  // the first point of each bucket and 'hash_next' chains the rest
+  // (DIVERSE_NO_INDEX terminated).
+  float inv_cell_size;
+  uint16_t hash_head[DIVERSE_HASH_SIZE];
+  uint16_t hash_next[NUM_DIVERSE_VECTORS];
+
+  // Bounding box of the stored points, and a sphere around its center that
+  // holds all of them. A new point farther than max_distance from some stored
+  // point can only exist outside of the bound given by this sphere, which
+  // saves checking every point against max_distance.
+  float bound_min[THREE_AXIS_DATA_DIM];
+  float bound_max[THREE_AXIS_DATA_DIM];
+  float bound_center[THREE_AXIS_DATA_DIM];
+  float bound_radius;
+
   // Setup variables for NormQuality check.
   size_t min_num_diverse_vectors;
   size_t max_num_max_distance;
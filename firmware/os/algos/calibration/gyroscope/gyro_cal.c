@@ -59,6 +59,17 @@ static void computeGyroCal(struct GyroCal* gyro_cal,
 
 static void checkWatchdog(struct GyroCal* gyro_cal, uint64_t sample_time_nanos);
 
+/*
+ * Returns the number of leading samples in 'sample_time_nanos' that can only
+ * feed the stillness detectors: they are before the current stillness window
+ * end-time and do not trip the watchdog, so deviceStillnessCheck() would
+ * return without action for each of them. Returns 0 while no window end-time
+ * is set.
+ */
+static size_t gyroCalQuietSamples(const struct GyroCal* gyro_cal,
+                                  const uint64_t* sample_time_nanos,
+                                  size_t num_samples);
+
 // Data tracker command enumeration.
 enum GyroCalTrackerCommand {
   DO_RESET = 0,    // Resets the local data used for data tracking.
@@ -81,6 +92,12 @@ static bool gyroTemperatureStatsTracker(struct GyroCal* gyro_cal,
                                         float temperature_celsius,
                                         enum GyroCalTrackerCommand do_this);
 
+// Same as 'num_samples' DO_UPDATE_DATA calls of gyroTemperatureStatsTracker()
+// with the same temperature.
+static void gyroTemperatureStatsUpdateBatch(struct GyroCal* gyro_cal,
+                                            float temperature_celsius,
+                                            size_t num_samples);
+
 /*
  * Tracks the minimum and maximum gyroscope stillness window means.
  * Returns 'true' when the difference between gyroscope min and max window
@@ -314,6 +331,208 @@ void gyroCalUpdateAccel(struct GyroCal* gyro_cal, uint64_t sample_time_nanos,
   deviceStillnessCheck(gyro_cal, sample_time_nanos);
 }
 
+// Update the gyro calibration with a batch of gyro data [rad/sec].
+void gyroCalUpdateGyroBatch(struct GyroCal* gyro_cal,
+                            const uint64_t* sample_time_nanos,
+                            const float* data, size_t num_samples,
+                            float temperature_celsius) {
+  size_t i = 0;
+  while (i < num_samples) {
+    // Make sure that a valid window end-time is set, and start the watchdog
+    // timer (as in gyroCalUpdateGyro()).
+    if (gyro_cal->stillness_win_endtime_nanos <= 0) {
+      gyro_cal->stillness_win_endtime_nanos =
+          sample_time_nanos[i] + gyro_cal->window_time_duration_nanos;
+      gyro_cal->gyro_watchdog_start_nanos = sample_time_nanos[i];
+    }
+
+    const size_t num_quiet = gyroCalQuietSamples(
+        gyro_cal, &sample_time_nanos[i], num_samples - i);
+    if (num_quiet == 0) {
+      // This sample may end the window or trip the watchdog.
+      gyroCalUpdateGyro(gyro_cal, sample_time_nanos[i], data[3 * i],
+                        data[3 * i + 1], data[3 * i + 2],
+                        temperature_celsius);
+      ++i;
+      continue;
+    }
+
+    gyroTemperatureStatsUpdateBatch(gyro_cal, temperature_celsius, num_quiet);
+
+#ifdef GYRO_CAL_DBG_ENABLED
+    size_t j;
+    for (j = i; j < i + num_quiet; ++j) {
+      sampleRateEstimatorUpdate(&gyro_cal->debug_gyro_cal.sample_rate_estimator,
+                                sample_time_nanos[j]);
+    }
+#endif  // GYRO_CAL_DBG_ENABLED
+
+    gyroStillDetUpdateBatch(&gyro_cal->gyro_stillness_detect,
+                            gyro_cal->stillness_win_endtime_nanos,
+                            &sample_time_nanos[i], &data[3 * i], num_quiet);
+    i += num_quiet;
+  }
+}
+
+// Update the gyro calibration with a batch of mag data [micro Tesla].
+void gyroCalUpdateMagBatch(struct GyroCal* gyro_cal,
+                           const uint64_t* sample_time_nanos,
+                           const float* data, size_t num_samples) {
+  size_t i = 0;
+  while (i < num_samples) {
+    const size_t num_quiet = gyroCalQuietSamples(
+        gyro_cal, &sample_time_nanos[i], num_samples - i);
+    if (num_quiet == 0) {
+      gyroCalUpdateMag(gyro_cal, sample_time_nanos[i], data[3 * i],
+                       data[3 * i + 1], data[3 * i + 2]);
+      ++i;
+      continue;
+    }
+
+    gyroStillDetUpdateBatch(&gyro_cal->mag_stillness_detect,
+                            gyro_cal->stillness_win_endtime_nanos,
+                            &sample_time_nanos[i], &data[3 * i], num_quiet);
+    gyro_cal->using_mag_sensor = true;
+    i += num_quiet;
+  }
+}
+
+// Update the gyro calibration with a batch of accel data [m/sec^2].
+void gyroCalUpdateAccelBatch(struct GyroCal* gyro_cal,
+                             const uint64_t* sample_time_nanos,
+                             const float* data, size_t num_samples) {
+  size_t i = 0;
+  while (i < num_samples) {
+    const size_t num_quiet = gyroCalQuietSamples(
+        gyro_cal, &sample_time_nanos[i], num_samples - i);
+    if (num_quiet == 0) {
+      gyroCalUpdateAccel(gyro_cal, sample_time_nanos[i], data[3 * i],
+                         data[3 * i + 1], data[3 * i + 2]);
+      ++i;
+      continue;
+    }
+
+    gyroStillDetUpdateBatch(&gyro_cal->accel_stillness_detect,
+                            gyro_cal->stillness_win_endtime_nanos,
+                            &sample_time_nanos[i], &data[3 * i], num_quiet);
+    i += num_quiet;
+  }
+}
+
+bool gyroCalStageSample(struct GyroCalFifoRuns* runs,
+                        enum GyroCalRunSensor sensor,
+                        uint64_t sample_time_nanos, float x, float y, float z) {
+  const size_t n = runs->run[sensor].num_samples;
+
+  runs->run[sensor].sample_time_nanos[n] = sample_time_nanos;
+  runs->run[sensor].data[3 * n] = x;
+  runs->run[sensor].data[3 * n + 1] = y;
+  runs->run[sensor].data[3 * n + 2] = z;
+  runs->run[sensor].num_samples = n + 1;
+
+  return n + 1 >= GYRO_CAL_FIFO_RUN_SAMPLES;
+}
+
+// Feeds 'num_samples' samples of a staged run, starting at 'first'.
+static void gyroCalFeedRun(struct GyroCal* gyro_cal,
+                           const struct GyroCalFifoRuns* runs,
+                           enum GyroCalRunSensor sensor, size_t first,
+                           size_t num_samples, float temperature_celsius) {
+  const uint64_t* sample_time_nanos =
+      &runs->run[sensor].sample_time_nanos[first];
+  const float* data = &runs->run[sensor].data[3 * first];
+
+  switch (sensor) {
+    case GYRO_CAL_RUN_ACCEL:
+      gyroCalUpdateAccelBatch(gyro_cal, sample_time_nanos, data, num_samples);
+      break;
+    case GYRO_CAL_RUN_GYRO:
+      gyroCalUpdateGyroBatch(gyro_cal, sample_time_nanos, data, num_samples,
+                             temperature_celsius);
+      break;
+    case GYRO_CAL_RUN_MAG:
+      gyroCalUpdateMagBatch(gyro_cal, sample_time_nanos, data, num_samples);
+      break;
+    default:
+      break;
+  }
+}
+
+void gyroCalFlushFifoRuns(struct GyroCal* gyro_cal,
+                          struct GyroCalFifoRuns* runs,
+                          float temperature_celsius) {
+  size_t next[GYRO_CAL_NUM_RUNS] = {0};
+  enum GyroCalRunSensor sensor, earliest;
+  size_t num_quiet;
+
+  for (;;) {
+    // Samples before the window end-time only accumulate into their own
+    // detector, so their order across the sensors does not matter.
+    for (sensor = 0; sensor < GYRO_CAL_NUM_RUNS; ++sensor) {
+      num_quiet = gyroCalQuietSamples(
+          gyro_cal, &runs->run[sensor].sample_time_nanos[next[sensor]],
+          runs->run[sensor].num_samples - next[sensor]);
+      if (num_quiet > 0) {
+        gyroCalFeedRun(gyro_cal, runs, sensor, next[sensor], num_quiet,
+                       temperature_celsius);
+        next[sensor] += num_quiet;
+      }
+    }
+
+    // The earliest remaining sample may end the window or trip the watchdog.
+    earliest = GYRO_CAL_NUM_RUNS;
+    for (sensor = 0; sensor < GYRO_CAL_NUM_RUNS; ++sensor) {
+      if (next[sensor] < runs->run[sensor].num_samples &&
+          (earliest == GYRO_CAL_NUM_RUNS ||
+           runs->run[sensor].sample_time_nanos[next[sensor]] <
+               runs->run[earliest].sample_time_nanos[next[earliest]])) {
+        earliest = sensor;
+      }
+    }
+    if (earliest == GYRO_CAL_NUM_RUNS) {
+      break;
+    }
+
+    gyroCalFeedRun(gyro_cal, runs, earliest, next[earliest], 1,
+                   temperature_celsius);
+    ++next[earliest];
+  }
+
+  for (sensor = 0; sensor < GYRO_CAL_NUM_RUNS; ++sensor) {
+    runs->run[sensor].num_samples = 0;
+  }
+}
+
+size_t gyroCalQuietSamples(const struct GyroCal* gyro_cal,
+                           const uint64_t* sample_time_nanos,
+                           size_t num_samples) {
+  const uint64_t win_endtime = gyro_cal->stillness_win_endtime_nanos;
+  const uint64_t watchdog_start = gyro_cal->gyro_watchdog_start_nanos;
+  const uint64_t watchdog_duration =
+      gyro_cal->gyro_watchdog_timeout_duration_nanos;
+  size_t i;
+
+  if (win_endtime <= 0) {
+    return 0;
+  }
+
+  for (i = 0; i < num_samples; ++i) {
+    // A sample at or past the window end-time may complete a window.
+    if (sample_time_nanos[i] >= win_endtime) {
+      break;
+    }
+
+    // Same timeout conditions as checkWatchdog().
+    if (watchdog_start > 0 &&
+        (sample_time_nanos[i] > watchdog_duration + watchdog_start ||
+         sample_time_nanos[i] + watchdog_duration < watchdog_start)) {
+      break;
+    }
+  }
+
+  return i;
+}
+
 // TODO: Consider breaking this function up to improve readability.
 // Checks the state of all stillness detectors to determine
 // whether the device is "still".
@@ -679,6 +898,33 @@ bool gyroTemperatureStatsTracker(struct GyroCal* gyro_cal,
   return min_max_temp_exceeded;
 }
 
+void gyroTemperatureStatsUpdateBatch(struct GyroCal* gyro_cal,
+                                     float temperature_celsius,
+                                     size_t num_samples) {
+  // Does the mean accumulation.
+  float mean_accumulator = gyro_cal->temperature_mean_tracker.mean_accumulator;
+  size_t i;
+  for (i = 0; i < num_samples; ++i) {
+    mean_accumulator += temperature_celsius;
+  }
+  gyro_cal->temperature_mean_tracker.mean_accumulator = mean_accumulator;
+  gyro_cal->temperature_mean_tracker.num_points += num_samples;
+
+  // Tracks the min, max, and latest temperature values.
+  gyro_cal->temperature_mean_tracker.latest_temperature_celsius =
+      temperature_celsius;
+  if (gyro_cal->temperature_mean_tracker.temperature_min_celsius >
+      temperature_celsius) {
+    gyro_cal->temperature_mean_tracker.temperature_min_celsius =
+        temperature_celsius;
+  }
+  if (gyro_cal->temperature_mean_tracker.temperature_max_celsius <
+      temperature_celsius) {
+    gyro_cal->temperature_mean_tracker.temperature_max_celsius =
+        temperature_celsius;
+  }
+}
+
 bool gyroStillMeanTracker(struct GyroCal* gyro_cal,
                           enum GyroCalTrackerCommand do_this) {
   bool mean_not_stable = false;
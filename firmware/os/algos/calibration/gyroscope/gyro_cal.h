@@ -207,6 +207,29 @@ struct GyroCal {
 #endif                                 // GYRO_CAL_DBG_ENABLED
 };
 
+// Number of samples per sensor that a driver stages before the runs are fed
+// to the calibration.
+#ifndef GYRO_CAL_FIFO_RUN_SAMPLES
+#define GYRO_CAL_FIFO_RUN_SAMPLES (8)
+#endif  // GYRO_CAL_FIFO_RUN_SAMPLES
+
+// Sensors of the staged runs; equal time stamps are fed in this order.
+enum GyroCalRunSensor {
+  GYRO_CAL_RUN_ACCEL = 0,
+  GYRO_CAL_RUN_GYRO,
+  GYRO_CAL_RUN_MAG,
+  GYRO_CAL_NUM_RUNS
+};
+
+// Samples a FIFO driver stages per sensor while it parses a FIFO read.
+struct GyroCalFifoRuns {
+  struct {
+    uint64_t sample_time_nanos[GYRO_CAL_FIFO_RUN_SAMPLES];
+    float data[3 * GYRO_CAL_FIFO_RUN_SAMPLES];  // x, y, z triplets.
+    size_t num_samples;
+  } run[GYRO_CAL_NUM_RUNS];
+};
+
 /////// FUNCTION PROTOTYPES //////////////////////////////////////////
 
 // Initialize the gyro calibration data structure.
@@ -245,6 +268,40 @@ void gyroCalUpdateMag(struct GyroCal* gyro_cal, uint64_t sample_time_nanos,
 void gyroCalUpdateAccel(struct GyroCal* gyro_cal, uint64_t sample_time_nanos,
                         float x, float y, float z);
 
+// Batch versions of the above for a FIFO's worth of samples of one sensor.
+// Each is equivalent to calling the single sample update for every sample in
+// order, but samples that cannot end a stillness window are accumulated in a
+// single pass. 'data' holds 'num_samples' x, y, z triplets and
+// 'sample_time_nanos' their time stamps.
+void gyroCalUpdateGyroBatch(struct GyroCal* gyro_cal,
+                            const uint64_t* sample_time_nanos,
+                            const float* data, size_t num_samples,
+                            float temperature_celsius);
+
+void gyroCalUpdateMagBatch(struct GyroCal* gyro_cal,
+                           const uint64_t* sample_time_nanos,
+                           const float* data, size_t num_samples);
+
+void gyroCalUpdateAccelBatch(struct GyroCal* gyro_cal,
+                             const uint64_t* sample_time_nanos,
+                             const float* data, size_t num_samples);
+
+// Stages one sample of 'sensor'. Returns true when that sensor's run is full,
+// and gyroCalFlushFifoRuns() has to be called before staging more samples.
+bool gyroCalStageSample(struct GyroCalFifoRuns* runs,
+                        enum GyroCalRunSensor sensor,
+                        uint64_t sample_time_nanos, float x, float y, float z);
+
+// Feeds all staged samples to the calibration and empties the runs. This is
+// equivalent to the single sample updates in time stamp order across the
+// sensors: the samples that cannot end the current window go through the batch
+// updates, and the earliest remaining sample is fed on its own before the
+// window end-time is looked at again. All gyro samples use
+// 'temperature_celsius'.
+void gyroCalFlushFifoRuns(struct GyroCal* gyro_cal,
+                          struct GyroCalFifoRuns* runs,
+                          float temperature_celsius);
+
 #ifdef GYRO_CAL_DBG_ENABLED
 // Print debug data report.
 void gyroCalDebugPrint(struct GyroCal* gyro_cal,
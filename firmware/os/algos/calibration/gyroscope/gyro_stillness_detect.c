@@ -120,6 +120,81 @@ void gyroStillDetUpdate(struct GyroStillDet* gyro_still_det,
   gyro_still_det->acc_var_z += delta * delta;
 }
 
+// Update the stillness detector with a batch of samples.
+void gyroStillDetUpdateBatch(struct GyroStillDet* gyro_still_det,
+                             uint64_t stillness_win_endtime,
+                             const uint64_t* sample_time, const float* data,
+                             size_t num_samples) {
+  size_t i = 0;
+
+  // If the window end time is not valid then wait till it is.
+  if (stillness_win_endtime <= 0 || num_samples == 0) {
+    return;
+  }
+
+  // The first sample of a new window sets the assumed mean.
+  if (gyro_still_det->start_new_window) {
+    gyroStillDetUpdate(gyro_still_det, stillness_win_endtime, sample_time[0],
+                       data[0], data[1], data[2]);
+    i = 1;
+  }
+  if (i >= num_samples) {
+    return;
+  }
+
+  // The remaining samples only accumulate, so this runs without branches on
+  // local copies of the sums (same order of operations as
+  // gyroStillDetUpdate()).
+  const float assumed_mean_x = gyro_still_det->assumed_mean_x;
+  const float assumed_mean_y = gyro_still_det->assumed_mean_y;
+  const float assumed_mean_z = gyro_still_det->assumed_mean_z;
+  float mean_x = gyro_still_det->mean_x;
+  float mean_y = gyro_still_det->mean_y;
+  float mean_z = gyro_still_det->mean_z;
+  float win_mean_x = gyro_still_det->win_mean_x;
+  float win_mean_y = gyro_still_det->win_mean_y;
+  float win_mean_z = gyro_still_det->win_mean_z;
+  float acc_var_x = gyro_still_det->acc_var_x;
+  float acc_var_y = gyro_still_det->acc_var_y;
+  float acc_var_z = gyro_still_det->acc_var_z;
+  const uint32_t num_new_samples = (uint32_t)(num_samples - i);
+
+  for (; i < num_samples; ++i) {
+    const float* v = &data[3 * i];
+    mean_x += v[0];
+    mean_y += v[1];
+    mean_z += v[2];
+
+    const float delta_x = v[0] - assumed_mean_x;
+    const float delta_y = v[1] - assumed_mean_y;
+    const float delta_z = v[2] - assumed_mean_z;
+    win_mean_x += delta_x;
+    win_mean_y += delta_y;
+    win_mean_z += delta_z;
+    acc_var_x += delta_x * delta_x;
+    acc_var_y += delta_y * delta_y;
+    acc_var_z += delta_z * delta_z;
+  }
+
+  gyro_still_det->mean_x = mean_x;
+  gyro_still_det->mean_y = mean_y;
+  gyro_still_det->mean_z = mean_z;
+  gyro_still_det->win_mean_x = win_mean_x;
+  gyro_still_det->win_mean_y = win_mean_y;
+  gyro_still_det->win_mean_z = win_mean_z;
+  gyro_still_det->acc_var_x = acc_var_x;
+  gyro_still_det->acc_var_y = acc_var_y;
+  gyro_still_det->acc_var_z = acc_var_z;
+  gyro_still_det->num_acc_samples += num_new_samples;
+  gyro_still_det->num_acc_win_samples += num_new_samples;
+
+  // Only the last sample decides whether the window is ready.
+  gyro_still_det->last_sample_time = sample_time[num_samples - 1];
+  gyro_still_det->stillness_window_ready =
+      (gyro_still_det->last_sample_time >= stillness_win_endtime) &&
+      (gyro_still_det->num_acc_samples > 1);
+}
+
 // Calculates and returns the stillness confidence score [0,1].
 float gyroStillDetCompute(struct GyroStillDet* gyro_still_det) {
   float tmp_denom = 1.f;
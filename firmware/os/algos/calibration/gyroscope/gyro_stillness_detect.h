@@ -101,6 +101,14 @@ void gyroStillDetUpdate(struct GyroStillDet* gyro_still_det,
                         uint64_t stillness_win_endtime, uint64_t sample_time,
                         float x, float y, float z);
 
+// Update the stillness detector with a batch of samples, same as calling
+// gyroStillDetUpdate() for each of them in order. 'data' holds 'num_samples'
+// x, y, z triplets and 'sample_time' their time stamps.
+void gyroStillDetUpdateBatch(struct GyroStillDet* gyro_still_det,
+                             uint64_t stillness_win_endtime,
+                             const uint64_t* sample_time, const float* data,
+                             size_t num_samples);
+
 // Calculates and returns the stillness confidence score [0,1].
 float gyroStillDetCompute(struct GyroStillDet* gyro_still_det);
 
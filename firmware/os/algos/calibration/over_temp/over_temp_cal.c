@@ -45,6 +45,17 @@ static const struct OverTempCalWeight kOtcDefaultWeight1 = {
 // The default weighting used for all older offsets.
 #define OTC_MIN_WEIGHT_VALUE (0.04f)
 
+// Reference temperature for the running model sums.
+#define OTC_MODEL_SUMS_REF_TEMP_CELSIUS (JUMPSTART_START_TEMP_CELSIUS)
+
+// Number of incremental changes to the running model sums after which they are
+// recomputed from the model data.
+#define OTC_MODEL_SUMS_REBUILD_COUNT (64)
+
+// Temperature span of one 'model_data' index bucket.
+#define OTC_TEMP_BUCKET_CELSIUS \
+  ((OTC_TEMP_MAX_CELSIUS - OTC_TEMP_MIN_CELSIUS) / OTC_NUM_TEMP_BUCKETS)
+
 #ifdef OVERTEMPCAL_DBG_ENABLED
 // A debug version label to help with tracking results.
 #define OTC_DEBUG_VERSION_STRING "[Jan 10, 2018]"
@@ -184,10 +195,37 @@ static bool isValidOtcLinearModel(const struct OverTempCal *over_temp_cal,
 // Returns "true" if 'offset' and 'offset_temp_celsius' is valid.
 static bool isValidOtcOffset(const float *offset, float offset_temp_celsius);
 
-// Returns the least-squares weight based on the age of a particular offset
-// estimate.
-static float evaluateWeightingFunction(const struct OverTempCal *over_temp_cal,
-                                       uint64_t offset_age_nanos);
+// Returns the weighting function level based on the age of a particular offset
+// estimate. Level OTC_NUM_WEIGHT_LEVELS holds all offsets older than the
+// weighting function.
+static size_t evaluateWeightLevel(const struct OverTempCal *over_temp_cal,
+                                  uint64_t offset_age_nanos);
+
+// Returns the least-squares weight of a weighting function level.
+static float evaluateLevelWeight(const struct OverTempCal *over_temp_cal,
+                                 size_t level);
+
+// Returns the temperature bucket index for 'temperature_celsius'.
+static size_t tempBucket(float temperature_celsius);
+
+// Adds (sign = 1) or subtracts (sign = -1) a model data point to/from 'sums'.
+static void accumulateModelSums(struct OverTempCalModelSums *sums,
+                                const struct OverTempModelThreeAxis *data,
+                                float sign);
+
+// Adds the 'model_data' point at 'model_index' to the running model sums and
+// the temperature bucket index.
+static void modelIndexInsert(struct OverTempCal *over_temp_cal,
+                             size_t model_index);
+
+// Removes the 'model_data' point at 'model_index' from the running model sums
+// and the temperature bucket index.
+static void modelIndexRemove(struct OverTempCal *over_temp_cal,
+                             size_t model_index);
+
+// Recomputes the running model sums and the temperature bucket index from the
+// 'model_data'. Must be called after any bulk change to the 'model_data'.
+static void modelIndexRebuild(struct OverTempCal *over_temp_cal);
 
 // Computes the age increment, adds it to the age of each OTC model data point,
 // and resets the age update counter.
@@ -285,6 +323,9 @@ void overTempCalInit(struct OverTempCal *over_temp_cal,
   over_temp_cal->compensated_offset.offset_temp_celsius =
       INVALID_TEMPERATURE_CELSIUS;
 
+  // Initializes the (empty) model data index.
+  modelIndexRebuild(over_temp_cal);
+
 #ifdef OVERTEMPCAL_DBG_ENABLED
   // Sets the default sensor descriptors for debugging.
   overTempCalDebugDescriptors(over_temp_cal, "OVER_TEMP_CAL", "mDPS",
@@ -351,6 +392,7 @@ void overTempCalSetModel(struct OverTempCal *over_temp_cal, const float *offset,
 #endif  // OVERTEMPCAL_DBG_ENABLED
     }
   }
+  modelIndexRebuild(over_temp_cal);
 
   // If the new offset is valid, then it will be used as the current compensated
   // offset, otherwise the current value will be kept.
@@ -448,6 +490,7 @@ void overTempCalSetModelData(struct OverTempCal *over_temp_cal,
     }
   }
   over_temp_cal->num_model_pts = valid_data_count;
+  modelIndexRebuild(over_temp_cal);
 
   // Initializes the OTC linear model parameters.
   resetOtcLinearModel(over_temp_cal);
@@ -617,20 +660,31 @@ void overTempCalUpdateSensorEstimate(struct OverTempCal *over_temp_cal,
   //          temp_hi_check = (bin_num + 1) * delta_temp_per_bin
   //          Check condition:
   //          temp_lo_check <= model_data[i].offset_temp_celsius < temp_hi_check
+  //       Only the temperature buckets overlapping the bin are searched. The
+  //       lowest matching index is used, as with a scan of the whole array.
   bool replaced_one = false;
-  for (size_t i = 0; i < over_temp_cal->num_model_pts; i++) {
-    if (over_temp_cal->model_data[i].offset_temp_celsius < temp_hi_check &&
-        over_temp_cal->model_data[i].offset_temp_celsius >= temp_lo_check) {
-      // NOTE - The pointer to the new model data point is set here; the offset
-      // data is set below in the call to 'setLatestEstimate'.
-      over_temp_cal->latest_offset = &over_temp_cal->model_data[i];
-      replaced_one = true;
-      break;
+  size_t model_index = OTC_MODEL_SIZE;
+  for (size_t b = tempBucket(temp_lo_check); b <= tempBucket(temp_hi_check);
+       b++) {
+    for (size_t i = over_temp_cal->bucket_head[b]; i != OTC_NO_MODEL_INDEX;
+         i = over_temp_cal->bucket_next[i]) {
+      if (over_temp_cal->model_data[i].offset_temp_celsius < temp_hi_check &&
+          over_temp_cal->model_data[i].offset_temp_celsius >= temp_lo_check &&
+          i < model_index) {
+        model_index = i;
+      }
     }
   }
+  if (model_index < OTC_MODEL_SIZE) {
+    // NOTE - The pointer to the new model data point is set here; the offset
+    // data is set below in the call to 'setLatestEstimate'.
+    over_temp_cal->latest_offset = &over_temp_cal->model_data[model_index];
+    replaced_one = true;
+  }
 
   // NOTE - The pointer to the new model data point is set here; the offset
   // data is set below in the call to 'setLatestEstimate'.
+  bool added_one = false;
   if (!replaced_one) {
     if (over_temp_cal->num_model_pts < OTC_MODEL_SIZE) {
       // 3) If nothing was replaced, and the 'model_data' buffer is not full
@@ -638,6 +692,7 @@ void overTempCalUpdateSensorEstimate(struct OverTempCal *over_temp_cal,
       over_temp_cal->latest_offset =
           &over_temp_cal->model_data[over_temp_cal->num_model_pts];
       over_temp_cal->num_model_pts++;
+      added_one = true;
     } else {
       // 4) Otherwise (nothing was replaced and buffer is full), replace the
       //    oldest data with the incoming one.
@@ -651,8 +706,14 @@ void overTempCalUpdateSensorEstimate(struct OverTempCal *over_temp_cal,
     }
   }
 
-  // Updates the latest model estimate data.
+  // Updates the latest model estimate data, and the running model sums and
+  // temperature index along with it.
+  model_index = over_temp_cal->latest_offset - over_temp_cal->model_data;
+  if (!added_one) {
+    modelIndexRemove(over_temp_cal, model_index);
+  }
   setLatestEstimate(over_temp_cal, offset, temperature_celsius);
+  modelIndexInsert(over_temp_cal, model_index);
 
   // The latest offset estimate is the nearest temperature offset.
   over_temp_cal->nearest_offset = over_temp_cal->latest_offset;
@@ -791,6 +852,9 @@ bool overTempValidateAndSetWeight(
       over_temp_cal->weighting_function[index - 1].offset_age_nanos <
           new_otc_weight->offset_age_nanos) {
     over_temp_cal->weighting_function[index] = *new_otc_weight;
+
+    // The weighting level of the model data may have changed.
+    modelIndexRebuild(over_temp_cal);
     return true;
   }
 
@@ -1200,19 +1264,38 @@ void findNearestEstimate(struct OverTempCal *over_temp_cal,
     return;
   }
 
-  // Performs a brute force search for the estimate nearest
-  // 'temperature_celsius'.
+  // Searches the temperature buckets outward from the one containing
+  // 'temperature_celsius'. Points in buckets 'ring' away are at least
+  // (ring - 1) bucket widths away, so the search ends once that exceeds the
+  // best distance found. Ties go to the lowest index, as with a brute force
+  // search.
   float dtemp_new = 0.0f;
   float dtemp_old = FLT_MAX;
-  over_temp_cal->nearest_offset = &over_temp_cal->model_data[0];
-  for (size_t i = 0; i < over_temp_cal->num_model_pts; i++) {
-    dtemp_new = NANO_ABS(over_temp_cal->model_data[i].offset_temp_celsius -
-                         temperature_celsius);
-    if (dtemp_new < dtemp_old) {
-      over_temp_cal->nearest_offset = &over_temp_cal->model_data[i];
-      dtemp_old = dtemp_new;
+  size_t nearest_index = 0;
+  const size_t center = tempBucket(temperature_celsius);
+  for (size_t ring = 0; ring < OTC_NUM_TEMP_BUCKETS; ring++) {
+    if (ring > 1 && (ring - 1) * OTC_TEMP_BUCKET_CELSIUS > dtemp_old) {
+      break;
+    }
+    for (size_t side = 0; side < 2; side++) {
+      if ((side == 0 && ring > center) || (side == 1 && ring == 0) ||
+          (side == 1 && center + ring >= OTC_NUM_TEMP_BUCKETS)) {
+        continue;
+      }
+      const size_t b = side ? center + ring : center - ring;
+      for (size_t i = over_temp_cal->bucket_head[b]; i != OTC_NO_MODEL_INDEX;
+           i = over_temp_cal->bucket_next[i]) {
+        dtemp_new = NANO_ABS(over_temp_cal->model_data[i].offset_temp_celsius -
+                             temperature_celsius);
+        if (dtemp_new < dtemp_old ||
+            (dtemp_new <= dtemp_old && i < nearest_index)) {
+          nearest_index = i;
+          dtemp_old = dtemp_new;
+        }
+      }
     }
   }
+  over_temp_cal->nearest_offset = &over_temp_cal->model_data[nearest_index];
 }
 
 void removeStaleModelData(struct OverTempCal *over_temp_cal,
@@ -1233,6 +1316,9 @@ void removeStaleModelData(struct OverTempCal *over_temp_cal,
   }
 
   if (removed_one) {
+    // Removal shifts the model data, so the index is rebuilt.
+    modelIndexRebuild(over_temp_cal);
+
     // If anything was removed, then this attempts to recompute the model.
     computeModelUpdate(over_temp_cal, timestamp_nanos);
 
@@ -1348,50 +1434,42 @@ void updateModel(const struct OverTempCal *over_temp_cal,
   ASSERT_NOT_NULL(sensor_intercept);
   ASSERT(over_temp_cal->num_model_pts > 0);
 
+  // Combines the running sums of each weighting level. The temperatures are
+  // relative to OTC_MODEL_SUMS_REF_TEMP_CELSIUS.
   float sw = 0.0f;
   float st = 0.0f, stt = 0.0f;
-  float sx = 0.0f, stsx = 0.0f;
-  float sy = 0.0f, stsy = 0.0f;
-  float sz = 0.0f, stsz = 0.0f;
-  float weight = 1.0f;
-
-  // First pass computes the weighted mean values.
-  const size_t n = over_temp_cal->num_model_pts;
-  for (size_t i = 0; i < n; ++i) {
-    weight = evaluateWeightingFunction(
-        over_temp_cal, over_temp_cal->model_data[i].offset_age_nanos);
+  float so[3] = {0.0f, 0.0f, 0.0f};
+  float stso[3] = {0.0f, 0.0f, 0.0f};
+  for (size_t i = 0; i <= OTC_NUM_WEIGHT_LEVELS; i++) {
+    const struct OverTempCalModelSums *sums = &over_temp_cal->model_sums[i];
+    if (sums->num_pts == 0) {
+      continue;
+    }
 
-    sw += weight;
-    st += over_temp_cal->model_data[i].offset_temp_celsius * weight;
-    sx += over_temp_cal->model_data[i].offset[0] * weight;
-    sy += over_temp_cal->model_data[i].offset[1] * weight;
-    sz += over_temp_cal->model_data[i].offset[2] * weight;
+    const float weight = evaluateLevelWeight(over_temp_cal, i);
+    sw += weight * sums->num_pts;
+    st += weight * sums->st;
+    stt += weight * sums->stt;
+    for (size_t j = 0; j < 3; j++) {
+      so[j] += weight * sums->so[j];
+      stso[j] += weight * sums->stso[j];
+    }
   }
 
-  // Second pass computes the mean corrected second moment values.
+  // Removes the weighted mean temperature from the second moments.
   ASSERT(sw > 0.0f);
   const float inv_sw = 1.0f / sw;
-  for (size_t i = 0; i < n; ++i) {
-    weight = evaluateWeightingFunction(
-        over_temp_cal, over_temp_cal->model_data[i].offset_age_nanos);
+  stt -= st * st * inv_sw;
 
-    const float t =
-        over_temp_cal->model_data[i].offset_temp_celsius - st * inv_sw;
-    stt += weight * t * t;
-    stsx += t * over_temp_cal->model_data[i].offset[0] * weight;
-    stsy += t * over_temp_cal->model_data[i].offset[1] * weight;
-    stsz += t * over_temp_cal->model_data[i].offset[2] * weight;
-  }
-
-  // Calculates the linear model fit parameters.
+  // Calculates the linear model fit parameters, and moves the intercept back
+  // from the reference temperature to 0 Celsius.
   ASSERT(stt > 0.0f);
   const float inv_stt = 1.0f / stt;
-  temp_sensitivity[0] = stsx * inv_stt;
-  sensor_intercept[0] = (sx - st * temp_sensitivity[0]) * inv_sw;
-  temp_sensitivity[1] = stsy * inv_stt;
-  sensor_intercept[1] = (sy - st * temp_sensitivity[1]) * inv_sw;
-  temp_sensitivity[2] = stsz * inv_stt;
-  sensor_intercept[2] = (sz - st * temp_sensitivity[2]) * inv_sw;
+  for (size_t j = 0; j < 3; j++) {
+    temp_sensitivity[j] = (stso[j] - st * so[j] * inv_sw) * inv_stt;
+    sensor_intercept[j] = (so[j] - st * temp_sensitivity[j]) * inv_sw -
+                          temp_sensitivity[j] * OTC_MODEL_SUMS_REF_TEMP_CELSIUS;
+  }
 }
 
 bool outlierCheck(struct OverTempCal *over_temp_cal, const float *offset,
@@ -1470,20 +1548,124 @@ bool isValidOtcOffset(const float *offset, float offset_temp_celsius) {
   return checkAndEnforceTemperatureRange(&offset_temp_celsius);
 }
 
-float evaluateWeightingFunction(const struct OverTempCal *over_temp_cal,
-                                uint64_t offset_age_nanos) {
+size_t evaluateWeightLevel(const struct OverTempCal *over_temp_cal,
+                           uint64_t offset_age_nanos) {
   ASSERT_NOT_NULL(over_temp_cal);
-  for (size_t i = 0; i < OTC_NUM_WEIGHT_LEVELS; i++) {
+  size_t i;
+  for (i = 0; i < OTC_NUM_WEIGHT_LEVELS; i++) {
     if (offset_age_nanos <=
         over_temp_cal->weighting_function[i].offset_age_nanos) {
-      return over_temp_cal->weighting_function[i].weight;
+      break;
     }
   }
 
+  return i;
+}
+
+float evaluateLevelWeight(const struct OverTempCal *over_temp_cal,
+                          size_t level) {
+  ASSERT_NOT_NULL(over_temp_cal);
+  if (level < OTC_NUM_WEIGHT_LEVELS) {
+    return over_temp_cal->weighting_function[level].weight;
+  }
+
   // Returning the default weight for all older offsets.
   return OTC_MIN_WEIGHT_VALUE;
 }
 
+size_t tempBucket(float temperature_celsius) {
+  const int32_t bucket = CAL_FLOOR((temperature_celsius - OTC_TEMP_MIN_CELSIUS) /
+                                   OTC_TEMP_BUCKET_CELSIUS);
+  if (bucket < 0) {
+    return 0;
+  }
+  return NANO_MIN((size_t)bucket, (size_t)(OTC_NUM_TEMP_BUCKETS - 1));
+}
+
+void accumulateModelSums(struct OverTempCalModelSums *sums,
+                         const struct OverTempModelThreeAxis *data,
+                         float sign) {
+  ASSERT_NOT_NULL(sums);
+  ASSERT_NOT_NULL(data);
+  const float t = data->offset_temp_celsius - OTC_MODEL_SUMS_REF_TEMP_CELSIUS;
+  const float st = sign * t;
+
+  if (sign > 0.0f) {
+    sums->num_pts++;
+  } else {
+    ASSERT(sums->num_pts > 0);
+    sums->num_pts--;
+  }
+  sums->st += st;
+  sums->stt += st * t;
+  for (size_t j = 0; j < 3; j++) {
+    sums->so[j] += sign * data->offset[j];
+    sums->stso[j] += st * data->offset[j];
+  }
+}
+
+void modelIndexInsert(struct OverTempCal *over_temp_cal, size_t model_index) {
+  ASSERT_NOT_NULL(over_temp_cal);
+  const struct OverTempModelThreeAxis *data =
+      &over_temp_cal->model_data[model_index];
+
+  const size_t b = tempBucket(data->offset_temp_celsius);
+  over_temp_cal->bucket_next[model_index] = over_temp_cal->bucket_head[b];
+  over_temp_cal->bucket_head[b] = model_index;
+
+  // Periodically recomputes the sums instead of updating them, to bound the
+  // round-off drift of repeated add/subtract.
+  if (++over_temp_cal->model_sums_updates >= OTC_MODEL_SUMS_REBUILD_COUNT) {
+    modelIndexRebuild(over_temp_cal);
+  } else {
+    accumulateModelSums(
+        &over_temp_cal->model_sums[evaluateWeightLevel(
+            over_temp_cal, data->offset_age_nanos)],
+        data, 1.0f);
+  }
+}
+
+void modelIndexRemove(struct OverTempCal *over_temp_cal, size_t model_index) {
+  ASSERT_NOT_NULL(over_temp_cal);
+  const struct OverTempModelThreeAxis *data =
+      &over_temp_cal->model_data[model_index];
+
+  uint8_t *link = &over_temp_cal->bucket_head[tempBucket(
+      data->offset_temp_celsius)];
+  while (*link != OTC_NO_MODEL_INDEX && *link != model_index) {
+    link = &over_temp_cal->bucket_next[*link];
+  }
+  ASSERT(*link == model_index);
+  if (*link == model_index) {
+    *link = over_temp_cal->bucket_next[model_index];
+  }
+
+  over_temp_cal->model_sums_updates++;
+  accumulateModelSums(&over_temp_cal->model_sums[evaluateWeightLevel(
+                          over_temp_cal, data->offset_age_nanos)],
+                      data, -1.0f);
+}
+
+void modelIndexRebuild(struct OverTempCal *over_temp_cal) {
+  ASSERT_NOT_NULL(over_temp_cal);
+  memset(over_temp_cal->model_sums, 0, sizeof(over_temp_cal->model_sums));
+  memset(over_temp_cal->bucket_head, OTC_NO_MODEL_INDEX,
+         sizeof(over_temp_cal->bucket_head));
+  over_temp_cal->model_sums_updates = 0;
+
+  // Inserting in reverse keeps each bucket chain in increasing index order.
+  for (size_t i = over_temp_cal->num_model_pts; i-- > 0;) {
+    const struct OverTempModelThreeAxis *data = &over_temp_cal->model_data[i];
+    const size_t b = tempBucket(data->offset_temp_celsius);
+    over_temp_cal->bucket_next[i] = over_temp_cal->bucket_head[b];
+    over_temp_cal->bucket_head[b] = i;
+
+    accumulateModelSums(&over_temp_cal->model_sums[evaluateWeightLevel(
+                            over_temp_cal, data->offset_age_nanos)],
+                        data, 1.0f);
+  }
+}
+
 void modelDataSetAgeUpdate(struct OverTempCal *over_temp_cal,
                            uint64_t timestamp_nanos) {
   ASSERT_NOT_NULL(over_temp_cal);
@@ -1498,9 +1680,20 @@ void modelDataSetAgeUpdate(struct OverTempCal *over_temp_cal,
   // Resets the age update counter.
   over_temp_cal->last_age_update_nanos = timestamp_nanos;
 
-  // Updates the model dataset ages.
+  // Updates the model dataset ages, and moves the points that crossed into an
+  // older weighting level over to that level's running sums.
   for (size_t i = 0; i < over_temp_cal->num_model_pts; i++) {
-    over_temp_cal->model_data[i].offset_age_nanos += age_increment_nanos;
+    struct OverTempModelThreeAxis *data = &over_temp_cal->model_data[i];
+    const size_t level = evaluateWeightLevel(over_temp_cal,
+                                             data->offset_age_nanos);
+    data->offset_age_nanos += age_increment_nanos;
+    const size_t new_level = evaluateWeightLevel(over_temp_cal,
+                                                 data->offset_age_nanos);
+    if (new_level != level) {
+      accumulateModelSums(&over_temp_cal->model_sums[level], data, -1.0f);
+      accumulateModelSums(&over_temp_cal->model_sums[new_level], data, 1.0f);
+      over_temp_cal->model_sums_updates++;
+    }
   }
 }
 
@@ -142,6 +142,17 @@ extern "C" {
 // The refresh interval for the OTC model (30 seconds).
 #define OTC_REFRESH_MODEL_NANOS (SEC_TO_NANOS(30))
 
+// Number of temperature buckets spanning [OTC_TEMP_MIN_CELSIUS,
+// OTC_TEMP_MAX_CELSIUS] used to index the 'model_data' by temperature.
+#define OTC_NUM_TEMP_BUCKETS (64)
+
+// Marks the end of a temperature bucket chain.
+#define OTC_NO_MODEL_INDEX (0xFF)
+
+#if OTC_MODEL_SIZE >= OTC_NO_MODEL_INDEX
+#error "OTC_MODEL_SIZE does not fit the temperature bucket index."
+#endif
+
 // Defines a weighting function value for the linear model fit routine.
 struct OverTempCalWeight {
   // The age limit below which an offset will use this weight value.
@@ -151,6 +162,15 @@ struct OverTempCalWeight {
   float weight;
 };
 
+// Unweighted least-squares sums over the model data points that share one
+// weighting level. Temperatures are taken relative to a fixed reference
+// temperature to keep the single-pass second moments well conditioned.
+struct OverTempCalModelSums {
+  size_t num_pts;
+  float st, stt;           // sum(t), sum(t^2)
+  float so[3], stso[3];    // sum(offset), sum(t * offset)
+};
+
 #ifdef OVERTEMPCAL_DBG_ENABLED
 // Debug printout state enumeration.
 enum OverTempCalDebugState {
@@ -201,6 +221,20 @@ struct OverTempCal {
   // younger offset estimates.
   struct OverTempCalWeight weighting_function[OTC_NUM_WEIGHT_LEVELS];
 
+  // Running sums of the 'model_data' per weighting level; the last entry holds
+  // the points older than the weighting function. These are kept up to date
+  // as points are added, replaced and aged so that a model update does not
+  // have to revisit every point, and are recomputed from scratch every
+  // OTC_MODEL_SUMS_REBUILD_COUNT updates to bound round-off drift.
+  struct OverTempCalModelSums model_sums[OTC_NUM_WEIGHT_LEVELS + 1];
+  size_t model_sums_updates;
+
+  // Temperature bucket index of the 'model_data': 'bucket_head' holds the
+  // first point in each bucket and 'bucket_next' chains the remaining ones
+  // (OTC_NO_MODEL_INDEX terminated).
+  uint8_t bucket_head[OTC_NUM_TEMP_BUCKETS];
+  uint8_t bucket_next[OTC_MODEL_SIZE];
+
   // The active over-temperature compensated offset estimate data. Contains the
   // current sensor temperature at which offset compensation is performed.
   struct OverTempModelThreeAxis compensated_offset;
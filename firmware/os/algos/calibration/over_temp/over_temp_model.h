@@ -23,8 +23,12 @@
 extern "C" {
 #endif
 
-// Defines the maximum size of the OverTempCal 'model_data' array.
+// Defines the maximum size of the OverTempCal 'model_data' array. May be
+// overridden at build time (at most 254: 0xFF is OTC_NO_MODEL_INDEX, see
+// OverTempCal 'bucket_next').
+#ifndef OTC_MODEL_SIZE
 #define OTC_MODEL_SIZE (40)
+#endif
 
 /*
  * Over-temperature data structures that contain a modeled sensor offset
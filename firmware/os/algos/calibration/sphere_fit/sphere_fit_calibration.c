@@ -22,7 +22,6 @@
 #include <string.h>
 
 #include "calibration/util/cal_log.h"
-#include "common/math/mat.h"
 #include "common/math/vec.h"
 
 // FORWARD DECLARATIONS
@@ -150,14 +149,8 @@ void sphereFitResidAndJacobianFunc(const float *state, const void *f_data,
   // dy/db1 = [-scale_factor_x, 0, 0]
   // dy/db2 = [0, -scale_factor_y, 0]
   // dy/db3 = [0, 0, -scale_factor_z]
-  float A[SF_STATE_DIM * THREE_AXIS_DIM];
-  if (jacobian) {
-    memset(jacobian, 0, sizeof(float) * SF_STATE_DIM * data->num_fit_points);
-    memset(A, 0, sizeof(A));
-    A[0 * SF_STATE_DIM + eParamOffset1] = -calstruct.scale_factor_x;
-    A[1 * SF_STATE_DIM + eParamOffset2] = -calstruct.scale_factor_y;
-    A[2 * SF_STATE_DIM + eParamOffset3] = -calstruct.scale_factor_z;
-  }
+  // A is sparse, so each Jacobian row x_corr' * A is written out below
+  // element by element rather than through a matrix multiply.
 
   // Loop over all data points to compute residual and Jacobian.
   // TODO(dvitus): Use fit_data_std when available to weight residuals.
@@ -179,6 +172,9 @@ void sphereFitResidAndJacobianFunc(const float *state, const void *f_data,
     // Compute Jacobian if valid pointer.
     if (jacobian) {
       if (norm < MIN_VALID_DATA_NORM) {
+        // Leave the remaining rows zeroed.
+        memset(&jacobian[i * SF_STATE_DIM], 0,
+               sizeof(float) * SF_STATE_DIM * (data->num_fit_points - i));
         return;
       }
       const float scale = 1.f / norm;
@@ -186,18 +182,17 @@ void sphereFitResidAndJacobianFunc(const float *state, const void *f_data,
       // Compute bias corrected data.
       vecSub(x_bias_corr, x_data, calstruct.bias, THREE_AXIS_DIM);
 
-      // Populate non-bias terms for A
-      A[0 + eParamScaleMatrix11] = x_bias_corr[0];
-      A[1 * SF_STATE_DIM + eParamScaleMatrix21] = x_bias_corr[0];
-      A[1 * SF_STATE_DIM + eParamScaleMatrix22] = x_bias_corr[1];
-      A[2 * SF_STATE_DIM + eParamScaleMatrix31] = x_bias_corr[0];
-      A[2 * SF_STATE_DIM + eParamScaleMatrix32] = x_bias_corr[1];
-      A[2 * SF_STATE_DIM + eParamScaleMatrix33] = x_bias_corr[2];
-
       // Compute J = x_corr / ||x_corr|| * A
-      matTransposeMultiplyVec(&jacobian[i * SF_STATE_DIM], A, x_corr,
-                              THREE_AXIS_DIM, SF_STATE_DIM);
-      vecScalarMulInPlace(&jacobian[i * SF_STATE_DIM], scale, SF_STATE_DIM);
+      float *J = &jacobian[i * SF_STATE_DIM];
+      J[eParamScaleMatrix11] = (x_corr[0] * x_bias_corr[0]) * scale;
+      J[eParamScaleMatrix21] = (x_corr[1] * x_bias_corr[0]) * scale;
+      J[eParamScaleMatrix22] = (x_corr[1] * x_bias_corr[1]) * scale;
+      J[eParamScaleMatrix31] = (x_corr[2] * x_bias_corr[0]) * scale;
+      J[eParamScaleMatrix32] = (x_corr[2] * x_bias_corr[1]) * scale;
+      J[eParamScaleMatrix33] = (x_corr[2] * x_bias_corr[2]) * scale;
+      J[eParamOffset1] = (x_corr[0] * -calstruct.scale_factor_x) * scale;
+      J[eParamOffset2] = (x_corr[1] * -calstruct.scale_factor_y) * scale;
+      J[eParamOffset3] = (x_corr[2] * -calstruct.scale_factor_z) * scale;
     }
   }
 }
@@ -24,8 +24,26 @@ static bool computeResidualAndGradients(ResidualAndJacobianFunction func,
 static bool computeStep(const float *gradient, float *hessian, float *L,
                         float damping_factor, size_t dim, float *step);
 
+static void computeNormalEquations(const float *jacobian,
+                                   const float *residual, size_t state_dim,
+                                   size_t meas_dim, float *gradient,
+                                   float *hessian);
+
+static bool solveCholesky(const float *hessian, const float *gradient,
+                          size_t dim, float *L, float *step);
+
 const static float kEps = 1e-10f;
 
+// Minimum value under the square root of a Cholesky diagonal element, same as
+// in matCholeskyDecomposition().
+#define LM_CHOLESKY_TOLERANCE (1e-6f)
+
+// State dimension for which the normal equations are formed and solved by
+// kernels specialized on a constant dimension: 9 for the sphere fit (scale
+// matrix and offset), its only user. Any other dimension goes through the
+// generic matrix routines.
+#define LM_FIXED_DIM_SPHERE_FIT (9)
+
 // FUNCTION IMPLEMENTATIONS
 ////////////////////////////////////////////////////////////////////////
 void lmSolverInit(struct LmSolver *solver, const struct LmParams *params,
@@ -227,9 +245,18 @@ bool computeResidualAndGradients(ResidualAndJacobianFunction func,
 
   // Compute the cost function hessian = jacobian' jacobian and
   // gradient = -jacobian' residual
-  matTransposeMultiplyMat(hessian, jacobian, meas_dim, state_dim);
-  matTransposeMultiplyVec(gradient, jacobian, residual, meas_dim, state_dim);
-  vecScalarMulInPlace(gradient, -1.f, state_dim);
+  switch (state_dim) {
+    case LM_FIXED_DIM_SPHERE_FIT:
+      computeNormalEquations(jacobian, residual, LM_FIXED_DIM_SPHERE_FIT,
+                             meas_dim, gradient, hessian);
+      break;
+    default:
+      matTransposeMultiplyMat(hessian, jacobian, meas_dim, state_dim);
+      matTransposeMultiplyVec(gradient, jacobian, residual, meas_dim,
+                              state_dim);
+      vecScalarMulInPlace(gradient, -1.f, state_dim);
+      break;
+  }
 
   // Check if solution is found (cost function gradient is sufficiently small).
   return (vecMaxAbsoluteValue(gradient, state_dim) < gradient_threshold);
@@ -260,6 +287,16 @@ bool computeStep(const float *gradient, float *hessian, float *L,
   // 1) A = hessian + damping_factor * Identity.
   matAddConstantDiagonal(hessian, damping_factor, dim);
 
+  // 2) Solve A * step = gradient for step, using the specialized kernel for
+  // the fixed dimension.
+  switch (dim) {
+    case LM_FIXED_DIM_SPHERE_FIT:
+      return solveCholesky(hessian, gradient, LM_FIXED_DIM_SPHERE_FIT, L,
+                           step);
+    default:
+      break;
+  }
+
   // 2) Solve A * step = gradient for step.
   // a) compute cholesky decomposition of A = L L^T.
   if (!matCholeskyDecomposition(L, hessian, dim)) {
@@ -269,3 +306,93 @@ bool computeStep(const float *gradient, float *hessian, float *L,
   // b) solve for step via back-solve.
   return matLinearSolveCholesky(step, L, gradient, dim);
 }
+
+/*
+ * Computes gradient = -J' f and hessian = J' J. Only the upper triangle of the
+ * hessian is accumulated, each element in a local sum, and then mirrored.
+ * Called with a constant state_dim so that the compiler can specialize and
+ * unroll the loops for that dimension.
+ */
+static inline void computeNormalEquations(const float *jacobian,
+                                          const float *residual,
+                                          size_t state_dim, size_t meas_dim,
+                                          float *gradient, float *hessian) {
+  size_t i, j, k;
+  for (i = 0; i < state_dim; ++i) {
+    float sum = 0.0f;
+    for (k = 0; k < meas_dim; ++k) {
+      sum += jacobian[k * state_dim + i] * residual[k];
+    }
+    gradient[i] = -sum;
+
+    for (j = i; j < state_dim; ++j) {
+      sum = 0.0f;
+      for (k = 0; k < meas_dim; ++k) {
+        sum += jacobian[k * state_dim + i] * jacobian[k * state_dim + j];
+      }
+      hessian[i * state_dim + j] = sum;
+      hessian[j * state_dim + i] = sum;
+    }
+  }
+}
+
+/*
+ * Solves hessian * step = gradient through a Cholesky decomposition of the
+ * (damped) hessian into L, followed by forward and backward substitution.
+ * Same arithmetic as matCholeskyDecomposition() and matLinearSolveCholesky(),
+ * but only the lower triangle of L is touched (no clearing) and the loops are
+ * specialized on a constant dim, like computeNormalEquations(). The
+ * substitutions do not recheck the diagonal, which is at least
+ * sqrt(LM_CHOLESKY_TOLERANCE) once the decomposition succeeds.
+ *
+ * Returns false if the hessian is not positive definite.
+ */
+static inline bool solveCholesky(const float *hessian, const float *gradient,
+                                 size_t dim, float *L, float *step) {
+  size_t i, j, k;
+  float inv_diag;
+  float sum;
+
+  for (i = 0; i < dim; ++i) {
+    // L[i][i] = sqrt(A[i][i] - sum_k<i L[i][k]^2).
+    sum = 0.0f;
+    for (k = 0; k < i; ++k) {
+      sum += L[i * dim + k] * L[i * dim + k];
+    }
+    sum = hessian[i * dim + i] - sum;
+    if (sum < LM_CHOLESKY_TOLERANCE) {
+      return false;
+    }
+    L[i * dim + i] = sqrtf(sum);
+    inv_diag = 1.0f / L[i * dim + i];
+
+    // L[j][i] = (A[i][j] - sum_k<i L[i][k] * L[j][k]) / L[i][i], j > i.
+    for (j = i + 1; j < dim; ++j) {
+      sum = 0.0f;
+      for (k = 0; k < i; ++k) {
+        sum += L[i * dim + k] * L[j * dim + k];
+      }
+      L[j * dim + i] = (hessian[i * dim + j] - sum) * inv_diag;
+    }
+  }
+
+  // Solve L y = gradient, storing y in step.
+  for (i = 0; i < dim; ++i) {
+    sum = 0.0f;
+    for (k = 0; k < i; ++k) {
+      sum += L[i * dim + k] * step[k];
+    }
+    step[i] = (gradient[i] - sum) / L[i * dim + i];
+  }
+
+  // Solve L' step = y.
+  for (i = dim; i-- > 0;) {
+    sum = 0.0f;
+    for (k = i + 1; k < dim; ++k) {
+      sum += L[k * dim + i] * step[k];
+    }
+    step[i] = (step[i] - sum) / L[i * dim + i];
+  }
+
+  return true;
+}
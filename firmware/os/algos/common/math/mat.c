@@ -96,18 +96,18 @@ void mat33Multiply(struct Mat33 *out, const struct Mat33 *A,
   ASSERT(out != A);
   ASSERT(out != B);
 
+  // Keep B in registers: the compiler has to assume out may alias A and B
+  // and would otherwise reload them after every store.
+  const float b00 = B->elem[0][0], b01 = B->elem[0][1], b02 = B->elem[0][2];
+  const float b10 = B->elem[1][0], b11 = B->elem[1][1], b12 = B->elem[1][2];
+  const float b20 = B->elem[2][0], b21 = B->elem[2][1], b22 = B->elem[2][2];
+
   uint32_t i;
   for (i = 0; i < 3; ++i) {
-    uint32_t j;
-    for (j = 0; j < 3; ++j) {
-      uint32_t k;
-      float sum = 0.0f;
-      for (k = 0; k < 3; ++k) {
-        sum += A->elem[i][k] * B->elem[k][j];
-      }
-
-      out->elem[i][j] = sum;
-    }
+    const float a0 = A->elem[i][0], a1 = A->elem[i][1], a2 = A->elem[i][2];
+    out->elem[i][0] = a0 * b00 + a1 * b10 + a2 * b20;
+    out->elem[i][1] = a0 * b01 + a1 * b11 + a2 * b21;
+    out->elem[i][2] = a0 * b02 + a1 * b12 + a2 * b22;
   }
 }
 
@@ -179,18 +179,16 @@ void mat33MultiplyTransposed(struct Mat33 *out, const struct Mat33 *A,
   ASSERT_NOT_NULL(out);
   ASSERT_NOT_NULL(A);
   ASSERT_NOT_NULL(B);
+  const float b00 = B->elem[0][0], b01 = B->elem[0][1], b02 = B->elem[0][2];
+  const float b10 = B->elem[1][0], b11 = B->elem[1][1], b12 = B->elem[1][2];
+  const float b20 = B->elem[2][0], b21 = B->elem[2][1], b22 = B->elem[2][2];
+
   uint32_t i;
   for (i = 0; i < 3; ++i) {
-    uint32_t j;
-    for (j = 0; j < 3; ++j) {
-      uint32_t k;
-      float sum = 0.0f;
-      for (k = 0; k < 3; ++k) {
-        sum += A->elem[k][i] * B->elem[k][j];
-      }
-
-      out->elem[i][j] = sum;
-    }
+    const float a0 = A->elem[0][i], a1 = A->elem[1][i], a2 = A->elem[2][i];
+    out->elem[i][0] = a0 * b00 + a1 * b10 + a2 * b20;
+    out->elem[i][1] = a0 * b01 + a1 * b11 + a2 * b21;
+    out->elem[i][2] = a0 * b02 + a1 * b12 + a2 * b22;
   }
 }
 
@@ -202,18 +200,16 @@ void mat33MultiplyTransposed2(struct Mat33 *out, const struct Mat33 *A,
   ASSERT_NOT_NULL(out);
   ASSERT_NOT_NULL(A);
   ASSERT_NOT_NULL(B);
+  const float b00 = B->elem[0][0], b01 = B->elem[0][1], b02 = B->elem[0][2];
+  const float b10 = B->elem[1][0], b11 = B->elem[1][1], b12 = B->elem[1][2];
+  const float b20 = B->elem[2][0], b21 = B->elem[2][1], b22 = B->elem[2][2];
+
   uint32_t i;
   for (i = 0; i < 3; ++i) {
-    uint32_t j;
-    for (j = 0; j < 3; ++j) {
-      uint32_t k;
-      float sum = 0.0f;
-      for (k = 0; k < 3; ++k) {
-        sum += A->elem[i][k] * B->elem[j][k];
-      }
-
-      out->elem[i][j] = sum;
-    }
+    const float a0 = A->elem[i][0], a1 = A->elem[i][1], a2 = A->elem[i][2];
+    out->elem[i][0] = a0 * b00 + a1 * b01 + a2 * b02;
+    out->elem[i][1] = a0 * b10 + a1 * b11 + a2 * b12;
+    out->elem[i][2] = a0 * b20 + a1 * b21 + a2 * b22;
   }
 }
 
@@ -447,18 +443,19 @@ void mat44Apply(struct Vec4 *out, const struct Mat44 *A, const struct Vec4 *v) {
   ASSERT_NOT_NULL(out);
   ASSERT_NOT_NULL(A);
   ASSERT_NOT_NULL(v);
+  const float x = v->x, y = v->y, z = v->z, w = v->w;
 
-  out->x = A->elem[0][0] * v->x + A->elem[0][1] * v->y + A->elem[0][2] * v->z +
-           A->elem[0][3] * v->w;
+  out->x = A->elem[0][0] * x + A->elem[0][1] * y + A->elem[0][2] * z +
+           A->elem[0][3] * w;
 
-  out->y = A->elem[1][0] * v->x + A->elem[1][1] * v->y + A->elem[1][2] * v->z +
-           A->elem[1][3] * v->w;
+  out->y = A->elem[1][0] * x + A->elem[1][1] * y + A->elem[1][2] * z +
+           A->elem[1][3] * w;
 
-  out->z = A->elem[2][0] * v->x + A->elem[2][1] * v->y + A->elem[2][2] * v->z +
-           A->elem[2][3] * v->w;
+  out->z = A->elem[2][0] * x + A->elem[2][1] * y + A->elem[2][2] * z +
+           A->elem[2][3] * w;
 
-  out->w = A->elem[3][0] * v->x + A->elem[3][1] * v->y + A->elem[3][2] * v->z +
-           A->elem[3][3] * v->w;
+  out->w = A->elem[3][0] * x + A->elem[3][1] * y + A->elem[3][2] * z +
+           A->elem[3][3] * w;
 }
 
 UNROLLED
@@ -671,6 +668,7 @@ bool matCholeskyDecomposition(float *L, const float *A, size_t n) {
   ASSERT_NOT_NULL(A);
   size_t i, j, k;
   float sum = 0.0f;
+  float inv_diag;
   // initialize L to zero.
   memset(L, 0, sizeof(float) * n * n);
 
@@ -686,6 +684,7 @@ bool matCholeskyDecomposition(float *L, const float *A, size_t n) {
       return false;
     }
     L[i * n + i] = sqrtf(sum);
+    inv_diag = 1.0f / L[i * n + i];
 
     // for j = i+1:N,  compute L[j][i] =
     //      (1/L[i][i]) * (A[i][j] - sum_k = 1:i-1 L[i][k] * L[j][k])
@@ -694,8 +693,8 @@ bool matCholeskyDecomposition(float *L, const float *A, size_t n) {
       for (k = 0; k < i; ++k) {
         sum += L[i * n + k] * L[j * n + k];
       }
-      // division okay because magnitude of L[i][i] already checked above.
-      L[j * n + i] = (A[i * n + j] - sum) / L[i * n + i];
+      // inverse okay because magnitude of L[i][i] already checked above.
+      L[j * n + i] = (A[i * n + j] - sum) * inv_diag;
     }
   }
 
@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Off-target check of the matrix kernels in mat.c against plain reference
+// loops (the original implementations), plus a timing of both.
+//
+// The 3x3 and 4x4 kernels sum the same products in the same order as the
+// reference, so their results must be exactly equal. The Cholesky
+// decomposition multiplies by 1/L[i][i] instead of dividing, so it rounds
+// differently; it is held to the same backward error, |L L^T - A| / |A|, as
+// the reference instead, which unlike the difference in L does not grow with
+// the conditioning of A.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common/math/mat.h"
+
+#define NUM_INPUTS 256
+#define BENCH_ROUNDS 20000
+#define MAX_CHOLESKY_DIM 9
+// Allowed backward error, in multiples of the reference's (or of FLT_EPSILON
+// where the reference happens to be exact).
+#define CHOLESKY_ERROR_RATIO 2.0
+
+// Reference implementations; kept out of line so the timing compares calls
+// with calls.
+__attribute__((noinline))
+static void refMat33Multiply(struct Mat33 *out, const struct Mat33 *A,
+                             const struct Mat33 *B) {
+  uint32_t i, j, k;
+  for (i = 0; i < 3; ++i) {
+    for (j = 0; j < 3; ++j) {
+      float sum = 0.0f;
+      for (k = 0; k < 3; ++k) {
+        sum += A->elem[i][k] * B->elem[k][j];
+      }
+      out->elem[i][j] = sum;
+    }
+  }
+}
+
+__attribute__((noinline))
+static void refMat33MultiplyTransposed(struct Mat33 *out, const struct Mat33 *A,
+                                       const struct Mat33 *B) {
+  uint32_t i, j, k;
+  for (i = 0; i < 3; ++i) {
+    for (j = 0; j < 3; ++j) {
+      float sum = 0.0f;
+      for (k = 0; k < 3; ++k) {
+        sum += A->elem[k][i] * B->elem[k][j];
+      }
+      out->elem[i][j] = sum;
+    }
+  }
+}
+
+__attribute__((noinline))
+static void refMat33MultiplyTransposed2(struct Mat33 *out,
+                                        const struct Mat33 *A,
+                                        const struct Mat33 *B) {
+  uint32_t i, j, k;
+  for (i = 0; i < 3; ++i) {
+    for (j = 0; j < 3; ++j) {
+      float sum = 0.0f;
+      for (k = 0; k < 3; ++k) {
+        sum += A->elem[i][k] * B->elem[j][k];
+      }
+      out->elem[i][j] = sum;
+    }
+  }
+}
+
+__attribute__((noinline))
+static void refMat44Apply(struct Vec4 *out, const struct Mat44 *A,
+                          const struct Vec4 *v) {
+  out->x = A->elem[0][0] * v->x + A->elem[0][1] * v->y + A->elem[0][2] * v->z +
+           A->elem[0][3] * v->w;
+  out->y = A->elem[1][0] * v->x + A->elem[1][1] * v->y + A->elem[1][2] * v->z +
+           A->elem[1][3] * v->w;
+  out->z = A->elem[2][0] * v->x + A->elem[2][1] * v->y + A->elem[2][2] * v->z +
+           A->elem[2][3] * v->w;
+  out->w = A->elem[3][0] * v->x + A->elem[3][1] * v->y + A->elem[3][2] * v->z +
+           A->elem[3][3] * v->w;
+}
+
+__attribute__((noinline))
+static bool refMatCholeskyDecomposition(float *L, const float *A, size_t n) {
+  size_t i, j, k;
+  float sum;
+  memset(L, 0, sizeof(float) * n * n);
+
+  for (i = 0; i < n; ++i) {
+    sum = 0.0f;
+    for (k = 0; k < i; ++k) {
+      sum += L[i * n + k] * L[i * n + k];
+    }
+    sum = A[i * n + i] - sum;
+    if (sum < 1E-6f) {
+      return false;
+    }
+    L[i * n + i] = sqrtf(sum);
+
+    for (j = i + 1; j < n; ++j) {
+      sum = 0.0f;
+      for (k = 0; k < i; ++k) {
+        sum += L[i * n + k] * L[j * n + k];
+      }
+      L[j * n + i] = (A[i * n + j] - sum) / L[i * n + i];
+    }
+  }
+
+  return true;
+}
+
+static struct Mat33 mat33In[NUM_INPUTS];
+static struct Mat44 mat44In[NUM_INPUTS];
+static struct Vec4 vec4In[NUM_INPUTS];
+static float spdIn[NUM_INPUTS][MAX_CHOLESKY_DIM * MAX_CHOLESKY_DIM];
+
+static float randomFloat(void) {
+  return (float)rand() / RAND_MAX * 2.0f - 1.0f;
+}
+
+static void fillRandom(float *f, size_t n) {
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    f[i] = randomFloat() * 100.0f;
+  }
+}
+
+// A = M^T M + I is symmetric positive definite.
+static void fillSpd(float *A, size_t n) {
+  float M[MAX_CHOLESKY_DIM * MAX_CHOLESKY_DIM];
+  fillRandom(M, n * n);
+  matTransposeMultiplyMat(A, M, n, n);
+  matAddConstantDiagonal(A, 1.0f, n);
+}
+
+// max |L L^T - A| / max |A|
+static double choleskyBackwardError(const float *L, const float *A, size_t n) {
+  double err = 0.0, norm = 0.0, sum;
+  size_t i, j, k;
+  for (i = 0; i < n; ++i) {
+    for (j = 0; j < n; ++j) {
+      sum = 0.0;
+      for (k = 0; k < n; ++k) {
+        sum += (double)L[i * n + k] * L[j * n + k];
+      }
+      err = fmax(err, fabs(sum - A[i * n + j]));
+      norm = fmax(norm, fabs(A[i * n + j]));
+    }
+  }
+  return err / norm;
+}
+
+static double nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1E9 + ts.tv_nsec;
+}
+
+static bool mat33Equal(const struct Mat33 *a, const struct Mat33 *b) {
+  uint32_t i, j;
+  for (i = 0; i < 3; ++i) {
+    for (j = 0; j < 3; ++j) {
+      if (a->elem[i][j] != b->elem[i][j]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+typedef void (*Mat33Func)(struct Mat33 *out, const struct Mat33 *A,
+                          const struct Mat33 *B);
+
+static bool checkMat33(const char *name, Mat33Func func, Mat33Func ref) {
+  struct Mat33 out, expected;
+  volatile float sink = 0.0f;
+  double start, ns, refNs;
+  int i, r;
+
+  for (i = 0; i + 1 < NUM_INPUTS; ++i) {
+    func(&out, &mat33In[i], &mat33In[i + 1]);
+    ref(&expected, &mat33In[i], &mat33In[i + 1]);
+    if (!mat33Equal(&out, &expected)) {
+      printf("FAIL: %s differs from reference for input %d\n", name, i);
+      return false;
+    }
+  }
+
+  start = nowNs();
+  for (r = 0; r < BENCH_ROUNDS; ++r) {
+    for (i = 0; i + 1 < NUM_INPUTS; ++i) {
+      func(&out, &mat33In[i], &mat33In[i + 1]);
+      sink += out.elem[2][2];
+    }
+  }
+  ns = nowNs() - start;
+
+  start = nowNs();
+  for (r = 0; r < BENCH_ROUNDS; ++r) {
+    for (i = 0; i + 1 < NUM_INPUTS; ++i) {
+      ref(&out, &mat33In[i], &mat33In[i + 1]);
+      sink += out.elem[2][2];
+    }
+  }
+  refNs = nowNs() - start;
+
+  printf("PASS: %-26s %6.2f ns/call, reference %6.2f ns/call\n", name,
+         ns / (BENCH_ROUNDS * (NUM_INPUTS - 1)),
+         refNs / (BENCH_ROUNDS * (NUM_INPUTS - 1)));
+  return true;
+}
+
+static bool checkMat44Apply(void) {
+  struct Vec4 out, expected;
+  volatile float sink = 0.0f;
+  double start, ns, refNs;
+  int i, r;
+
+  for (i = 0; i < NUM_INPUTS; ++i) {
+    mat44Apply(&out, &mat44In[i], &vec4In[i]);
+    refMat44Apply(&expected, &mat44In[i], &vec4In[i]);
+    if (out.x != expected.x || out.y != expected.y || out.z != expected.z ||
+        out.w != expected.w) {
+      printf("FAIL: mat44Apply differs from reference for input %d\n", i);
+      return false;
+    }
+  }
+
+  start = nowNs();
+  for (r = 0; r < BENCH_ROUNDS; ++r) {
+    for (i = 0; i < NUM_INPUTS; ++i) {
+      mat44Apply(&out, &mat44In[i], &vec4In[i]);
+      sink += out.w;
+    }
+  }
+  ns = nowNs() - start;
+
+  start = nowNs();
+  for (r = 0; r < BENCH_ROUNDS; ++r) {
+    for (i = 0; i < NUM_INPUTS; ++i) {
+      refMat44Apply(&out, &mat44In[i], &vec4In[i]);
+      sink += out.w;
+    }
+  }
+  refNs = nowNs() - start;
+
+  printf("PASS: %-26s %6.2f ns/call, reference %6.2f ns/call\n", "mat44Apply",
+         ns / (BENCH_ROUNDS * NUM_INPUTS), refNs / (BENCH_ROUNDS * NUM_INPUTS));
+  return true;
+}
+
+static bool checkCholesky(size_t n) {
+  float L[MAX_CHOLESKY_DIM * MAX_CHOLESKY_DIM];
+  float expected[MAX_CHOLESKY_DIM * MAX_CHOLESKY_DIM];
+  double maxErr = 0.0, maxRefErr = 0.0, err, refErr;
+  volatile float sink = 0.0f;
+  double start, ns, refNs;
+  int i, r;
+
+  for (i = 0; i < NUM_INPUTS; ++i) {
+    fillSpd(spdIn[i], n);
+    if (!matCholeskyDecomposition(L, spdIn[i], n) ||
+        !refMatCholeskyDecomposition(expected, spdIn[i], n)) {
+      printf("FAIL: matCholeskyDecomposition(%zu) failed for input %d\n", n,
+             i);
+      return false;
+    }
+    err = choleskyBackwardError(L, spdIn[i], n);
+    refErr = choleskyBackwardError(expected, spdIn[i], n);
+    if (err > CHOLESKY_ERROR_RATIO * fmax(refErr, FLT_EPSILON)) {
+      printf("FAIL: matCholeskyDecomposition(%zu) backward error %g, "
+             "reference %g, for input %d\n", n, err, refErr, i);
+      return false;
+    }
+    maxErr = fmax(maxErr, err);
+    maxRefErr = fmax(maxRefErr, refErr);
+  }
+
+  start = nowNs();
+  for (r = 0; r < BENCH_ROUNDS / 10; ++r) {
+    for (i = 0; i < NUM_INPUTS; ++i) {
+      matCholeskyDecomposition(L, spdIn[i], n);
+      sink += L[n * n - 1];
+    }
+  }
+  ns = nowNs() - start;
+
+  start = nowNs();
+  for (r = 0; r < BENCH_ROUNDS / 10; ++r) {
+    for (i = 0; i < NUM_INPUTS; ++i) {
+      refMatCholeskyDecomposition(L, spdIn[i], n);
+      sink += L[n * n - 1];
+    }
+  }
+  refNs = nowNs() - start;
+
+  printf("PASS: matCholeskyDecomposition(%zu) %6.2f ns/call, reference %6.2f "
+         "ns/call, backward error %.3g, reference %.3g\n", n,
+         ns / (BENCH_ROUNDS / 10 * NUM_INPUTS),
+         refNs / (BENCH_ROUNDS / 10 * NUM_INPUTS), maxErr, maxRefErr);
+  return true;
+}
+
+int main(void) {
+  bool pass = true;
+  int i;
+
+  srand(1);
+  for (i = 0; i < NUM_INPUTS; ++i) {
+    fillRandom(&mat33In[i].elem[0][0], 9);
+    fillRandom(&mat44In[i].elem[0][0], 16);
+    fillRandom(&vec4In[i].x, 4);
+  }
+
+  pass &= checkMat33("mat33Multiply", mat33Multiply, refMat33Multiply);
+  pass &= checkMat33("mat33MultiplyTransposed", mat33MultiplyTransposed,
+                     refMat33MultiplyTransposed);
+  pass &= checkMat33("mat33MultiplyTransposed2", mat33MultiplyTransposed2,
+                     refMat33MultiplyTransposed2);
+  pass &= checkMat44Apply();
+  pass &= checkCholesky(3);
+  pass &= checkCholesky(4);
+  pass &= checkCholesky(MAX_CHOLESKY_DIM);
+
+  return pass ? 0 : 1;
+}
@@ -19,10 +19,17 @@
 #include <algos/fusion.h>
 
 #include <errno.h>
-#include <nanohub_math.h>
 #include <stdio.h>
 
+#ifdef _OS_BUILD_
+#include <nanohub_math.h>
 #include <seos.h>
+#else
+#include <math.h>
+#ifndef UNROLLED
+#define UNROLLED
+#endif
+#endif  // _OS_BUILD_
 
 #ifdef DEBUG_CH
 // change to 0 to disable fusion debugging output
@@ -104,6 +111,9 @@ void initFusion(struct Fusion *fusion, uint32_t flags) {
                                | ((fusion->flags & FUSION_USE_GYRO) ? GYRO : 0));
     }
 
+    // noise parameters may have changed with the mode
+    fusion->mBatchDt = 0.0f;
+
     fusionSetMagTrust(fusion, NORMAL);
     fusion->lastMagInvalid = false;
 }
@@ -115,21 +125,25 @@ int fusionHasEstimate(const struct Fusion *fusion) {
                                   | ((fusion->flags & FUSION_USE_GYRO) ? GYRO : 0));
 }
 
+static void computeGQGt(const struct FusionParam *param, float dT, struct Mat33 GQGt[2][2]) {
+    float dT2 = dT * dT;
+    float dT3 = dT2 * dT;
+
+    float q00 = param->gyro_var * dT +
+                0.33333f * param->gyro_bias_var * dT3;
+    float q11 = param->gyro_bias_var * dT;
+    float q10 = 0.5f * param->gyro_bias_var * dT2;
+    float q01 = q10;
+
+    initDiagonalMatrix(&GQGt[0][0], q00);
+    initDiagonalMatrix(&GQGt[0][1], -q10);
+    initDiagonalMatrix(&GQGt[1][0], -q01);
+    initDiagonalMatrix(&GQGt[1][1], q11);
+}
+
 static void updateDt(struct Fusion *fusion, float dT) {
     if (fabsf(fusion->mPredictDt - dT) > DELTA_TIME_MARGIN) {
-        float dT2 = dT * dT;
-        float dT3 = dT2 * dT;
-
-        float q00 = fusion->param.gyro_var * dT +
-                    0.33333f * fusion->param.gyro_bias_var * dT3;
-        float q11 = fusion->param.gyro_bias_var * dT;
-        float q10 = 0.5f * fusion->param.gyro_bias_var * dT2;
-        float q01 = q10;
-
-        initDiagonalMatrix(&fusion->GQGt[0][0], q00);
-        initDiagonalMatrix(&fusion->GQGt[0][1], -q10);
-        initDiagonalMatrix(&fusion->GQGt[1][0], -q01);
-        initDiagonalMatrix(&fusion->GQGt[1][1], q11);
+        computeGQGt(&fusion->param, dT, fusion->GQGt);
         fusion->mPredictDt = dT;
     }
 }
@@ -257,8 +271,17 @@ static void fusionCheckState(struct Fusion *fusion) {
 
 #define kEps 1.0E-4f
 
+// below this rotation per step (in radians) the series forms of the trig terms are exact in float
+// and avoid the cancellation in 1 - cos(x) and x - sin(x)
+#define SMALL_ANGLE 0.1f
+
+// max gyro samples folded into one covariance propagation by fusionHandleGyroBatch()
+#define GYRO_BATCH_WINDOW 8
+
+// advance the attitude by one gyro sample and return the state transition for the step in phi;
+// returns false if the rotation is too small to bother, in which case nothing changes
 UNROLLED
-static void fusionPredict(struct Fusion *fusion, const struct Vec3 *w) {
+static bool fusionPredictState(struct Fusion *fusion, const struct Vec3 *w, struct Mat33 phi[2]) {
     const float dT = fusion->mPredictDt;
 
     Quat q = fusion->x0;
@@ -282,18 +305,31 @@ static void fusionPredict(struct Fusion *fusion, const struct Vec3 *w) {
     float norm_we = vec3Norm(&we);
 
     if (fabsf(norm_we) < kEps) {
-        return;
+        return false;
     }
 
     float lwedT = norm_we * dT;
     float hlwedT = 0.5f * lwedT;
     float ilwe = 1.0f / norm_we;
-    float k0 = (1.0f - cosf(lwedT)) * (ilwe * ilwe);
-    float k1 = sinf(lwedT);
-    float k2 = cosf(hlwedT);
+    float k0, k1, k2, k3, shlwedT;
+
+    if (lwedT < SMALL_ANGLE) {
+        float x2 = lwedT * lwedT, h2 = 0.25f * x2;
+        k0 = dT * dT * (0.5f - x2 * (1.0f / 24.0f - x2 * (1.0f / 720.0f)));
+        k1 = lwedT * (1.0f - x2 * (1.0f / 6.0f - x2 * (1.0f / 120.0f)));
+        k2 = 1.0f - h2 * (0.5f - h2 * (1.0f / 24.0f - h2 * (1.0f / 720.0f)));
+        k3 = dT * dT * dT * (1.0f / 6.0f - x2 * (1.0f / 120.0f - x2 * (1.0f / 5040.0f)));
+        shlwedT = hlwedT * (1.0f - h2 * (1.0f / 6.0f - h2 * (1.0f / 120.0f)));
+    } else {
+        k0 = (1.0f - cosf(lwedT)) * (ilwe * ilwe);
+        k1 = sinf(lwedT);
+        k2 = cosf(hlwedT);
+        k3 = ilwe * ilwe * ilwe * (lwedT - k1);
+        shlwedT = sinf(hlwedT);
+    }
 
     struct Vec3 psi = we;
-    vec3ScalarMul(&psi, sinf(hlwedT) * ilwe);
+    vec3ScalarMul(&psi, shlwedT * ilwe);
 
     struct Vec3 negPsi = psi;
     vec3ScalarMul(&negPsi, -1.0f);
@@ -322,24 +358,24 @@ static void fusionPredict(struct Fusion *fusion, const struct Vec3 *w) {
     struct Mat33 tmp = wx;
     mat33ScalarMul(&tmp, k1 * ilwe);
 
-    fusion->Phi0[0] = I33;
-    mat33Sub(&fusion->Phi0[0], &tmp);
+    phi[0] = I33;
+    mat33Sub(&phi[0], &tmp);
 
     tmp = wx2;
     mat33ScalarMul(&tmp, k0);
 
-    mat33Add(&fusion->Phi0[0], &tmp);
+    mat33Add(&phi[0], &tmp);
 
     tmp = wx;
     mat33ScalarMul(&tmp, k0);
-    fusion->Phi0[1] = tmp;
+    phi[1] = tmp;
 
-    mat33Sub(&fusion->Phi0[1], &I33dT);
+    mat33Sub(&phi[1], &I33dT);
 
     tmp = wx2;
-    mat33ScalarMul(&tmp, ilwe * ilwe * ilwe * (lwedT - k1));
+    mat33ScalarMul(&tmp, k3);
 
-    mat33Sub(&fusion->Phi0[1], &tmp);
+    mat33Sub(&phi[1], &tmp);
 
     mat44Apply(&fusion->x0, &O, &q);
 
@@ -350,15 +386,23 @@ static void fusionPredict(struct Fusion *fusion, const struct Vec3 *w) {
         fusion->x0.w = -fusion->x0.w;
     }
 
+    return true;
+}
+
+// P = Phi * P * Phi^T + GQGt, where Phi = [phi[0] phi[1]; 0 I]
+UNROLLED
+static void fusionPredictCovariance(struct Fusion *fusion, const struct Mat33 phi[2], struct Mat33 GQGt[2][2]) {
+    struct Mat33 tmp;
+
     // Pnew = Phi * P
 
     struct Mat33 Pnew[2][2];
-    mat33Multiply(&Pnew[0][0], &fusion->Phi0[0], &fusion->P[0][0]);
-    mat33Multiply(&tmp, &fusion->Phi0[1], &fusion->P[1][0]);
+    mat33Multiply(&Pnew[0][0], &phi[0], &fusion->P[0][0]);
+    mat33Multiply(&tmp, &phi[1], &fusion->P[1][0]);
     mat33Add(&Pnew[0][0], &tmp);
 
-    mat33Multiply(&Pnew[0][1], &fusion->Phi0[0], &fusion->P[0][1]);
-    mat33Multiply(&tmp, &fusion->Phi0[1], &fusion->P[1][1]);
+    mat33Multiply(&Pnew[0][1], &phi[0], &fusion->P[0][1]);
+    mat33Multiply(&tmp, &phi[1], &fusion->P[1][1]);
     mat33Add(&Pnew[0][1], &tmp);
 
     Pnew[1][0] = fusion->P[1][0];
@@ -366,26 +410,32 @@ static void fusionPredict(struct Fusion *fusion, const struct Vec3 *w) {
 
     // P = Pnew * Phi^T
 
-    mat33MultiplyTransposed2(&fusion->P[0][0], &Pnew[0][0], &fusion->Phi0[0]);
-    mat33MultiplyTransposed2(&tmp, &Pnew[0][1], &fusion->Phi0[1]);
+    mat33MultiplyTransposed2(&fusion->P[0][0], &Pnew[0][0], &phi[0]);
+    mat33MultiplyTransposed2(&tmp, &Pnew[0][1], &phi[1]);
     mat33Add(&fusion->P[0][0], &tmp);
 
     fusion->P[0][1] = Pnew[0][1];
 
-    mat33MultiplyTransposed2(&fusion->P[1][0], &Pnew[1][0], &fusion->Phi0[0]);
-    mat33MultiplyTransposed2(&tmp, &Pnew[1][1], &fusion->Phi0[1]);
+    mat33MultiplyTransposed2(&fusion->P[1][0], &Pnew[1][0], &phi[0]);
+    mat33MultiplyTransposed2(&tmp, &Pnew[1][1], &phi[1]);
     mat33Add(&fusion->P[1][0], &tmp);
 
     fusion->P[1][1] = Pnew[1][1];
 
-    mat33Add(&fusion->P[0][0], &fusion->GQGt[0][0]);
-    mat33Add(&fusion->P[0][1], &fusion->GQGt[0][1]);
-    mat33Add(&fusion->P[1][0], &fusion->GQGt[1][0]);
-    mat33Add(&fusion->P[1][1], &fusion->GQGt[1][1]);
+    mat33Add(&fusion->P[0][0], &GQGt[0][0]);
+    mat33Add(&fusion->P[0][1], &GQGt[0][1]);
+    mat33Add(&fusion->P[1][0], &GQGt[1][0]);
+    mat33Add(&fusion->P[1][1], &GQGt[1][1]);
 
     fusionCheckState(fusion);
 }
 
+static void fusionPredict(struct Fusion *fusion, const struct Vec3 *w) {
+    if (fusionPredictState(fusion, w, fusion->Phi0)) {
+        fusionPredictCovariance(fusion, fusion->Phi0, fusion->GQGt);
+    }
+}
+
 void fusionHandleGyro(struct Fusion *fusion, const struct Vec3 *w, float dT) {
     if (!fusion_init_complete(fusion, GYRO, w, dT)) {
         return;
@@ -396,6 +446,53 @@ void fusionHandleGyro(struct Fusion *fusion, const struct Vec3 *w, float dT) {
     fusionPredict(fusion, w);
 }
 
+void fusionHandleGyroBatch(struct Fusion *fusion, const struct Vec3 *w, size_t n, float dT) {
+    struct Mat33 phi[2], tmp;
+    size_t i = 0, m;
+
+    // initialization wants the samples one at a time
+    while (i < n && !fusionHasEstimate(fusion)) {
+        fusionHandleGyro(fusion, &w[i++], dT);
+    }
+
+    if (i == n) {
+        return;
+    }
+
+    updateDt(fusion, dT);
+
+    while (i < n) {
+        // chain the per-sample transitions; Phi stays [phi[0] phi[1]; 0 I] under multiplication:
+        // [a b; 0 I] * [A B; 0 I] = [a*A a*B+b; 0 I]
+        for (m = 0; i < n && m < GYRO_BATCH_WINDOW; i++) {
+            if (!fusionPredictState(fusion, &w[i], phi)) {
+                continue;
+            }
+            if (!m++) {
+                fusion->Phi0[0] = phi[0];
+                fusion->Phi0[1] = phi[1];
+            } else {
+                mat33Multiply(&tmp, &phi[0], &fusion->Phi0[1]);
+                mat33Add(&tmp, &phi[1]);
+                fusion->Phi0[1] = tmp;
+                mat33Multiply(&tmp, &phi[0], &fusion->Phi0[0]);
+                fusion->Phi0[0] = tmp;
+            }
+        }
+
+        if (m == 1) {
+            fusionPredictCovariance(fusion, fusion->Phi0, fusion->GQGt);
+        } else if (m) {
+            // the noise of m steps is the noise of one step m times as long
+            if (fabsf(fusion->mBatchDt - m * dT) > DELTA_TIME_MARGIN) {
+                computeGQGt(&fusion->param, m * dT, fusion->GQGtBatch);
+                fusion->mBatchDt = m * dT;
+            }
+            fusionPredictCovariance(fusion, fusion->Phi0, fusion->GQGtBatch);
+        }
+    }
+}
+
 UNROLLED
 static void scaleCovariance(struct Mat33 *out, const struct Mat33 *A, const struct Mat33 *P) {
     uint32_t r;
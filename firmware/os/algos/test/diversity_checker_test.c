@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Off-target check of diversityCheckerUpdate() (spatial hash and bounding
+// sphere) against the linear scan it replaced, plus a timing of both.
+//
+// The input is magnetometer-like: samples on a sphere of the local field
+// around a hard iron bias, with noise, the odd outlier well off the sphere,
+// local field updates and resets, as mag_cal does them. The tuning is the
+// BMI160 driver's, except that the threshold is sometimes made small so that
+// builds with a large NUM_DIVERSE_VECTORS fill up too. After every sample the
+// stored points and the max distance violation count must match the
+// reference.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <calibration/diversity_checker/diversity_checker.h>
+#include <common/math/vec.h>
+
+#define SAMPLES             3000000
+#define RESET_PERIOD        2000    // samples between resets, on average
+
+// the old diversity_checker, as it was: a scan over all stored points
+struct RefChecker {
+    float data[THREE_AXIS_DATA_DIM * NUM_DIVERSE_VECTORS];
+    size_t num_points;
+    size_t num_max_dist_violations;
+    bool data_full;
+};
+
+static bool refFindNearestPoint(struct RefChecker *ref, float threshold, float max_distance,
+                                float x, float y, float z)
+{
+    const float vec[THREE_AXIS_DATA_DIM] = { x, y, z };
+    float diff[THREE_AXIS_DATA_DIM];
+    size_t i;
+
+    for (i = 0; i < ref->num_points; ++i) {
+        vecSub(diff, &ref->data[i * THREE_AXIS_DATA_DIM], vec, THREE_AXIS_DATA_DIM);
+        float k = vecNormSquared(diff, THREE_AXIS_DATA_DIM);
+
+        if (k < threshold)
+            return false;
+
+        if (k > max_distance) {
+            ref->num_max_dist_violations++;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void refUpdate(struct RefChecker *ref, float threshold, float max_distance,
+                      float x, float y, float z)
+{
+    if (!ref->data_full && refFindNearestPoint(ref, threshold, max_distance, x, y, z)) {
+        ref->data[ref->num_points * 3] = x;
+        ref->data[ref->num_points * 3 + 1] = y;
+        ref->data[ref->num_points * 3 + 2] = z;
+        if (++ref->num_points == NUM_DIVERSE_VECTORS)
+            ref->data_full = true;
+    }
+}
+
+static uint32_t mRandState = 0x2545f491;
+
+static uint32_t rnd(void)
+{
+    mRandState ^= mRandState << 13;
+    mRandState ^= mRandState >> 17;
+    mRandState ^= mRandState << 5;
+    return mRandState;
+}
+
+static float uniform(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(rnd() / 4294967296.0);
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void init(struct DiversityChecker *dc, struct RefChecker *ref, float field,
+                 float thresholdTuning)
+{
+    const struct DiversityCheckerParameters parameters = {
+        6.0f,               // var_threshold
+        10.0f,              // max_min_threshold
+        field,              // local_field
+        thresholdTuning,    // threshold_tuning_param
+        2.552f,             // max_distance_tuning_param
+        8,                  // min_num_diverse_vectors
+        1                   // max_num_max_distance
+    };
+
+    diversityCheckerInit(dc, &parameters);
+    memset(ref, 0, sizeof(*ref));
+}
+
+int main(void)
+{
+    static struct DiversityChecker dc;
+    static struct RefChecker ref;
+    size_t i, stored = 0, violations = 0, mismatches = 0, full = 0;
+    float field = 48.0f, bias[3] = { 0 }, x, y, z, theta, phi, r;
+    double ns = 0.0, refNs = 0.0, t0;
+
+    init(&dc, &ref, field, 0.5f);
+
+    for (i = 0; i < SAMPLES; i++) {
+        if (rnd() % RESET_PERIOD == 0) {
+            stored += ref.num_points;
+            violations += ref.num_max_dist_violations;
+            full += ref.data_full;
+            field = uniform(25.0f, 65.0f);
+            init(&dc, &ref, field, (rnd() & 3) ? 0.5f : uniform(0.02f, 0.5f));
+            bias[0] = uniform(-100.0f, 100.0f);
+            bias[1] = uniform(-100.0f, 100.0f);
+            bias[2] = uniform(-100.0f, 100.0f);
+        } else if (rnd() % 500 == 0) {
+            // mag_cal passes the radius of each new fit
+            float local = field * uniform(0.8f, 1.2f);
+            diversityCheckerLocalFieldUpdate(&dc, local);
+        }
+
+        theta = uniform(0.0f, 6.2831853f);
+        phi = acosf(uniform(-1.0f, 1.0f));
+        r = (rnd() % 1000 == 0) ? field * uniform(2.0f, 4.0f) : field + uniform(-1.0f, 1.0f);
+        x = bias[0] + r * sinf(phi) * cosf(theta);
+        y = bias[1] + r * sinf(phi) * sinf(theta);
+        z = bias[2] + r * cosf(phi);
+
+        t0 = nowNs();
+        diversityCheckerUpdate(&dc, x, y, z);
+        ns += nowNs() - t0;
+
+        t0 = nowNs();
+        refUpdate(&ref, dc.threshold, dc.max_distance, x, y, z);
+        refNs += nowNs() - t0;
+
+        if (dc.num_points != ref.num_points || dc.data_full != ref.data_full ||
+            dc.num_max_dist_violations != ref.num_max_dist_violations ||
+            memcmp(dc.diverse_data, ref.data, ref.num_points * 3 * sizeof(float))) {
+            if (!mismatches++)
+                printf("FAIL: diversity_checker differs from the linear scan at sample %zu\n", i);
+            init(&dc, &ref, field, 0.5f);
+        }
+    }
+
+    printf("%s: diversity_checker %d points, %zu samples, %zu stored, %zu full, %zu max distance, "
+           "%zu mismatches, %5.1f ns/sample, reference %5.1f ns/sample\n",
+           mismatches || !full || !violations ? "FAIL" : "PASS", NUM_DIVERSE_VECTORS,
+           (size_t)SAMPLES, stored, full, violations, mismatches, ns / SAMPLES, refNs / SAMPLES);
+
+    return mismatches || !full || !violations ? 1 : 0;
+}
@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Off-target check of fusionHandleGyroBatch() against feeding the same gyro
+// samples one at a time through fusionHandleGyro(), plus a timing of both.
+//
+// Both filters see the same events in the same order, as the orientation
+// driver hands them over: every run of gyro samples up to the next accel or
+// mag sample goes to fusionHandleGyroBatch() in one call. The attitudes of
+// the two after one run from the same state may only differ by float rounding
+// (the process noise of a run is that of one long step, which is close to,
+// not exactly, the sum of the per-step noises). Over a whole recording those
+// differences feed back through the accel/mag updates and the attitudes
+// drift apart by a fraction of the filter's own error, so that is bounded
+// loosely, and on the simulated motion batch must be as close to the truth.
+//
+// The input is a simulated rotation with matching, noisy accel and mag, at
+// gyro runs of 4, 8 and 16 samples, or the trace in the file given as the
+// only argument: one "<g|a|m> <time_ns> <x> <y> <z>" line per resampled
+// sample, in time order.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algos/fusion.h>
+
+#define MAX_EVENTS          (1 << 20)
+#define MAX_GYRO_RUN        32      // as in the orientation driver
+
+#define SIM_SECONDS         500
+#define SIM_GYRO_HZ         400
+
+#define MAX_WINDOW_DIFF     1e-4    // deg, one run of samples from the same state
+#define MAX_WINDOW_P_DIFF   1e-5    // relative to the largest covariance element
+#define MAX_ATTITUDE_DIFF   1.0     // deg, batch vs per-sample at any time
+#define MAX_TRUTH_DIFF      0.01    // deg, by which batch may be worse against the truth
+
+enum { GYR, ACC, MAG };
+
+struct Event {
+    int type;
+    struct Vec3 v;
+    float truth[4];                 // simulated attitude after this event
+};
+
+struct Result {
+    double windowDiff;              // deg, one run from the same state
+    double windowPDiff;             // relative, covariance after that run
+    double maxDiff;                 // deg, between the two filters
+    double truthErr, refTruthErr;   // deg, mean over the last 90%
+    double ns, refNs;               // in gyro handling, per gyro sample
+};
+
+static struct Event mEvents[MAX_EVENTS];
+static size_t mNumEvents;
+static float mDt[3];
+static bool mHaveTruth;
+
+static double nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static float noise(float amplitude)
+{
+    return amplitude * ((float)rand() / RAND_MAX - 0.5f);
+}
+
+// angle in degrees between two attitudes, either sign of the quaternion; atan2 of the
+// difference and the sum keeps it exact for nearly equal, not quite unit quaternions
+static double attitudeDiff(const float a[4], const float b[4])
+{
+    double dot = 0.0, diff = 0.0, sum = 0.0, s;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        dot += (double)a[i] * b[i];
+    s = dot < 0.0 ? -1.0 : 1.0;
+
+    for (i = 0; i < 4; i++) {
+        diff += (a[i] - s * b[i]) * (a[i] - s * b[i]);
+        sum += (a[i] + s * b[i]) * (a[i] + s * b[i]);
+    }
+
+    return 4.0 * atan2(sqrt(diff), sqrt(sum)) * 180.0 / 3.14159265358979;
+}
+
+static void getAttitude(const struct Fusion *fusion, float q[4])
+{
+    struct Vec4 att;
+
+    fusionGetAttitude(fusion, &att);
+    q[0] = att.x;
+    q[1] = att.y;
+    q[2] = att.z;
+    q[3] = att.w;
+}
+
+// q = q * exp(w * dt / 2), in double; x, y, z, w order as fusionGetAttitude()
+static void rotate(double q[4], const double w[3], double dt)
+{
+    double n = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    double s = n > 0.0 ? sin(0.5 * n * dt) / n : 0.0, c = cos(0.5 * n * dt);
+    double r[4] = { w[0] * s, w[1] * s, w[2] * s, c };
+    double p[4];
+
+    p[0] = q[3] * r[0] + q[0] * r[3] + q[1] * r[2] - q[2] * r[1];
+    p[1] = q[3] * r[1] - q[0] * r[2] + q[1] * r[3] + q[2] * r[0];
+    p[2] = q[3] * r[2] + q[0] * r[1] - q[1] * r[0] + q[2] * r[3];
+    p[3] = q[3] * r[3] - q[0] * r[0] - q[1] * r[1] - q[2] * r[2];
+    memcpy(q, p, sizeof(p));
+}
+
+// world vector v seen from the body at attitude q (body to world)
+static void toBody(struct Vec3 *out, const double q[4], const double v[3])
+{
+    double x = q[0], y = q[1], z = q[2], w = q[3];
+    double R[3][3] = {
+        { 1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w) },
+        { 2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w) },
+        { 2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y) },
+    };
+
+    initVec3(out, R[0][0] * v[0] + R[1][0] * v[1] + R[2][0] * v[2],
+             R[0][1] * v[0] + R[1][1] * v[1] + R[2][1] * v[2],
+             R[0][2] * v[0] + R[1][2] * v[1] + R[2][2] * v[2]);
+}
+
+static void addEvent(int type, const struct Vec3 *v, const double q[4])
+{
+    struct Event *e = &mEvents[mNumEvents++];
+
+    e->type = type;
+    e->v = *v;
+    e->truth[0] = q[0];
+    e->truth[1] = q[1];
+    e->truth[2] = q[2];
+    e->truth[3] = q[3];
+}
+
+// a slow tumble at up to ~30 deg/s, accel every run gyro samples, mag every 2 runs
+static void simulate(int run)
+{
+    static const double g[3] = { 0.0, 0.0, 9.81 }, mag[3] = { 0.0, 20.0, -40.0 };
+    double q[4] = { 0.0, 0.0, 0.0, 1.0 };
+    double dt = 1.0 / SIM_GYRO_HZ;
+    struct Vec3 v;
+    int i;
+
+    srand(1);
+    mNumEvents = 0;
+    mHaveTruth = true;
+    mDt[GYR] = dt;
+    mDt[ACC] = dt * run;
+    mDt[MAG] = dt * run * 2;
+
+    for (i = 0; i < SIM_SECONDS * SIM_GYRO_HZ && mNumEvents < MAX_EVENTS - 3; i++) {
+        double t = i * dt;
+        double w[3] = { 0.5 * sin(t), 0.3 * cos(0.7 * t), 0.2 };
+
+        initVec3(&v, w[0] + noise(0.01f), w[1] + noise(0.01f), w[2] + noise(0.01f));
+        rotate(q, w, dt);
+        addEvent(GYR, &v, q);
+
+        if ((i + 1) % run == 0) {
+            toBody(&v, q, g);
+            v.x += noise(0.05f);
+            v.y += noise(0.05f);
+            v.z += noise(0.05f);
+            addEvent(ACC, &v, q);
+        }
+
+        if ((i + 1) % (2 * run) == 0) {
+            toBody(&v, q, mag);
+            v.x += noise(0.3f);
+            v.y += noise(0.3f);
+            v.z += noise(0.3f);
+            addEvent(MAG, &v, q);
+        }
+    }
+}
+
+static bool loadTrace(const char *filename)
+{
+    static const double none[4] = { 0.0, 0.0, 0.0, 1.0 };
+    unsigned long long t, first[3] = { 0 }, last[3] = { 0 };
+    size_t count[3] = { 0 };
+    struct Vec3 v;
+    char type;
+    FILE *file;
+    int i;
+
+    file = fopen(filename, "r");
+    if (!file) {
+        perror(filename);
+        return false;
+    }
+
+    mNumEvents = 0;
+    mHaveTruth = false;
+    while (mNumEvents < MAX_EVENTS &&
+           fscanf(file, " %c %llu %f %f %f", &type, &t, &v.x, &v.y, &v.z) == 5) {
+        i = type == 'g' ? GYR : type == 'a' ? ACC : type == 'm' ? MAG : -1;
+        if (i < 0)
+            continue;
+        if (!count[i]++)
+            first[i] = t;
+        last[i] = t;
+        addEvent(i, &v, none);
+    }
+    fclose(file);
+
+    // the driver resamples each sensor to a fixed period
+    for (i = 0; i < 3; i++)
+        mDt[i] = count[i] > 1 ? (last[i] - first[i]) * 1e-9f / (count[i] - 1) : 0.0f;
+
+    if (!count[GYR] || !count[ACC]) {
+        fprintf(stderr, "%s: need gyro and accel samples\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
+static void handle(struct Fusion *fusion, const struct Event *e)
+{
+    if (e->type == ACC)
+        fusionHandleAcc(fusion, &e->v, mDt[ACC]);
+    else
+        fusionHandleMag(fusion, &e->v, mDt[MAG]);
+}
+
+// largest element difference of the two covariances, relative to the largest element
+static double covarianceDiff(const struct Fusion *a, const struct Fusion *b)
+{
+    double diff = 0.0, max = 0.0;
+    int i, j, r, c;
+
+    for (i = 0; i < 2; i++)
+        for (j = 0; j < 2; j++)
+            for (r = 0; r < 3; r++)
+                for (c = 0; c < 3; c++) {
+                    diff = fmax(diff, fabs(a->P[i][j].elem[r][c] - b->P[i][j].elem[r][c]));
+                    max = fmax(max, fabs(b->P[i][j].elem[r][c]));
+                }
+
+    return max > 0.0 ? diff / max : diff;
+}
+
+// one run of n gyro samples from the same state, both ways
+static void checkWindow(const struct Fusion *state, const struct Vec3 *w, size_t n,
+                        struct Result *res)
+{
+    struct Fusion batch = *state, ref = *state;
+    float q[4], refQ[4];
+    size_t i;
+
+    fusionHandleGyroBatch(&batch, w, n, mDt[GYR]);
+    for (i = 0; i < n; i++)
+        fusionHandleGyro(&ref, &w[i], mDt[GYR]);
+
+    getAttitude(&batch, q);
+    getAttitude(&ref, refQ);
+    res->windowDiff = attitudeDiff(q, refQ);
+    res->windowPDiff = covarianceDiff(&batch, &ref);
+}
+
+static void run(struct Result *res)
+{
+    bool windowChecked = false;
+    struct Fusion batch, ref;
+    struct Vec3 w[MAX_GYRO_RUN];
+    float q[4], refQ[4];
+    size_t i, j, n, gyro = 0, compared = 0;
+    double start;
+
+    memset(res, 0, sizeof(*res));
+    initFusion(&batch, FUSION_USE_MAG | FUSION_USE_GYRO | FUSION_REINITIALIZE);
+    initFusion(&ref, FUSION_USE_MAG | FUSION_USE_GYRO | FUSION_REINITIALIZE);
+
+    for (i = 0; i < mNumEvents; i = j) {
+        if (mEvents[i].type != GYR) {
+            handle(&batch, &mEvents[i]);
+            handle(&ref, &mEvents[i]);
+            j = i + 1;
+        } else {
+            for (j = i, n = 0; j < mNumEvents && mEvents[j].type == GYR && n < MAX_GYRO_RUN; j++)
+                w[n++] = mEvents[j].v;
+            gyro += n;
+
+            // once, from a settled state
+            if (!windowChecked && n > 1 && i > mNumEvents / 2 && fusionHasEstimate(&ref)) {
+                checkWindow(&ref, w, n, res);
+                windowChecked = true;
+            }
+
+            start = nowNs();
+            fusionHandleGyroBatch(&batch, w, n, mDt[GYR]);
+            res->ns += nowNs() - start;
+
+            start = nowNs();
+            for (n = 0; n < j - i; n++)
+                fusionHandleGyro(&ref, &w[n], mDt[GYR]);
+            res->refNs += nowNs() - start;
+        }
+
+        if (!fusionHasEstimate(&batch) || !fusionHasEstimate(&ref))
+            continue;
+
+        getAttitude(&batch, q);
+        getAttitude(&ref, refQ);
+        if (attitudeDiff(q, refQ) > res->maxDiff)
+            res->maxDiff = attitudeDiff(q, refQ);
+
+        // past the initial convergence
+        if (mHaveTruth && j > mNumEvents / 10) {
+            res->truthErr += attitudeDiff(q, mEvents[j - 1].truth);
+            res->refTruthErr += attitudeDiff(refQ, mEvents[j - 1].truth);
+            compared++;
+        }
+    }
+
+    if (compared) {
+        res->truthErr /= compared;
+        res->refTruthErr /= compared;
+    }
+    res->ns /= gyro;
+    res->refNs /= gyro;
+}
+
+static bool check(const char *name)
+{
+    struct Result res;
+    bool ok;
+
+    run(&res);
+
+    ok = res.windowDiff <= MAX_WINDOW_DIFF && res.windowPDiff <= MAX_WINDOW_P_DIFF &&
+         res.maxDiff <= MAX_ATTITUDE_DIFF && res.truthErr <= res.refTruthErr + MAX_TRUTH_DIFF;
+
+    printf("%s: %-8s one run: %.2g deg, P %.2g; over the run: max %.3f deg", ok ? "PASS" : "FAIL",
+           name, res.windowDiff, res.windowPDiff, res.maxDiff);
+    if (mHaveTruth)
+        printf(", error %.3f deg, reference %.3f deg", res.truthErr, res.refTruthErr);
+    printf(", %6.1f ns/sample, reference %6.1f ns/sample\n", res.ns, res.refNs);
+
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    static const int runs[] = { 4, 8, 16 };
+    char name[16];
+    bool ok = true;
+    size_t i;
+
+    if (argc > 1) {
+        if (!loadTrace(argv[1]))
+            return 2;
+        return check("trace") ? 0 : 1;
+    }
+
+    for (i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        simulate(runs[i]);
+        snprintf(name, sizeof(name), "run %d", runs[i]);
+        ok &= check(name);
+    }
+
+    return ok ? 0 : 1;
+}
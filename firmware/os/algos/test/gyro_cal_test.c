@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Off-target check of the staged gyro_cal updates the IMU drivers use
+// (gyroCalStageSample() and gyroCalFlushFifoRuns()) against feeding the same
+// samples one at a time through gyroCalUpdate{Accel,Gyro,Mag}() in time
+// order, plus a timing of both.
+//
+// The input is a simulated 400Hz gyro and accel (same time stamps, as in
+// the BMI160 FIFO frames) and a 50Hz mag, alternating between still periods
+// long enough for a calibration, motion, and gaps that trip the watchdog.
+// The samples are cut into FIFO reads of random length; the temperature only
+// changes between reads. After every read the two GyroCal structures must be
+// bytewise identical.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <calibration/gyroscope/gyro_cal.h>
+
+#define MAX_EVENTS          (1 << 21)
+#define MAX_READ            160     // samples per simulated FIFO read
+
+#define GYRO_PERIOD_NS      2500000ull
+#define MAG_DECIMATION      8
+#define SEGMENTS            300
+
+#define SEC_TO_NANOS(s)     ((uint64_t)((s) * 1e9))
+
+enum { ACC, GYR, MAG };
+
+struct Event {
+    int type;
+    uint64_t t;
+    float v[3];
+};
+
+static struct Event mEvents[MAX_EVENTS];
+static size_t mNumEvents;
+static uint32_t mRandState = 0x2545f491;
+
+static uint32_t rnd(void)
+{
+    mRandState ^= mRandState << 13;
+    mRandState ^= mRandState >> 17;
+    mRandState ^= mRandState << 5;
+    return mRandState;
+}
+
+static float noise(float scale)
+{
+    return scale * ((float)(rnd() % 20001) / 10000.0f - 1.0f);
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void addEvent(int type, uint64_t t, float x, float y, float z)
+{
+    if (mNumEvents < MAX_EVENTS) {
+        mEvents[mNumEvents].type = type;
+        mEvents[mNumEvents].t = t;
+        mEvents[mNumEvents].v[0] = x;
+        mEvents[mNumEvents].v[1] = y;
+        mEvents[mNumEvents].v[2] = z;
+        mNumEvents++;
+    }
+}
+
+// Events are generated in the order the per-sample reference feeds them:
+// by time stamp, accel before gyro before mag on equal ones.
+static void simulate(void)
+{
+    uint64_t t = SEC_TO_NANOS(1);
+    size_t seg, i, n, k = 0;
+
+    for (seg = 0; seg < SEGMENTS; seg++) {
+        int kind = rnd() % 4;   // 0, 1: still, 2: moving, 3: gap
+        float gyr = kind < 2 ? 1e-3f : 0.5f;
+        float acc = kind < 2 ? 5e-3f : 1.0f;
+        float mag = kind < 2 ? 0.3f : 5.0f;
+
+        if (kind == 3) {
+            t += SEC_TO_NANOS(2 + rnd() % 8);
+            continue;
+        }
+
+        n = (2 + rnd() % 10) * 400;
+        for (i = 0; i < n; i++, k++, t += GYRO_PERIOD_NS + rnd() % 20000) {
+            addEvent(ACC, t, noise(acc), noise(acc), 9.81f + noise(acc));
+            addEvent(GYR, t, 0.01f + noise(gyr), -0.02f + noise(gyr), 0.005f + noise(gyr));
+            if (k % MAG_DECIMATION == 0)
+                addEvent(MAG, t, 20.0f + noise(mag), -5.0f + noise(mag), 40.0f + noise(mag));
+        }
+    }
+}
+
+static void init(struct GyroCal *gyroCal)
+{
+    // As in the BMI160 driver.
+    const struct GyroCalParameters parameters = {
+        SEC_TO_NANOS(5),                // min_still_duration_nanos
+        SEC_TO_NANOS(5.9f),             // max_still_duration_nanos
+        0,                              // calibration_time_nanos
+        SEC_TO_NANOS(1.5f),             // window_time_duration_nanos
+        0,                              // bias_x
+        0,                              // bias_y
+        0,                              // bias_z
+        0.95f,                          // stillness_threshold
+        40.0f * 1e-3f * 3.14159265f / 180.0f,  // stillness_mean_delta_limit
+        7.5e-5f,                        // gyro_var_threshold
+        1.5e-5f,                        // gyro_confidence_delta
+        4.5e-3f,                        // accel_var_threshold
+        9.0e-4f,                        // accel_confidence_delta
+        5.0f,                           // mag_var_threshold
+        1.0f,                           // mag_confidence_delta
+        1.5f,                           // temperature_delta_limit_celsius
+        true                            // gyro_calibration_enable
+    };
+
+    memset(gyroCal, 0, sizeof(*gyroCal));
+    gyroCalInit(gyroCal, &parameters);
+}
+
+static void feedSingle(struct GyroCal *gyroCal, const struct Event *e, float temp)
+{
+    switch (e->type) {
+    case ACC:
+        gyroCalUpdateAccel(gyroCal, e->t, e->v[0], e->v[1], e->v[2]);
+        break;
+    case GYR:
+        gyroCalUpdateGyro(gyroCal, e->t, e->v[0], e->v[1], e->v[2], temp);
+        break;
+    default:
+        gyroCalUpdateMag(gyroCal, e->t, e->v[0], e->v[1], e->v[2]);
+        break;
+    }
+}
+
+static void feedStaged(struct GyroCal *gyroCal, struct GyroCalFifoRuns *runs,
+                       const struct Event *e, float temp)
+{
+    static const enum GyroCalRunSensor sensor[] = {
+        [ACC] = GYRO_CAL_RUN_ACCEL, [GYR] = GYRO_CAL_RUN_GYRO, [MAG] = GYRO_CAL_RUN_MAG,
+    };
+
+    if (gyroCalStageSample(runs, sensor[e->type], e->t, e->v[0], e->v[1], e->v[2]))
+        gyroCalFlushFifoRuns(gyroCal, runs, temp);
+}
+
+int main(void)
+{
+    static struct GyroCal ref, staged;
+    static struct GyroCalFifoRuns runs;
+    size_t i, j, n, reads = 0, cals = 0, mismatches = 0;
+    double refNs = 0.0, stagedNs = 0.0, t0;
+    float temp = 25.0f;
+
+    simulate();
+    init(&ref);
+    init(&staged);
+
+    for (i = 0; i < mNumEvents; i += n, reads++) {
+        n = 1 + rnd() % MAX_READ;
+        if (n > mNumEvents - i)
+            n = mNumEvents - i;
+
+        t0 = nowNs();
+        for (j = i; j < i + n; j++)
+            feedSingle(&ref, &mEvents[j], temp);
+        refNs += nowNs() - t0;
+
+        t0 = nowNs();
+        for (j = i; j < i + n; j++)
+            feedStaged(&staged, &runs, &mEvents[j], temp);
+        gyroCalFlushFifoRuns(&staged, &runs, temp);
+        stagedNs += nowNs() - t0;
+
+        if (memcmp(&ref, &staged, sizeof(ref))) {
+            if (!mismatches++)
+                printf("FAIL: gyro_cal state differs after read %zu (sample %zu)\n", reads, i + n);
+            staged = ref;
+        }
+
+        if (gyroCalNewBiasAvailable(&ref))
+            cals++;
+        gyroCalNewBiasAvailable(&staged);
+
+        temp += noise(0.05f);
+    }
+
+    printf("%s: gyro_cal %zu samples in %zu reads, %zu calibrations, %zu mismatches, "
+           "%5.2f ns/sample, reference %5.2f ns/sample\n", mismatches || !cals ? "FAIL" : "PASS",
+           mNumEvents, reads, cals, mismatches, stagedNs / mNumEvents, refNs / mNumEvents);
+
+    if (mismatches || !cals)
+        return 1;
+
+    return 0;
+}
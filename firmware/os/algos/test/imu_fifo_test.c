@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Off-target check of imu_fifo_decode() against the per-driver decodes it
+// replaced, plus a timing of both over a FIFO burst.
+//
+// The references are the bmi160 and lsm6dsm sample decodes as they were. The
+// drivers now decode with imu_fifo_decode() and remap the scaled floats with
+// the same compile time macros. lsm6dsm used to remap the raw integers and
+// scale after; negation commutes with the scaling, so the results must be
+// equal (0.0f and -0.0f compare equal, as they should).
+//
+// The burst is random, or read from the file given as the only argument: a
+// raw FIFO dump, taken as back to back 6 byte x/y/z samples.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algos/imu_fifo.h>
+
+#define MAX_SAMPLES         4096
+#define BENCH_ROUNDS        500
+#define BENCH_REPEATS       8       // interleaved, the fastest of each is kept
+
+#define BMI160_KSCALE       0.00239364f
+#define LSM6DSM_KSCALE      0.00122173f
+
+// lunchbox mounting: x = -y, y = x
+#define BMI160_TO_ANDROID_COORDINATE(x, y, z)   \
+    do {                                        \
+        float xi = x, yi = y, zi = z;           \
+        x = -yi; y = xi; z = zi;                \
+    } while (0)
+
+// LSM6DSM_ACCEL_GYRO_ROT_MATRIX 0,1,0, -1,0,0, 0,0,-1 through its X/Y/Z_MAP
+#define LSM6DSM_REMAP_X(x, y, z)    (-(y))
+#define LSM6DSM_REMAP_Y(x, y, z)    (x)
+#define LSM6DSM_REMAP_Z(x, y, z)    (-(z))
+
+static uint8_t mBurst[MAX_SAMPLES * 6];
+static size_t mNumSamples;
+
+__attribute__((noinline))
+static void refBmi160Decode(const uint8_t *buf, size_t n, float *out)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++, buf += 6, out += 3) {
+        int16_t raw_x = (buf[0] | buf[1] << 8);
+        int16_t raw_y = (buf[2] | buf[3] << 8);
+        int16_t raw_z = (buf[4] | buf[5] << 8);
+        float x = (float)raw_x * BMI160_KSCALE;
+        float y = (float)raw_y * BMI160_KSCALE;
+        float z = (float)raw_z * BMI160_KSCALE;
+
+        BMI160_TO_ANDROID_COORDINATE(x, y, z);
+        out[0] = x;
+        out[1] = y;
+        out[2] = z;
+    }
+}
+
+__attribute__((noinline))
+static void refLsm6dsmDecode(const uint8_t *buf, size_t n, const int16_t *bias, float *out)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++, buf += 6, out += 3) {
+        int16_t x = (int16_t)(buf[1] << 8) | buf[0];
+        int16_t y = (int16_t)(buf[3] << 8) | buf[2];
+        int16_t z = (int16_t)(buf[5] << 8) | buf[4];
+
+        x -= bias[0];
+        y -= bias[1];
+        z -= bias[2];
+
+        out[0] = LSM6DSM_REMAP_X(x, y, z) * LSM6DSM_KSCALE;
+        out[1] = LSM6DSM_REMAP_Y(x, y, z) * LSM6DSM_KSCALE;
+        out[2] = LSM6DSM_REMAP_Z(x, y, z) * LSM6DSM_KSCALE;
+    }
+}
+
+__attribute__((noinline))
+static void bmi160Decode(const uint8_t *buf, size_t n, const int16_t *bias, float *out)
+{
+    size_t i;
+
+    (void)bias;
+    for (i = 0; i < n; i++, buf += 6, out += 3) {
+        float v[3];
+
+        imu_fifo_decode(buf, NULL, BMI160_KSCALE, v);
+        BMI160_TO_ANDROID_COORDINATE(v[0], v[1], v[2]);
+        out[0] = v[0];
+        out[1] = v[1];
+        out[2] = v[2];
+    }
+}
+
+__attribute__((noinline))
+static void lsm6dsmDecode(const uint8_t *buf, size_t n, const int16_t *bias, float *out)
+{
+    // a local copy, as the driver makes of its gyro offset
+    const int16_t b[3] = { bias[0], bias[1], bias[2] };
+    size_t i;
+
+    for (i = 0; i < n; i++, buf += 6, out += 3) {
+        float v[3];
+
+        imu_fifo_decode(buf, b, LSM6DSM_KSCALE, v);
+        out[0] = LSM6DSM_REMAP_X(v[0], v[1], v[2]);
+        out[1] = LSM6DSM_REMAP_Y(v[0], v[1], v[2]);
+        out[2] = LSM6DSM_REMAP_Z(v[0], v[1], v[2]);
+    }
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool loadBurst(const char *filename)
+{
+    FILE *file;
+    size_t len;
+    size_t i;
+
+    if (!filename) {
+        srand(1);
+        for (i = 0; i < sizeof(mBurst); i++)
+            mBurst[i] = rand();
+        // the int16 extremes, which wrap when the bias is applied
+        memcpy(mBurst, "\x00\x80\xff\x7f\x00\x80\xff\x7f\x00\x80\xff\x7f", 12);
+        mNumSamples = MAX_SAMPLES;
+        return true;
+    }
+
+    file = fopen(filename, "rb");
+    if (!file) {
+        perror(filename);
+        return false;
+    }
+    len = fread(mBurst, 1, sizeof(mBurst), file);
+    fclose(file);
+
+    mNumSamples = len / 6;
+    if (mNumSamples == 0) {
+        fprintf(stderr, "%s: no samples\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
+typedef void (*decode_t)(const uint8_t *buf, size_t n, const int16_t *bias, float *out);
+
+static bool check(const char *name, decode_t decode, decode_t ref, const int16_t *bias)
+{
+    static float out[MAX_SAMPLES * 3], refOut[MAX_SAMPLES * 3];
+    double start, t, ns = 0.0, refNs = 0.0;
+    size_t i;
+    int r, k;
+
+    decode(mBurst, mNumSamples, bias, out);
+    ref(mBurst, mNumSamples, bias, refOut);
+    for (i = 0; i < mNumSamples * 3; i++) {
+        if (out[i] != refOut[i]) {
+            printf("FAIL: %s differs from reference at sample %zu axis %zu: %g vs %g\n",
+                   name, i / 3, i % 3, out[i], refOut[i]);
+            return false;
+        }
+    }
+
+    for (k = 0; k < BENCH_REPEATS; k++) {
+        start = nowNs();
+        for (r = 0; r < BENCH_ROUNDS; r++)
+            decode(mBurst, mNumSamples, bias, out);
+        t = nowNs() - start;
+        if (k == 0 || t < ns)
+            ns = t;
+
+        start = nowNs();
+        for (r = 0; r < BENCH_ROUNDS; r++)
+            ref(mBurst, mNumSamples, bias, refOut);
+        t = nowNs() - start;
+        if (k == 0 || t < refNs)
+            refNs = t;
+    }
+
+    printf("PASS: %-8s %zu samples, %5.2f ns/sample, reference %5.2f ns/sample\n", name,
+           mNumSamples, ns / BENCH_ROUNDS / mNumSamples, refNs / BENCH_ROUNDS / mNumSamples);
+
+    return true;
+}
+
+static void refBmi160(const uint8_t *buf, size_t n, const int16_t *bias, float *out)
+{
+    (void)bias;
+    refBmi160Decode(buf, n, out);
+}
+
+int main(int argc, char **argv)
+{
+    static const int16_t gyroBias[3] = { -7, 12, 32767 };
+    bool ok = true;
+
+    if (!loadBurst(argc > 1 ? argv[1] : NULL))
+        return 2;
+
+    ok &= check("bmi160", bmi160Decode, refBmi160, NULL);
+    ok &= check("lsm6dsm", lsm6dsmDecode, refLsm6dsmDecode, gyroBias);
+
+    return ok ? 0 : 1;
+}
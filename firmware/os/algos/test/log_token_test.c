@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Off-target check of os/core/logToken.c: the driver debug lines are logged
+// through osLogT() with random arguments, the HOST_EVT_DEBUG_LOG payloads the
+// flush hands to osEnqueueEvtOrFree() are decoded the way the host does it,
+// and every line must come out as the libc printf of the same arguments.
+// Then osLogT() is timed against the cvprintf() that osLog() runs per line.
+//
+// The OS calls logToken.c makes are stubbed below: osDefer() only records the
+// flush callback, which the test runs itself.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <atomic.h>
+#include <heap.h>
+#include <hostIntf.h>
+#include <logToken.h>
+#include <printf.h>
+#include <seos.h>
+
+#define ITERATIONS          200000
+#define FLUSH_EVERY         16      // records between flushes while timing
+
+// where a record's token is counted from; anywhere in the image will do
+const char __attribute__((section(".logstr"))) __logstr_start[] = "";
+
+static OsDeferCbkF mDeferred;
+static char mDecoded[FLUSH_EVERY + 1][256];
+static size_t mNumDecoded, mTokenBytes;
+static uint32_t mRandState = 0x2545f491;
+
+uint32_t atomicAdd32bits(volatile uint32_t *val, uint32_t addend)
+{
+    uint32_t old = *val;
+
+    *val = old + addend;
+    return old;
+}
+
+uint32_t atomicXchgByte(volatile uint8_t *byte, uint32_t newVal)
+{
+    uint32_t old = *byte;
+
+    *byte = newVal;
+    return old;
+}
+
+bool atomicCmpXchg32bits(volatile uint32_t *word, uint32_t prevVal, uint32_t newVal)
+{
+    if (*word != prevVal)
+        return false;
+
+    *word = newVal;
+    return true;
+}
+
+void *heapAlloc(uint32_t sz)
+{
+    return malloc(sz);
+}
+
+void heapFree(void *ptr)
+{
+    free(ptr);
+}
+
+bool osDefer(OsDeferCbkF callback, void *cookie, bool urgent)
+{
+    (void)cookie;
+    (void)urgent;
+    mDeferred = callback;
+    return true;
+}
+
+static uint32_t getWords(const uint32_t *args, uint32_t *pos, bool wide, uint64_t *val)
+{
+    *val = args[(*pos)++];
+    if (wide)
+        *val |= (uint64_t)args[(*pos)++] << 32;
+
+    return *pos;
+}
+
+// the host side: walk the format as logTokenCollect() does, printing each
+// conversion with the arguments it recorded
+static void decode(const struct LogTokenRecord *rec, const uint32_t *args, char *out, size_t size)
+{
+    const char *fmt = __logstr_start + (int32_t)rec->token;
+    bool lp64 = rec->flags & LOG_TOKEN_FLAG_LP64;
+    size_t len = 0;
+    uint32_t pos = 0;
+    uint64_t val;
+
+    while (*fmt && len < size - 1) {
+        char spec[16] = "%";
+        size_t specLen = 1;
+        uint32_t numLong = 0;
+        bool useSizeT = false, wide;
+        const uint8_t *str;
+        char c;
+
+        if ((c = *fmt++) != '%') {
+            out[len++] = c;
+            continue;
+        }
+
+        while ((c = *fmt++) && strchr("0123456789.#-+ hlLzt", c)) {
+            if (c == 'l')
+                numLong++;
+            else if (c == 'z' || c == 't')
+                useSizeT = true;
+            else if (c != 'h' && c != 'L' && specLen < sizeof(spec) - 4)
+                spec[specLen++] = c;
+        }
+
+        switch (c) {
+        case '%':
+            out[len++] = '%';
+            continue;
+        case 'c': case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            wide = numLong > 1 || (numLong && lp64) || (useSizeT && lp64);
+            getWords(args, &pos, wide, &val);
+            if (wide) {
+                spec[specLen++] = 'l';
+                spec[specLen++] = 'l';
+            }
+            spec[specLen++] = c;
+            if (wide)
+                len += snprintf(out + len, size - len, spec, (unsigned long long)val);
+            else
+                len += snprintf(out + len, size - len, spec, (unsigned int)val);
+            break;
+        case 'p':
+            getWords(args, &pos, lp64, &val);
+            len += snprintf(out + len, size - len, "%p", (void *)(uintptr_t)val);
+            break;
+        case 's':
+            str = (const uint8_t *)(args + pos);
+            pos += (1 + str[0] + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+            spec[specLen++] = '.';
+            spec[specLen++] = '*';
+            spec[specLen++] = 's';
+            len += snprintf(out + len, size - len, spec, str[0], (const char *)str + 1);
+            break;
+        default:
+            fmt--;
+            break;
+        }
+        if (len > size - 1)
+            len = size - 1;
+    }
+    out[len] = 0;
+}
+
+bool osEnqueueEvtOrFree(uint32_t evtType, void *evtData, EventFreeF evtFreeF)
+{
+    struct HostIntfDataBuffer *buffer = evtData;
+    uint32_t args[LOG_TOKEN_ARG_WORDS_MAX];
+    struct LogTokenRecord rec;
+    size_t pos = 1;
+
+    (void)evtType;
+
+    if (buffer->buffer[0] != LOG_TOKEN_MARK)
+        mNumDecoded = FLUSH_EVERY + 1;
+
+    while (pos + sizeof(rec) <= buffer->length) {
+        memcpy(&rec, buffer->buffer + pos, sizeof(rec));
+        pos += sizeof(rec);
+        memcpy(args, buffer->buffer + pos, rec.numWords * sizeof(uint32_t));
+        pos += rec.numWords * sizeof(uint32_t);
+
+        if (mNumDecoded < FLUSH_EVERY && rec.token != LOG_TOKEN_DROPPED)
+            decode(&rec, args, mDecoded[mNumDecoded++], sizeof(mDecoded[0]));
+        else
+            mNumDecoded = FLUSH_EVERY + 1;
+    }
+
+    mTokenBytes += buffer->length;
+    evtFreeF(evtData);
+    return true;
+}
+
+static void flush(void)
+{
+    OsDeferCbkF cbk = mDeferred;
+
+    mDeferred = NULL;
+    if (cbk)
+        cbk(NULL);
+}
+
+static uint32_t rnd(void)
+{
+    mRandState ^= mRandState << 13;
+    mRandState ^= mRandState >> 17;
+    mRandState ^= mRandState << 5;
+    return mRandState;
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool nullPutchar(void *userData, char c)
+{
+    (*(size_t *)userData)++;
+    (void)c;
+    return true;
+}
+
+static uint32_t textLog(const char *fmt, ...)
+{
+    static size_t chars;
+    uint32_t ret;
+    va_list vl;
+
+    va_start(vl, fmt);
+    ret = cvprintf(nullPutchar, 0, &chars, fmt, vl);
+    va_end(vl);
+
+    return ret;
+}
+
+static void expect(char *out, size_t size, const char *fmt, ...)
+{
+    va_list vl;
+
+    va_start(vl, fmt);
+    vsnprintf(out, size, fmt, vl);
+    va_end(vl);
+}
+
+// the lines the BMI160 and LSM6DSM drivers log from their interrupt and FIFO
+// paths, in the form the DEBUG_PRINT macros hand them to osLogT()
+#define LINES(LOG, a, b, c, t, s)                                                   \
+    LOG("[BMI160] int1: fifo len %d, frames %d, ts %llu\n", (int)(a), (int)(b), (unsigned long long)(t)); \
+    LOG("[BMI160] chunked read %d of %d at 0x%02x\n", (int)(a), (int)(b), (unsigned)(c)); \
+    LOG("[BMI160] skip frame hdr 0x%x, %d bytes left, state %s\n", (unsigned)(c), (int)(a), (s)); \
+    LOG("[BMI160] wm %d: acc %lu gyr %lu mag %lu\n", (int)(a), (unsigned long)(b), (unsigned long)(c), (unsigned long)(t)); \
+    LOG("[LSM6DSM] %s: fifo %u samples, delta %lld ns, %%ok\n", (s), (unsigned)(a), (long long)(t) - (long long)(b)); \
+    LOG("[LSM6DSM] %s %s %p %zu\n", (s), "done", (void *)(uintptr_t)(c), (size_t)(b))
+
+#define TOKEN_LOG(fmt, ...) osLogT(LOG_DEBUG, fmt, ##__VA_ARGS__)
+#define TEXT_LOG(fmt, ...) textLog(fmt, ##__VA_ARGS__)
+#define EXPECT_LOG(fmt, ...) expect(mExpected[n++], sizeof(mExpected[0]), fmt, ##__VA_ARGS__)
+
+static const char *const mStates[] = { "idle", "fifo_read", "sensor_time_overflow_wait", "" };
+static char mExpected[FLUSH_EVERY][256];
+
+int main(void)
+{
+    size_t i, j, n, lines = 0, textChars = 0, tokenBytes, mismatches = 0;
+    double tokenNs = 0.0, textNs = 0.0, t0;
+    uint32_t a, b, c;
+    uint64_t t;
+    const char *s;
+
+    logTokenStart();
+
+    for (i = 0; i < ITERATIONS; i++) {
+        a = rnd() % 1024;
+        b = rnd();
+        c = rnd() % 256;
+        t = (uint64_t)rnd() << 20 | rnd();
+        s = mStates[rnd() % 4];
+
+        n = 0;
+        LINES(EXPECT_LOG, a, b, c, t, s);
+        for (j = 0; j < n; j++)
+            textChars += strlen(mExpected[j]);
+
+        t0 = nowNs();
+        LINES(TOKEN_LOG, a, b, c, t, s);
+        if (i % (FLUSH_EVERY / n) == FLUSH_EVERY / n - 1 || i == ITERATIONS - 1)
+            flush();
+        tokenNs += nowNs() - t0;
+
+        t0 = nowNs();
+        LINES(TEXT_LOG, a, b, c, t, s);
+        textNs += nowNs() - t0;
+
+        lines += n;
+
+        // check one batch in 64 decoded against what libc prints
+        if (i % 64)
+            continue;
+
+        flush();
+        tokenBytes = mTokenBytes;
+        mNumDecoded = 0;
+        LINES(TOKEN_LOG, a, b, c, t, s);
+        flush();
+        mTokenBytes = tokenBytes;
+        if (mNumDecoded != n) {
+            if (!mismatches++)
+                printf("FAIL: log_token decoded %zu of %zu lines\n", mNumDecoded, n);
+            continue;
+        }
+        for (j = 0; j < n; j++) {
+            if (strcmp(mDecoded[j], mExpected[j]) && !mismatches++)
+                printf("FAIL: log_token decoded \"%s\", expected \"%s\"\n", mDecoded[j], mExpected[j]);
+        }
+    }
+
+    printf("%s: log_token %zu lines, %zu mismatches, %5.1f ns/line (%4.1f bytes), "
+           "text %5.1f ns/line (%4.1f bytes)\n", mismatches ? "FAIL" : "PASS",
+           lines, mismatches, tokenNs / lines, (double)mTokenBytes / lines,
+           textNs / lines, (double)textChars / lines);
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Off-target check of the over_temp_cal running model sums and temperature
+// index against recomputing them from 'model_data', plus a timing.
+//
+// A gyro offset with a linear temperature dependence is fed through a 6-day
+// simulated trace: temperature at 1Hz wandering between 15C and 60C, and
+// offset estimates every 10s to 10min, as gyro_cal would give them. The
+// parameters are the BMI160 driver's, with a short age limit so stale data
+// removal runs too. After every call:
+//  - each 'model_data' point is in exactly one bucket chain, the one for its
+//    temperature;
+//  - the per weighting level sums match a double precision sum over
+//    'model_data';
+//  - a nearest point found by overTempCalSetTemperature() is the one a brute
+//    force search picks, lowest index on ties;
+//  - a new model matches a double precision weighted least-squares fit.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <calibration/over_temp/over_temp_cal.h>
+#include <calibration/util/cal_log.h>
+
+#define DAYS                6
+#define TEMP_PERIOD_NS      SEC_TO_NANOS(1)
+
+// as in over_temp_cal.c
+#define TEMP_BUCKET_CELSIUS ((OTC_TEMP_MAX_CELSIUS - OTC_TEMP_MIN_CELSIUS) / OTC_NUM_TEMP_BUCKETS)
+#define MIN_WEIGHT          0.04
+#define SUMS_REF_CELSIUS    JUMPSTART_START_TEMP_CELSIUS
+
+// relative to the largest sum of magnitudes seen on the level: the running
+// sums keep the round-off of points that have left it until the next rebuild
+#define MAX_SUM_ERR         1e-4
+#define MAX_MODEL_ERR       1e-3    // of the sensitivity, relative to its limit
+
+static uint32_t mRandState = 0x2545f491;
+static size_t mFailures;
+
+static uint32_t rnd(void)
+{
+    mRandState ^= mRandState << 13;
+    mRandState ^= mRandState >> 17;
+    mRandState ^= mRandState << 5;
+    return mRandState;
+}
+
+static float noise(float scale)
+{
+    return scale * ((float)(rnd() % 20001) / 10000.0f - 1.0f);
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void fail(uint64_t t, const char *what)
+{
+    if (!mFailures++)
+        printf("FAIL: over_temp_cal %s at %.1f h\n", what, t / 3.6e12);
+}
+
+static size_t tempBucket(float temp)
+{
+    const int32_t bucket = CAL_FLOOR((temp - OTC_TEMP_MIN_CELSIUS) / TEMP_BUCKET_CELSIUS);
+
+    if (bucket < 0)
+        return 0;
+    return bucket < OTC_NUM_TEMP_BUCKETS ? (size_t)bucket : OTC_NUM_TEMP_BUCKETS - 1;
+}
+
+static size_t weightLevel(const struct OverTempCal *otc, uint64_t age)
+{
+    size_t i;
+
+    for (i = 0; i < OTC_NUM_WEIGHT_LEVELS; i++) {
+        if (age <= otc->weighting_function[i].offset_age_nanos)
+            break;
+    }
+
+    return i;
+}
+
+static double levelWeight(const struct OverTempCal *otc, size_t level)
+{
+    return level < OTC_NUM_WEIGHT_LEVELS ? otc->weighting_function[level].weight : MIN_WEIGHT;
+}
+
+static void checkIndex(const struct OverTempCal *otc, uint64_t t)
+{
+    uint8_t seen[OTC_MODEL_SIZE] = { 0 };
+    size_t b, i, count = 0;
+
+    for (b = 0; b < OTC_NUM_TEMP_BUCKETS; b++) {
+        for (i = otc->bucket_head[b]; i != OTC_NO_MODEL_INDEX; i = otc->bucket_next[i]) {
+            if (i >= otc->num_model_pts || seen[i]++ || count++ > OTC_MODEL_SIZE ||
+                tempBucket(otc->model_data[i].offset_temp_celsius) != b) {
+                fail(t, "bucket chains do not match model_data");
+                return;
+            }
+        }
+    }
+
+    if (count != otc->num_model_pts)
+        fail(t, "bucket chains miss model_data points");
+}
+
+static double mPeak[OTC_NUM_WEIGHT_LEVELS + 1][4];
+
+static bool close(double a, double b, double *peak, double mag)
+{
+    if (mag > *peak)
+        *peak = mag;
+
+    return fabs(a - b) <= MAX_SUM_ERR * *peak;
+}
+
+static void checkSums(const struct OverTempCal *otc, uint64_t t)
+{
+    double st[OTC_NUM_WEIGHT_LEVELS + 1] = { 0 }, stt[OTC_NUM_WEIGHT_LEVELS + 1] = { 0 };
+    double so[OTC_NUM_WEIGHT_LEVELS + 1][3] = { { 0 } }, stso[OTC_NUM_WEIGHT_LEVELS + 1][3] = { { 0 } };
+    double mag[OTC_NUM_WEIGHT_LEVELS + 1][4] = { { 0 } };  // |t|, t^2, |o|, |t * o|
+    size_t num[OTC_NUM_WEIGHT_LEVELS + 1] = { 0 };
+    size_t i, j, l;
+
+    for (i = 0; i < otc->num_model_pts; i++) {
+        const struct OverTempModelThreeAxis *d = &otc->model_data[i];
+        double temp = d->offset_temp_celsius - SUMS_REF_CELSIUS;
+
+        l = weightLevel(otc, d->offset_age_nanos);
+        num[l]++;
+        st[l] += temp;
+        stt[l] += temp * temp;
+        mag[l][0] += fabs(temp);
+        mag[l][1] += temp * temp;
+        for (j = 0; j < 3; j++) {
+            so[l][j] += d->offset[j];
+            stso[l][j] += temp * d->offset[j];
+            mag[l][2] += fabs(d->offset[j]);
+            mag[l][3] += fabs(temp * d->offset[j]);
+        }
+    }
+
+    for (l = 0; l <= OTC_NUM_WEIGHT_LEVELS; l++) {
+        const struct OverTempCalModelSums *s = &otc->model_sums[l];
+        bool ok = s->num_pts == num[l] && close(s->st, st[l], &mPeak[l][0], mag[l][0]) &&
+                  close(s->stt, stt[l], &mPeak[l][1], mag[l][1]);
+
+        for (j = 0; j < 3; j++)
+            ok = ok && close(s->so[j], so[l][j], &mPeak[l][2], mag[l][2]) &&
+                 close(s->stso[j], stso[l][j], &mPeak[l][3], mag[l][3]);
+        if (!ok) {
+            fail(t, "model sums differ from model_data");
+            return;
+        }
+    }
+}
+
+static void checkNearest(const struct OverTempCal *otc, float temp, uint64_t t)
+{
+    size_t i, best = 0;
+    float d, bestD = 1e30f;
+
+    for (i = 0; i < otc->num_model_pts; i++) {
+        d = fabsf(otc->model_data[i].offset_temp_celsius - temp);
+        if (d < bestD) {
+            best = i;
+            bestD = d;
+        }
+    }
+
+    if (otc->nearest_offset != &otc->model_data[best])
+        fail(t, "nearest point differs from a brute force search");
+}
+
+// returns the largest sensitivity error, relative to the limit
+static double checkModel(const struct OverTempCal *otc, uint64_t t)
+{
+    double sw = 0.0, st = 0.0, stt = 0.0, so[3] = { 0 }, stso[3] = { 0 }, err, maxErr = 0.0;
+    size_t i, j;
+
+    for (i = 0; i < otc->num_model_pts; i++) {
+        const struct OverTempModelThreeAxis *d = &otc->model_data[i];
+        double w = levelWeight(otc, weightLevel(otc, d->offset_age_nanos));
+        double temp = d->offset_temp_celsius;
+
+        sw += w;
+        st += w * temp;
+        stt += w * temp * temp;
+        for (j = 0; j < 3; j++) {
+            so[j] += w * d->offset[j];
+            stso[j] += w * temp * d->offset[j];
+        }
+    }
+
+    for (j = 0; j < 3; j++) {
+        double sens = (stso[j] - st * so[j] / sw) / (stt - st * st / sw);
+        double icpt = (so[j] - sens * st) / sw;
+
+        // only axes the fit limits let through are updated
+        if (fabs(sens) >= otc->temp_sensitivity_limit || fabs(icpt) >= otc->sensor_intercept_limit)
+            continue;
+
+        err = fabs(otc->temp_sensitivity[j] - sens) / otc->temp_sensitivity_limit;
+        if (err > maxErr)
+            maxErr = err;
+    }
+
+    if (maxErr > MAX_MODEL_ERR)
+        fail(t, "model differs from a weighted least-squares fit");
+
+    return maxErr;
+}
+
+int main(void)
+{
+    static struct OverTempCal otc;
+    const struct OverTempCalParameters parameters = {
+        MSEC_TO_NANOS(500),     // min_temp_update_period_nanos
+        HRS_TO_NANOS(12),       // age_limit_nanos, short so stale data goes
+        0.75f,                  // delta_temp_per_bin
+        40.0f * MDEG_TO_RAD,    // jump_tolerance
+        50.0f * MDEG_TO_RAD,    // outlier_limit
+        80.0f * MDEG_TO_RAD,    // temp_sensitivity_limit
+        3.0e3f * MDEG_TO_RAD,   // sensor_intercept_limit
+        0.1f * MDEG_TO_RAD,     // significant_offset_change
+        5,                      // min_num_model_pts
+        true                    // over_temp_enable
+    };
+    const float sens[3] = { 2.0f * MDEG_TO_RAD, -5.0f * MDEG_TO_RAD, 0.5f * MDEG_TO_RAD };
+    const float icpt[3] = { 100.0f * MDEG_TO_RAD, -50.0f * MDEG_TO_RAD, 20.0f * MDEG_TO_RAD };
+    uint64_t t, end = DAYS_TO_NANOS(DAYS), nextEstimate = MIN_TO_NANOS(1);
+    size_t estimates = 0, temps = 0, models = 0, nearest = 0, maxPts = 0, j;
+    double ns = 0.0, maxModelErr = 0.0, err, t0;
+    float temp = 30.0f, target = 30.0f, offset[3], lastCheck;
+
+    overTempCalInit(&otc, &parameters);
+
+    for (t = SEC_TO_NANOS(1); t < end; t += TEMP_PERIOD_NS) {
+        // a slow walk towards a target that changes every so often
+        if (rnd() % 3600 == 0)
+            target = 15.0f + (rnd() % 4500) / 100.0f;
+        temp += 0.002f * (target - temp) + noise(0.02f);
+
+        lastCheck = otc.last_temp_check_celsius;
+        t0 = nowNs();
+        overTempCalSetTemperature(&otc, t, temp);
+        ns += nowNs() - t0;
+        temps++;
+
+        if (otc.last_temp_check_celsius != lastCheck) {
+            checkNearest(&otc, otc.last_temp_check_celsius, t);
+            nearest++;
+        }
+
+        if (t >= nextEstimate) {
+            for (j = 0; j < 3; j++)
+                offset[j] = sens[j] * temp + icpt[j] + noise(0.3f * MDEG_TO_RAD);
+
+            t0 = nowNs();
+            overTempCalUpdateSensorEstimate(&otc, t, offset, temp);
+            ns += nowNs() - t0;
+            estimates++;
+
+            if (overTempCalNewModelUpdateAvailable(&otc)) {
+                err = checkModel(&otc, t);
+                if (err > maxModelErr)
+                    maxModelErr = err;
+                models++;
+            }
+            if (otc.num_model_pts > maxPts)
+                maxPts = otc.num_model_pts;
+
+            nextEstimate = t + SEC_TO_NANOS(10 + rnd() % 590);
+        }
+
+        checkIndex(&otc, t);
+        checkSums(&otc, t);
+    }
+
+    if (!models || maxPts < 2 * parameters.min_num_model_pts)
+        fail(t, "built no model");
+
+    printf("%s: over_temp_cal %zu estimates, %zu temperatures, up to %zu points, %zu nearest "
+           "checks, %zu models, sensitivity error %.1e of limit, %.1f ns/call\n",
+           mFailures ? "FAIL" : "PASS", estimates, temps, maxPts, nearest, models,
+           maxModelErr, ns / (estimates + temps));
+
+    return mFailures ? 1 : 0;
+}
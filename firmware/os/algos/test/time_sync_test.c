@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Off-target check of algos/time_sync against a double precision fit of the
+// same history, and against the lazy fit it replaced, plus a timing of both.
+//
+// Two clocks with a random drift and jitter are synced at random intervals,
+// with the occasional truncate, hold and reset as the IMU drivers do them.
+// After every step the estimates at the newest data point and 100ms past it
+// are compared with the exact least-squares line through the history, and
+// drift_ppm/jitter_ns with its slope and rms residual. The reference is the
+// old fit, which ran in the first estimate after each add and fitted time1
+// directly rather than time1 - time2.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <floatRt.h>
+#include <algos/time_sync.h>
+
+#define STEPS               200000
+#define SAMPLES_PER_SYNC    200     // estimates per sync point, for the timing
+
+// of an estimate, against the exact fit: alpha and the means are floats of up
+// to the 16s a full history spans, whose ulp is 2048ns
+#define MAX_ERR_NS          4096.0
+#define MAX_DRIFT_ERR_PPM   0.05
+#define MAX_JITTER_ERR      0.02    // relative, for jitter above 100 ns
+
+// the old time_sync, as it was: fit on the first estimate after a change
+typedef struct {
+    uint64_t time1[NUM_TIME_SYNC_DATAPOINTS];
+    uint64_t time2[NUM_TIME_SYNC_DATAPOINTS];
+    size_t n;
+    size_t i;
+
+    uint64_t time1_base;
+    uint64_t time2_base;
+
+    bool estimate_valid;
+    float alpha, beta;
+
+    uint8_t hold_count;
+} ref_sync_t;
+
+static void ref_reset(ref_sync_t *sync) {
+    sync->n = 0;
+    sync->i = 0;
+    sync->estimate_valid = false;
+
+    sync->hold_count = 0;
+}
+
+static void ref_truncate(ref_sync_t *sync, size_t window_size) {
+    size_t k, m;
+    sync->n = (window_size < sync->n) ? window_size : sync->n;
+    sync->estimate_valid = false;
+
+    size_t bidx = (sync->i >= sync->n) ? (sync->i - sync->n)
+        : (sync->i + NUM_TIME_SYNC_DATAPOINTS - sync->n);
+
+    for (k = 0; k < bidx; ++k) {
+        uint64_t tmp1 = sync->time1[0];
+        uint64_t tmp2 = sync->time2[0];
+
+        for (m = 0; m < NUM_TIME_SYNC_DATAPOINTS - 1; ++m) {
+            sync->time1[m] = sync->time1[m + 1];
+            sync->time2[m] = sync->time2[m + 1];
+        }
+        sync->time1[NUM_TIME_SYNC_DATAPOINTS - 1] = tmp1;
+        sync->time2[NUM_TIME_SYNC_DATAPOINTS - 1] = tmp2;
+    }
+
+    sync->i = (sync->n < NUM_TIME_SYNC_DATAPOINTS) ? sync->n : 0;
+}
+
+static void ref_add(ref_sync_t *sync, uint64_t time1, uint64_t time2) {
+    size_t i = sync->i;
+
+    sync->time1[i] = time1;
+    sync->time2[i] = time2;
+
+    if (++i == NUM_TIME_SYNC_DATAPOINTS) {
+        i = 0;
+    }
+
+    sync->i = i;
+
+    size_t prev_n = sync->n;
+    if (sync->n < NUM_TIME_SYNC_DATAPOINTS) {
+        ++sync->n;
+    }
+
+    sync->estimate_valid = false;
+
+    if (sync->hold_count > 0) {
+        --sync->hold_count;
+        ref_truncate(sync, prev_n);
+    }
+}
+
+static bool ref_estimate_time1(ref_sync_t *sync, uint64_t time2, uint64_t *time1) {
+    size_t j;
+
+    if (sync->n < 2)
+        return false;
+
+    *time1 = 0;
+
+    if (!sync->estimate_valid) {
+        size_t n = sync->n;
+
+        size_t i = sync->i;
+        if (n < NUM_TIME_SYNC_DATAPOINTS) {
+            if (i != n) {
+                return false;
+            }
+            i = 0;
+        }
+
+        uint64_t time1_base = sync->time1[i];
+        uint64_t time2_base = sync->time2[i];
+
+        float mean_x = 0.0f;
+        float mean_y = 0.0f;
+        float invN = 1.0f / n;
+        size_t ii = i;
+        for (j = 0; j < n; ++j) {
+            mean_y += floatFromUint64(sync->time1[ii] - time1_base) * invN;
+            mean_x += floatFromUint64(sync->time2[ii] - time2_base) * invN;
+
+            if (++ii == NUM_TIME_SYNC_DATAPOINTS) {
+                ii = 0;
+            }
+        }
+
+        float sum_x2 = 0.0f, sum_xy = 0.0f;
+        ii = i;
+        for (j = 0; j < n; ++j) {
+            float y = floatFromUint64(sync->time1[ii] - time1_base) - mean_y;
+            float x = floatFromUint64(sync->time2[ii] - time2_base) - mean_x;
+
+            sum_x2 += x * x;
+            sum_xy += x * y;
+
+            if (++ii == NUM_TIME_SYNC_DATAPOINTS) {
+                ii = 0;
+            }
+        }
+
+        float beta = sum_xy / sum_x2;
+        float alpha = mean_y - beta * mean_x;
+
+        sync->alpha = alpha;
+        sync->beta = beta;
+        sync->time1_base = time1_base;
+        sync->time2_base = time2_base;
+
+        sync->estimate_valid = true;
+    }
+
+    *time1 = sync->time1_base + floatToInt64(sync->alpha + sync->beta * floatFromInt64(time2 - sync->time2_base));
+
+    return true;
+}
+
+// exact least-squares line through the history, as time1 - time1_base against
+// time2 - time2_base, both relative to the oldest data point
+struct ExactFit {
+    uint64_t time1_base, time2_base;
+    double alpha, drift, jitter;
+};
+
+static bool exactFit(const time_sync_t *sync, struct ExactFit *fit) {
+    double mean_x = 0.0, mean_d = 0.0, sum_x2 = 0.0, sum_xd = 0.0, sse = 0.0;
+    size_t n = sync->n, i, j;
+
+    if (n < 2)
+        return false;
+
+    i = (n < NUM_TIME_SYNC_DATAPOINTS) ? 0 : sync->i;
+    fit->time1_base = sync->time1[i];
+    fit->time2_base = sync->time2[i];
+
+    for (j = 0; j < n; j++) {
+        size_t k = (i + j) % NUM_TIME_SYNC_DATAPOINTS;
+        mean_x += (double)(sync->time2[k] - fit->time2_base) / n;
+        mean_d += (double)(int64_t)((sync->time1[k] - fit->time1_base) - (sync->time2[k] - fit->time2_base)) / n;
+    }
+    for (j = 0; j < n; j++) {
+        size_t k = (i + j) % NUM_TIME_SYNC_DATAPOINTS;
+        double x = (double)(sync->time2[k] - fit->time2_base) - mean_x;
+        double d = (double)(int64_t)((sync->time1[k] - fit->time1_base) - (sync->time2[k] - fit->time2_base)) - mean_d;
+        sum_x2 += x * x;
+        sum_xd += x * d;
+    }
+    if (!(sum_x2 > 0.0))
+        return false;
+
+    fit->drift = sum_xd / sum_x2;
+    fit->alpha = mean_d + mean_x - (1.0 + fit->drift) * mean_x;
+    for (j = 0; j < n; j++) {
+        size_t k = (i + j) % NUM_TIME_SYNC_DATAPOINTS;
+        double x = (double)(sync->time2[k] - fit->time2_base) - mean_x;
+        double d = (double)(int64_t)((sync->time1[k] - fit->time1_base) - (sync->time2[k] - fit->time2_base)) - mean_d;
+        double r = d - fit->drift * x;
+        sse += r * r;
+    }
+    fit->jitter = sqrt(sse / n);
+
+    return true;
+}
+
+static double exactEstimate(const struct ExactFit *fit, uint64_t time2) {
+    double x = (double)(int64_t)(time2 - fit->time2_base);
+
+    return (double)fit->time1_base + fit->alpha + (1.0 + fit->drift) * x;
+}
+
+static uint32_t mRandState = 0x2545f491;
+
+static uint32_t rnd(void)
+{
+    mRandState ^= mRandState << 13;
+    mRandState ^= mRandState >> 17;
+    mRandState ^= mRandState << 5;
+    return mRandState;
+}
+
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (rnd() / 4294967296.0);
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static time_sync_t sync;
+    static ref_sync_t ref;
+    double drift = 0.0, jitter = 0.0, maxErr = 0.0, maxRefErr = 0.0, maxDriftErr = 0.0;
+    double maxJitterErr = 0.0, maxDiff = 0.0, ns = 0.0, refNs = 0.0, statsNs = 0.0, t0, err;
+    uint64_t time2 = 1000000000ull, time1 = 5000000000000ull, est, refEst, sink = 0;
+    size_t step, k, checks = 0, stats = 0, failures = 0;
+    struct ExactFit fit;
+    time_sync_stats_t st;
+    bool valid, refValid;
+
+    time_sync_init(&sync);
+    ref_reset(&ref);
+
+    for (step = 0; step < STEPS; step++) {
+        uint32_t op = rnd() % 1000;
+        uint64_t dt;
+
+        if (op < 2 || step == 0) {
+            // new clock pair: as after a sensor power cycle
+            time_sync_reset(&sync);
+            ref_reset(&ref);
+            drift = uniform(-200e-6, 200e-6);
+            jitter = (rnd() & 1) ? uniform(0.0, 20000.0) : 0.0;
+            time1 += (uint64_t)rnd() << 8;
+        } else if (op < 10) {
+            size_t window = 1 + rnd() % NUM_TIME_SYNC_DATAPOINTS;
+            time_sync_truncate(&sync, window);
+            ref_truncate(&ref, window);
+        } else if (op < 15) {
+            uint8_t count = 1 + rnd() % 4;
+            time_sync_hold(&sync, count);
+            ref.hold_count = count;
+        }
+
+        // sync points 20ms to 1s apart, as the drivers take them
+        dt = 20000000ull + rnd() % 980000000ull;
+        time2 += dt;
+        time1 += (uint64_t)llround(dt * (1.0 + drift));
+        uint64_t t1 = time1 + (uint64_t)(int64_t)llround(uniform(-jitter, jitter));
+
+        time_sync_add(&sync, t1, time2);
+        ref_add(&ref, t1, time2);
+
+        if (!exactFit(&sync, &fit))
+            continue;
+
+        for (k = 0; k < 2; k++) {
+            uint64_t at = time2 + k * 100000000ull;
+
+            valid = time_sync_estimate_time1(&sync, at, &est);
+            refValid = ref_estimate_time1(&ref, at, &refEst);
+            if (!valid || !refValid) {
+                if (!failures++)
+                    printf("FAIL: time_sync no estimate at step %zu\n", step);
+                continue;
+            }
+
+            err = fabs((double)(int64_t)(est - fit.time1_base) - (exactEstimate(&fit, at) - fit.time1_base));
+            if (err > maxErr)
+                maxErr = err;
+            err = fabs((double)(int64_t)(refEst - fit.time1_base) - (exactEstimate(&fit, at) - fit.time1_base));
+            if (err > maxRefErr)
+                maxRefErr = err;
+            err = fabs((double)(int64_t)(est - refEst));
+            if (err > maxDiff)
+                maxDiff = err;
+            checks++;
+        }
+
+        if (sync.n >= 4 && time_sync_get_stats(&sync, &st)) {
+            err = fabs(st.drift_ppm - fit.drift * 1e6);
+            if (err > maxDriftErr)
+                maxDriftErr = err;
+            if (fit.jitter > 100.0) {
+                err = fabs(st.jitter_ns - fit.jitter) / fit.jitter;
+                if (err > maxJitterErr)
+                    maxJitterErr = err;
+            }
+            stats++;
+        }
+    }
+
+    // timing: a sync point followed by the estimates of a batch of samples
+    time_sync_reset(&sync);
+    ref_reset(&ref);
+    for (step = 0; step < 20000; step++) {
+        time2 += 100000000ull;
+        time1 += 100000000ull + 4000ull + rnd() % 1000;
+
+        t0 = nowNs();
+        time_sync_add(&sync, time1, time2);
+        for (k = 0; k < SAMPLES_PER_SYNC; k++) {
+            time_sync_estimate_time1(&sync, time2 + k * 500000ull, &est);
+            sink += est;
+        }
+        ns += nowNs() - t0;
+
+        t0 = nowNs();
+        ref_add(&ref, time1, time2);
+        for (k = 0; k < SAMPLES_PER_SYNC; k++) {
+            ref_estimate_time1(&ref, time2 + k * 500000ull, &est);
+            sink += est;
+        }
+        refNs += nowNs() - t0;
+
+        t0 = nowNs();
+        time_sync_get_stats(&sync, &st);
+        statsNs += nowNs() - t0;
+        sink += st.n;
+    }
+
+    if (maxErr > MAX_ERR_NS || maxErr > maxRefErr || maxDriftErr > MAX_DRIFT_ERR_PPM || maxJitterErr > MAX_JITTER_ERR)
+        failures++;
+
+    printf("%s: time_sync %zu estimates, max error %.0f ns (old fit %.0f ns, %.0f ns apart), "
+           "%zu stats, drift %.3f ppm, jitter %.1f%%; %.2f ns/sample, reference %.2f ns/sample, "
+           "stats %.0f ns (%llx)\n",
+           failures ? "FAIL" : "PASS", checks, maxErr, maxRefErr, maxDiff, stats, maxDriftErr,
+           maxJitterErr * 100.0, ns / step / SAMPLES_PER_SYNC, refNs / step / SAMPLES_PER_SYNC,
+           statsNs / step, (unsigned long long)(sink & 0xf));
+
+    return failures ? 1 : 0;
+}
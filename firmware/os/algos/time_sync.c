@@ -32,10 +32,93 @@ bool time_sync_init(time_sync_t *sync) {
     return true;
 }
 
-void time_sync_truncate(time_sync_t *sync, size_t window_size) {
+// Least-square linear fit of the history, so that time1 = alpha + beta * time2
+// relative to the oldest data point. Done once per data point, which leaves
+// time_sync_estimate_time1() a multiply-add per sample.
+static void time_sync_fit(time_sync_t *sync) {
+    size_t j;
+
+    sync->estimate_valid = false;
+
+    if (sync->n < 2)
+        return;
+
+    size_t n = sync->n;
+
+    // Rewind to the oldest sample in the history.
+    size_t i = sync->i;
+    if (n < NUM_TIME_SYNC_DATAPOINTS) {
+        if (i != n) {
+            return;
+        }
+        i = 0;
+    }
+
+    uint64_t time1_base = sync->time1[i];
+    uint64_t time2_base = sync->time2[i];
+
+    // x = time2, y = time1, d = y - x. d is taken in integers, so it keeps
+    // full resolution however far apart the data points are; fitting d rather
+    // than y gives the drift (beta - 1) to well below a ppm.
+    float mean_x = 0.0f;
+    float mean_y = 0.0f;
+    float mean_d = 0.0f;
+    float invN = 1.0f / n;
+    size_t ii = i;
+    for (j = 0; j < n; ++j) {
+        uint64_t dy = sync->time1[ii] - time1_base;
+        uint64_t dx = sync->time2[ii] - time2_base;
+
+        mean_y += floatFromUint64(dy) * invN;
+        mean_x += floatFromUint64(dx) * invN;
+        mean_d += floatFromInt64((int64_t)(dy - dx)) * invN;
+
+        if (++ii == NUM_TIME_SYNC_DATAPOINTS) {
+            ii = 0;
+        }
+    }
+
+    // Two-pass approach so that only values relative to mean are computed.
+    // Typically, |x| is smaller than 8e8 in nsec.
+    // So sum_x2 is smaller than 1e19.
+    // That leaves plenty of room for blocking tasks.
+    float sum_x2 = 0.0f, sum_xd = 0.0f;
+    ii = i;
+    for (j = 0; j < n; ++j) {
+        uint64_t dy = sync->time1[ii] - time1_base;
+        uint64_t dx = sync->time2[ii] - time2_base;
+        float x = floatFromUint64(dx) - mean_x;
+        float d = floatFromInt64((int64_t)(dy - dx)) - mean_d;
+
+        sum_x2 += x * x;
+        sum_xd += x * d;
+
+        if (++ii == NUM_TIME_SYNC_DATAPOINTS) {
+            ii = 0;
+        }
+    }
+
+    if (!(sum_x2 > 0.0f))
+        return;
+
+    float drift = sum_xd / sum_x2;
+    float beta = 1.0f + drift;
+    float alpha = mean_y - beta * mean_x;
+
+    sync->alpha = alpha;
+    sync->beta = beta;
+    sync->drift = drift;
+    sync->mean_x = mean_x;
+    sync->mean_d = mean_d;
+    sync->time1_base = time1_base;
+    sync->time2_base = time2_base;
+
+    sync->estimate_valid = true;
+}
+
+static void time_sync_shrink(time_sync_t *sync, size_t window_size) {
     size_t k, m;
     sync->n = (window_size < sync->n) ? window_size : sync->n;
-    sync->estimate_valid = false;
 
     // oldest sample index (new time_base) after truncation
     size_t bidx = (sync->i >= sync->n) ? (sync->i - sync->n)
@@ -57,6 +140,11 @@ void time_sync_truncate(time_sync_t *sync, size_t window_size) {
     sync->i = (sync->n < NUM_TIME_SYNC_DATAPOINTS) ? sync->n : 0;
 }
 
+void time_sync_truncate(time_sync_t *sync, size_t window_size) {
+    time_sync_shrink(sync, window_size);
+    time_sync_fit(sync);
+}
+
 bool time_sync_add(time_sync_t *sync, uint64_t time1, uint64_t time2) {
     size_t i = sync->i;
 
@@ -74,86 +162,55 @@ bool time_sync_add(time_sync_t *sync, uint64_t time1, uint64_t time2) {
         ++sync->n;
     }
 
-    sync->estimate_valid = false;
-
     if (sync->hold_count > 0) {
         --sync->hold_count;
-        time_sync_truncate(sync, prev_n);
+        time_sync_shrink(sync, prev_n);
     }
 
+    time_sync_fit(sync);
+
     return true;
 }
 
-bool time_sync_estimate_time1(time_sync_t *sync, uint64_t time2, uint64_t *time1)
+bool time_sync_estimate_time1(const time_sync_t *sync, uint64_t time2, uint64_t *time1)
 {
-    size_t j;
-
-    if (sync->n < 2)
+    if (!sync->estimate_valid)
         return false;
 
-    *time1 = 0;
+    *time1 = sync->time1_base + floatToInt64(sync->alpha + sync->beta * floatFromInt64(time2 - sync->time2_base));
 
-    if (!sync->estimate_valid) {
-        size_t n = sync->n;
+    return true;
+}
 
-        // Rewind to the oldest sample in the history.
-        size_t i = sync->i;
-        if (n < NUM_TIME_SYNC_DATAPOINTS) {
-            if (i != n) {
-                return false;
-            }
-            i = 0;
-        }
+bool time_sync_get_stats(const time_sync_t *sync, time_sync_stats_t *stats) {
+    size_t j;
 
-        uint64_t time1_base = sync->time1[i];
-        uint64_t time2_base = sync->time2[i];
-
-        // Least-square linear regresison:
-        // Compute alpha and beta so that time1 = alpha + beta * time2.
-        // x = time2, y = time1
-        float mean_x = 0.0f;
-        float mean_y = 0.0f;
-        float invN = 1.0f / n;
-        size_t ii = i;
-        for (j = 0; j < n; ++j) {
-            mean_y += floatFromUint64(sync->time1[ii] - time1_base) * invN;
-            mean_x += floatFromUint64(sync->time2[ii] - time2_base) * invN;
-
-            if (++ii == NUM_TIME_SYNC_DATAPOINTS) {
-                ii = 0;
-            }
-        }
+    if (!sync->estimate_valid)
+        return false;
 
-        // Two-pass approach so that only values relative to mean are computed.
-        // Typically, |y| and |x| are smaller than 8e8 in nsec.
-        // So sum_x2 and sum_xy are smaller than 1e19.
-        // That leaves plenty of room for blocking tasks.
-        float sum_x2 = 0.0f, sum_xy = 0.0f;
-        ii = i;
-        for (j = 0; j < n; ++j) {
-            float y = floatFromUint64(sync->time1[ii] - time1_base) - mean_y;
-            float x = floatFromUint64(sync->time2[ii] - time2_base) - mean_x;
-
-            sum_x2 += x * x;
-            sum_xy += x * y;
-
-            if (++ii == NUM_TIME_SYNC_DATAPOINTS) {
-                ii = 0;
-            }
+    // The fit left the oldest data point at time1_base/time2_base. Residuals
+    // are y - alpha - beta * x = d - drift * x relative to the means, rather
+    // than sum_y2 - beta * sum_xy, which loses everything to cancellation in
+    // float. Only debug output wants them, so they are not kept up per fit.
+    size_t n = sync->n;
+    size_t ii = (n < NUM_TIME_SYNC_DATAPOINTS) ? 0 : sync->i;
+    float sse = 0.0f;
+    for (j = 0; j < n; ++j) {
+        uint64_t dy = sync->time1[ii] - sync->time1_base;
+        uint64_t dx = sync->time2[ii] - sync->time2_base;
+        float r = floatFromInt64((int64_t)(dy - dx)) - sync->mean_d
+                  - sync->drift * (floatFromUint64(dx) - sync->mean_x);
+
+        sse += r * r;
+
+        if (++ii == NUM_TIME_SYNC_DATAPOINTS) {
+            ii = 0;
         }
-
-        float beta = sum_xy / sum_x2;
-        float alpha = mean_y - beta * mean_x;
-
-        sync->alpha = alpha;
-        sync->beta = beta;
-        sync->time1_base = time1_base;
-        sync->time2_base = time2_base;
-
-        sync->estimate_valid = true;
     }
 
-    *time1 = sync->time1_base + floatToInt64(sync->alpha + sync->beta * floatFromInt64(time2 - sync->time2_base));
+    stats->n = n;
+    stats->drift_ppm = sync->drift * 1e6f;
+    stats->jitter_ns = sqrtf(sse / n);
 
     return true;
 }
@@ -34,6 +34,7 @@
 #include <hostIntf_priv.h>
 #include <nanohubCommand.h>
 #include <nanohubPacket.h>
+#include <logToken.h>
 #include <seos.h>
 #include <seos_priv.h>
 #include <util.h>
@@ -51,8 +52,9 @@
 #define MIN_NUM_BLOCKS          10          /* times 256 = 2560 bytes */
 #define SENSOR_INIT_DELAY       500000000   /* ns */
 #define SENSOR_INIT_ERROR_MAX   4
-#define CHECK_LATENCY_TIME      500000000   /* ns */
+#define LATENCY_TIMER_SLACK     10000000    /* ns, deadlines this close are handled together */
 #define EVT_LATENCY_TIMER       EVT_NO_FIRST_USER_EVENT
+#define EVT_SUSPEND_CHANGE      (EVT_NO_FIRST_USER_EVENT + 1)
 
 static const uint32_t delta_time_multiplier_order = 9;
 static const uint32_t delta_time_coarse_mask = ~1;
@@ -82,11 +84,16 @@ struct ConfigCmd
 struct ActiveSensor
 {
     uint64_t latency;
+    uint64_t reqLatency;    // as requested from the sensor, see updateSuspendLatency()
     uint64_t firstTime;
     uint64_t lastTime;
     struct HostIntfDataBuffer buffer;
     uint32_t rate;
     uint32_t sensorHandle;
+    // A data event that came in while a flush could not be queued, kept
+    // through a shared reference until the output queue has room again.
+    struct OsSharedEvt *heldEvt;
+    const void *heldEvtData;
     float rawScale;
     uint16_t minSamples;
     uint16_t curSamples;
@@ -127,7 +134,7 @@ static struct
 {
     uint8_t pad; // packet header is 10 bytes. + 2 to word align
     uint8_t prePreamble;
-    uint8_t buf[NANOHUB_PACKET_SIZE_MAX];
+    uint8_t buf[NANOHUB_JUMBO_PACKET_SIZE_MAX]; // also holds regular packets
     uint8_t postPreamble;
 } mTxBuf;
 static struct
@@ -146,7 +153,11 @@ static uint32_t mInterruptCntWkup, mInterruptCntNonWkup;
 static uint32_t mWakeupBlocks, mNonWakeupBlocks, mTotalBlocks;
 static uint32_t mHostIntfTid;
 static uint32_t mLatencyTimer;
+static uint64_t mLatencyDeadline;
 static uint8_t mLatencyCnt;
+static uint8_t mHeldEvts;
+static bool mHeldEvtsRetry;
+static struct HostIntfBatchStats mBatchStats;
 
 static uint8_t mRxIdle;
 static uint8_t mWakeActive;
@@ -186,6 +197,7 @@ static void hostIntfTxAckDone(size_t tx, int err);
 static void hostIntfGenerateResponse(void *cookie);
 
 static void hostIntfTxPayloadDone(size_t tx, int err);
+static void copyHeldEvts(void *cookie);
 
 static inline void *hostIntfGetPayload(uint8_t *buf)
 {
@@ -212,6 +224,25 @@ static inline __le32 hostIntfComputeCrc(uint8_t *buf)
     return htole32(crc);
 }
 
+static inline void *hostIntfGetJumboPayload(uint8_t *buf)
+{
+    struct NanohubJumboPacket *packet = (struct NanohubJumboPacket *)buf;
+    return packet->data;
+}
+
+static inline struct NanohubPacketFooter *hostIntfGetJumboFooter(uint8_t *buf)
+{
+    struct NanohubJumboPacket *packet = (struct NanohubJumboPacket *)buf;
+    return (struct NanohubPacketFooter *)(buf + sizeof(*packet) + le16toh(packet->len));
+}
+
+static inline __le32 hostIntfComputeJumboCrc(uint8_t *buf)
+{
+    struct NanohubJumboPacket *packet = (struct NanohubJumboPacket *)buf;
+    uint32_t crc = crc32(packet, le16toh(packet->len) + sizeof(*packet), CRC_INIT);
+    return htole32(crc);
+}
+
 static void hostIntfPrintErrMsg(void *cookie)
 {
     struct hostIntfIntErrMsg *msg = (struct hostIntfIntErrMsg *)cookie;
@@ -309,6 +340,22 @@ static void hostIntfTxPacket(__le32 reason, uint8_t len, uint32_t seq,
     hostIntfTxBuf(1+NANOHUB_PACKET_SIZE(len), &mTxBuf.prePreamble, callback);
 }
 
+static void hostIntfTxJumboPacket(__le32 reason, uint16_t len, uint32_t seq,
+        HostIntfCommCallbackF callback)
+{
+    struct NanohubJumboPacket *txPacket = (struct NanohubJumboPacket *)(mTxBuf.buf);
+    txPacket->reason = reason;
+    txPacket->seq = seq;
+    txPacket->sync = NANOHUB_SYNC_BYTE_JUMBO;
+    txPacket->len = htole16(len);
+
+    struct NanohubPacketFooter *txFooter = hostIntfGetJumboFooter(mTxBuf.buf);
+    txFooter->crc = hostIntfComputeJumboCrc(mTxBuf.buf);
+
+    // send starting with the prePremable byte
+    hostIntfTxBuf(1+NANOHUB_JUMBO_PACKET_SIZE(len), &mTxBuf.prePreamble, callback);
+}
+
 static void hostIntfTxNakPacket(__le32 reason, uint32_t seq,
         HostIntfCommCallbackF callback)
 {
@@ -506,10 +553,18 @@ static void hostIntfGenerateResponse(void *cookie)
 {
     void *rxPayload = hostIntfGetPayload(mRxBuf);
     uint8_t rx_len = hostIntfGetPayloadLen(mRxBuf);
-    void *txPayload = hostIntfGetPayload(mTxBuf.buf);
-    uint8_t respLen = mRxCmd->handler(rxPayload, rx_len, txPayload, mRxTimestamp);
+    void *txPayload;
+    uint32_t respLen;
 
-    hostIntfTxPacket(mRxCmd->reason, respLen, mTxRetrans.seq, hostIntfTxPayloadDone);
+    if (mRxCmd->jumbo) {
+        txPayload = hostIntfGetJumboPayload(mTxBuf.buf);
+        respLen = mRxCmd->handler(rxPayload, rx_len, txPayload, mRxTimestamp);
+        hostIntfTxJumboPacket(mRxCmd->reason, respLen, mTxRetrans.seq, hostIntfTxPayloadDone);
+    } else {
+        txPayload = hostIntfGetPayload(mTxBuf.buf);
+        respLen = mRxCmd->handler(rxPayload, rx_len, txPayload, mRxTimestamp);
+        hostIntfTxPacket(mRxCmd->reason, respLen, mTxRetrans.seq, hostIntfTxPayloadDone);
+    }
 }
 
 static void hostIntfTxPayloadDone(size_t tx, int err)
@@ -539,6 +594,16 @@ static void resetBuffer(struct ActiveSensor *sensor)
     memset(&sensor->buffer.firstSample, 0x00, sizeof(struct SensorFirstSample));
 }
 
+static void releaseHeldEvt(struct ActiveSensor *sensor)
+{
+    if (sensor->heldEvt) {
+        osReleaseSharedEvent(sensor->heldEvt);
+        sensor->heldEvt = NULL;
+        sensor->heldEvtData = NULL;
+        mHeldEvts--;
+    }
+}
+
 void hostIntfSetBusy(bool busy)
 {
     mBusy = busy;
@@ -588,7 +653,7 @@ bool hostIntfPacketDequeue(void *data, uint32_t *wakeup, uint32_t *nonwakeup)
             sensor = mActiveSensorTable + mLastSensor;
 
             if (sensor->curSamples != sensor->buffer.firstSample.numSamples) {
-                osLog(LOG_ERROR, "hostIntfPacketDequeue: sensor(%d)->curSamples=%d != buffer->numSamples=%d\n", sensor->buffer.sensType, sensor->curSamples, sensor->buffer.firstSample.numSamples);
+                osLogT(LOG_ERROR, "hostIntfPacketDequeue: sensor(%d)->curSamples=%d != buffer->numSamples=%d\n", sensor->buffer.sensType, sensor->curSamples, sensor->buffer.firstSample.numSamples);
                 sensor->curSamples = sensor->buffer.firstSample.numSamples;
             }
 
@@ -619,6 +684,10 @@ bool hostIntfPacketDequeue(void *data, uint32_t *wakeup, uint32_t *nonwakeup)
         }
     }
 
+    // there is room in the queue now for events held back
+    if (ret && mHeldEvts && !mHeldEvtsRetry)
+        mHeldEvtsRetry = osDefer(copyHeldEvts, NULL, false);
+
     *wakeup = mWakeupBlocks;
     *nonwakeup = mNonWakeupBlocks;
 
@@ -661,6 +730,90 @@ static void latencyTimerCallback(uint32_t timerId, void* data)
     osEnqueuePrivateEvt(EVT_LATENCY_TIMER, data, NULL, mHostIntfTid);
 }
 
+// The latency timer is armed only for the earliest batch deadline instead of
+// polling, so a sensor batching for seconds does not wake the hub every
+// half second just to find nothing due.
+static void latencyTimerArm(uint64_t deadline)
+{
+    uint64_t now = sensorGetTime();
+    uint64_t delay = deadline > now + LATENCY_TIMER_SLACK ? deadline - now : LATENCY_TIMER_SLACK;
+
+    if (mLatencyTimer) {
+        if (deadline >= mLatencyDeadline)
+            return;
+        timTimerCancel(mLatencyTimer);
+    }
+
+    mLatencyDeadline = deadline;
+    mLatencyTimer = timTimerSet(delay, 100, 100, latencyTimerCallback, NULL, true);
+}
+
+static void latencyTimerCancel(void)
+{
+    if (mLatencyTimer) {
+        timTimerCancel(mLatencyTimer);
+        mLatencyTimer = 0;
+    }
+}
+
+void hostIntfGetBatchStats(struct HostIntfBatchStats *stats)
+{
+    *stats = mBatchStats;
+}
+
+void hostIntfCountFifoInterrupt(void)
+{
+    atomicAdd32bits(&mBatchStats.fifoInterrupts, 1);
+}
+
+static bool isSuspendBatched(const struct ActiveSensor *sensor)
+{
+    return sensor->sensorHandle && sensor->interrupt == NANOHUB_INT_NONWAKEUP &&
+           sensor->rate && sensor->rate < SENSOR_RATE_ONDEMAND;
+}
+
+// The kernel masks the non-wakeup interrupt while the AP is suspended, and
+// non-wakeup data then only has to be in the output queue by the time it
+// resumes, not within the host's batch latency. So for the suspend, the
+// non-wakeup sensors are asked for the latency it takes them to fill the
+// room left in the output queue, if that is longer; the drivers size their
+// FIFO watermarks from it as from any other request. They get the host's
+// latency back on resume.
+static void updateSuspendLatency(void)
+{
+    uint32_t i, used = mWakeupBlocks + mNonWakeupBlocks;
+    uint64_t blockRate = 0, room = 0, latency;
+    struct ActiveSensor *sensor;
+
+    if (!mActiveSensorTable)
+        return;
+
+    if (hostIntfGetInterruptMask(NANOHUB_INT_NONWAKEUP)) {
+        // blocks per 1024 s, as rates are in SENSOR_HZ units
+        for (i = 0; i < mNumSensors; i++) {
+            sensor = mActiveSensorTable + i;
+            if (isSuspendBatched(sensor))
+                blockRate += sensor->rate / sensor->packetSamples;
+        }
+        if (blockRate && used < mTotalBlocks)
+            room = (uint64_t)(mTotalBlocks - used) * 1024000000000ull / blockRate;
+    }
+
+    for (i = 0; i < mNumSensors; i++) {
+        sensor = mActiveSensorTable + i;
+        if (!isSuspendBatched(sensor))
+            continue;
+
+        latency = room > sensor->latency ? room : sensor->latency;
+        if (latency != sensor->reqLatency &&
+            sensorRequestRateChange(mHostIntfTid, sensor->sensorHandle, sensor->rate, latency)) {
+            sensor->reqLatency = latency;
+            if (latency > sensor->latency)
+                mBatchStats.suspendRaises++;
+        }
+    }
+}
+
 static bool initSensors()
 {
     uint32_t i, j, blocks, maxBlocks, numAxis, packetSamples;
@@ -756,6 +909,7 @@ static bool initSensors()
             mActiveSensorTable[j].biasReportType = 0;
             mActiveSensorTable[j].rate = 0;
             mActiveSensorTable[j].latency = 0;
+            mActiveSensorTable[j].reqLatency = 0;
             mActiveSensorTable[j].numAxis = si->numAxis;
             mActiveSensorTable[j].interrupt = si->interrupt;
             if (si->flags1 & SENSOR_INFO_FLAGS1_RAW) {
@@ -1177,6 +1331,7 @@ static void onEvtAppStart(const void *evtData)
 #ifdef DEBUG_LOG_EVT
         osEventSubscribe(mHostIntfTid, EVT_DEBUG_LOG);
         platEarlyLogFlush();
+        logTokenStart();
 #endif
         reason = pwrResetReason();
         data = alloca(sizeof(uint32_t) + sizeof(reason));
@@ -1274,17 +1429,28 @@ static void onEvtDebugLog(const void *evtData)
 static void onEvtLatencyTimer(const void *evtData)
 {
     uint64_t sensorTime = sensorGetTime();
+    uint64_t deadline, next = UINT64_MAX;
     uint32_t i, cnt;
 
+    mLatencyTimer = 0;
+    mBatchStats.latencyWakeups++;
+
     for (i = 0, cnt = 0; i < mNumSensors && cnt < mLatencyCnt; i++) {
         if (mActiveSensorTable[i].latency > 0) {
             cnt++;
-            if (mActiveSensorTable[i].firstTime &&
-                sensorTime >= mActiveSensorTable[i].firstTime + mActiveSensorTable[i].latency) {
-                hostIntfSetInterrupt(mActiveSensorTable[i].interrupt);
+            if (mActiveSensorTable[i].firstTime) {
+                deadline = mActiveSensorTable[i].firstTime + mActiveSensorTable[i].latency;
+                if (sensorTime + LATENCY_TIMER_SLACK >= deadline)
+                    hostIntfSetInterrupt(mActiveSensorTable[i].interrupt);
+                else if (deadline < next)
+                    next = deadline;
             }
         }
     }
+
+    // batches started after this are armed for as their data comes in
+    if (next != UINT64_MAX)
+        latencyTimerArm(next);
 }
 
 static void onConfigCmdFlushOne(struct ActiveSensor *sensor, struct ConfigCmd *cmd)
@@ -1296,17 +1462,17 @@ static void onConfigCmdEnableOne(struct ActiveSensor *sensor, struct ConfigCmd *
 {
     if (sensorRequestRateChange(mHostIntfTid, sensor->sensorHandle, cmd->rate, cmd->latency)) {
         sensor->rate = cmd->rate;
+        sensor->reqLatency = cmd->latency;
         if (sensor->latency != cmd->latency) {
             if (!sensor->latency) {
-                if (mLatencyCnt++ == 0)
-                    mLatencyTimer = timTimerSet(CHECK_LATENCY_TIME, 100, 100, latencyTimerCallback, NULL, false);
+                mLatencyCnt++;
             } else if (!cmd->latency) {
-                if (--mLatencyCnt == 0) {
-                    timTimerCancel(mLatencyTimer);
-                    mLatencyTimer = 0;
-                }
+                if (--mLatencyCnt == 0)
+                    latencyTimerCancel();
             }
             sensor->latency = cmd->latency;
+            if (sensor->latency && sensor->firstTime)
+                latencyTimerArm(sensor->firstTime + sensor->latency);
         }
     }
 }
@@ -1322,12 +1488,11 @@ static void onConfigCmdEnableAll(struct ActiveSensor *sensor, struct ConfigCmd *
         }
 
         if (sensorRequest(mHostIntfTid, sensor->sensorHandle, cmd->rate, cmd->latency)) {
-            if (cmd->latency) {
-                if (mLatencyCnt++ == 0)
-                    mLatencyTimer = timTimerSet(CHECK_LATENCY_TIME, 100, 100, latencyTimerCallback, NULL, false);
-            }
+            if (cmd->latency)
+                mLatencyCnt++;
             sensor->rate = cmd->rate;
             sensor->latency = cmd->latency;
+            sensor->reqLatency = cmd->latency;
             osEventSubscribe(mHostIntfTid, sensorGetMyEventType(cmd->sensType));
             break;
         } else {
@@ -1338,16 +1503,16 @@ static void onConfigCmdEnableAll(struct ActiveSensor *sensor, struct ConfigCmd *
 
 static void onConfigCmdDisableOne(struct ActiveSensor *sensor, struct ConfigCmd *cmd)
 {
+    releaseHeldEvt(sensor);
     sensorRelease(mHostIntfTid, sensor->sensorHandle);
     osEventUnsubscribe(mHostIntfTid, sensorGetMyEventType(cmd->sensType));
     if (sensor->latency) {
-        if (--mLatencyCnt == 0) {
-            timTimerCancel(mLatencyTimer);
-            mLatencyTimer = 0;
-        }
+        if (--mLatencyCnt == 0)
+            latencyTimerCancel();
     }
     sensor->rate = 0;
     sensor->latency = 0;
+    sensor->reqLatency = 0;
     sensor->oneshot = false;
     sensor->sensorHandle = 0;
     if (sensor->buffer.length) {
@@ -1479,41 +1644,104 @@ static uint32_t getSensorInterrupt(struct ActiveSensor *sensor)
     return interrupt;
 }
 
+static bool sensorBufferBlocked(struct ActiveSensor *sensor)
+{
+    bool haveFlush = sensor->buffer.firstSample.numFlushes > 0;
+    if (sensor->buffer.length > 0 &&
+        (haveFlush || sensor->buffer.firstSample.numSamples == sensor->packetSamples)) {
+            // processing will be aborted if we have pending flush and are not able to send
+            // in this case, send eventually will be retried, otherwise data will be lost
+            if (!enqueueSensorBuffer(sensor) && haveFlush)
+                return true;
+    }
+
+    return false;
+}
+
+static void copySamples(struct ActiveSensor *sensor, const void* evtData)
+{
+    switch (sensor->numAxis) {
+    case NUM_AXIS_EMBEDDED:
+        copyEmbeddedSamples(sensor, evtData);
+        break;
+    case NUM_AXIS_ONE:
+        copySingleSamples(sensor, evtData);
+        break;
+    case NUM_AXIS_THREE:
+        if (sensor->raw)
+            copyTripleSamplesRaw(sensor, evtData);
+        else
+            copyTripleSamples(sensor, evtData);
+        break;
+    }
+}
+
+// Returns false if the sensor still holds an event it cannot copy yet
+static bool copyHeldEvt(struct ActiveSensor *sensor)
+{
+    if (!sensor->heldEvt)
+        return true;
+
+    if (sensorBufferBlocked(sensor))
+        return false;
+
+    copySamples(sensor, sensor->heldEvtData);
+    releaseHeldEvt(sensor);
+    return true;
+}
+
+static void copyHeldEvts(void *cookie)
+{
+    struct ActiveSensor *sensor;
+    uint32_t i;
+
+    mHeldEvtsRetry = false;
+
+    for (i = 0; i < mNumSensors && mHeldEvts; i++) {
+        sensor = mActiveSensorTable + i;
+        if (sensor->heldEvt && copyHeldEvt(sensor)) {
+            mBatchStats.dataEvents++;
+            if (sensor->latency && sensor->firstTime)
+                latencyTimerArm(sensor->firstTime + sensor->latency);
+            nanohubPrefetchTx(getSensorInterrupt(sensor), mWakeupBlocks, mNonWakeupBlocks);
+        }
+    }
+}
+
 static void onEvtSensorDataActive(struct ActiveSensor *sensor, uint32_t evtType, const void* evtData)
 {
     if (evtData == SENSOR_DATA_EVENT_FLUSH) {
+        // the held samples go out before the flush, or not at all
+        if (!copyHeldEvt(sensor))
+            releaseHeldEvt(sensor);
         queueFlush(sensor);
     } else {
-        bool haveFlush = sensor->buffer.firstSample.numFlushes > 0;
-        if (sensor->buffer.length > 0 &&
-            (haveFlush || sensor->buffer.firstSample.numSamples == sensor->packetSamples)) {
-                // processing will be aborted if we have pending flush and are not able to send
-                // in this case, send eventually will be retried, otherwise data will be lost
-                if (!enqueueSensorBuffer(sensor) && haveFlush)
-                    return;
-        }
+        if (sensor->numAxis != NUM_AXIS_EMBEDDED && sensor->numAxis != NUM_AXIS_ONE &&
+            sensor->numAxis != NUM_AXIS_THREE)
+            return;
 
-        switch (sensor->numAxis) {
-        case NUM_AXIS_EMBEDDED:
-            copyEmbeddedSamples(sensor, evtData);
-            break;
-        case NUM_AXIS_ONE:
-            copySingleSamples(sensor, evtData);
-            break;
-        case NUM_AXIS_THREE:
-            if (sensor->raw)
-                copyTripleSamplesRaw(sensor, evtData);
-            else
-                copyTripleSamples(sensor, evtData);
-            break;
-        default:
+        if (!copyHeldEvt(sensor) || sensorBufferBlocked(sensor)) {
+            // keep these samples instead of dropping them; one event per sensor,
+            // later ones are dropped while it is held
+            if (!sensor->heldEvt && (sensor->heldEvt = osRetainCurrentEventShared())) {
+                sensor->heldEvtData = evtData;
+                mHeldEvts++;
+            }
             return;
         }
+
+        copySamples(sensor, evtData);
     }
 
+    if (evtData != SENSOR_DATA_EVENT_FLUSH)
+        mBatchStats.dataEvents++;
+    if (sensor->latency && sensor->firstTime)
+        latencyTimerArm(sensor->firstTime + sensor->latency);
+
     nanohubPrefetchTx(getSensorInterrupt(sensor), mWakeupBlocks, mNonWakeupBlocks);
 
     if (sensor->oneshot) {
+        releaseHeldEvt(sensor);
         sensorRelease(mHostIntfTid, sensor->sensorHandle);
         osEventUnsubscribe(mHostIntfTid, evtType);
         sensor->sensorHandle = 0;
@@ -1578,6 +1806,9 @@ static void hostIntfHandleEvent(uint32_t evtType, const void* evtData)
     case EVT_LATENCY_TIMER:
         onEvtLatencyTimer(evtData);
         break;
+    case EVT_SUSPEND_CHANGE:
+        updateSuspendLatency();
+        break;
     case EVT_NO_SENSOR_CONFIG_EVENT:
         onEvtNoSensorConfigEvent(evtData);
         break;
@@ -1661,6 +1892,8 @@ void hostIntfSetInterruptMask(uint32_t bit)
                 if (mInterruptCntNonWkup++ == 0)
                     apIntSet(false);
             }
+            if (bit == NANOHUB_INT_NONWAKEUP)
+                osEnqueuePrivateEvt(EVT_SUSPEND_CHANGE, NULL, NULL, mHostIntfTid);
         }
     }
     cpuIntsRestore(state);
@@ -1683,6 +1916,8 @@ void hostIntfClearInterruptMask(uint32_t bit)
                 if (--mInterruptCntNonWkup == 0)
                     apIntClear(false);
             }
+            if (bit == NANOHUB_INT_NONWAKEUP)
+                osEnqueuePrivateEvt(EVT_SUSPEND_CHANGE, NULL, NULL, mHostIntfTid);
         }
     }
     cpuIntsRestore(state);
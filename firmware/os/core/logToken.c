@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <atomic.h>
+#include <eventnums.h>
+#include <heap.h>
+#include <hostIntf.h>
+#include <logToken.h>
+#include <nanohubPacket.h>
+#include <sensType.h>
+#include <seos.h>
+
+#ifdef LOG_TOKEN_ENABLED
+
+#ifndef LOG_TOKEN_RING_WORDS
+#define LOG_TOKEN_RING_WORDS    512     // must be a power of 2
+#endif
+#define LOG_TOKEN_RING_MASK     (LOG_TOKEN_RING_WORDS - 1)
+#define LOG_TOKEN_HDR_WORDS     (sizeof(struct LogTokenRecord) / sizeof(uint32_t))
+
+#define LOG_TOKEN_HDR(level, numWords, flags) \
+    ((uint32_t)(uint8_t)(level) | ((uint32_t)(numWords) << 8) | ((uint32_t)(flags) << 16))
+#define LOG_TOKEN_HDR_WORDS_OF(hdr)     (((hdr) >> 8) & 0xFF)
+#define LOG_TOKEN_HDR_COMMITTED(hdr)    ((hdr) & ((uint32_t)LOG_TOKEN_FLAG_COMMITTED << 16))
+
+/*
+ * Records are reserved by moving mLogRingHead with a compare-and-swap, so any
+ * context (including interrupts) may log. A record becomes visible to the
+ * flush only once its header word, written last, has the committed flag set.
+ * The flush zeroes every word it consumes before moving mLogRingTail, so stale
+ * argument words can never pass for a committed header.
+ */
+static volatile uint32_t mLogRing[LOG_TOKEN_RING_WORDS];
+static volatile uint32_t mLogRingHead;
+static volatile uint32_t mLogRingTail;
+static volatile uint32_t mLogDropped;
+static volatile uint8_t mLogFlushPending;
+static bool mLogStarted;
+
+extern const char __logstr_start[];
+
+static bool logTokenPutArg(uint32_t *args, uint32_t *numWords, uint64_t val, bool wide)
+{
+    uint32_t words = wide ? 2 : 1;
+
+    if (*numWords + words > LOG_TOKEN_ARG_WORDS_MAX)
+        return false;
+
+    args[(*numWords)++] = val;
+    if (wide)
+        args[(*numWords)++] = val >> 32;
+
+    return true;
+}
+
+static bool logTokenPutStr(uint32_t *args, uint32_t *numWords, const char *str)
+{
+    uint8_t *dst = (uint8_t *)(args + *numWords);
+    uint32_t len, words;
+
+    if (!str)
+        str = "(null)";
+    for (len = 0; len < LOG_TOKEN_STR_MAX && str[len]; len++)
+        ;
+
+    words = (1 + len + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    if (*numWords + words > LOG_TOKEN_ARG_WORDS_MAX)
+        return false;
+
+    args[*numWords + words - 1] = 0;
+    dst[0] = len;
+    memcpy(dst + 1, str, len);
+    *numWords += words;
+
+    return true;
+}
+
+// pull the arguments off vl exactly the way cvprintf() would consume them
+static uint32_t logTokenCollect(uint32_t *args, const char *fmt, va_list vl, uint16_t *flags)
+{
+    uint32_t numWords = 0;
+    uint32_t numLong;
+    bool useSizeT, ok = true;
+    char c;
+
+    while ((c = *fmt++) != 0) {
+        if (c != '%')
+            continue;
+
+        numLong = 0;
+        useSizeT = false;
+more_fmt:
+        switch (c = *fmt++) {
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+        case '.': case '#': case '-': case '+': case ' ':
+        case 'h': case 'L':
+            goto more_fmt;
+        case 'l':
+            numLong++;
+            goto more_fmt;
+        case 'z':
+        case 't':
+            useSizeT = true;
+            goto more_fmt;
+        case '%':
+            continue;
+        case 'c': case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            if (numLong > 1 || (numLong && sizeof(long) > sizeof(uint32_t)) ||
+                (useSizeT && sizeof(size_t) > sizeof(uint32_t)))
+                ok = logTokenPutArg(args, &numWords, va_arg(vl, unsigned long long), true);
+            else
+                ok = logTokenPutArg(args, &numWords, va_arg(vl, unsigned int), false);
+            break;
+        case 'p':
+            ok = logTokenPutArg(args, &numWords, (uintptr_t)va_arg(vl, const void *),
+                                sizeof(void *) > sizeof(uint32_t));
+            break;
+        case 's':
+            ok = logTokenPutStr(args, &numWords, va_arg(vl, const char *));
+            break;
+        default:
+            // end of string, %f, or something cvprintf() would print literally
+            if (!c)
+                return numWords;
+            continue;
+        }
+
+        if (!ok) {
+            *flags |= LOG_TOKEN_FLAG_TRUNCATED;
+            break;
+        }
+    }
+
+    return numWords;
+}
+
+static void logTokenFlush(void *cookie)
+{
+    struct HostIntfDataBuffer *buffer;
+    uint32_t hdr, words, dropped, i, w;
+    size_t len;
+
+    // clear first, so anything logged from here on schedules another flush
+    atomicWriteByte(&mLogFlushPending, false);
+
+    while (true) {
+        hdr = mLogRing[mLogRingTail & LOG_TOKEN_RING_MASK];
+        dropped = atomicRead32bits(&mLogDropped);
+        if (!LOG_TOKEN_HDR_COMMITTED(hdr) && !dropped)
+            break;
+
+        buffer = heapAlloc(sizeof(*buffer));
+        if (!buffer)
+            break;
+
+        buffer->sensType = SENS_TYPE_INVALID;
+        buffer->dataType = HOSTINTF_DATA_TYPE_LOG;
+        buffer->interrupt = NANOHUB_INT_NONWAKEUP;
+        buffer->buffer[0] = LOG_TOKEN_MARK;
+        len = 1;
+
+        if (dropped) {
+            struct LogTokenRecord rec = {
+                .level = LOG_WARN,
+                .numWords = 1,
+                .token = LOG_TOKEN_DROPPED,
+            };
+
+            atomicAdd32bits(&mLogDropped, -dropped);
+            memcpy(buffer->buffer + len, &rec, sizeof(rec));
+            len += sizeof(rec);
+            memcpy(buffer->buffer + len, &dropped, sizeof(dropped));
+            len += sizeof(dropped);
+        }
+
+        while (LOG_TOKEN_HDR_COMMITTED(hdr = mLogRing[mLogRingTail & LOG_TOKEN_RING_MASK])) {
+            words = LOG_TOKEN_HDR_WORDS + LOG_TOKEN_HDR_WORDS_OF(hdr);
+            if (len + words * sizeof(uint32_t) > sizeof(buffer->buffer))
+                break;
+
+            for (i = 0; i < words; i++) {
+                w = mLogRing[(mLogRingTail + i) & LOG_TOKEN_RING_MASK];
+                memcpy(buffer->buffer + len, &w, sizeof(w));
+                len += sizeof(w);
+                mLogRing[(mLogRingTail + i) & LOG_TOKEN_RING_MASK] = 0;
+            }
+            mLogRingTail += words;
+        }
+
+        buffer->length = len;
+        osEnqueueEvtOrFree(EVENT_TYPE_BIT_DISCARDABLE | EVT_DEBUG_LOG, buffer, heapFree);
+    }
+}
+
+static void logTokenKick(void)
+{
+    if (mLogStarted && !atomicReadByte(&mLogFlushPending) && !atomicXchgByte(&mLogFlushPending, true)) {
+        if (!osDefer(logTokenFlush, NULL, false))
+            atomicWriteByte(&mLogFlushPending, false);
+    }
+}
+
+void osLogTokenized(enum LogLevel level, const char *fmt, ...)
+{
+    uint32_t args[LOG_TOKEN_ARG_WORDS_MAX];
+    uint32_t numWords, head, pos, i;
+    uint16_t flags = LOG_TOKEN_FLAG_COMMITTED;
+    va_list vl;
+
+    if (sizeof(long) > sizeof(uint32_t))
+        flags |= LOG_TOKEN_FLAG_LP64;
+
+    va_start(vl, fmt);
+    numWords = logTokenCollect(args, fmt, vl, &flags);
+    va_end(vl);
+
+    do {
+        head = mLogRingHead;
+        if (head + LOG_TOKEN_HDR_WORDS + numWords - mLogRingTail > LOG_TOKEN_RING_WORDS) {
+            atomicAdd32bits(&mLogDropped, 1);
+            logTokenKick();
+            return;
+        }
+    } while (!atomicCmpXchg32bits(&mLogRingHead, head, head + LOG_TOKEN_HDR_WORDS + numWords));
+
+    pos = head + LOG_TOKEN_HDR_WORDS;
+    for (i = 0; i < numWords; i++)
+        mLogRing[(pos + i) & LOG_TOKEN_RING_MASK] = args[i];
+    mLogRing[(head + 1) & LOG_TOKEN_RING_MASK] = fmt - __logstr_start;
+    mLogRing[head & LOG_TOKEN_RING_MASK] = LOG_TOKEN_HDR(level, numWords, flags);
+
+    logTokenKick();
+}
+
+void logTokenStart(void)
+{
+    mLogStarted = true;
+    logTokenKick();
+}
+
+#endif
@@ -49,6 +49,7 @@
 #include <appSec.h>
 #include <cpu.h>
 #include <cpu/cpuMath.h>
+#include <i2c.h>
 #include <algos/ap_hub_sync.h>
 #include <sensors_priv.h>
 
@@ -58,6 +59,11 @@
         { .reason = _reason, .fastHandler = _fastHandler, .handler = _handler, \
           .minDataLen = sizeof(_minReqType), .maxDataLen = sizeof(_maxReqType) }
 
+#define NANOHUB_JUMBO_COMMAND(_reason, _handler, _minReqType, _maxReqType) \
+        { .reason = _reason, .fastHandler = NULL, .handler = _handler, \
+          .minDataLen = sizeof(_minReqType), .maxDataLen = sizeof(_maxReqType), \
+          .jumbo = true }
+
 #define NANOHUB_HAL_LEGACY_COMMAND(_msg, _handler) \
         { .msg = _msg, .handler = _handler }
 
@@ -134,12 +140,19 @@ static inline uint32_t unaligned_u32(uint32_t *val) {
 
 static uint32_t getOsHwVersion(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp)
 {
-    struct NanohubOsHwVersionsResponse *resp = tx;
-    resp->hwType = htole16(platHwType());
-    resp->hwVer = htole16(platHwVer());
-    resp->blVer = htole16(platBlVer());
-    resp->osVer = htole16(OS_VER);
-    resp->variantVer = htole32(VARIANT_VER);
+    struct NanohubOsHwVersionsCapsResponse *resp = tx;
+    resp->ver.hwType = htole16(platHwType());
+    resp->ver.hwVer = htole16(platHwVer());
+    resp->ver.blVer = htole16(platBlVer());
+    resp->ver.osVer = htole16(OS_VER);
+    resp->ver.variantVer = htole32(VARIANT_VER);
+
+    // only hosts that asked for capabilities know to expect them
+    if (rx_len < sizeof(struct NanohubOsHwVersionsCapsRequest))
+        return sizeof(resp->ver);
+
+    resp->caps = htole32(NANOHUB_OS_CAP_JUMBO_READ_EVENT);
+    resp->jumboPayloadMax = htole16(NANOHUB_JUMBO_PAYLOAD_MAX);
 
     return sizeof(*resp);
 }
@@ -891,15 +904,12 @@ static uint32_t readEventFast(void *rx, uint8_t rx_len, void *tx, uint64_t times
     return ret;
 }
 
-static uint32_t readEvent(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp)
+static uint32_t readEventFill(void *tx)
 {
-    struct NanohubReadEventRequest *req = rx;
     uint8_t *buf = tx;
     uint32_t length, wakeup, nonwakeup;
     uint32_t totLength = 0;
 
-    addDelta(&mTimeSync, req->apBootTime, timestamp);
-
     if ((totLength = atomicReadByte(&mTxCurrLength))) {
         memcpy(tx, &mTxCurr, totLength);
         atomicWriteByte(&mTxCurrLength, 0);
@@ -931,6 +941,37 @@ static uint32_t readEvent(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp
     return totLength;
 }
 
+static uint32_t readEvent(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp)
+{
+    struct NanohubReadEventRequest *req = rx;
+
+    addDelta(&mTimeSync, req->apBootTime, timestamp);
+
+    return readEventFill(tx);
+}
+
+static uint32_t readEventJumbo(void *rx, uint8_t rx_len, void *tx, uint64_t timestamp)
+{
+    struct NanohubReadEventRequest *req = rx;
+    struct NanohubReadEventJumboRecord *record;
+    uint8_t *buf = tx;
+    uint32_t length, totLength = 0;
+
+    addDelta(&mTimeSync, req->apBootTime, timestamp);
+
+    // each fill produces at most one HostIntfDataBuffer, so keep going while
+    // a worst case one still fits
+    while (totLength + sizeof(*record) + sizeof(struct HostIntfDataBuffer) <= NANOHUB_JUMBO_PAYLOAD_MAX) {
+        record = (struct NanohubReadEventJumboRecord *)(buf + totLength);
+        if (!(length = readEventFill(record->evt)))
+            break;
+        record->len = htole16(length);
+        totLength += sizeof(*record) + length;
+    }
+
+    return totLength;
+}
+
 static bool forwardPacket(uint32_t event, void *data, size_t data_size,
                           void *hdr, size_t hdr_size, uint32_t tid)
 {
@@ -1052,7 +1093,7 @@ const static struct NanohubCommand mBuiltinCommands[] = {
                     getOsHwVersion,
                     getOsHwVersion,
                     struct NanohubOsHwVersionsRequest,
-                    struct NanohubOsHwVersionsRequest),
+                    struct NanohubOsHwVersionsCapsRequest),
     NANOHUB_COMMAND(NANOHUB_REASON_GET_APP_VERSIONS,
                     NULL,
                     getAppVersion,
@@ -1098,6 +1139,10 @@ const static struct NanohubCommand mBuiltinCommands[] = {
                     readEvent,
                     struct NanohubReadEventRequest,
                     struct NanohubReadEventRequest),
+    NANOHUB_JUMBO_COMMAND(NANOHUB_REASON_READ_EVENT_JUMBO,
+                    readEventJumbo,
+                    struct NanohubReadEventRequest,
+                    struct NanohubReadEventRequest),
     NANOHUB_COMMAND(NANOHUB_REASON_WRITE_EVENT,
                     writeEvent,
                     writeEvent,
@@ -1849,6 +1894,107 @@ static void halFinishUpload(void *rx, uint8_t rx_len, uint32_t transactionId)
     osEnqueueEvtOrFree(EVT_APP_TO_HOST_CHRE, resp, heapFree);
 }
 
+static void halTaskStats(void *rx, uint8_t rx_len, uint32_t transactionId)
+{
+    struct NanohubHalTaskStatsRx *req = rx;
+    struct NanohubHalTaskStatsTx *resp;
+    struct NanohubHalTaskStatsEntry *entry;
+    struct TaskStats stats;
+    uint64_t appId;
+    uint32_t tid, idx;
+    int heapUse;
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    resp->hdr = (struct NanohubHalHdr) {
+        .appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0),
+        .len = sizeof(*resp) - sizeof(resp->hdr) - sizeof(resp->entries),
+        .transactionId = transactionId,
+    };
+    resp->ret = (struct NanohubHalRet) {
+        .msg = NANOHUB_HAL_TASK_STATS,
+    };
+    resp->cycleRate = htole32(cpuGetCycleRate());
+    resp->first = req->first;
+    resp->count = 0;
+
+    for (idx = req->first; resp->count < NANOHUB_HAL_TASK_STATS_MAX_ENTRIES && osTaskStatsByIndex(idx, &appId, &tid, &stats); idx++) {
+        heapUse = heapGetTaskSize(tid);
+        entry = &resp->entries[resp->count++];
+        entry->appId = htole64(appId);
+        entry->tid = htole16(tid);
+        entry->evtCount = htole32(stats.evtCount);
+        entry->timerCount = htole32(stats.timerCount);
+        entry->cycles = htole64(stats.cycles);
+        entry->maxCycles = htole32(stats.maxCycles);
+        entry->heapUse = htole32(heapUse > 0 ? heapUse : 0);
+        resp->hdr.len += sizeof(*entry);
+    }
+    resp->more = osTaskStatsByIndex(idx, &appId, &tid, &stats);
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST_CHRE, resp, heapFree);
+}
+
+static void halBatchStats(void *rx, uint8_t rx_len, uint32_t transactionId)
+{
+    struct NanohubHalBatchStatsTx *resp;
+    struct HostIntfBatchStats stats;
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    hostIntfGetBatchStats(&stats);
+
+    resp->hdr = (struct NanohubHalHdr) {
+        .appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0),
+        .len = sizeof(*resp) - sizeof(resp->hdr),
+        .transactionId = transactionId,
+    };
+    resp->ret = (struct NanohubHalRet) {
+        .msg = NANOHUB_HAL_BATCH_STATS,
+    };
+    resp->time = htole64(sensorGetTime());
+    resp->dataEvents = htole32(stats.dataEvents);
+    resp->latencyWakeups = htole32(stats.latencyWakeups);
+    resp->fifoInterrupts = htole32(stats.fifoInterrupts);
+    resp->suspendRaises = htole32(stats.suspendRaises);
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST_CHRE, resp, heapFree);
+}
+
+static void halI2cStats(void *rx, uint8_t rx_len, uint32_t transactionId)
+{
+    struct NanohubHalI2cStatsRx *req = rx;
+    struct NanohubHalI2cStatsTx *resp;
+    struct I2cMasterStats stats = { };
+    int ret;
+
+    if (!(resp = heapAlloc(sizeof(*resp))))
+        return;
+
+    ret = i2cMasterGetStats(req->bus, &stats);
+
+    resp->hdr = (struct NanohubHalHdr) {
+        .appId = APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 0),
+        .len = sizeof(*resp) - sizeof(resp->hdr),
+        .transactionId = transactionId,
+    };
+    resp->ret = (struct NanohubHalRet) {
+        .msg = NANOHUB_HAL_I2C_STATS,
+        .status = htole32(ret),
+    };
+    resp->bus = req->bus;
+    resp->time = htole64(sensorGetTime());
+    resp->xfers = htole32(stats.xfers);
+    resp->merged = htole32(stats.merged);
+    resp->maxDepth = htole32(stats.maxDepth);
+    resp->waitTotal = htole64(stats.waitTotal);
+    resp->waitMax = htole64(stats.waitMax);
+
+    osEnqueueEvtOrFree(EVT_APP_TO_HOST_CHRE, resp, heapFree);
+}
+
 const static struct NanohubHalCommand mBuiltinHalCommands[] = {
     NANOHUB_HAL_COMMAND(NANOHUB_HAL_APP_MGMT,
                             halAppMgmt,
@@ -1882,6 +2028,18 @@ const static struct NanohubHalCommand mBuiltinHalCommands[] = {
                             halFinishUpload,
                             struct { },
                             struct { }),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_TASK_STATS,
+                            halTaskStats,
+                            struct NanohubHalTaskStatsRx,
+                            struct NanohubHalTaskStatsRx),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_BATCH_STATS,
+                            halBatchStats,
+                            struct { },
+                            struct { }),
+    NANOHUB_HAL_COMMAND(NANOHUB_HAL_I2C_STATS,
+                            halI2cStats,
+                            struct NanohubHalI2cStatsRx,
+                            struct NanohubHalI2cStatsRx),
 };
 
 const struct NanohubHalCommand *nanohubHalFindCommand(uint8_t msg)
@@ -84,6 +84,18 @@ static void osExpApiEvtqFreeRetained(uintptr_t *retValP, va_list args)
     osFreeRetainedEvent(evtType, evtData, evtFreeingInfoP);
 }
 
+static void osExpApiEvtqRetainShared(uintptr_t *retValP, va_list args)
+{
+    *retValP = (uintptr_t)osRetainCurrentEventShared();
+}
+
+static void osExpApiEvtqReleaseShared(uintptr_t *retValP, va_list args)
+{
+    struct OsSharedEvt *sharedEvt = va_arg(args, struct OsSharedEvt*);
+
+    osReleaseSharedEvent(sharedEvt);
+}
+
 static void osExpApiLogLogv(uintptr_t *retValP, va_list args)
 {
     enum LogLevel level = va_arg(args, int /* enums promoted to ints in va_args in C */);
@@ -496,6 +508,8 @@ void osApiExport(struct SlabAllocator *mainSlubAllocator)
             [SYSCALL_OS_MAIN_EVTQ_ENQUEUE_PRIVATE] = { .func = osExpApiEvtqEnqueuePrivate, },
             [SYSCALL_OS_MAIN_EVTQ_RETAIN_EVT]      = { .func = osExpApiEvtqRetainEvt,      },
             [SYSCALL_OS_MAIN_EVTQ_FREE_RETAINED]   = { .func = osExpApiEvtqFreeRetained,   },
+            [SYSCALL_OS_MAIN_EVTQ_RETAIN_SHARED]   = { .func = osExpApiEvtqRetainShared,   },
+            [SYSCALL_OS_MAIN_EVTQ_RELEASE_SHARED]  = { .func = osExpApiEvtqReleaseShared,  },
         },
     };
 
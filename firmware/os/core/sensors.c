@@ -29,11 +29,16 @@
 #include <sensors_priv.h>
 
 
+#define SENSOR_HANDLE_ID_MASK   0xFF
+
 static struct Sensor mSensors[MAX_REGISTERED_SENSORS];
 ATOMIC_BITSET_DECL(mSensorsUsed, MAX_REGISTERED_SENSORS, static);
+/* sensor slot + 1 for each handle id in use (lower bits of the handle), 0 if unused */
+static uint8_t mSensorIdxById[SENSOR_HANDLE_ID_MASK + 1];
 static struct SlabAllocator *mInternalEvents;
 static struct SlabAllocator *mCliSensMatrix;
 static uint32_t mNextSensorHandle;
+static bool mReconfigScheduled;
 struct SingleAxisDataEvent singleAxisFlush = { .referenceTime = 0 };
 struct TripleAxisDataEvent tripleAxisFlush = { .referenceTime = 0 };
 
@@ -41,7 +46,7 @@ static inline uint32_t newSensorHandle()
 {
     // FIXME: only let lower 8 bits of counter to the id; should use all 16 bits, but this
     // somehow confuses upper layers; pending investigation
-    return (osGetCurrentTid() << 16) | (atomicAdd32bits(&mNextSensorHandle, 1) & 0xFF);
+    return (osGetCurrentTid() << 16) | (atomicAdd32bits(&mNextSensorHandle, 1) & SENSOR_HANDLE_ID_MASK);
 }
 
 bool sensorsInit(void)
@@ -63,25 +68,22 @@ bool sensorsInit(void)
 
 struct Sensor* sensorFindByHandle(uint32_t handle)
 {
-    uint32_t i;
+    uint32_t idx = mSensorIdxById[handle & SENSOR_HANDLE_ID_MASK];
 
-    for (i = 0; i < MAX_REGISTERED_SENSORS; i++)
-        if (mSensors[i].handle == handle)
-            return mSensors + i;
+    /* the id only selects the slot, the full handle must still match */
+    if (idx && handle && mSensors[idx - 1].handle == handle)
+        return mSensors + idx - 1;
 
     return NULL;
 }
 
-static struct SensorsClientRequest* sensorClientRequestFind(uint32_t sensorHandle, uint32_t clientTid)
+static struct SensorsClientRequest* sensorClientRequestFind(struct Sensor *s, uint32_t clientTid)
 {
-    uint32_t i;
+    struct SensorsClientRequest *req;
 
-    for (i = 0; i < MAX_CLI_SENS_MATRIX_SZ; i++) {
-        struct SensorsClientRequest *req = slabAllocatorGetNth(mCliSensMatrix, i);
-
-        if (req && req->handle == sensorHandle && req->clientTid == clientTid)
+    for (req = s->clients; req; req = req->next)
+        if (req->clientTid == clientTid)
             return req;
-    }
 
     return NULL;
 }
@@ -98,14 +100,21 @@ static uint32_t sensorRegisterEx(const struct SensorInfo *si, TaggedPtr callInfo
 
     /* grab a handle:
      * this is safe since nobody else could have "JUST" taken this handle,
-     * we'll need to circle around 16 bits before that happens, and have the same TID
+     * we'll need to circle around 16 bits before that happens, and have the same TID.
+     * The id part of the handle must not be in use either, it indexes the slot.
      */
     do {
         handle = newSensorHandle();
-    } while (!handle || sensorFindByHandle(handle));
+    } while (!handle || mSensorIdxById[handle & SENSOR_HANDLE_ID_MASK]);
 
     /* fill the struct in and mark it valid (by setting handle) */
     s = mSensors + idx;
+    s->clients = NULL;
+    s->clientsByLatency = NULL;
+    s->numClients = 0;
+    s->numOnchangeClients = 0;
+    s->reconfigPending = 0;
+    mSensorIdxById[handle & SENSOR_HANDLE_ID_MASK] = idx + 1;
     s->si = si;
     s->currentRate = SENSOR_RATE_OFF;
     s->currentLatency = SENSOR_LATENCY_INVALID;
@@ -157,6 +166,7 @@ bool sensorRegisterInitComplete(uint32_t handle)
 bool sensorUnregister(uint32_t handle)
 {
     struct Sensor *s = sensorFindByHandle(handle);
+    struct SensorsClientRequest *req;
 
     if (!s)
         return false;
@@ -164,6 +174,16 @@ bool sensorUnregister(uint32_t handle)
     /* mark as invalid */
     s->handle = 0;
     mem_reorder_barrier();
+    mSensorIdxById[handle & SENSOR_HANDLE_ID_MASK] = 0;
+
+    /* drop the requests still held against it, nobody can release them now */
+    while ((req = s->clients)) {
+        s->clients = req->next;
+        slabAllocatorFree(mCliSensMatrix, req);
+    }
+    s->clientsByLatency = NULL;
+    s->numClients = 0;
+    s->numOnchangeClients = 0;
 
     /* free struct */
     atomicBitsetClearBit(mSensorsUsed, s - mSensors);
@@ -380,29 +400,24 @@ static void sensorReconfig(struct Sensor* s, uint32_t newHwRate, uint64_t newHwL
     }
 }
 
-static uint64_t sensorCalcHwLatency(struct Sensor* s)
+/* rate a request is ordered by: ondemand and onchange ask for no particular rate */
+static inline uint32_t sensorRequestOrderRate(uint32_t rate)
 {
-    uint64_t smallestLatency = SENSOR_LATENCY_INVALID;
-    uint32_t i;
-
-    for (i = 0; i < MAX_CLI_SENS_MATRIX_SZ; i++) {
-        struct SensorsClientRequest *req = slabAllocatorGetNth(mCliSensMatrix, i);
-
-        /* we only care about this sensor's stuff */
-        if (!req || req->handle != s->handle)
-            continue;
-
-        if (smallestLatency > req->latency)
-            smallestLatency = req->latency;
-    }
+    return (rate == SENSOR_RATE_ONDEMAND || rate == SENSOR_RATE_ONCHANGE) ? 0 : rate;
+}
 
-    return smallestLatency;
+static uint64_t sensorCalcHwLatency(struct Sensor* s)
+{
+    /* requests are kept ordered by latency, the first one has the smallest */
+    return s->clientsByLatency ? s->clientsByLatency->latency : SENSOR_LATENCY_INVALID;
 }
 
 static uint32_t sensorCalcHwRate(struct Sensor* s, uint32_t extraReqedRate, uint32_t removedRate)
 {
     bool haveUsers = false, haveOnChange = extraReqedRate == SENSOR_RATE_ONCHANGE;
     uint32_t highestReq = 0;
+    uint32_t numClients, numOnchangeClients;
+    struct SensorsClientRequest *req;
     uint32_t i;
 
     if (s->si->supportedRates &&
@@ -417,31 +432,33 @@ static uint32_t sensorCalcHwRate(struct Sensor* s, uint32_t extraReqedRate, uint
         highestReq = (extraReqedRate == SENSOR_RATE_ONDEMAND || extraReqedRate == SENSOR_RATE_ONCHANGE) ? 0 : extraReqedRate;
     }
 
-    for (i = 0; i < MAX_CLI_SENS_MATRIX_SZ; i++) {
-        struct SensorsClientRequest *req = slabAllocatorGetNth(mCliSensMatrix, i);
+    /* removedRate, if given, is the rate of one of the requests: leave it out */
+    numClients = s->numClients;
+    numOnchangeClients = s->numOnchangeClients;
+    if (removedRate != SENSOR_RATE_OFF) {
+        numClients--;
+        if (removedRate == SENSOR_RATE_ONCHANGE)
+            numOnchangeClients--;
+    }
 
-        /* we only care about this sensor's stuff */
-        if (!req || req->handle != s->handle)
-            continue;
+    if (numClients)
+        haveUsers = true;
+
+    /* we can always do ondemand and if we see an on-change then we already checked and do allow it */
+    if (numOnchangeClients)
+        haveOnChange = true;
 
+    /* requests are kept ordered by rate, so the first one not skipped has the highest */
+    for (req = s->clients; req; req = req->next) {
         /* skip an instance of a removed rate if one was given */
         if (req->rate == removedRate) {
             removedRate = SENSOR_RATE_OFF;
             continue;
         }
 
-        haveUsers = true;
-
-        /* we can always do ondemand and if we see an on-change then we already checked and do allow it */
-        if (req->rate == SENSOR_RATE_ONDEMAND)
-            continue;
-        if (req->rate == SENSOR_RATE_ONCHANGE) {
-            haveOnChange = true;
-            continue;
-        }
-
-        if (highestReq < req->rate)
-            highestReq = req->rate;
+        if (highestReq < sensorRequestOrderRate(req->rate))
+            highestReq = sensorRequestOrderRate(req->rate);
+        break;
     }
 
     if (!highestReq) {   /* no requests -> we can definitely do that */
@@ -460,6 +477,58 @@ static uint32_t sensorCalcHwRate(struct Sensor* s, uint32_t extraReqedRate, uint
     return SENSOR_RATE_IMPOSSIBLE;
 }
 
+/* apply changed client requests, then send new onchange clients the current state */
+static void sensorReconfigNow(struct Sensor* s)
+{
+    struct SensorsClientRequest *req;
+
+    s->reconfigPending = 0;
+    sensorReconfig(s, sensorCalcHwRate(s, 0, 0), sensorCalcHwLatency(s));
+
+    for (req = s->clients; req; req = req->next) {
+        if (req->sendLastState) {
+            req->sendLastState = false;
+            if (!sensorCallFuncSendOneDirectEvt(s, req->clientTid))
+                osLog(LOG_WARN, "Cannot send last state for onchange sensor: enqueue fail");
+        }
+    }
+}
+
+static void sensorReconfigPending(void *unused)
+{
+    uint32_t i;
+
+    (void)unused;
+
+    /* clear first: reconfiguring one sensor may request another one */
+    mReconfigScheduled = false;
+    mem_reorder_barrier();
+
+    for (i = 0; i < MAX_REGISTERED_SENSORS; i++) {
+        struct Sensor *s = mSensors + i;
+
+        if (s->handle && s->reconfigPending)
+            sensorReconfigNow(s);
+    }
+}
+
+/* client requests changed: reconfigure once all requests queued so far are in */
+static void sensorReconfigLater(struct Sensor* s)
+{
+    s->reconfigPending = 1;
+
+    if (mReconfigScheduled)
+        return;
+
+    if (osDefer(sensorReconfigPending, NULL, false)) {
+        mReconfigScheduled = true;
+        return;
+    }
+
+    /* cannot defer, do it now */
+    sensorReconfigNow(s);
+}
+
 static void sensorInternalEvtFreeF(void *evtP)
 {
     slabAllocatorFree(mInternalEvents, evtP);
@@ -571,25 +640,72 @@ const struct SensorInfo* sensorFind(uint32_t sensorType, uint32_t idx, uint32_t
     return NULL;
 }
 
-static bool sensorAddRequestor(uint32_t sensorHandle, uint32_t clientTid, uint32_t rate, uint64_t latency)
+static void sensorLinkRequestor(struct Sensor *s, struct SensorsClientRequest *req)
+{
+    struct SensorsClientRequest **prevP;
+
+    /* equal keys go after the existing ones, so older requests are found first */
+    for (prevP = &s->clients; *prevP; prevP = &(*prevP)->next)
+        if (sensorRequestOrderRate((*prevP)->rate) < sensorRequestOrderRate(req->rate))
+            break;
+    req->next = *prevP;
+    *prevP = req;
+
+    for (prevP = &s->clientsByLatency; *prevP; prevP = &(*prevP)->nextByLatency)
+        if ((*prevP)->latency > req->latency)
+            break;
+    req->nextByLatency = *prevP;
+    *prevP = req;
+
+    s->numClients++;
+    if (req->rate == SENSOR_RATE_ONCHANGE)
+        s->numOnchangeClients++;
+}
+
+static void sensorUnlinkRequestor(struct Sensor *s, struct SensorsClientRequest *req)
+{
+    struct SensorsClientRequest **prevP;
+
+    for (prevP = &s->clients; *prevP; prevP = &(*prevP)->next) {
+        if (*prevP == req) {
+            *prevP = req->next;
+            break;
+        }
+    }
+
+    for (prevP = &s->clientsByLatency; *prevP; prevP = &(*prevP)->nextByLatency) {
+        if (*prevP == req) {
+            *prevP = req->nextByLatency;
+            break;
+        }
+    }
+
+    s->numClients--;
+    if (req->rate == SENSOR_RATE_ONCHANGE)
+        s->numOnchangeClients--;
+}
+
+static bool sensorAddRequestor(struct Sensor *s, uint32_t clientTid, uint32_t rate, uint64_t latency)
 {
     struct SensorsClientRequest *req = slabAllocatorAlloc(mCliSensMatrix);
 
     if (!req)
         return false;
 
-    req->handle = sensorHandle;
+    req->handle = s->handle;
     req->clientTid = clientTid;
-    mem_reorder_barrier();
     req->rate = rate;
     req->latency = latency;
+    req->sendLastState = s->hasOnchange;
+    mem_reorder_barrier();
+    sensorLinkRequestor(s, req);
 
     return true;
 }
 
-static bool sensorGetCurRequestorRate(uint32_t sensorHandle, uint32_t clientTid, uint32_t *rateP)
+static bool sensorGetCurRequestorRate(struct Sensor *s, uint32_t clientTid, uint32_t *rateP)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, clientTid);
+    struct SensorsClientRequest *req = sensorClientRequestFind(s, clientTid);
 
     if (req) {
         if (rateP)
@@ -600,24 +716,28 @@ static bool sensorGetCurRequestorRate(uint32_t sensorHandle, uint32_t clientTid,
     }
 }
 
-static bool sensorAmendRequestor(uint32_t sensorHandle, uint32_t clientTid, uint32_t newRate, uint64_t newLatency)
+static bool sensorAmendRequestor(struct Sensor *s, uint32_t clientTid, uint32_t newRate, uint64_t newLatency)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, clientTid);
+    struct SensorsClientRequest *req = sensorClientRequestFind(s, clientTid);
 
     if (req) {
+        /* re-insert at the new rate and latency */
+        sensorUnlinkRequestor(s, req);
         req->rate = newRate;
         req->latency = newLatency;
+        sensorLinkRequestor(s, req);
         return true;
     } else {
         return false;
     }
 }
 
-static bool sensorDeleteRequestor(uint32_t sensorHandle, uint32_t clientTid)
+static bool sensorDeleteRequestor(struct Sensor *s, uint32_t clientTid)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, clientTid);
+    struct SensorsClientRequest *req = sensorClientRequestFind(s, clientTid);
 
     if (req) {
+        sensorUnlinkRequestor(s, req);
         req->rate = SENSOR_RATE_OFF;
         req->latency = SENSOR_LATENCY_INVALID;
         req->clientTid = 0;
@@ -633,7 +753,6 @@ static bool sensorDeleteRequestor(uint32_t sensorHandle, uint32_t clientTid)
 bool sensorRequest(uint32_t unusedTid, uint32_t sensorHandle, uint32_t rate, uint64_t latency)
 {
     struct Sensor* s = sensorFindByHandle(sensorHandle);
-    uint32_t newSensorRate;
     uint64_t samplingPeriod;
     uint32_t clientTid;
 
@@ -645,8 +764,7 @@ bool sensorRequest(uint32_t unusedTid, uint32_t sensorHandle, uint32_t rate, uin
     clientTid = osGetCurrentTid();
 
     /* verify the rate is possible */
-    newSensorRate = sensorCalcHwRate(s, rate, 0);
-    if (newSensorRate == SENSOR_RATE_IMPOSSIBLE)
+    if (sensorCalcHwRate(s, rate, 0) == SENSOR_RATE_IMPOSSIBLE)
         return false;
 
     /* the latency should be lower bounded by sampling period */
@@ -654,23 +772,18 @@ bool sensorRequest(uint32_t unusedTid, uint32_t sensorHandle, uint32_t rate, uin
     latency = latency > samplingPeriod ? latency : samplingPeriod;
 
     /* record the request */
-    if (!sensorAddRequestor(sensorHandle, clientTid, rate, latency))
+    if (!sensorAddRequestor(s, clientTid, rate, latency))
         return false;
 
-    /* update actual sensor if needed */
-    sensorReconfig(s, newSensorRate, sensorCalcHwLatency(s));
-
-    /* if onchange request, ask sensor to send last state */
-    if (s->hasOnchange && !sensorCallFuncSendOneDirectEvt(s, clientTid))
-        osLog(LOG_WARN, "Cannot send last state for onchange sensor: enqueue fail");
-
+    /* update actual sensor if needed; an onchange sensor sends the last state after that */
+    sensorReconfigLater(s);
     return true;
 }
 
 bool sensorRequestRateChange(uint32_t unusedTid, uint32_t sensorHandle, uint32_t newRate, uint64_t newLatency)
 {
     struct Sensor* s = sensorFindByHandle(sensorHandle);
-    uint32_t oldRate, newSensorRate;
+    uint32_t oldRate;
     uint64_t samplingPeriod;
     uint32_t clientTid;
 
@@ -681,12 +794,11 @@ bool sensorRequestRateChange(uint32_t unusedTid, uint32_t sensorHandle, uint32_t
 
     clientTid = osGetCurrentTid();
     /* get current rate */
-    if (!sensorGetCurRequestorRate(sensorHandle, clientTid, &oldRate))
+    if (!sensorGetCurRequestorRate(s, clientTid, &oldRate))
         return false;
 
     /* verify the new rate is possible given all other ongoing requests */
-    newSensorRate = sensorCalcHwRate(s, newRate, oldRate);
-    if (newSensorRate == SENSOR_RATE_IMPOSSIBLE)
+    if (sensorCalcHwRate(s, newRate, oldRate) == SENSOR_RATE_IMPOSSIBLE)
         return false;
 
     /* the latency should be lower bounded by sampling period */
@@ -694,11 +806,11 @@ bool sensorRequestRateChange(uint32_t unusedTid, uint32_t sensorHandle, uint32_t
     newLatency = newLatency > samplingPeriod ? newLatency : samplingPeriod;
 
     /* record the request */
-    if (!sensorAmendRequestor(sensorHandle, clientTid, newRate, newLatency))
+    if (!sensorAmendRequestor(s, clientTid, newRate, newLatency))
         return false;
 
     /* update actual sensor if needed */
-    sensorReconfig(s, newSensorRate, sensorCalcHwLatency(s));
+    sensorReconfigLater(s);
     return true;
 }
 
@@ -712,11 +824,11 @@ bool sensorRelease(uint32_t unusedTid, uint32_t sensorHandle)
         return false;
 
     /* record the request */
-    if (!sensorDeleteRequestor(sensorHandle, osGetCurrentTid()))
+    if (!sensorDeleteRequestor(s, osGetCurrentTid()))
         return false;
 
     /* update actual sensor if needed */
-    sensorReconfig(s, sensorCalcHwRate(s, 0, 0), sensorCalcHwLatency(s));
+    sensorReconfigLater(s);
     return true;
 }
 
@@ -729,8 +841,8 @@ uint32_t sensorFreeAll(uint32_t clientTid)
     for (i = 0; i < MAX_REGISTERED_SENSORS; i++) {
         if (mSensors[i].handle) {
             s = mSensors + i;
-            if (sensorDeleteRequestor(s->handle, clientTid)) {
-                sensorReconfig(s, sensorCalcHwRate(s, 0, 0), sensorCalcHwLatency(s));
+            if (sensorDeleteRequestor(s, clientTid)) {
+                sensorReconfigLater(s);
                 count1 ++;
             }
             if (HANDLE_TO_TID(s->handle) == clientTid) {
@@ -752,7 +864,7 @@ bool sensorTriggerOndemand(uint32_t unusedTid, uint32_t sensorHandle)
     if (!s || !s->hasOndemand)
         return false;
 
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, osGetCurrentTid());
+    struct SensorsClientRequest *req = sensorClientRequestFind(s, osGetCurrentTid());
 
     if (req)
         return sensorCallFuncTrigger(s);
@@ -805,6 +917,10 @@ uint32_t sensorGetCurRate(uint32_t sensorHandle)
 {
     struct Sensor* s = sensorFindByHandle(sensorHandle);
 
+    /* do not report the rate from before the latest requests */
+    if (s && s->reconfigPending)
+        sensorReconfigNow(s);
+
     return s ? s->currentRate : SENSOR_RATE_OFF;
 }
 
@@ -812,6 +928,9 @@ uint64_t sensorGetCurLatency(uint32_t sensorHandle)
 {
     struct Sensor* s = sensorFindByHandle(sensorHandle);
 
+    if (s && s->reconfigPending)
+        sensorReconfigNow(s);
+
     return s ? s->currentLatency : SENSOR_LATENCY_INVALID;
 }
 
@@ -831,14 +950,16 @@ uint64_t sensorGetHwLatency(uint32_t sensorHandle)
 
 uint32_t sensorGetReqRate(uint32_t sensorHandle)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, osGetCurrentTid());
+    struct Sensor* s = sensorFindByHandle(sensorHandle);
+    struct SensorsClientRequest *req = s ? sensorClientRequestFind(s, osGetCurrentTid()) : NULL;
 
     return req ? req->rate : SENSOR_RATE_OFF;
 }
 
 uint64_t sensorGetReqLatency(uint32_t sensorHandle)
 {
-    struct SensorsClientRequest *req = sensorClientRequestFind(sensorHandle, osGetCurrentTid());
+    struct Sensor* s = sensorFindByHandle(sensorHandle);
+    struct SensorsClientRequest *req = s ? sensorClientRequestFind(s, osGetCurrentTid()) : NULL;
 
     return req ? req->latency : SENSOR_LATENCY_INVALID;
 }
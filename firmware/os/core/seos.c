@@ -60,6 +60,14 @@ static struct TaskList mTasks;
 static struct Task *mCurrentTask;
 static struct Task *mSystemTask;
 static TaggedPtr *mCurEvtEventFreeingInfo = NULL; //used as flag for retaining. NULL when none or already retained
+static union SeosInternalSlabData *mCurEvtShared = NULL; //shared-retain record for current event. NULL until some app takes a shared reference
+static union SeosInternalSlabData *mSharedRefs = NULL; //references apps hold to shared events, released with the app
+static uint32_t mCurEvtType;
+static void *mCurEvtData;
+static uint32_t mTaskStatsNested; //main loop only: cycles spent in runs nested in the current one, so they are not charged twice
+static volatile uint32_t mTaskStatsTimerCycles; //running total of cycles in direct timer callbacks; only written with interrupts off
+
+static int osSharedEventReleaseAll(uint32_t tid);
 
 static inline void list_init(struct TaskList *l)
 {
@@ -302,7 +310,7 @@ static void osTaskRelease(struct Task *task)
 {
     uint32_t taskTid = task->tid;
     uint32_t platErr, sensorErr;
-    int timErr, heapErr;
+    int timErr, sharedErr, heapErr;
     uint64_t appId;
 
     if (task->app)
@@ -313,10 +321,11 @@ static void osTaskRelease(struct Task *task)
     platErr = platFreeResources(taskTid); // HW resources cleanup (IRQ, DMA etc)
     sensorErr = sensorFreeAll(taskTid);
     timErr = timTimerCancelAll(taskTid);
+    sharedErr = osSharedEventReleaseAll(taskTid);
     heapErr = heapFreeAll(taskTid);
 
-    if (platErr || sensorErr || timErr || heapErr)
-        osLog(LOG_WARN, "released app ID 0x%" PRIx64 "; plat:%08" PRIx32 " sensor:%08" PRIx32 " tim:%d heap:%d; TID %04" PRIX32 "\n", appId, platErr, sensorErr, timErr, heapErr, taskTid);
+    if (platErr || sensorErr || timErr || sharedErr || heapErr)
+        osLog(LOG_WARN, "released app ID 0x%" PRIx64 "; plat:%08" PRIx32 " sensor:%08" PRIx32 " tim:%d shared:%d heap:%d; TID %04" PRIX32 "\n", appId, platErr, sensorErr, timErr, sharedErr, heapErr, taskTid);
     else
         osLog(LOG_INFO, "released app ID 0x%" PRIx64 "; TID %04" PRIX32 "\n", appId, taskTid);
 }
@@ -335,12 +344,58 @@ static inline void osTaskEnd(struct Task *task)
     osTaskRelease(task);
 }
 
+void osTaskStatsBegin(struct TaskStatsSpan *span)
+{
+    span->nested = mTaskStatsNested;
+    mTaskStatsNested = 0;
+    span->start = cpuGetCycles();
+    span->timers = mTaskStatsTimerCycles;
+}
+
+void osTaskStatsEnd(struct TaskStatsSpan *span, struct Task *task)
+{
+    // timer cycles are sampled after the start and before the end time, so all callbacks counted ran within the span
+    uint32_t timers = mTaskStatsTimerCycles - span->timers;
+    uint32_t busy = cpuGetCycles() - span->start - timers;
+    uint32_t own = busy > mTaskStatsNested ? busy - mTaskStatsNested : 0;
+
+    mTaskStatsNested = span->nested + busy;
+
+    if (!task)
+        return;
+
+    task->stats.evtCount++;
+    task->stats.cycles += own;
+    if (own > task->stats.maxCycles)
+        task->stats.maxCycles = own;
+}
+
+// called with interrupts off, possibly from the timer interrupt, so it only touches timer-side counters
+void osTaskStatsTimer(uint32_t tid, uint32_t cycles)
+{
+    struct Task *task = osTaskByIdx(TID_TO_TASK_IDX(tid));
+
+    mTaskStatsTimerCycles += cycles;
+
+    if (!task || task->tid != tid)
+        return;
+
+    task->timerStats.timerCount++;
+    task->timerStats.cycles += cycles;
+    if (cycles > task->timerStats.maxCycles)
+        task->timerStats.maxCycles = cycles;
+}
+
 static inline void osTaskHandle(struct Task *task, uint16_t evtType, uint16_t fromTid, const void* evtData)
 {
     struct Task *preempted = osSetCurrentTask(task);
+    struct TaskStatsSpan span;
+
+    osTaskStatsBegin(&span);
     cpuAppHandle(task->app, &task->platInfo,
                  EVENT_WITH_ORIGIN(evtType, osTaskIsChre(task) ? fromTid : 0),
                  evtData);
+    osTaskStatsEnd(&span, task);
     osSetCurrentTask(preempted);
 }
 
@@ -1120,9 +1175,12 @@ static void osInternalEvtHandle(uint32_t evtType, void *evtData)
         if (task) {
             //private events cannot be retained
             TaggedPtr *tmp = mCurEvtEventFreeingInfo;
+            union SeosInternalSlabData *tmpShared = mCurEvtShared;
             mCurEvtEventFreeingInfo = NULL;
+            mCurEvtShared = NULL;
             osTaskHandle(task, evtType, da->privateEvt.fromTid, da->privateEvt.evtData);
             mCurEvtEventFreeingInfo = tmp;
+            mCurEvtShared = tmpShared;
         }
         break;
     }
@@ -1152,6 +1210,86 @@ void osFreeRetainedEvent(uint32_t evtType, void *evtData, TaggedPtr *evtFreeingI
     handleEventFreeing(evtType, evtData, *evtFreeingInfoP);
 }
 
+static void osSharedEventPut(union SeosInternalSlabData *shared)
+{
+    if (--shared->sharedEvt.refCnt)
+        return;
+
+    handleEventFreeing(shared->sharedEvt.evtType, shared->sharedEvt.evtData, shared->sharedEvt.evtFreeInfo);
+    slabAllocatorFree(mMiscInternalThingsSlab, shared);
+}
+
+struct OsSharedEvt *osRetainCurrentEventShared(void)
+{
+    union SeosInternalSlabData *shared = mCurEvtShared, *ref;
+
+    if (shared ? shared->sharedEvt.refCnt == UINT16_MAX : !mCurEvtEventFreeingInfo)
+        return NULL;
+
+    //each reference has its own record, so it knows its holder
+    ref = slabAllocatorAlloc(mMiscInternalThingsSlab);
+    if (!ref)
+        return NULL;
+
+    if (!shared) {
+        //first sharer takes freeing duty over from the dequeue loop, which keeps its own reference till dispatch is done
+        shared = slabAllocatorAlloc(mMiscInternalThingsSlab);
+        if (!shared) {
+            slabAllocatorFree(mMiscInternalThingsSlab, ref);
+            return NULL;
+        }
+
+        shared->sharedEvt.evtType = mCurEvtType;
+        shared->sharedEvt.evtData = mCurEvtData;
+        shared->sharedEvt.evtFreeInfo = *mCurEvtEventFreeingInfo;
+        shared->sharedEvt.refCnt = 1;
+        mCurEvtEventFreeingInfo = NULL;
+        mCurEvtShared = shared;
+    }
+
+    shared->sharedEvt.refCnt++;
+    ref->sharedRef.evt = shared;
+    ref->sharedRef.tid = osGetCurrentTid();
+    ref->sharedRef.next = mSharedRefs;
+    mSharedRefs = ref;
+
+    return (struct OsSharedEvt*)ref;
+}
+
+void osReleaseSharedEvent(struct OsSharedEvt *sharedEvt)
+{
+    union SeosInternalSlabData *ref = (union SeosInternalSlabData*)sharedEvt, **prevP;
+
+    //only references still on the list are released, a stale or bogus handle is ignored
+    for (prevP = &mSharedRefs; ref && *prevP; prevP = &(*prevP)->sharedRef.next) {
+        if (*prevP == ref) {
+            *prevP = ref->sharedRef.next;
+            osSharedEventPut(ref->sharedRef.evt);
+            slabAllocatorFree(mMiscInternalThingsSlab, ref);
+            return;
+        }
+    }
+}
+
+static int osSharedEventReleaseAll(uint32_t tid)
+{
+    union SeosInternalSlabData *ref, **prevP = &mSharedRefs;
+    int count = 0;
+
+    while ((ref = *prevP)) {
+        if (ref->sharedRef.tid == tid) {
+            *prevP = ref->sharedRef.next;
+            osSharedEventPut(ref->sharedRef.evt);
+            slabAllocatorFree(mMiscInternalThingsSlab, ref);
+            count++;
+        } else {
+            prevP = &ref->sharedRef.next;
+        }
+    }
+
+    return count;
+}
+
 void osMainInit(void)
 {
     cpuInit();
@@ -1185,6 +1323,8 @@ void osMainDequeueLoop(void)
 
     /* by default we free them when we're done with them */
     mCurEvtEventFreeingInfo = &evtFreeingInfo;
+    mCurEvtType = evtType;
+    mCurEvtData = evtData;
     tid = EVENT_GET_ORIGIN(evtType);
     evt = EVENT_GET_EVENT(evtType);
 
@@ -1206,9 +1346,12 @@ void osMainDequeueLoop(void)
     /* free it */
     if (mCurEvtEventFreeingInfo)
         handleEventFreeing(evtType, evtData, evtFreeingInfo);
+    else if (mCurEvtShared) /* drop our reference; freed here unless some app still holds one */
+        osSharedEventPut(mCurEvtShared);
 
     /* avoid some possible errors */
     mCurEvtEventFreeingInfo = NULL;
+    mCurEvtShared = NULL;
 }
 
 void __attribute__((noreturn)) osMain(void)
@@ -1461,6 +1604,35 @@ bool osAppInfoByIndex(uint32_t appIdx, uint64_t *appId, uint32_t *appVer, uint32
     return false;
 }
 
+bool osTaskStatsByIndex(uint32_t taskIdx, uint64_t *appId, uint32_t *tid, struct TaskStats *stats)
+{
+    struct Task *task;
+    int i = 0;
+
+    for_each_task(&mTasks, task) {
+        if (i != taskIdx) {
+            ++i;
+        } else {
+            struct TaskStats timerStats;
+            uint64_t intSta = cpuIntsOff();
+
+            timerStats = task->timerStats;
+            cpuIntsRestore(intSta);
+
+            *appId = task->app->hdr.appId;
+            *tid = task->tid;
+            *stats = task->stats;
+            stats->timerCount = timerStats.timerCount;
+            stats->cycles += timerStats.cycles;
+            if (timerStats.maxCycles > stats->maxCycles)
+                stats->maxCycles = timerStats.maxCycles;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool osExtAppInfoByIndex(uint32_t appIdx, uint64_t *appId, uint32_t *appVer, uint32_t *appSize)
 {
     struct Task *task;
@@ -37,6 +37,7 @@ struct SpiDeviceState {
     const struct SpiPacket *packets;
     size_t n;
     size_t currentBuf;
+    size_t chainEnd;
     struct SpiMode mode;
     uint16_t tid;
 
@@ -50,6 +51,7 @@ struct SpiDeviceState {
 };
 #define SPI_DEVICE_TO_STATE(p) ((struct SpiDeviceState *)p)
 
+static int spiMasterXfer(struct SpiDeviceState *state);
 static void spiMasterNext(struct SpiDeviceState *state);
 static void spiMasterStop(struct SpiDeviceState *state);
 static void spiMasterDone(struct SpiDeviceState *state, int err);
@@ -72,8 +74,7 @@ static int spiMasterStart(struct SpiDeviceState *state,
             return err;
     }
 
-    return dev->ops->masterRxTx(dev, state->packets[0].rxBuf,
-            state->packets[0].txBuf, state->packets[0].size, mode);
+    return spiMasterXfer(state);
 }
 
 void spi_masterStartAsync_done(struct SpiDevice *dev, int err)
@@ -90,22 +91,40 @@ static void spiDelayCallback(uint32_t timerId, void *data)
     spiMasterNext((struct SpiDeviceState *)data);
 }
 
-static void spiMasterNext(struct SpiDeviceState *state)
+static int spiMasterXfer(struct SpiDeviceState *state)
 {
     struct SpiDevice *dev = &state->dev;
+    size_t i = state->currentBuf;
+    const struct SpiMode *mode = &state->mode;
 
-    if (state->currentBuf == state->n) {
-        spiMasterStop(state);
-        return;
+    if (dev->ops->masterRxTxChain) {
+        // everything up to the next delay goes out with a single completion
+        size_t end = i + 1;
+
+        while (end < state->n && !state->packets[end - 1].delay)
+            end++;
+        state->chainEnd = end;
+
+        return dev->ops->masterRxTxChain(dev, &state->packets[i], end - i,
+                mode);
     }
 
-    size_t i = state->currentBuf;
     void *rxBuf = state->packets[i].rxBuf;
     const void *txBuf = state->packets[i].txBuf;
     size_t size = state->packets[i].size;
-    const struct SpiMode *mode = &state->mode;
 
-    int err = dev->ops->masterRxTx(dev, rxBuf, txBuf, size, mode);
+    state->chainEnd = i + 1;
+    return dev->ops->masterRxTx(dev, rxBuf, txBuf, size, mode);
+}
+
+static void spiMasterNext(struct SpiDeviceState *state)
+{
+    if (state->currentBuf == state->n) {
+        spiMasterStop(state);
+        return;
+    }
+
+    int err = spiMasterXfer(state);
     if (err)
         spiMasterDone(state, err);
 }
@@ -116,8 +135,9 @@ void spiMasterRxTxDone(struct SpiDevice *dev, int err)
     if (err) {
         spiMasterDone(state, err);
     } else {
-        size_t i = state->currentBuf++;
+        size_t i = state->chainEnd - 1;
 
+        state->currentBuf = state->chainEnd;
         if (state->packets[i].delay > 0) {
             if (!timTimerSet(state->packets[i].delay, 0, 50, spiDelayCallback, state, true)) {
                 ERROR_PRINT("Cannot do delayed spi, timer depleted\n");
@@ -277,6 +297,7 @@ static int spiSetupRxTx(struct SpiDeviceState *state,
     state->packets = packets;
     state->n = n;
     state->currentBuf = 0;
+    state->chainEnd = 0;
     state->rxTxCallback = callback;
     state->rxTxCookie = cookie;
     state->tid = osGetCurrentTid();
@@ -90,10 +90,13 @@ static void timCallFunc(struct Timer *tim)
 {
     struct TimerEvent *evt;
     TaggedPtr callInfo = tim->callInfo;
+    uint32_t start;
 
     if (taggedPtrIsPtr(callInfo)) {
         osSetCurrentTid(tim->tid);
+        start = cpuGetCycles();
         ((TimTimerCbkF)taggedPtrToPtr(callInfo))(tim->id, tim->callData);
+        osTaskStatsTimer(tim->tid, cpuGetCycles() - start);
     } else {
         osSetCurrentTid(OS_SYSTEM_TID);
         if ((evt = slabAllocatorAlloc(mInternalEvents)) != 0) {
@@ -86,6 +86,21 @@ void cpuInit(void)
 
     /* FPU on */
     SCB->CPACR |= 0x00F00000;
+
+    /* cycle counter on */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t cpuGetCycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+uint32_t cpuGetCycleRate(void)
+{
+    return pwrGetBusSpeed(PERIPH_BUS_AHB1);
 }
 
 //pack all our SR regs into 45 bits
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _X86_CPU_MATH_H_
+#define _X86_CPU_MATH_H_
+
+#include <stdint.h>
+
+//x86 has a native 64-bit divide, so none of the reciprocal tricks are needed here
+
+static inline uint32_t cpuMathUint44Div1000ToUint32(uint64_t val)
+{
+    return val / 1000;
+}
+
+static inline uint64_t cpuMathU64DivByU16(uint64_t val, uint32_t divBy /* 16 bits max*/)
+{
+    return val / divBy;
+}
+
+static inline uint64_t cpuMathRecipAssistedUdiv64by64(uint64_t num, uint64_t denom, uint64_t denomRecip)
+{
+    return num / denom;
+}
+
+static inline uint64_t cpuMathRecipAssistedUdiv64by32(uint64_t num, uint32_t denom, uint64_t denomRecip)
+{
+    return num / denom;
+}
+
+#define U64_DIV_BY_CONST_U16(u64, u16)              ((uint64_t)(u64) / (uint16_t)(u16))
+#define U64_RECIPROCAL_CALCULATE(val)               0
+#define U64_DIV_BY_U64_CONSTANT(val, constantVal)   ((uint64_t)(val) / (uint64_t)(constantVal))
+#define I64_DIV_BY_I64_CONSTANT(val, constantVal)   ((int64_t)(val) / (int64_t)(constantVal))
+
+#endif
+
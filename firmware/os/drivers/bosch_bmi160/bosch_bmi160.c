@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algos/imu_fifo.h>
 #include <algos/time_sync.h>
 #include <atomic.h>
 #include <common/math/macros.h>
@@ -25,6 +26,7 @@
 #include <hostIntf.h>
 #include <i2c.h>
 #include <isr.h>
+#include <logToken.h>
 #include <nanohub_math.h>
 #include <nanohubPacket.h>
 #include <printf.h>
@@ -86,13 +88,13 @@
 
 #define DEBUG_PRINT(fmt, ...) do { \
         if (DBG_ENABLE) {  \
-            osLog(LOG_DEBUG, "%s " fmt, "[BMI160]", ##__VA_ARGS__); \
+            osLogT(LOG_DEBUG, "[BMI160] " fmt, ##__VA_ARGS__); \
         } \
     } while (0);
 
 #define DEBUG_PRINT_IF(cond, fmt, ...) do { \
         if ((cond) && DBG_ENABLE) {  \
-            osLog(LOG_DEBUG, "%s " fmt, "[BMI160]", ##__VA_ARGS__); \
+            osLogT(LOG_DEBUG, "[BMI160] " fmt, ##__VA_ARGS__); \
         } \
     } while (0);
 
@@ -480,6 +482,9 @@ struct BMI160Task {
 #ifdef GYRO_CAL_ENABLED
     // Gyro Cal -- Declaration.
     struct GyroCal gyro_cal;
+
+    // Gyro Cal -- Samples staged while parsing a FIFO read.
+    struct GyroCalFifoRuns gyro_cal_runs;
 #endif  //  GYRO_CAL_ENABLED
 
 #ifdef OVERTEMPCAL_ENABLED
@@ -795,6 +800,15 @@ static bool sensortime_to_rtc_time(uint64_t sensor_time, uint64_t *rtc_time_ns)
 static void map_sensortime_to_rtc_time(uint64_t sensor_time, uint64_t rtc_time_ns) {
 // fixme: nsec?
     time_sync_add(&mTask.gSensorTime2RTC, rtc_time_ns, sensor_time * 39ull);
+
+#if TIMESTAMP_DBG
+    time_sync_stats_t stats;
+
+    if (time_sync_get_stats(&mTask.gSensorTime2RTC, &stats)) {
+        DEBUG_PRINT("sensortime sync: %u points, drift %d ppb, jitter %d ns\n",
+                (unsigned int)stats.n, (int)(stats.drift_ppm * 1000.0f), (int)stats.jitter_ns);
+    }
+#endif
 }
 
 static void invalidate_sensortime_to_rtc_time(void) {
@@ -900,6 +914,8 @@ static bool bmi160Isr1(struct ChainedIsr *isr)
         return false;
     }
     DEBUG_PRINT_IF(DBG_INT, "i1\n");
+    // INT1 only carries the FIFO watermark and full interrupts
+    hostIntfCountFifoInterrupt();
     initiateFifoRead(true /*isInterruptContext*/);
     extiClearPendingGpio(T(Int1));
     return true;
@@ -1983,14 +1999,12 @@ static uint64_t parseSensortime(uint32_t sensor_time24)
     return (full -  0x1000000ull);
 }
 
-static void parseRawData(struct BMI160Sensor *mSensor, uint8_t *buf, float kScale, uint64_t sensorTime)
+static void parseRawData(struct BMI160Sensor *mSensor, float x, float y, float z, uint64_t sensorTime)
 {
     TDECL();
     struct TripleAxisDataPoint *sample;
     uint64_t rtc_time, cur_time;
     uint32_t delta_time;
-    float x, y, z;
-    int16_t raw_x, raw_y, raw_z;
 #ifdef MAG_SLAVE_PRESENT
     bool newMagBias = false;
 #endif
@@ -2022,9 +2036,6 @@ static void parseRawData(struct BMI160Sensor *mSensor, uint8_t *buf, float kScal
 
 #ifdef MAG_SLAVE_PRESENT
     if (mSensor->idx == MAG) {
-        parseMagData(&magTask, &buf[0], &x, &y, &z);
-        BMM150_TO_ANDROID_COORDINATE(x, y, z);
-
         float xi, yi, zi;
         magCalRemoveSoftiron(&mTask.moc, x, y, z, &xi, &yi, &zi);
 
@@ -2033,24 +2044,16 @@ static void parseRawData(struct BMI160Sensor *mSensor, uint8_t *buf, float kScal
         magCalRemoveBias(&mTask.moc, xi, yi, zi, &x, &y, &z);
 
 #ifdef GYRO_CAL_ENABLED
-        // Gyro Cal -- Add magnetometer sample.
-        gyroCalUpdateMag(&mTask.gyro_cal,
-                         rtc_time,  // nsec
-                         x, y, z);
+        // Gyro Cal -- Stage magnetometer sample.
+        if (gyroCalStageSample(&mTask.gyro_cal_runs, GYRO_CAL_RUN_MAG,
+                               rtc_time,  // nsec
+                               x, y, z))
+            gyroCalFlushFifoRuns(&mTask.gyro_cal, &mTask.gyro_cal_runs,
+                                 mTask.tempCelsius);
 #endif  // GYRO_CAL_ENABLED
     } else
 #endif  // MAG_SLAVE_PRESENT
     {
-        raw_x = (buf[0] | buf[1] << 8);
-        raw_y = (buf[2] | buf[3] << 8);
-        raw_z = (buf[4] | buf[5] << 8);
-
-        x = (float)raw_x * kScale;
-        y = (float)raw_y * kScale;
-        z = (float)raw_z * kScale;
-
-        BMI160_TO_ANDROID_COORDINATE(x, y, z);
-
         if (mSensor->idx == ACC) {
 
 #ifdef ACCEL_CAL_ENABLED
@@ -2066,17 +2069,23 @@ static void parseRawData(struct BMI160Sensor *mSensor, uint8_t *buf, float kScal
 #endif  // ACCEL_CAL_ENABLED
 
 #ifdef GYRO_CAL_ENABLED
-          // Gyro Cal -- Add accelerometer sample.
-          gyroCalUpdateAccel(&mTask.gyro_cal,
-                             rtc_time,  // nsec
-                             x, y, z);
+          // Gyro Cal -- Stage accelerometer sample.
+          if (gyroCalStageSample(&mTask.gyro_cal_runs, GYRO_CAL_RUN_ACCEL,
+                                 rtc_time,  // nsec
+                                 x, y, z))
+              gyroCalFlushFifoRuns(&mTask.gyro_cal, &mTask.gyro_cal_runs,
+                                   mTask.tempCelsius);
 #endif  // GYRO_CAL_ENABLED
         } else if (mSensor->idx == GYR) {
 #ifdef GYRO_CAL_ENABLED
-          // Gyro Cal -- Add gyroscope and temperature sample.
-          gyroCalUpdateGyro(&mTask.gyro_cal,
-                            rtc_time,  // nsec
-                            x, y, z, mTask.tempCelsius);
+          // Gyro Cal -- Stage gyroscope sample. The staged samples are fed
+          // at the end of the FIFO read, so a new bias applies from the
+          // next gyroscope sample after that.
+          if (gyroCalStageSample(&mTask.gyro_cal_runs, GYRO_CAL_RUN_GYRO,
+                                 rtc_time,  // nsec
+                                 x, y, z))
+              gyroCalFlushFifoRuns(&mTask.gyro_cal, &mTask.gyro_cal_runs,
+                                   mTask.tempCelsius);
 
 #ifdef OVERTEMPCAL_ENABLED
           // Over-Temp Gyro Cal -- Update measured temperature.
@@ -2508,8 +2517,11 @@ static void dispatchData(void)
             if (fh_param & 4) { // have mag data
                 if (size >= 8) {
                     if (frame_sensor_time_valid) {
-                        // scale not used
-                        parseRawData(&mTask.sensors[MAG], &buf[i], 0, tmp_frame_time);
+                        float x, y, z;
+
+                        parseMagData(&magTask, &buf[i], &x, &y, &z);
+                        BMM150_TO_ANDROID_COORDINATE(x, y, z);
+                        parseRawData(&mTask.sensors[MAG], x, y, z, tmp_frame_time);
 #if TIMESTAMP_DBG
                         if (mTask.prev_frame_time[MAG] == ULONG_LONG_MAX) {
                             DEBUG_PRINT("mag enabled: frame %d time 0x%08x\n",
@@ -2535,7 +2547,11 @@ static void dispatchData(void)
             if (fh_param & 2) { // have gyro data
                 if (size >= 6) {
                     if (frame_sensor_time_valid) {
-                        parseRawData(&mTask.sensors[GYR], &buf[i], kScale_gyr, tmp_frame_time);
+                        float v[3];
+
+                        imu_fifo_decode(&buf[i], NULL, kScale_gyr, v);
+                        BMI160_TO_ANDROID_COORDINATE(v[0], v[1], v[2]);
+                        parseRawData(&mTask.sensors[GYR], v[0], v[1], v[2], tmp_frame_time);
 #if TIMESTAMP_DBG
                         if (mTask.prev_frame_time[GYR] == ULONG_LONG_MAX) {
                             DEBUG_PRINT("gyr enabled: frame %d time 0x%08x\n",
@@ -2560,7 +2576,11 @@ static void dispatchData(void)
             if (fh_param & 1) { // have accel data
                 if (size >= 6) {
                     if (frame_sensor_time_valid) {
-                        parseRawData(&mTask.sensors[ACC], &buf[i], kScale_acc, tmp_frame_time);
+                        float v[3];
+
+                        imu_fifo_decode(&buf[i], NULL, kScale_acc, v);
+                        BMI160_TO_ANDROID_COORDINATE(v[0], v[1], v[2]);
+                        parseRawData(&mTask.sensors[ACC], v[0], v[1], v[2], tmp_frame_time);
 #if TIMESTAMP_DBG
                         if (mTask.prev_frame_time[ACC] == ULONG_LONG_MAX) {
                             DEBUG_PRINT("acc enabled: frame %d time 0x%08x\n",
@@ -2599,6 +2619,12 @@ static void dispatchData(void)
         }
     }
 
+#ifdef GYRO_CAL_ENABLED
+    // Gyro Cal -- Feed the samples staged during this FIFO read.
+    gyroCalFlushFifoRuns(&mTask.gyro_cal, &mTask.gyro_cal_runs,
+                         mTask.tempCelsius);
+#endif  // GYRO_CAL_ENABLED
+
     //flush data events.
     flushAllData();
 }
@@ -3831,6 +3857,8 @@ static bool startTask(uint32_t task_id)
 
 #ifdef BMI160_USE_I2C
     i2cMasterRequest(BMI160_I2C_BUS_ID, BMI160_I2C_SPEED);
+    // FIFO reads must not queue up behind slow baro/ALS polls on a shared bus
+    i2cMasterSetPriority(BMI160_I2C_BUS_ID, BMI160_I2C_ADDR, I2C_PRIO_HIGH);
 #else
     spiMasterRequest(BMI160_SPI_BUS_ID, &T(spiDev));
 #endif
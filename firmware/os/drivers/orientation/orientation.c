@@ -49,6 +49,7 @@
  */
 #define FIFO_MARGIN                 15
 #define MAX_NUM_SAMPLES             (FIFO_MARGIN + FIFO_DEPTH) // actual input sample fifo depth
+#define MAX_GYRO_RUN                16 // max gyro samples handed to fusion in one call
 #define EVT_SENSOR_ACC_DATA_RDY     sensorGetMyEventType(SENS_TYPE_ACCEL)
 #define EVT_SENSOR_GYR_DATA_RDY     sensorGetMyEventType(SENS_TYPE_GYRO)
 #define EVT_SENSOR_MAG_DATA_RDY     sensorGetMyEventType(SENS_TYPE_MAG)
@@ -446,12 +447,12 @@ static bool updateOutput(ssize_t last_accel_sample_index, uint64_t last_sensor_t
 
 static void drainSamples()
 {
-    struct Vec3 a, w, m;
+    struct Vec3 a, w[MAX_GYRO_RUN], m;
     uint64_t a_time, g_time, m_time;
     size_t i = mTask.sample_indices[ACC];
     size_t j = 0;
     size_t k = 0;
-    size_t which;
+    size_t which, n;
     float dT;
     bool success = true;
 
@@ -509,17 +510,23 @@ static void drainSamples()
             }
             break;
         case GYR:
-            initVec3(&w, mTask.samples[GYR][j].x, mTask.samples[GYR][j].y, mTask.samples[GYR][j].z);
+            // take the whole run of gyro samples up to the next acc/mag sample, so that fusion
+            // can propagate its covariance once per run instead of once per sample
+            n = 0;
+            do {
+                initVec3(&w[n++], mTask.samples[GYR][j].x, mTask.samples[GYR][j].y, mTask.samples[GYR][j].z);
+
+                --mTask.sample_counts[GYR];
+                if (++j == MAX_NUM_SAMPLES)
+                    j = 0;
+            } while (n < MAX_GYRO_RUN && mTask.sample_counts[GYR] > 0
+                    && mTask.samples[GYR][j].time <= a_time && mTask.samples[GYR][j].time <= m_time);
 
             if (mTask.flags & FUSION_FLAG_ENABLED)
-                fusionHandleGyro(&mTask.fusion, &w, dT);
+                fusionHandleGyroBatch(&mTask.fusion, w, n, dT);
 
             if (mTask.flags & FUSION_FLAG_GAME_ENABLED)
-                fusionHandleGyro(&mTask.game, &w, dT);
-
-            --mTask.sample_counts[GYR];
-            if (++j == MAX_NUM_SAMPLES)
-                j = 0;
+                fusionHandleGyroBatch(&mTask.game, w, n, dT);
             break;
         case MAG:
             initVec3(&m, mTask.samples[MAG][k].x, mTask.samples[MAG][k].y, mTask.samples[MAG][k].z);
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <eventnums.h>
+#include <nanohubPacket.h>
+#include <seos.h>
+#include <sensors.h>
+#include <sensorAgg.h>
+
+#define SENSOR_AGG_APP_ID       APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 15)
+#define SENSOR_AGG_APP_VERSION  1
+
+#define EVT_SENSOR_ACC_DATA_RDY sensorGetMyEventType(SENS_TYPE_ACCEL)
+#define EVT_AGG_CONFIG          EVT_NO_FIRST_USER_EVENT
+
+#define LOG_TAG "[AGG]"
+
+static struct SensorAggTask
+{
+    const struct SensorAggKernel *kernels[SENSOR_AGG_MAX_KERNELS];
+    uint32_t tid;
+    uint32_t accelHandle;
+    uint32_t accelRate;
+    uint64_t accelLatency;
+    uint8_t numKernels;
+    bool configPending;
+} mTask;
+
+bool sensorAggEnable(const struct SensorAggKernel *kernel, bool on)
+{
+    uint32_t i;
+
+    for (i = 0; i < mTask.numKernels; i++) {
+        if (mTask.kernels[i] == kernel)
+            break;
+    }
+
+    if (on) {
+        if (i == mTask.numKernels) {
+            if (mTask.numKernels == SENSOR_AGG_MAX_KERNELS) {
+                osLog(LOG_WARN, LOG_TAG " no room for kernel\n");
+                return false;
+            }
+            mTask.kernels[mTask.numKernels++] = kernel;
+        }
+    } else if (i < mTask.numKernels) {
+        mTask.kernels[i] = mTask.kernels[--mTask.numKernels];
+    }
+
+    // several kernels switching in one go only need one accel reconfiguration
+    if (mTask.tid && !mTask.configPending) {
+        mTask.configPending = true;
+        if (!osEnqueuePrivateEvt(EVT_AGG_CONFIG, NULL, NULL, mTask.tid))
+            mTask.configPending = false;
+    }
+
+    return true;
+}
+
+static void configAccel(void)
+{
+    uint32_t rate = 0;
+    uint64_t latency = SENSOR_LATENCY_NODATA;
+    uint32_t i;
+
+    mTask.configPending = false;
+
+    for (i = 0; i < mTask.numKernels; i++) {
+        if (mTask.kernels[i]->rate > rate)
+            rate = mTask.kernels[i]->rate;
+        if (mTask.kernels[i]->latency < latency)
+            latency = mTask.kernels[i]->latency;
+    }
+
+    if (!rate) {
+        if (mTask.accelHandle) {
+            sensorRelease(mTask.tid, mTask.accelHandle);
+            osEventUnsubscribe(mTask.tid, EVT_SENSOR_ACC_DATA_RDY);
+            mTask.accelHandle = 0;
+        }
+        return;
+    }
+
+    if (!mTask.accelHandle) {
+        for (i = 0; sensorFind(SENS_TYPE_ACCEL, i, &mTask.accelHandle) != NULL; i++) {
+            if (sensorRequest(mTask.tid, mTask.accelHandle, rate, latency)) {
+                osEventSubscribe(mTask.tid, EVT_SENSOR_ACC_DATA_RDY);
+                mTask.accelRate = rate;
+                mTask.accelLatency = latency;
+                return;
+            }
+        }
+        osLog(LOG_WARN, LOG_TAG " accel request failed\n");
+        mTask.accelHandle = 0;
+    } else if (rate != mTask.accelRate || latency != mTask.accelLatency) {
+        if (sensorRequestRateChange(mTask.tid, mTask.accelHandle, rate, latency)) {
+            mTask.accelRate = rate;
+            mTask.accelLatency = latency;
+        }
+    }
+}
+
+static void processAccel(const struct TripleAxisDataEvent *ev)
+{
+    const struct SensorAggKernel *kernels[SENSOR_AGG_MAX_KERNELS];
+    uint32_t numSamples = ev->samples[0].firstSample.numSamples;
+    uint32_t numKernels = mTask.numKernels;
+    uint32_t produced = 0;
+    struct SensorAggSample s;
+    uint32_t i, k;
+
+    // a kernel may turn itself off from output(); walk a snapshot
+    memcpy(kernels, mTask.kernels, numKernels * sizeof(kernels[0]));
+
+    s.time = ev->referenceTime;
+    for (i = 0; i < numSamples; i++) {
+        if (i > 0)
+            s.time += ev->samples[i].deltaTime;
+        s.x = ev->samples[i].x;
+        s.y = ev->samples[i].y;
+        s.z = ev->samples[i].z;
+
+        for (k = 0; k < numKernels; k++) {
+            if (kernels[k]->sample(&s))
+                produced |= 1 << k;
+        }
+    }
+
+    for (k = 0; k < numKernels; k++) {
+        if (produced & (1 << k))
+            kernels[k]->output();
+    }
+}
+
+static void handleEvent(uint32_t evtType, const void* evtData)
+{
+    if (evtData == SENSOR_DATA_EVENT_FLUSH)
+        return;
+
+    switch (evtType) {
+    case EVT_APP_START:
+        osEventUnsubscribe(mTask.tid, EVT_APP_START);
+        // fall through: pick up kernels enabled before we were running
+    case EVT_AGG_CONFIG:
+        configAccel();
+        break;
+
+    case EVT_SENSOR_ACC_DATA_RDY:
+        if (mTask.numKernels)
+            processAccel((const struct TripleAxisDataEvent *)evtData);
+        break;
+    }
+}
+
+static bool startTask(uint32_t tid)
+{
+    mTask.tid = tid;
+    osEventSubscribe(tid, EVT_APP_START);
+    return true;
+}
+
+static void endTask(void)
+{
+    if (mTask.accelHandle)
+        sensorRelease(mTask.tid, mTask.accelHandle);
+}
+
+INTERNAL_APP_INIT(SENSOR_AGG_APP_ID, SENSOR_AGG_APP_VERSION, startTask, endTask, handleEvent);
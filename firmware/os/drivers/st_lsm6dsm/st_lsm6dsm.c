@@ -28,6 +28,7 @@
 #include <timer.h>
 #include <printf.h>
 #include <isr.h>
+#include <logToken.h>
 #include <hostIntf.h>
 #include <nanohubPacket.h>
 #include <cpu/cpuMath.h>
@@ -41,6 +42,7 @@
 #include <calibration/magnetometer/mag_cal.h>
 #include <calibration/over_temp/over_temp_cal.h>
 #include <algos/time_sync.h>
+#include <algos/imu_fifo.h>
 
 #include "st_lsm6dsm_lis3mdl_slave.h"
 #include "st_lsm6dsm_lsm303agr_slave.h"
@@ -117,6 +119,7 @@
 #define LSM6DSM_FIFO_STATUS2_FIFO_EMPTY                 (0x10)
 #define LSM6DSM_FIFO_STATUS2_FIFO_FULL_SMART            (0x20)
 #define LSM6DSM_FIFO_STATUS2_FIFO_FULL_OVERRUN          (0x40)
+#define LSM6DSM_FIFO_STATUS2_FIFO_WATERMARK             (0x80)
 #define LSM6DSM_FIFO_STATUS2_FIFO_ERROR                 (LSM6DSM_FIFO_STATUS2_FIFO_EMPTY | \
                                                          LSM6DSM_FIFO_STATUS2_FIFO_FULL_SMART | \
                                                          LSM6DSM_FIFO_STATUS2_FIFO_FULL_OVERRUN)
@@ -579,7 +582,7 @@ static void lsm6dsm_writeSlaveRegister(uint8_t addr, uint8_t value, uint32_t acc
 #define DEBUG_PRINT(fmt, ...) \
     do { \
         if (LSM6DSM_DBG_ENABLED) { \
-            osLog(LOG_DEBUG, "%s " fmt, "[LSM6DSM]", ##__VA_ARGS__); \
+            osLogT(LOG_DEBUG, "[LSM6DSM] " fmt, ##__VA_ARGS__); \
         } \
     } while (0);
 
@@ -810,6 +813,7 @@ struct LSM6DSMAccelGyroCfgData {
  * @slaveConn: slave interface / communication data.
  * @accelCal: accelerometer calibration algo data.
  * @gyroCal: gyroscope calibration algo data.
+ * @gyroCalRuns: samples staged for gyroCal while parsing the FIFO.
  * @overTempCal: gyroscope over temperature calibration algo data.
  * @magnCal: magnetometer calibration algo data.
  * @int1: int1 gpio data.
@@ -862,6 +866,7 @@ typedef struct LSM6DSMTask {
 #endif /* LSM6DSM_ACCEL_CALIB_ENABLED */
 #ifdef LSM6DSM_GYRO_CALIB_ENABLED
     struct GyroCal gyroCal;
+    struct GyroCalFifoRuns gyroCalRuns;
 #ifdef LSM6DSM_OVERTEMP_CALIB_ENABLED
     struct OverTempCal overTempCal;
 #endif /* LSM6DSM_OVERTEMP_CALIB_ENABLED */
@@ -4195,8 +4200,8 @@ static void lsm6dsm_oneAxisDataEvtFree(void *ptr)
 static bool lsm6dsm_processSensorThreeAxisData(struct LSM6DSMSensor *mSensor, uint8_t *data, uint16_t *sampleNum, uint64_t *timestamp)
 {
     TDECL();
-    int16_t x, y, z;
-    float x_remap, y_remap, z_remap;
+    int16_t bias[LSM6DSM_TRIAXIAL_NUM_AXIS];
+    float x_remap, y_remap, z_remap, data_f[3];
     struct TripleAxisDataPoint *samples;
 
     if (*timestamp == 0)
@@ -4208,15 +4213,13 @@ static bool lsm6dsm_processSensorThreeAxisData(struct LSM6DSMSensor *mSensor, ui
     }
     samples = mSensor->tADataEvt->samples;
 
-    x = (int16_t)(data[1] << 8) | data[0];
-    y = (int16_t)(data[3] << 8) | data[2];
-    z = (int16_t)(data[5] << 8) | data[4];
-
     switch (mSensor->idx) {
     case ACCEL:
-        x_remap = LSM6DSM_REMAP_X_DATA(x, y, z, LSM6DSM_ACCEL_GYRO_ROT_MATRIX) * LSM6DSM_ACCEL_KSCALE;
-        y_remap = LSM6DSM_REMAP_Y_DATA(x, y, z, LSM6DSM_ACCEL_GYRO_ROT_MATRIX) * LSM6DSM_ACCEL_KSCALE;
-        z_remap = LSM6DSM_REMAP_Z_DATA(x, y, z, LSM6DSM_ACCEL_GYRO_ROT_MATRIX) * LSM6DSM_ACCEL_KSCALE;
+        imu_fifo_decode(data, NULL, LSM6DSM_ACCEL_KSCALE, data_f);
+
+        x_remap = LSM6DSM_REMAP_X_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_ACCEL_GYRO_ROT_MATRIX);
+        y_remap = LSM6DSM_REMAP_Y_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_ACCEL_GYRO_ROT_MATRIX);
+        z_remap = LSM6DSM_REMAP_Z_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_ACCEL_GYRO_ROT_MATRIX);
 
 #ifdef LSM6DSM_ACCEL_CALIB_ENABLED
         accelCalRun(&T(accelCal), *timestamp, x_remap, y_remap, z_remap, T(currentTemperature));
@@ -4237,23 +4240,29 @@ static bool lsm6dsm_processSensorThreeAxisData(struct LSM6DSMSensor *mSensor, ui
 #endif /* LSM6DSM_ACCEL_CALIB_ENABLED */
 
 #ifdef LSM6DSM_GYRO_CALIB_ENABLED
-        if (T(sensors[GYRO].enabled))
-            gyroCalUpdateAccel(&T(gyroCal), *timestamp, x_remap, y_remap, z_remap);
+        if (T(sensors[GYRO].enabled)) {
+            if (gyroCalStageSample(&T(gyroCalRuns), GYRO_CAL_RUN_ACCEL, *timestamp, x_remap, y_remap, z_remap))
+                gyroCalFlushFifoRuns(&T(gyroCal), &T(gyroCalRuns), T(currentTemperature));
+        }
 #endif /* LSM6DSM_GYRO_CALIB_ENABLED */
 
         break;
 
     case GYRO:
-        x -= (int16_t)T(gyroCalibrationData)[0];
-        y -= (int16_t)T(gyroCalibrationData)[1];
-        z -= (int16_t)T(gyroCalibrationData)[2];
+        bias[0] = (int16_t)T(gyroCalibrationData)[0];
+        bias[1] = (int16_t)T(gyroCalibrationData)[1];
+        bias[2] = (int16_t)T(gyroCalibrationData)[2];
 
-        x_remap = LSM6DSM_REMAP_X_DATA(x, y, z, LSM6DSM_ACCEL_GYRO_ROT_MATRIX) * LSM6DSM_GYRO_KSCALE;
-        y_remap = LSM6DSM_REMAP_Y_DATA(x, y, z, LSM6DSM_ACCEL_GYRO_ROT_MATRIX) * LSM6DSM_GYRO_KSCALE;
-        z_remap = LSM6DSM_REMAP_Z_DATA(x, y, z, LSM6DSM_ACCEL_GYRO_ROT_MATRIX) * LSM6DSM_GYRO_KSCALE;
+        imu_fifo_decode(data, bias, LSM6DSM_GYRO_KSCALE, data_f);
+
+        x_remap = LSM6DSM_REMAP_X_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_ACCEL_GYRO_ROT_MATRIX);
+        y_remap = LSM6DSM_REMAP_Y_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_ACCEL_GYRO_ROT_MATRIX);
+        z_remap = LSM6DSM_REMAP_Z_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_ACCEL_GYRO_ROT_MATRIX);
 
 #ifdef LSM6DSM_GYRO_CALIB_ENABLED
-        gyroCalUpdateGyro(&T(gyroCal), *timestamp, x_remap, y_remap, z_remap, T(currentTemperature));
+        /* Staged samples are fed at the end of lsm6dsm_parseFifoData, a new bias applies after that */
+        if (gyroCalStageSample(&T(gyroCalRuns), GYRO_CAL_RUN_GYRO, *timestamp, x_remap, y_remap, z_remap))
+            gyroCalFlushFifoRuns(&T(gyroCal), &T(gyroCalRuns), T(currentTemperature));
 
 #ifdef LSM6DSM_OVERTEMP_CALIB_ENABLED
         overTempCalSetTemperature(&T(overTempCal), *timestamp, T(currentTemperature));
@@ -4300,9 +4309,11 @@ static bool lsm6dsm_processSensorThreeAxisData(struct LSM6DSMSensor *mSensor, ui
         float magnOffX, magnOffY, magnOffZ;
 #endif /* LSM6DSM_MAGN_CALIB_ENABLED */
 
-        x_remap = LSM6DSM_REMAP_X_DATA(x, y, z, LSM6DSM_MAGN_ROT_MATRIX) * LSM6DSM_MAGN_KSCALE;
-        y_remap = LSM6DSM_REMAP_Y_DATA(x, y, z, LSM6DSM_MAGN_ROT_MATRIX) * LSM6DSM_MAGN_KSCALE;
-        z_remap = LSM6DSM_REMAP_Z_DATA(x, y, z, LSM6DSM_MAGN_ROT_MATRIX) * LSM6DSM_MAGN_KSCALE;
+        imu_fifo_decode(data, NULL, LSM6DSM_MAGN_KSCALE, data_f);
+
+        x_remap = LSM6DSM_REMAP_X_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_MAGN_ROT_MATRIX);
+        y_remap = LSM6DSM_REMAP_Y_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_MAGN_ROT_MATRIX);
+        z_remap = LSM6DSM_REMAP_Z_DATA(data_f[0], data_f[1], data_f[2], LSM6DSM_MAGN_ROT_MATRIX);
 
 #ifdef LSM6DSM_MAGN_CALIB_ENABLED
         magCalRemoveSoftiron(&T(magnCal), x_remap, y_remap, z_remap, &magnOffX, &magnOffY, &magnOffZ);
@@ -4541,6 +4552,10 @@ static void lsm6dsm_parseFifoData(uint8_t *data, uint16_t numPattern)
         }
     }
 
+#ifdef LSM6DSM_GYRO_CALIB_ENABLED
+    gyroCalFlushFifoRuns(&T(gyroCal), &T(gyroCalRuns), T(currentTemperature));
+#endif /* LSM6DSM_GYRO_CALIB_ENABLED */
+
     for (n = 0; n < FIFO_NUM; n++) {
         if (samplesCounter[n])
             lsm6dsm_pushData(T(fifoCntl).decimatorsIdx[n], &samplesCounter[n]);
@@ -4568,6 +4583,14 @@ static inline void lsm6dsm_updateSyncTaskValues(void)
 
     time_sync_add(&T(time).sensorTimeToRtcData, T(time).timeSyncRtcTime, (uint64_t)T(time).timestampSyncTaskLSB * LSM6DSM_TIME_RESOLUTION);
 
+#if LSM6DSM_DBG_ENABLED
+    time_sync_stats_t syncStats;
+
+    if (time_sync_get_stats(&T(time).sensorTimeToRtcData, &syncStats))
+        DEBUG_PRINT("updateSyncTaskValues: %u points, drift %d ppb, jitter %d ns\n",
+                (unsigned int)syncStats.n, (int)(syncStats.drift_ppm * 1000.0f), (int)syncStats.jitter_ns);
+#endif /* LSM6DSM_DBG_ENABLED */
+
 #if defined(LSM6DSM_GYRO_CALIB_ENABLED) || defined(LSM6DSM_ACCEL_CALIB_ENABLED)
     T(currentTemperature) = LSM6DSM_TEMP_OFFSET +
             (float)((int16_t)((T_SLAVE_INTERFACE(tempDataBuffer[2]) << 8) | T_SLAVE_INTERFACE(tempDataBuffer[1]))) / 256.0f;
@@ -4693,6 +4716,9 @@ static void lsm6dsm_handleSpiDoneEvt(const void *evtData)
             DEBUG_PRINT("Significant Motion event!\n");
         }
 
+        if (T_SLAVE_INTERFACE(fifoStatusRegBuffer[2]) & LSM6DSM_FIFO_STATUS2_FIFO_WATERMARK)
+            hostIntfCountFifoInterrupt();
+
         if ((T_SLAVE_INTERFACE(fifoStatusRegBuffer[2]) & LSM6DSM_FIFO_STATUS2_FIFO_ERROR) == 0) {
             T(fifoDataToRead) = (((T_SLAVE_INTERFACE(fifoStatusRegBuffer[2]) & LSM6DSM_FIFO_CTRL2_FTH_MASK) << 8) | T_SLAVE_INTERFACE(fifoStatusRegBuffer[1])) * 2;
 
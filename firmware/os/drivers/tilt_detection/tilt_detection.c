@@ -27,13 +27,13 @@
 
 #include <nanohub_math.h>
 #include <sensors.h>
+#include <sensorAgg.h>
 #include <limits.h>
 
-#define TILT_APP_VERSION 1
+#define TILT_APP_VERSION 2
 
 #define EVT_SENSOR_ANY_MOTION sensorGetMyEventType(SENS_TYPE_ANY_MOTION)
 #define EVT_SENSOR_NO_MOTION sensorGetMyEventType(SENS_TYPE_NO_MOTION)
-#define EVT_SENSOR_ACCEL sensorGetMyEventType(SENS_TYPE_ACCEL)
 
 #define ACCEL_MIN_RATE    SENSOR_HZ(50)
 #define ACCEL_MAX_LATENCY 250000000ull   // 250 ms
@@ -58,7 +58,6 @@ static struct TiltDetectionTask {
     uint32_t handle;
     uint32_t anyMotionHandle;
     uint32_t noMotionHandle;
-    uint32_t accelHandle;
     enum {
         STATE_DISABLED,
         STATE_AWAITING_ANY_MOTION,
@@ -73,75 +72,81 @@ static void algoInit()
     // nothing here
 }
 
-static bool algoUpdate(struct TripleAxisDataEvent *ev)
+static bool algoUpdate(const struct SensorAggSample *sample)
 {
     float dotProduct = 0.0f;
     uint64_t dt;
     bool latch_g_vector = false;
     bool tilt_detected = false;
     struct TiltAlgoState *state = &mTask.algoState;
-    uint64_t sample_ts = ev->referenceTime;
-    uint32_t numSamples = ev->samples[0].firstSample.numSamples;
-    uint32_t i;
-    struct TripleAxisDataPoint *sample;
     float invN;
 
-    for (i = 0; i < numSamples; i++) {
-        sample = &ev->samples[i];
-        if (i > 0)
-            sample_ts += sample->deltaTime;
-
-        if (state->this_batch_init_ts == 0) {
-            state->this_batch_init_ts = sample_ts;
-        }
+    if (state->this_batch_init_ts == 0) {
+        state->this_batch_init_ts = sample->time;
+    }
 
-        state->this_batch_sample_sum[0] += sample->x;
-        state->this_batch_sample_sum[1] += sample->y;
-        state->this_batch_sample_sum[2] += sample->z;
+    state->this_batch_sample_sum[0] += sample->x;
+    state->this_batch_sample_sum[1] += sample->y;
+    state->this_batch_sample_sum[2] += sample->z;
 
-        state->this_batch_num_samples++;
+    state->this_batch_num_samples++;
 
-        dt = (sample_ts - state->this_batch_init_ts);
+    dt = (sample->time - state->this_batch_init_ts);
 
-        if (dt > BATCH_TIME) {
-            invN = 1.0f / state->this_batch_num_samples;
-            state->this_batch_g[0] = state->this_batch_sample_sum[0] * invN;
-            state->this_batch_g[1] = state->this_batch_sample_sum[1] * invN;
-            state->this_batch_g[2] = state->this_batch_sample_sum[2] * invN;
+    if (dt > BATCH_TIME) {
+        invN = 1.0f / state->this_batch_num_samples;
+        state->this_batch_g[0] = state->this_batch_sample_sum[0] * invN;
+        state->this_batch_g[1] = state->this_batch_sample_sum[1] * invN;
+        state->this_batch_g[2] = state->this_batch_sample_sum[2] * invN;
 
-            if (state->last_ref_g_vector_valid) {
-                dotProduct = state->this_batch_g[0] * state->last_ref_g_vector[0] +
-                    state->this_batch_g[1] * state->last_ref_g_vector[1] +
-                    state->this_batch_g[2] * state->last_ref_g_vector[2];
+        if (state->last_ref_g_vector_valid) {
+            dotProduct = state->this_batch_g[0] * state->last_ref_g_vector[0] +
+                state->this_batch_g[1] * state->last_ref_g_vector[1] +
+                state->this_batch_g[2] * state->last_ref_g_vector[2];
 
-                if (dotProduct < ANGLE_THRESH) {
-                    tilt_detected = true;
-                    latch_g_vector = true;
-                }
-            } else { // reference g vector not valid, first time computing
+            if (dotProduct < ANGLE_THRESH) {
+                tilt_detected = true;
                 latch_g_vector = true;
-                state->last_ref_g_vector_valid = true;
-            }
-
-            // latch the first batch or when dotProduct < ANGLE_THRESH
-            if (latch_g_vector) {
-                state->last_ref_g_vector[0] = state->this_batch_g[0];
-                state->last_ref_g_vector[1] = state->this_batch_g[1];
-                state->last_ref_g_vector[2] = state->this_batch_g[2];
             }
+        } else { // reference g vector not valid, first time computing
+            latch_g_vector = true;
+            state->last_ref_g_vector_valid = true;
+        }
 
-            // Seed the next batch
-            state->this_batch_init_ts = 0;
-            state->this_batch_num_samples = 0;
-            state->this_batch_sample_sum[0] = 0;
-            state->this_batch_sample_sum[1] = 0;
-            state->this_batch_sample_sum[2] = 0;
+        // latch the first batch or when dotProduct < ANGLE_THRESH
+        if (latch_g_vector) {
+            state->last_ref_g_vector[0] = state->this_batch_g[0];
+            state->last_ref_g_vector[1] = state->this_batch_g[1];
+            state->last_ref_g_vector[2] = state->this_batch_g[2];
         }
+
+        // Seed the next batch
+        state->this_batch_init_ts = 0;
+        state->this_batch_num_samples = 0;
+        state->this_batch_sample_sum[0] = 0;
+        state->this_batch_sample_sum[1] = 0;
+        state->this_batch_sample_sum[2] = 0;
     }
 
     return tilt_detected;
 }
 
+static void algoOutput(void)
+{
+    union EmbeddedDataPoint sample;
+
+    sample.idata = 1;
+    osEnqueueEvt(sensorGetMyEventType(SENS_TYPE_TILT), sample.vptr, NULL);
+}
+
+static const struct SensorAggKernel mKernel =
+{
+    .rate = ACCEL_MIN_RATE,
+    .latency = ACCEL_MAX_LATENCY,
+    .sample = algoUpdate,
+    .output = algoOutput,
+};
+
 static void configAnyMotion(bool on) {
     if (on) {
         sensorRequest(mTask.taskId, mTask.anyMotionHandle, SENSOR_RATE_ONCHANGE, 0);
@@ -163,15 +168,8 @@ static void configNoMotion(bool on) {
 }
 
 static void configAccel(bool on) {
-    if (on) {
-        sensorRequest(mTask.taskId, mTask.accelHandle, ACCEL_MIN_RATE,
-                      ACCEL_MAX_LATENCY);
-        osEventSubscribe(mTask.taskId, EVT_SENSOR_ACCEL);
-    } else {
-        sensorRelease(mTask.taskId, mTask.accelHandle);
-        osEventUnsubscribe(mTask.taskId, EVT_SENSOR_ACCEL);
-    }
-
+    // accel samples come through the aggregation app, see sensorAgg.h
+    sensorAggEnable(&mKernel, on);
 }
 
 // *****************************************************************************
@@ -232,7 +230,6 @@ static void tiltDetectionHandleEvent(uint32_t evtType, const void* evtData)
         osEventUnsubscribe(mTask.taskId, EVT_APP_START);
         sensorFind(SENS_TYPE_ANY_MOTION, 0, &mTask.anyMotionHandle);
         sensorFind(SENS_TYPE_NO_MOTION, 0, &mTask.noMotionHandle);
-        sensorFind(SENS_TYPE_ACCEL, 0, &mTask.accelHandle);
         break;
 
     case EVT_SENSOR_ANY_MOTION:
@@ -254,16 +251,6 @@ static void tiltDetectionHandleEvent(uint32_t evtType, const void* evtData)
             mTask.taskState = STATE_AWAITING_ANY_MOTION;
         }
         break;
-
-    case EVT_SENSOR_ACCEL:
-        if (mTask.taskState == STATE_AWAITING_TILT) {
-            if (algoUpdate((struct TripleAxisDataEvent *)evtData)) {
-                union EmbeddedDataPoint sample;
-                sample.idata = 1;
-                osEnqueueEvt(sensorGetMyEventType(SENS_TYPE_TILT), sample.vptr, NULL);
-            }
-        }
-        break;
     }
 }
 
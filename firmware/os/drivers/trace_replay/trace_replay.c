@@ -0,0 +1,477 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Trace replay "sensor" for the native platform.
+ *
+ * Registers accel, gyro, mag and baro through the normal SensorOps and feeds them samples read
+ * from a recorded text trace, one sample per line:
+ *
+ *     <timestamp ns> accel|gyro|mag <x> <y> <z>
+ *     <timestamp ns> baro <value>
+ *
+ * Blank lines and lines starting with '#' are ignored. Samples are batched into events the way a
+ * FIFO driver would, and only reach sensors that are powered. The trace is named by
+ * NANOHUB_TRACE; NANOHUB_TRACE_FAST=1 replays as fast as the OS can take it instead of at the
+ * recorded timestamps, and NANOHUB_TRACE_LOOP=1 restarts the trace at its end. Recorded timestamps
+ * are always carried into the events, shifted to start at the moment replay starts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <eventnums.h>
+#include <heap.h>
+#include <hostIntf.h>
+#include <nanohubPacket.h>
+#include <sensors.h>
+#include <seos.h>
+#include <slab.h>
+#include <timer.h>
+#include <util.h>
+
+#define TRACE_REPLAY_APP_ID      APP_ID_MAKE(NANOHUB_VENDOR_GOOGLE, 14)
+#define TRACE_REPLAY_APP_VERSION 1
+
+#define MAX_BATCH_SAMPLES        15   // same as the bmi160 comms event size
+#define MAX_PENDING_EVENTS       32
+#define FAST_SAMPLES_PER_STEP    64   // yield to other tasks this often when replaying flat out
+#define MAX_LINE                 256
+
+#define INFO_PRINT(fmt, ...) osLog(LOG_INFO, "[TRACE] " fmt, ##__VA_ARGS__)
+#define ERROR_PRINT(fmt, ...) osLog(LOG_ERROR, "[TRACE] " fmt, ##__VA_ARGS__)
+
+enum TraceReplayEvents
+{
+    EVT_REPLAY_STEP = EVT_APP_START + 1,
+};
+
+enum TraceSensor
+{
+    ACC,
+    GYR,
+    MAG,
+    BARO,
+    NUM_TRACE_SENSORS,
+};
+
+struct TraceSample
+{
+    uint64_t time;
+    uint8_t sensor;
+    float v[3];
+};
+
+struct TraceSensorState
+{
+    uint32_t handle;
+    bool powered;
+    union {
+        void *evt;
+        struct TripleAxisDataEvent *triple;
+        struct SingleAxisDataEvent *single;
+    };
+    uint64_t lastTime;
+};
+
+static struct TraceReplayTask
+{
+    struct TraceSensorState sensors[NUM_TRACE_SENSORS];
+    struct SlabAllocator *evtSlab;
+    FILE *file;
+
+    struct TraceSample next;
+    bool haveNext;
+
+    uint64_t traceStart;   // trace time of the first sample
+    uint64_t traceLast;    // trace time of the last sample read
+    uint64_t timeBase;     // sensor time that traceStart maps to
+
+    uint32_t id;
+    uint32_t timerHandle;
+    bool running;
+    bool stepQueued;
+    bool fast;
+    bool loop;
+} mTask;
+
+static const char * const mSensorNames[NUM_TRACE_SENSORS] = {
+    [ACC] = "accel",
+    [GYR] = "gyro",
+    [MAG] = "mag",
+    [BARO] = "baro",
+};
+
+static const uint32_t mSupportedRates[] =
+{
+    SENSOR_HZ(25.0f/8.0f),
+    SENSOR_HZ(25.0f/4.0f),
+    SENSOR_HZ(25.0f/2.0f),
+    SENSOR_HZ(25.0f),
+    SENSOR_HZ(50.0f),
+    SENSOR_HZ(100.0f),
+    SENSOR_HZ(200.0f),
+    SENSOR_HZ(400.0f),
+    0,
+};
+
+static const struct SensorInfo mSensorInfo[NUM_TRACE_SENSORS];
+
+static bool traceReadSample(struct TraceSample *s)
+{
+    char line[MAX_LINE], name[16];
+    unsigned long long time;
+    int i, n;
+
+    while (fgets(line, sizeof(line), mTask.file)) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+            continue;
+
+        n = sscanf(line, "%llu %15s %f %f %f", &time, name, &s->v[0], &s->v[1], &s->v[2]);
+        for (i = 0; i < NUM_TRACE_SENSORS; i++)
+            if (!strcmp(name, mSensorNames[i]))
+                break;
+
+        if (n < 3 || i == NUM_TRACE_SENSORS || (i != BARO && n != 5)) {
+            ERROR_PRINT("bad trace line: %s", line);
+            continue;
+        }
+
+        s->time = time;
+        s->sensor = i;
+        return true;
+    }
+
+    return false;
+}
+
+static void traceFreeEvt(void *ptr)
+{
+    slabAllocatorFree(mTask.evtSlab, ptr);
+}
+
+static void traceFlushSensor(enum TraceSensor idx)
+{
+    struct TraceSensorState *sensor = &mTask.sensors[idx];
+    uint32_t evtType = sensorGetMyEventType(mSensorInfo[idx].sensorType);
+
+    if (!sensor->evt)
+        return;
+
+    if (!osEnqueueEvtOrFree(EVENT_TYPE_BIT_DISCARDABLE | evtType, sensor->evt, traceFreeEvt))
+        ERROR_PRINT("failed to enqueue %s event\n", mSensorNames[idx]);
+
+    sensor->evt = NULL;
+}
+
+static void traceFlushAll(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_TRACE_SENSORS; i++)
+        traceFlushSensor(i);
+}
+
+static void traceAddSample(const struct TraceSample *s, uint64_t time)
+{
+    struct TraceSensorState *sensor = &mTask.sensors[s->sensor];
+    struct TripleAxisDataPoint *triple;
+    struct SingleAxisDataPoint *single;
+    uint8_t n;
+
+    if (!sensor->powered)
+        return;
+
+    if (!sensor->evt) {
+        sensor->evt = slabAllocatorAlloc(mTask.evtSlab);
+        if (!sensor->evt) {
+            // the OS is not keeping up; drop the sample like a FIFO overrun would
+            return;
+        }
+        memset(&sensor->triple->samples[0].firstSample, 0x00, sizeof(struct SensorFirstSample));
+        sensor->triple->referenceTime = time;
+        sensor->lastTime = time;
+    }
+
+    // TripleAxisDataEvent and SingleAxisDataEvent share the header and the first sample layout
+    n = sensor->triple->samples[0].firstSample.numSamples;
+    if (s->sensor == BARO) {
+        single = &sensor->single->samples[n];
+        if (n)
+            single->deltaTime = time - sensor->lastTime;
+        single->fdata = s->v[0];
+    } else {
+        triple = &sensor->triple->samples[n];
+        if (n)
+            triple->deltaTime = time - sensor->lastTime;
+        triple->x = s->v[0];
+        triple->y = s->v[1];
+        triple->z = s->v[2];
+    }
+    sensor->triple->samples[0].firstSample.numSamples = n + 1;
+    sensor->lastTime = time;
+
+    if (n + 1 == MAX_BATCH_SAMPLES)
+        traceFlushSensor(s->sensor);
+}
+
+static bool traceRewind(void)
+{
+    rewind(mTask.file);
+    mTask.haveNext = traceReadSample(&mTask.next);
+    if (!mTask.haveNext) {
+        ERROR_PRINT("trace is empty\n");
+        return false;
+    }
+    mTask.traceStart = mTask.next.time;
+    mTask.traceLast = mTask.next.time;
+
+    return true;
+}
+
+static void traceTimerCallback(uint32_t timerId, void *cookie)
+{
+    osEnqueuePrivateEvt(EVT_REPLAY_STEP, cookie, NULL, mTask.id);
+}
+
+static void traceScheduleStep(uint64_t due)
+{
+    uint64_t now = sensorGetTime();
+
+    if (mTask.fast || due <= now) {
+        if (!mTask.stepQueued)
+            mTask.stepQueued = osEnqueuePrivateEvt(EVT_REPLAY_STEP, NULL, NULL, mTask.id);
+    } else {
+        mTask.timerHandle = timTimerSet(due - now, 0, 50, traceTimerCallback, NULL, true);
+        if (!mTask.timerHandle)
+            ERROR_PRINT("no timer for next sample\n");
+    }
+}
+
+static void traceStep(void)
+{
+    uint64_t now = sensorGetTime(), due = 0;
+    uint32_t done = 0;
+
+    mTask.timerHandle = 0;
+
+    while (mTask.running) {
+        if (!mTask.haveNext) {
+            traceFlushAll();
+            if (!mTask.loop) {
+                INFO_PRINT("end of trace\n");
+                return;
+            }
+            // continue the timeline right after the end, so time never runs backwards
+            mTask.timeBase += mTask.traceLast - mTask.traceStart + 1;
+            if (!traceRewind())
+                return;
+            continue;
+        }
+
+        due = mTask.timeBase + (mTask.next.time - mTask.traceStart);
+        if (mTask.fast ? done == FAST_SAMPLES_PER_STEP : due > now)
+            break;
+
+        traceAddSample(&mTask.next, due);
+        mTask.traceLast = mTask.next.time;
+        mTask.haveNext = traceReadSample(&mTask.next);
+        done++;
+    }
+
+    // a FIFO driver would deliver at least once per interrupt, so do not sit on partial batches
+    traceFlushAll();
+
+    if (mTask.running)
+        traceScheduleStep(due);
+}
+
+static void traceStart(void)
+{
+    if (mTask.running || !mTask.file)
+        return;
+
+    if (!traceRewind())
+        return;
+
+    mTask.timeBase = sensorGetTime();
+    mTask.running = true;
+    traceScheduleStep(mTask.timeBase);
+}
+
+static void traceStop(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_TRACE_SENSORS; i++)
+        if (mTask.sensors[i].powered)
+            return;
+
+    mTask.running = false;
+    if (mTask.timerHandle) {
+        timTimerCancel(mTask.timerHandle);
+        mTask.timerHandle = 0;
+    }
+    traceFlushAll();
+}
+
+static bool traceSensorPower(bool on, void *cookie)
+{
+    enum TraceSensor idx = (enum TraceSensor)(uintptr_t)cookie;
+
+    mTask.sensors[idx].powered = on;
+    if (on)
+        traceStart();
+    else
+        traceStop();
+
+    return sensorSignalInternalEvt(mTask.sensors[idx].handle, SENSOR_INTERNAL_EVT_POWER_STATE_CHG, on, 0);
+}
+
+static bool traceSensorFirmwareUpload(void *cookie)
+{
+    enum TraceSensor idx = (enum TraceSensor)(uintptr_t)cookie;
+
+    return sensorSignalInternalEvt(mTask.sensors[idx].handle, SENSOR_INTERNAL_EVT_FW_STATE_CHG, 1, 0);
+}
+
+static bool traceSensorSetRate(uint32_t rate, uint64_t latency, void *cookie)
+{
+    enum TraceSensor idx = (enum TraceSensor)(uintptr_t)cookie;
+
+    // the trace dictates the real sample rate; accept whatever is asked for
+    return sensorSignalInternalEvt(mTask.sensors[idx].handle, SENSOR_INTERNAL_EVT_RATE_CHG, rate, latency);
+}
+
+static bool traceSensorFlush(void *cookie)
+{
+    enum TraceSensor idx = (enum TraceSensor)(uintptr_t)cookie;
+
+    traceFlushSensor(idx);
+
+    return osEnqueueEvt(sensorGetMyEventType(mSensorInfo[idx].sensorType), SENSOR_DATA_EVENT_FLUSH, NULL);
+}
+
+static const struct SensorInfo mSensorInfo[NUM_TRACE_SENSORS] =
+{
+    [ACC] = {
+        .sensorName = "Trace Accelerometer",
+        .supportedRates = mSupportedRates,
+        .sensorType = SENS_TYPE_ACCEL,
+        .numAxis = NUM_AXIS_THREE,
+        .interrupt = NANOHUB_INT_NONWAKEUP,
+        .minSamples = 3000,
+    },
+    [GYR] = {
+        .sensorName = "Trace Gyroscope",
+        .supportedRates = mSupportedRates,
+        .sensorType = SENS_TYPE_GYRO,
+        .numAxis = NUM_AXIS_THREE,
+        .interrupt = NANOHUB_INT_NONWAKEUP,
+        .minSamples = 20,
+    },
+    [MAG] = {
+        .sensorName = "Trace Magnetometer",
+        .supportedRates = mSupportedRates,
+        .sensorType = SENS_TYPE_MAG,
+        .numAxis = NUM_AXIS_THREE,
+        .interrupt = NANOHUB_INT_NONWAKEUP,
+        .minSamples = 600,
+    },
+    [BARO] = {
+        .sensorName = "Trace Pressure",
+        .supportedRates = mSupportedRates,
+        .sensorType = SENS_TYPE_BARO,
+        .numAxis = NUM_AXIS_ONE,
+        .interrupt = NANOHUB_INT_NONWAKEUP,
+        .minSamples = 300,
+    },
+};
+
+static const struct SensorOps mSensorOps =
+{
+    .sensorPower = traceSensorPower,
+    .sensorFirmwareUpload = traceSensorFirmwareUpload,
+    .sensorSetRate = traceSensorSetRate,
+    .sensorFlush = traceSensorFlush,
+};
+
+static void handleEvent(uint32_t evtType, const void* evtData)
+{
+    switch (evtType) {
+    case EVT_APP_START:
+        osEventUnsubscribe(mTask.id, EVT_APP_START);
+        break;
+
+    case EVT_REPLAY_STEP:
+        mTask.stepQueued = false;
+        traceStep();
+        break;
+    }
+}
+
+static bool startTask(uint32_t taskId)
+{
+    const char *path = getenv("NANOHUB_TRACE"), *opt;
+    int i;
+
+    mTask.id = taskId;
+
+    opt = getenv("NANOHUB_TRACE_FAST");
+    mTask.fast = opt && atoi(opt);
+    opt = getenv("NANOHUB_TRACE_LOOP");
+    mTask.loop = opt && atoi(opt);
+
+    if (path) {
+        mTask.file = fopen(path, "r");
+        if (!mTask.file)
+            ERROR_PRINT("cannot open %s\n", path);
+    }
+
+    // triple axis events are the larger of the two, so one slab serves all sensors
+    mTask.evtSlab = slabAllocatorNew(sizeof(struct TripleAxisDataEvent) + MAX_BATCH_SAMPLES * sizeof(struct TripleAxisDataPoint), 4, MAX_PENDING_EVENTS);
+    if (!mTask.evtSlab) {
+        ERROR_PRINT("slabAllocatorNew() failed\n");
+        return false;
+    }
+
+    // sensors register as initialized even without a trace, they just never produce data
+    for (i = 0; i < NUM_TRACE_SENSORS; i++)
+        mTask.sensors[i].handle = sensorRegister(&mSensorInfo[i], &mSensorOps, (void *)(uintptr_t)i, true);
+
+    osEventSubscribe(taskId, EVT_APP_START);
+
+    return true;
+}
+
+static void endTask(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_TRACE_SENSORS; i++) {
+        mTask.sensors[i].powered = false;
+        sensorUnregister(mTask.sensors[i].handle);
+    }
+    traceStop();
+
+    if (mTask.file)
+        fclose(mTask.file);
+    slabAllocatorDestroy(mTask.evtSlab);
+}
+
+INTERNAL_APP_INIT(TRACE_REPLAY_APP_ID, TRACE_REPLAY_APP_VERSION, startTask, endTask, handleEvent);
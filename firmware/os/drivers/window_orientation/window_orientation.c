@@ -28,9 +28,10 @@
 
 #include <nanohub_math.h>
 #include <sensors.h>
+#include <sensorAgg.h>
 #include <limits.h>
 
-#define WINDOW_ORIENTATION_APP_VERSION  2
+#define WINDOW_ORIENTATION_APP_VERSION  3
 
 #define LOG_TAG "[WO]"
 
@@ -103,7 +104,6 @@
 // The concerns are complexity and (not so much) the size of tilt_history.
 #define MIN_ACCEL_INTERVAL              NS2US(26666667ull)       // 26.7 ms for 37.5 Hz
 
-#define EVT_SENSOR_ACC_DATA_RDY sensorGetMyEventType(SENS_TYPE_ACCEL)
 #define EVT_SENSOR_WIN_ORIENTATION_DATA_RDY sensorGetMyEventType(SENS_TYPE_WIN_ORIENTATION)
 
 static int8_t Tilt_Tolerance[4][2] = {
@@ -116,7 +116,6 @@ static int8_t Tilt_Tolerance[4][2] = {
 struct WindowOrientationTask {
     uint32_t tid;
     uint32_t handle;
-    uint32_t accelHandle;
 
     uint64_t last_filtered_time;
     struct TripleAxisDataPoint last_filtered_sample;
@@ -133,6 +132,7 @@ struct WindowOrientationTask {
 
     int8_t current_rotation;
     int8_t prev_valid_rotation;
+    int8_t reported_rotation;
     int8_t proposed_rotation;
     int8_t predicted_rotation;
 
@@ -140,6 +140,7 @@ struct WindowOrientationTask {
     bool swinging;
     bool accelerating;
     bool overhead;
+    bool accelEnabled;
 };
 
 static struct WindowOrientationTask mTask;
@@ -385,172 +386,167 @@ static bool isSwinging(uint64_t now, int8_t tilt)
     return false;
 }
 
-static bool add_samples(struct TripleAxisDataEvent *ev)
+static bool add_sample(const struct SensorAggSample *s)
 {
-    int i, tilt_tmp;
+    int tilt_tmp;
     int orientation_angle, nearest_rotation;
     float x, y, z, alpha, magnitude;
-    uint64_t now_nsec = ev->referenceTime, now;
+    uint64_t now;
     uint64_t then, time_delta;
     struct TripleAxisDataPoint *last_sample;
-    size_t sampleCnt = ev->samples[0].firstSample.numSamples;
     bool skip_sample;
     bool accelerating, flat, swinging;
     bool change_detected;
     int8_t old_proposed_rotation, proposed_rotation;
     int8_t tilt_angle;
 
-    for (i = 0; i < sampleCnt; i++) {
+    x = s->x;
+    y = s->y;
+    z = s->z;
 
-        x = ev->samples[i].x;
-        y = ev->samples[i].y;
-        z = ev->samples[i].z;
+    // Apply a low-pass filter to the acceleration up vector in cartesian space.
+    // Reset the orientation listener state if the samples are too far apart in time.
 
-        // Apply a low-pass filter to the acceleration up vector in cartesian space.
-        // Reset the orientation listener state if the samples are too far apart in time.
+    now = NS2US(s->time); // convert to ~usec
 
-        now_nsec += i > 0 ? ev->samples[i].deltaTime : 0;
-        now = NS2US(now_nsec); // convert to ~usec
+    last_sample = &mTask.last_filtered_sample;
+    then = mTask.last_filtered_time;
+    time_delta = now - then;
 
-        last_sample = &mTask.last_filtered_sample;
-        then = mTask.last_filtered_time;
-        time_delta = now - then;
+    if ((now < then) || (now > then + MAX_FILTER_DELTA_TIME)) {
+        reset();
+        skip_sample = true;
+    } else {
+        // alpha is the weight on the new sample
+        alpha = floatFromUint64(time_delta) / floatFromUint64(FILTER_TIME_CONSTANT + time_delta);
+        x = alpha * (x - last_sample->x) + last_sample->x;
+        y = alpha * (y - last_sample->y) + last_sample->y;
+        z = alpha * (z - last_sample->z) + last_sample->z;
 
-        if ((now < then) || (now > then + MAX_FILTER_DELTA_TIME)) {
-            reset();
-            skip_sample = true;
-        } else {
-            // alpha is the weight on the new sample
-            alpha = floatFromUint64(time_delta) / floatFromUint64(FILTER_TIME_CONSTANT + time_delta);
-            x = alpha * (x - last_sample->x) + last_sample->x;
-            y = alpha * (y - last_sample->y) + last_sample->y;
-            z = alpha * (z - last_sample->z) + last_sample->z;
+        skip_sample = false;
+    }
 
-            skip_sample = false;
-        }
+    // poor man's interpolator for reduced complexity:
+    // drop samples when input sampling rate is 2.5x higher than requested
+    if (!skip_sample && (time_delta < MIN_ACCEL_INTERVAL)) {
+        skip_sample = true;
+    } else {
+        mTask.last_filtered_time = now;
+        mTask.last_filtered_sample.x = x;
+        mTask.last_filtered_sample.y = y;
+        mTask.last_filtered_sample.z = z;
+    }
+
+    accelerating = false;
+    flat = false;
+    swinging = false;
+
+    if (!skip_sample) {
+        // Calculate the magnitude of the acceleration vector.
+        magnitude = sqrtf(x * x + y * y + z * z);
 
-        // poor man's interpolator for reduced complexity:
-        // drop samples when input sampling rate is 2.5x higher than requested
-        if (!skip_sample && (time_delta < MIN_ACCEL_INTERVAL)) {
-            skip_sample = true;
+        if (magnitude < NEAR_ZERO_MAGNITUDE) {
+            LOGD("Ignoring sensor data, magnitude too close to zero.");
+            clearPredictedRotation();
         } else {
-            mTask.last_filtered_time = now;
-            mTask.last_filtered_sample.x = x;
-            mTask.last_filtered_sample.y = y;
-            mTask.last_filtered_sample.z = z;
-        }
+            // Determine whether the device appears to be undergoing
+            // external acceleration.
+            if (isAccelerating(magnitude)) {
+                accelerating = true;
+                mTask.accelerating_time = now;
+            }
 
-        accelerating = false;
-        flat = false;
-        swinging = false;
+            // Calculate the tilt angle.
+            // This is the angle between the up vector and the x-y plane
+            // (the plane of the screen) in a range of [-90, 90] degrees.
+            //  -90 degrees: screen horizontal and facing the ground (overhead)
+            //    0 degrees: screen vertical
+            //   90 degrees: screen horizontal and facing the sky (on table)
+            tilt_tmp = (int)(asinf(z / magnitude) * RADIANS_TO_DEGREES);
+            tilt_tmp = (tilt_tmp > 127) ? 127 : tilt_tmp;
+            tilt_tmp = (tilt_tmp < -128) ? -128 : tilt_tmp;
+            tilt_angle = tilt_tmp;
+            addTiltHistoryEntry(now, tilt_angle);
+
+            // Determine whether the device appears to be flat or swinging.
+            if (isFlat(now)) {
+                flat = true;
+                mTask.flat_time = now;
+            }
+            if (isSwinging(now, tilt_angle)) {
+                swinging = true;
+                mTask.swinging_time = now;
+            }
 
-        if (!skip_sample) {
-            // Calculate the magnitude of the acceleration vector.
-            magnitude = sqrtf(x * x + y * y + z * z);
+            // If the tilt angle is too close to horizontal then we cannot
+            // determine the orientation angle of the screen.
+            if (tilt_angle <= TILT_OVERHEAD_ENTER) {
+                mTask.overhead = true;
+            } else if (tilt_angle >= TILT_OVERHEAD_EXIT) {
+                mTask.overhead = false;
+            }
 
-            if (magnitude < NEAR_ZERO_MAGNITUDE) {
-                LOGD("Ignoring sensor data, magnitude too close to zero.");
+            if (mTask.overhead) {
+                LOGD("Ignoring sensor data, device is overhead: %d", (int)tilt_angle);
+                clearPredictedRotation();
+            } else if (fabsf(tilt_angle) > MAX_TILT) {
+                LOGD("Ignoring sensor data, tilt angle too high: %d", (int)tilt_angle);
                 clearPredictedRotation();
             } else {
-                // Determine whether the device appears to be undergoing
-                // external acceleration.
-                if (isAccelerating(magnitude)) {
-                    accelerating = true;
-                    mTask.accelerating_time = now;
+                // Calculate the orientation angle.
+                // This is the angle between the x-y projection of the up
+                // vector onto the +y-axis, increasing clockwise in a range
+                // of [0, 360] degrees.
+                orientation_angle = (int)(-atan2f(-x, y) * RADIANS_TO_DEGREES);
+                if (orientation_angle < 0) {
+                    // atan2 returns [-180, 180]; normalize to [0, 360]
+                    orientation_angle += 360;
                 }
 
-                // Calculate the tilt angle.
-                // This is the angle between the up vector and the x-y plane
-                // (the plane of the screen) in a range of [-90, 90] degrees.
-                //  -90 degrees: screen horizontal and facing the ground (overhead)
-                //    0 degrees: screen vertical
-                //   90 degrees: screen horizontal and facing the sky (on table)
-                tilt_tmp = (int)(asinf(z / magnitude) * RADIANS_TO_DEGREES);
-                tilt_tmp = (tilt_tmp > 127) ? 127 : tilt_tmp;
-                tilt_tmp = (tilt_tmp < -128) ? -128 : tilt_tmp;
-                tilt_angle = tilt_tmp;
-                addTiltHistoryEntry(now, tilt_angle);
-
-                // Determine whether the device appears to be flat or swinging.
-                if (isFlat(now)) {
-                    flat = true;
-                    mTask.flat_time = now;
+                // Find the nearest rotation.
+                nearest_rotation = (orientation_angle + 45) / 90;
+                if (nearest_rotation == 4) {
+                    nearest_rotation = 0;
                 }
-                if (isSwinging(now, tilt_angle)) {
-                    swinging = true;
-                    mTask.swinging_time = now;
-                }
-
-                // If the tilt angle is too close to horizontal then we cannot
-                // determine the orientation angle of the screen.
-                if (tilt_angle <= TILT_OVERHEAD_ENTER) {
-                    mTask.overhead = true;
-                } else if (tilt_angle >= TILT_OVERHEAD_EXIT) {
-                    mTask.overhead = false;
-                }
-
-                if (mTask.overhead) {
-                    LOGD("Ignoring sensor data, device is overhead: %d", (int)tilt_angle);
-                    clearPredictedRotation();
-                } else if (fabsf(tilt_angle) > MAX_TILT) {
-                    LOGD("Ignoring sensor data, tilt angle too high: %d", (int)tilt_angle);
-                    clearPredictedRotation();
+                // Determine the predicted orientation.
+                if (isTiltAngleAcceptable(nearest_rotation, tilt_angle)
+                    && isOrientationAngleAcceptable(mTask.current_rotation,
+                                                       nearest_rotation,
+                                                       orientation_angle)) {
+                    LOGD("Predicted: tilt %d, orientation %d, predicted %d",
+                         (int)tilt_angle, (int)orientation_angle, (int)mTask.predicted_rotation);
+                    updatePredictedRotation(now, nearest_rotation);
                 } else {
-                    // Calculate the orientation angle.
-                    // This is the angle between the x-y projection of the up
-                    // vector onto the +y-axis, increasing clockwise in a range
-                    // of [0, 360] degrees.
-                    orientation_angle = (int)(-atan2f(-x, y) * RADIANS_TO_DEGREES);
-                    if (orientation_angle < 0) {
-                        // atan2 returns [-180, 180]; normalize to [0, 360]
-                        orientation_angle += 360;
-                    }
-
-                    // Find the nearest rotation.
-                    nearest_rotation = (orientation_angle + 45) / 90;
-                    if (nearest_rotation == 4) {
-                        nearest_rotation = 0;
-                    }
-                    // Determine the predicted orientation.
-                    if (isTiltAngleAcceptable(nearest_rotation, tilt_angle)
-                        && isOrientationAngleAcceptable(mTask.current_rotation,
-                                                           nearest_rotation,
-                                                           orientation_angle)) {
-                        LOGD("Predicted: tilt %d, orientation %d, predicted %d",
-                             (int)tilt_angle, (int)orientation_angle, (int)mTask.predicted_rotation);
-                        updatePredictedRotation(now, nearest_rotation);
-                    } else {
-                        LOGD("Ignoring sensor data, no predicted rotation: "
-                             "tilt %d, orientation %d",
-                             (int)tilt_angle, (int)orientation_angle);
-                        clearPredictedRotation();
-                    }
+                    LOGD("Ignoring sensor data, no predicted rotation: "
+                         "tilt %d, orientation %d",
+                         (int)tilt_angle, (int)orientation_angle);
+                    clearPredictedRotation();
                 }
             }
+        }
 
-            mTask.flat = flat;
-            mTask.swinging = swinging;
-            mTask.accelerating = accelerating;
+        mTask.flat = flat;
+        mTask.swinging = swinging;
+        mTask.accelerating = accelerating;
 
-            // Determine new proposed rotation.
-            old_proposed_rotation = mTask.proposed_rotation;
-            if ((mTask.predicted_rotation < 0)
-                    || isPredictedRotationAcceptable(now, tilt_angle)) {
+        // Determine new proposed rotation.
+        old_proposed_rotation = mTask.proposed_rotation;
+        if ((mTask.predicted_rotation < 0)
+                || isPredictedRotationAcceptable(now, tilt_angle)) {
 
-                mTask.proposed_rotation = mTask.predicted_rotation;
-            }
-            proposed_rotation = mTask.proposed_rotation;
+            mTask.proposed_rotation = mTask.predicted_rotation;
+        }
+        proposed_rotation = mTask.proposed_rotation;
 
-            if ((proposed_rotation != old_proposed_rotation)
-                    && (proposed_rotation >= 0)) {
-                mTask.current_rotation = proposed_rotation;
+        if ((proposed_rotation != old_proposed_rotation)
+                && (proposed_rotation >= 0)) {
+            mTask.current_rotation = proposed_rotation;
 
-                change_detected = (proposed_rotation != mTask.prev_valid_rotation);
-                mTask.prev_valid_rotation = proposed_rotation;
+            change_detected = (proposed_rotation != mTask.prev_valid_rotation);
+            mTask.prev_valid_rotation = proposed_rotation;
 
-                if (change_detected) {
-                    return true;
-                }
+            if (change_detected) {
+                return true;
             }
         }
     }
@@ -558,13 +554,40 @@ static bool add_samples(struct TripleAxisDataEvent *ev)
     return false;
 }
 
+static void add_samples_done(void)
+{
+    union EmbeddedDataPoint sample;
+
+    // the batch may have changed rotation and settled back, or left the
+    // proposal unset; report the last valid rotation, once
+    if (mTask.prev_valid_rotation < 0
+            || mTask.prev_valid_rotation == mTask.reported_rotation)
+        return;
+    mTask.reported_rotation = mTask.prev_valid_rotation;
+
+    LOGV("rotation changed to: ******* %d *******\n",
+         (int)mTask.reported_rotation);
+
+    // send a single int32 here so no memory alloc/free needed.
+    sample.idata = mTask.reported_rotation;
+    if (!osEnqueueEvt(EVT_SENSOR_WIN_ORIENTATION_DATA_RDY, sample.vptr, NULL)) {
+        LOGW("osEnqueueEvt failure");
+    }
+}
+
+static const struct SensorAggKernel mKernel =
+{
+    .rate = ACCEL_MIN_RATE_HZ,
+    .latency = ACCEL_MAX_LATENCY_NS,
+    .sample = add_sample,
+    .output = add_samples_done,
+};
 
 static bool windowOrientationPower(bool on, void *cookie)
 {
-    if (on == false && mTask.accelHandle != 0) {
-        sensorRelease(mTask.tid, mTask.accelHandle);
-        mTask.accelHandle = 0;
-        osEventUnsubscribe(mTask.tid, EVT_SENSOR_ACC_DATA_RDY);
+    if (on == false && mTask.accelEnabled) {
+        sensorAggEnable(&mKernel, false);
+        mTask.accelEnabled = false;
     }
 
     sensorSignalInternalEvt(mTask.handle, SENSOR_INTERNAL_EVT_POWER_STATE_CHG, on, 0);
@@ -574,22 +597,16 @@ static bool windowOrientationPower(bool on, void *cookie)
 
 static bool windowOrientationSetRate(uint32_t rate, uint64_t latency, void *cookie)
 {
-    int i;
-
-    if (mTask.accelHandle == 0) {
-        for (i = 0; sensorFind(SENS_TYPE_ACCEL, i, &mTask.accelHandle) != NULL; i++) {
-            if (sensorRequest(mTask.tid, mTask.accelHandle, ACCEL_MIN_RATE_HZ, ACCEL_MAX_LATENCY_NS)) {
-                // clear hysteresis
-                mTask.current_rotation = -1;
-                mTask.prev_valid_rotation = -1;
-                reset();
-                osEventSubscribe(mTask.tid, EVT_SENSOR_ACC_DATA_RDY);
-                break;
-            }
-        }
+    if (!mTask.accelEnabled) {
+        // clear hysteresis
+        mTask.current_rotation = -1;
+        mTask.prev_valid_rotation = -1;
+    mTask.reported_rotation = -1;
+        reset();
+        mTask.accelEnabled = sensorAggEnable(&mKernel, true);
     }
 
-    if (mTask.accelHandle != 0)
+    if (mTask.accelEnabled)
         sensorSignalInternalEvt(mTask.handle, SENSOR_INTERNAL_EVT_RATE_CHG, rate, latency);
 
     return true;
@@ -609,30 +626,7 @@ static bool windowOrientationFlush(void *cookie)
 
 static void windowOrientationHandleEvent(uint32_t evtType, const void* evtData)
 {
-    struct TripleAxisDataEvent *ev;
-    union EmbeddedDataPoint sample;
-    bool rotation_changed;
-
-    if (evtData == SENSOR_DATA_EVENT_FLUSH)
-        return;
-
-    switch (evtType) {
-    case EVT_SENSOR_ACC_DATA_RDY:
-        ev = (struct TripleAxisDataEvent *)evtData;
-        rotation_changed = add_samples(ev);
-
-        if (rotation_changed) {
-            LOGV("rotation changed to: ******* %d *******\n",
-                 (int)mTask.proposed_rotation);
-
-            // send a single int32 here so no memory alloc/free needed.
-            sample.idata = mTask.proposed_rotation;
-            if (!osEnqueueEvt(EVT_SENSOR_WIN_ORIENTATION_DATA_RDY, sample.vptr, NULL)) {
-                LOGW("osEnqueueEvt failure");
-            }
-        }
-        break;
-    }
+    // accel samples come through the aggregation app, see sensorAgg.h
 }
 
 static const struct SensorOps mSops =
@@ -649,6 +643,7 @@ static bool window_orientation_start(uint32_t tid)
 
     mTask.current_rotation = -1;
     mTask.prev_valid_rotation = -1;
+    mTask.reported_rotation = -1;
     reset();
 
     mTask.handle = sensorRegister(&mSi, &mSops, NULL, true);
@@ -43,11 +43,13 @@ struct Fusion {
 
     struct Mat33 P[2][2];
     struct Mat33 GQGt[2][2];
+    struct Mat33 GQGtBatch[2][2];
 
     struct Mat33 Phi0[2];
     struct Vec3 Ba, Bm;
     uint32_t mInitState;
     float mPredictDt;
+    float mBatchDt;
     struct Vec3 mData[3];
     uint32_t mCount[3];
     uint32_t flags;
@@ -75,6 +77,9 @@ enum MagTrustMode {
 void initFusion(struct Fusion *fusion, uint32_t flags);
 
 void fusionHandleGyro(struct Fusion *fusion, const struct Vec3 *w, float dT);
+// same as calling fusionHandleGyro() on each of the n samples in turn, but folds runs of samples
+// into a single covariance propagation. feed accel/mag updates in between runs, in time order
+void fusionHandleGyroBatch(struct Fusion *fusion, const struct Vec3 *w, size_t n, float dT);
 int fusionHandleAcc(struct Fusion *fusion, const struct Vec3 *a, float dT);
 int fusionHandleMag(struct Fusion *fusion, const struct Vec3 *m, float dT);
 
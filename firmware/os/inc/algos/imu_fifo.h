@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMU_FIFO_H_
+
+#define IMU_FIFO_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Shared decoding of triaxial IMU FIFO samples.
+ *
+ * imu_fifo_decode() takes one little-endian int16 x/y/z triplet straight from
+ * the FIFO burst to scaled floats, with the optional raw bias applied in
+ * between. It is inline and runs where the driver walks its FIFO, so there is
+ * no intermediate buffer. The board remapping stays with the driver's
+ * compile time macros, which fold into the stores; a run time matrix costs
+ * more than the decode itself. So do timestamping, decimation and
+ * calibration.
+ *
+ * This is for sharing, not speed: it runs level with the per-driver decodes
+ * it replaced (algos/test/imu_fifo_test). A structure-of-arrays pass with a
+ * separate float transform was tried and dropped; Cortex-M4 has no float
+ * SIMD, and the second pass and its staging buffers cost more than the
+ * decode.
+ */
+
+// bias (raw LSB, may be NULL) is subtracted with int16 wrap-around, as a
+// driver doing "x -= (int16_t)bias" would
+static inline void imu_fifo_decode(const uint8_t *p, const int16_t *bias, float scale,
+                                   float out[3]) {
+    int16_t x = (int16_t)(p[0] | (p[1] << 8));
+    int16_t y = (int16_t)(p[2] | (p[3] << 8));
+    int16_t z = (int16_t)(p[4] | (p[5] << 8));
+
+    if (bias) {
+        x -= bias[0];
+        y -= bias[1];
+        z -= bias[2];
+    }
+
+    out[0] = (float)x * scale;
+    out[1] = (float)y * scale;
+    out[2] = (float)z * scale;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // IMU_FIFO_H_
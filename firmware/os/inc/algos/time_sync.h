@@ -39,16 +39,28 @@ typedef struct {
 
     bool estimate_valid;
     float alpha, beta;
+    float drift;    // beta - 1, fit separately to keep its resolution
+    float mean_x, mean_d;   // of time2 and time1 - time2, for the residuals
 
     uint8_t hold_count;
 
 } time_sync_t;
 
+// Quality of the current fit, e.g. for debug output.
+typedef struct {
+    size_t n;           // data points in the fit
+    float drift_ppm;    // how much faster time1 runs than time2, in ppm
+    float jitter_ns;    // rms residual of the data points around the fit, in time1 units
+} time_sync_stats_t;
+
 void time_sync_reset(time_sync_t *sync);
 bool time_sync_init(time_sync_t *sync);
 void time_sync_truncate(time_sync_t *sync, size_t window_size);
 bool time_sync_add(time_sync_t *sync, uint64_t time1, uint64_t time2);
-bool time_sync_estimate_time1(time_sync_t *sync, uint64_t time2, uint64_t *time1);
+// the fit is redone as data points come in, so this is a multiply-add
+bool time_sync_estimate_time1(const time_sync_t *sync, uint64_t time2, uint64_t *time1);
+// walks the history for the residuals, so keep it off the per-sample path
+bool time_sync_get_stats(const time_sync_t *sync, time_sync_stats_t *stats);
 void time_sync_hold(time_sync_t *sync, uint8_t count);
 
 #ifdef __cplusplus
@@ -34,6 +34,10 @@ uint64_t cpuIntsOff(void);
 uint64_t cpuIntsOn(void);
 void cpuIntsRestore(uint64_t state);
 
+/* free-running counter for profiling; it wraps, so only differences are meaningful */
+uint32_t cpuGetCycles(void);
+uint32_t cpuGetCycleRate(void); //cpuGetCycles() counts per second
+
 /* app loading, unloading & calling */
 bool cpuInternalAppLoad(const struct AppHdr *appHdr, struct PlatAppInfo *platInfo);
 bool cpuAppLoad(const struct AppHdr *appHdr, struct PlatAppInfo *platInfo);
@@ -83,4 +83,21 @@ void hostIntfSetBusy(bool busy);
 void hostIntfRxPacket(bool wakeupActive);
 void hostIntfTxAck(void *buffer, uint8_t len);
 
+/*
+ * Batching counters since boot; divide the change between two reads by the
+ * time between them for wakeups per second.
+ */
+struct HostIntfBatchStats
+{
+    uint32_t dataEvents;        // sensor data events taken in, about one per sensor per FIFO drain
+    uint32_t latencyWakeups;    // latency deadline timer expiries
+    uint32_t fifoInterrupts;    // sensor FIFO watermark interrupts, as counted by the drivers
+    uint32_t suspendRaises;     // sensor latencies raised past the host's for an AP suspend
+};
+
+void hostIntfGetBatchStats(struct HostIntfBatchStats *stats);
+
+// batching sensor drivers call this on every FIFO watermark interrupt; safe from an ISR
+void hostIntfCountFifoInterrupt(void);
+
 #endif /* __HOSTINTF_H */
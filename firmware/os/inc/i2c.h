@@ -27,10 +27,24 @@ extern "C" {
 
 typedef void (*I2cCallbackF)(void *cookie, size_t tx, size_t rx, int err);
 
+// transfers to higher priority devices go first; equal ones in queueing order
+#define I2C_PRIO_DEFAULT    0
+#define I2C_PRIO_HIGH       128
+
+struct I2cMasterStats {
+    uint32_t xfers;
+    uint32_t merged;        // sent after a repeated start to the same device
+    uint32_t maxDepth;      // transfers queued at once, including the new one
+    uint64_t waitTotal;     // ns from queueing to the start condition
+    uint64_t waitMax;
+};
+
 int i2cMasterRequest(uint32_t busId, uint32_t speedInHz);
 int i2cMasterRelease(uint32_t busId);
 int i2cMasterTxRx(uint32_t busId, uint32_t addr, const void *txBuf, size_t txSize,
         void *rxBuf, size_t rxSize, I2cCallbackF callback, void *cookie);
+int i2cMasterSetPriority(uint32_t busId, uint32_t addr, uint8_t prio);
+int i2cMasterGetStats(uint32_t busId, struct I2cMasterStats *stats);
 static inline int i2cMasterTx(uint32_t busId, uint32_t addr,
         const void *txBuf, size_t txSize, I2cCallbackF callback, void *cookie)
 {
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LOG_TOKEN_H
+#define __LOG_TOKEN_H
+
+#include <stdint.h>
+#include <seos.h>
+
+/*
+ * Tokenized logging. osLogT() takes the same arguments as osLog(), but its
+ * format string is placed in the .logstr section and never formatted on the
+ * hub: the hub records the string's offset in .logstr plus the raw argument
+ * words, and the host rebuilds the text using the .logstr section extracted
+ * from the OS ELF (os.*.logstr).
+ *
+ * Records only ever go to the host, so this needs DEBUG_LOG_EVT; without it,
+ * or without LOG_TOKENIZED, osLogT() is just osLog(). As with osLog(), %f is
+ * not supported. %s copies at most LOG_TOKEN_STR_MAX chars of the string.
+ */
+
+#if defined(LOG_TOKENIZED) && defined(DEBUG_LOG_EVT) && defined(_OS_BUILD_)
+#define LOG_TOKEN_ENABLED
+#endif
+
+// a HOST_EVT_DEBUG_LOG payload starting with this instead of a log level
+// holds struct LogTokenRecord entries, back to back
+#define LOG_TOKEN_MARK              'T'
+
+#define LOG_TOKEN_STR_MAX           31
+#define LOG_TOKEN_ARG_WORDS_MAX     16
+
+#define LOG_TOKEN_FLAG_TRUNCATED    0x0001  // ran out of argument words
+#define LOG_TOKEN_FLAG_LP64         0x0002  // long and pointers are 64-bit
+#define LOG_TOKEN_FLAG_COMMITTED    0x8000  // hub internal
+
+#define LOG_TOKEN_DROPPED           0xFFFFFFFF  // token of a record whose only arg is a drop count
+
+struct LogTokenRecord {
+    uint8_t level;      // enum LogLevel
+    uint8_t numWords;   // argument words following the record header
+    uint16_t flags;
+    uint32_t token;     // offset of the format string in .logstr
+    uint32_t args[0];   // 32-bit args take a word, 64-bit ones two (low first);
+                        // strings a length byte plus chars, padded to a word
+};
+
+#ifdef LOG_TOKEN_ENABLED
+
+#define osLogT(level, fmt, ...)                                                 \
+    do {                                                                        \
+        static const char __attribute__((section(".logstr"))) __logFmt[] = fmt; \
+        osLogTokenized(level, __logFmt, ##__VA_ARGS__);                         \
+    } while (0)
+
+void osLogTokenized(enum LogLevel level, const char *fmt, ...);
+void logTokenStart(void); //called once the host interface can take log events
+
+#else
+
+#define osLogT(level, fmt, ...) osLog(level, fmt, ##__VA_ARGS__)
+
+static inline void logTokenStart(void)
+{
+}
+
+#endif
+
+#endif /* __LOG_TOKEN_H */
@@ -18,6 +18,7 @@
 #define __NANOHUBCOMMAND_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define NANOHUB_FAST_DONT_ACK       0xFFFFFFFE
 #define NANOHUB_FAST_UNHANDLED_ACK  0xFFFFFFFF
@@ -28,6 +29,7 @@ struct NanohubCommand {
     uint32_t (*handler)(void *, uint8_t, void *, uint64_t);
     uint8_t minDataLen;
     uint8_t maxDataLen;
+    bool jumbo; // handler replies with a jumbo packet
 };
 
 void nanohubInitCommand(void);
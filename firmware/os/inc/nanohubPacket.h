@@ -65,7 +65,32 @@ static inline struct NanohubPacketFooter *nanohubGetPacketFooter(struct NanohubP
 #define NANOHUB_PACKET_SIZE_MAX       NANOHUB_PACKET_SIZE(NANOHUB_PACKET_PAYLOAD_MAX)
 #define NANOHUB_PACKET_SIZE_MIN       NANOHUB_PACKET_SIZE(0)
 
+/*
+ * Jumbo packets are only ever sent by the hub, in reply to a request the host
+ * made knowing the hub supports them (see NANOHUB_OS_CAP_JUMBO_READ_EVENT).
+ * They differ from regular packets only in their sync byte and 16-bit length;
+ * ACKs and NAKs for jumbo requests are still regular packets.
+ */
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubJumboPacket {
+    uint8_t sync;
+    __le32 seq;
+    __le32 reason;
+    __le16 len;
+    uint8_t data[0];
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_JUMBO_PACKET_SIZE(len) \
+    (sizeof(struct NanohubJumboPacket) + (len) + sizeof(struct NanohubPacketFooter))
+
+#ifndef NANOHUB_JUMBO_PAYLOAD_MAX
+#define NANOHUB_JUMBO_PAYLOAD_MAX     1024
+#endif
+#define NANOHUB_JUMBO_PACKET_SIZE_MAX NANOHUB_JUMBO_PACKET_SIZE(NANOHUB_JUMBO_PAYLOAD_MAX)
+
 #define NANOHUB_SYNC_BYTE             0x31
+#define NANOHUB_SYNC_BYTE_JUMBO       0x32
 
 #define NANOHUB_PREAMBLE_BYTE         0xFF
 #define NANOHUB_ACK_PREAMBLE_LEN      16
@@ -104,6 +129,27 @@ struct NanohubOsHwVersionsResponse {
 } ATTRIBUTE_PACKED;
 SET_PACKED_STRUCT_MODE_OFF
 
+/*
+ * Hosts that understand capabilities send hostCaps with the request and get
+ * the longer response back; an empty request still gets the original one.
+ * Kernels predating capabilities NAK the longer request.
+ */
+#define NANOHUB_OS_CAP_JUMBO_READ_EVENT       0x00000001
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubOsHwVersionsCapsRequest {
+    __le32 hostCaps;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubOsHwVersionsCapsResponse {
+    struct NanohubOsHwVersionsResponse ver;
+    __le32 caps;
+    __le16 jumboPayloadMax;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
 #define NANOHUB_REASON_GET_APP_VERSIONS       0x00001001
 
 SET_PACKED_STRUCT_MODE_ON
@@ -264,6 +310,20 @@ struct NanohubReadEventResponse {
 } ATTRIBUTE_PACKED;
 SET_PACKED_STRUCT_MODE_OFF
 
+/*
+ * Same request as READ_EVENT; the jumbo reply carries as many READ_EVENT
+ * payloads as fit, each prefixed by its length. A record with len 0 never
+ * appears; the packet length delimits the last one.
+ */
+#define NANOHUB_REASON_READ_EVENT_JUMBO       0x00001092
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubReadEventJumboRecord {
+    __le16 len;
+    uint8_t evt[0]; // struct NanohubReadEventResponse, len bytes
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
 #define NANOHUB_REASON_WRITE_EVENT            0x00001091
 
 SET_PACKED_STRUCT_MODE_ON
@@ -587,4 +647,78 @@ struct NanohubHalFinishUploadTx {
 } ATTRIBUTE_PACKED;
 SET_PACKED_STRUCT_MODE_OFF
 
+#define NANOHUB_HAL_TASK_STATS          0x19
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalTaskStatsRx {
+    uint8_t first; // index of first task to report
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+// counters are cumulative since the task was started; cycles are in units of cycleRate Hz
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalTaskStatsEntry {
+    __le64 appId;
+    __le16 tid;
+    __le32 evtCount;
+    __le32 timerCount;
+    __le64 cycles;
+    __le32 maxCycles;
+    __le32 heapUse;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_HAL_TASK_STATS_MAX_ENTRIES  3
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalTaskStatsTx {
+    struct NanohubHalHdr hdr;
+    struct NanohubHalRet ret;
+    __le32 cycleRate;
+    uint8_t first;
+    uint8_t count;
+    uint8_t more; // non-zero if there are tasks past first + count
+    struct NanohubHalTaskStatsEntry entries[NANOHUB_HAL_TASK_STATS_MAX_ENTRIES];
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_HAL_BATCH_STATS         0x1A
+
+// counters are cumulative since boot; time is the hub's sensor time in ns when they were read
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalBatchStatsTx {
+    struct NanohubHalHdr hdr;
+    struct NanohubHalRet ret;
+    __le64 time;
+    __le32 dataEvents;
+    __le32 latencyWakeups;
+    __le32 fifoInterrupts;
+    __le32 suspendRaises;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+#define NANOHUB_HAL_I2C_STATS           0x1B
+
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalI2cStatsRx {
+    uint8_t bus;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
+// ret.status is the i2cMasterGetStats() result; the counters are cumulative since boot and
+// only valid if it is 0; waits are in ns
+SET_PACKED_STRUCT_MODE_ON
+struct NanohubHalI2cStatsTx {
+    struct NanohubHalHdr hdr;
+    struct NanohubHalRet ret;
+    uint8_t bus;
+    __le64 time;
+    __le32 xfers;
+    __le32 merged;
+    __le32 maxDepth;
+    __le64 waitTotal;
+    __le64 waitMax;
+} ATTRIBUTE_PACKED;
+SET_PACKED_STRUCT_MODE_OFF
+
 #endif /* __NANOHUBPACKET_H */
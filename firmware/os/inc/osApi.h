@@ -74,7 +74,9 @@
 #define SYSCALL_OS_MAIN_EVTQ_ENQUEUE_PRIVATE 3 // (uint32_t evtType, void *evtData, uint32_t tidForFreeEvt, uint32_t toTid) -> bool success
 #define SYSCALL_OS_MAIN_EVTQ_RETAIN_EVT      4 // (TaggedPtr *evtFreeingInfoP) -> bool success
 #define SYSCALL_OS_MAIN_EVTQ_FREE_RETAINED   5 // (uint32_t evtType, void *evtData, TaggedPtr *evtFreeingInfoP) -> void
-#define SYSCALL_OS_MAIN_EVTQ_LAST            6 // always last. holes are allowed, but not immediately before this
+#define SYSCALL_OS_MAIN_EVTQ_RETAIN_SHARED   6 // (void) -> struct OsSharedEvt *sharedEvt
+#define SYSCALL_OS_MAIN_EVTQ_RELEASE_SHARED  7 // (struct OsSharedEvt *sharedEvt) -> void
+#define SYSCALL_OS_MAIN_EVTQ_LAST            8 // always last. holes are allowed, but not immediately before this
 
 //level 3 indices in the OS.main.logging table
 #define SYSCALL_OS_MAIN_LOG_LOGV         0 // (enum LogLevel level, const char *str, va_list *) -> void
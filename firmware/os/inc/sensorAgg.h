@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSOR_AGG_H_
+#define SENSOR_AGG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Accel aggregation for derived (virtual) sensors.
+ *
+ * Rather than each derived sensor holding its own accel request and
+ * subscription, it enables a kernel here. The aggregation app keeps a single
+ * accel request (highest rate, lowest latency of the enabled kernels), takes
+ * each batch once, rebuilds the sample timestamps once, and hands every
+ * sample to all enabled kernels in the same pass. Kernels run in the
+ * aggregation app's context. A kernel whose sample() returned true for any
+ * sample of the batch gets its output() called once the batch is done; that
+ * is where it enqueues its own sensor event.
+ */
+
+#define SENSOR_AGG_MAX_KERNELS  4
+
+struct SensorAggSample {
+    uint64_t time;      // ns
+    float x, y, z;      // m/s^2
+};
+
+struct SensorAggKernel {
+    uint32_t rate;      // accel rate needed, SENSOR_HZ units
+    uint64_t latency;   // max accel latency tolerated, ns
+    bool (*sample)(const struct SensorAggSample *s);
+    void (*output)(void);
+};
+
+// may be called from any task; the accel request is updated asynchronously
+bool sensorAggEnable(const struct SensorAggKernel *kernel, bool on);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SENSOR_AGG_H_
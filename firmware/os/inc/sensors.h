@@ -279,6 +279,7 @@ bool sensorFlush(uint32_t sensorHandle);
 bool sensorCalibrate(uint32_t sensorHandle);
 bool sensorSelfTest(uint32_t sensorHandle);
 bool sensorCfgData(uint32_t sensorHandle, void* cfgData);
+/* current rate and latency apply the sensor's deferred reconfiguration first, if one is due */
 uint32_t sensorGetCurRate(uint32_t sensorHandle);
 uint64_t sensorGetCurLatency(uint32_t sensorHandle);
 uint32_t sensorGetHwRate(uint32_t sensorHandle);
@@ -21,6 +21,8 @@
 #include <sensors.h>
 #include <seos.h>
 
+struct SensorsClientRequest;
+
 struct Sensor {
     const struct SensorInfo *si;
     uint32_t handle;         /* here 0 means invalid */
@@ -31,6 +33,11 @@ struct Sensor {
     uint32_t initComplete:1; /* sensor finished initializing */
     uint32_t hasOnchange :1; /* sensor supports onchange and wants to be notified to send new clients current state */
     uint32_t hasOndemand :1; /* sensor supports ondemand and wants to get triggers */
+    uint32_t reconfigPending:1; /* client requests changed, sensorReconfig() is due */
+    uint16_t numClients;     /* number of client requests */
+    uint16_t numOnchangeClients; /* number of those at SENSOR_RATE_ONCHANGE */
+    struct SensorsClientRequest *clients; /* this sensor's client requests, highest rate first */
+    struct SensorsClientRequest *clientsByLatency; /* the same requests, lowest latency first */
 };
 
 struct SensorsInternalEvent {
@@ -50,10 +57,13 @@ struct SensorsInternalEvent {
 };
 
 struct SensorsClientRequest {
+    struct SensorsClientRequest *next; /* next request for the same sensor, by rate */
+    struct SensorsClientRequest *nextByLatency; /* next request for the same sensor, by latency */
     uint32_t handle;
     uint32_t clientTid;
     uint64_t latency;
     uint32_t rate;
+    bool sendLastState; /* onchange sensor: send this client the current state once reconfigured */
 };
 
 #define MAX_INTERNAL_EVENTS       32 //also used for external app sensors' setRate() calls
@@ -287,8 +287,11 @@ bool osWriteShared(void *dest, const void *src, uint32_t len);
 bool osEraseShared();
 
 //event retaining support
+struct OsSharedEvt; //opaque handle for a shared reference to an event
 bool osRetainCurrentEvent(TaggedPtr *evtFreeingInfoP); //called from any apps' event handling to retain current event. Only valid for first app that tries. evtFreeingInfoP filled by call and used to free evt later
 void osFreeRetainedEvent(uint32_t evtType, void *evtData, TaggedPtr *evtFreeingInfoP);
+struct OsSharedEvt *osRetainCurrentEventShared(void); //called from any apps' event handling to take a read-only reference to current event. Any number of apps may do so; fails if an app retained it with osRetainCurrentEvent(). NULL on failure. The reference belongs to the calling app and is dropped when it is unloaded
+void osReleaseSharedEvent(struct OsSharedEvt *sharedEvt); //drop a reference (need not be the current event); the event is freed by its owner when the last one is dropped
 
 uint32_t osExtAppStopAppsByAppId(uint64_t appId);
 uint32_t osExtAppEraseAppsByAppId(uint64_t appId);
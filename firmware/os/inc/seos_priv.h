@@ -49,6 +49,20 @@ struct TaskList {
 } ATTRIBUTE_PACKED;
 SET_PACKED_STRUCT_MODE_OFF
 
+struct TaskStats {
+    uint32_t evtCount;   /* events handled */
+    uint32_t timerCount; /* timer callbacks run directly */
+    uint64_t cycles;     /* total cycles spent in the above, in cpuGetCycles() counts */
+    uint32_t maxCycles;  /* longest single run */
+};
+
+/* used to bracket a run of task code in the main loop; nested runs and timer callbacks are not charged to the outer task */
+struct TaskStatsSpan {
+    uint32_t start;
+    uint32_t nested;
+    uint32_t timers;
+};
+
 struct Task {
     /* App entry points */
     const struct AppHdr *app;
@@ -72,6 +86,8 @@ struct Task {
     uint8_t  flags;
     uint8_t  ioCount;
 
+    struct TaskStats stats;      /* main loop runs only */
+    struct TaskStats timerStats; /* direct timer callbacks only; written with interrupts off, possibly from the timer interrupt */
 };
 
 struct I2cEventData {
@@ -107,6 +123,17 @@ union SeosInternalSlabData {
         uint16_t fromTid;
         uint16_t toTid;
     } privateEvt;
+    struct {
+        uint32_t evtType;
+        void *evtData;
+        TaggedPtr evtFreeInfo;
+        uint16_t refCnt;
+    } sharedEvt;
+    struct {
+        union SeosInternalSlabData *evt;  /* the sharedEvt record */
+        union SeosInternalSlabData *next; /* next reference held by any app */
+        uint16_t tid;                     /* app holding this reference */
+    } sharedRef;
     union OsApiSlabItem osApiItem;
 };
 
@@ -120,6 +147,10 @@ void osTaskAbort(struct Task *task);
 void osTaskInvokeMessageFreeCallback(struct Task *task, void (*freeCallback)(void *, size_t), void *message, uint32_t messageSize);
 void osTaskInvokeEventFreeCallback(struct Task *task, void (*freeCallback)(uint16_t, void *), uint16_t event, void *data);
 void osChreTaskHandle(struct Task *task, uint32_t evtType, const void *evtData);
+void osTaskStatsBegin(struct TaskStatsSpan *span);
+void osTaskStatsEnd(struct TaskStatsSpan *span, struct Task *task);
+void osTaskStatsTimer(uint32_t tid, uint32_t cycles);
+bool osTaskStatsByIndex(uint32_t taskIdx, uint64_t *appId, uint32_t *tid, struct TaskStats *stats);
 
 static inline bool osTaskIsChre(const struct Task *task)
 {
@@ -33,6 +33,11 @@ struct SpiDevice_ops {
 
     int (*masterRxTx)(struct SpiDevice *dev, void *rxBuf, const void *txBuf,
             size_t size, const struct SpiMode *mode);
+    /* optional: run packets[0..n-1] back to back and report them all with a
+     * single spiMasterRxTxDone(); none but the last one has a delay */
+    int (*masterRxTxChain)(struct SpiDevice *dev,
+            const struct SpiPacket packets[], size_t n,
+            const struct SpiMode *mode);
 
     int (*masterStopSync)(struct SpiDevice *dev);
     int (*masterStopAsync)(struct SpiDevice *dev);
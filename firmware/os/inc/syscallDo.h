@@ -77,6 +77,16 @@ static inline bool eOsFreeRetainedEvent(uint32_t evtType, void *evtData, TaggedP
     return syscallDo3P(SYSCALL_NO(SYSCALL_DOMAIN_OS, SYSCALL_OS_MAIN, SYSCALL_OS_MAIN_EVENTQ, SYSCALL_OS_MAIN_EVTQ_FREE_RETAINED), evtType, evtData, evtFreeingInfoP);
 }
 
+static inline struct OsSharedEvt *eOsRetainCurrentEventShared(void)
+{
+    return (struct OsSharedEvt*)syscallDo0P(SYSCALL_NO(SYSCALL_DOMAIN_OS, SYSCALL_OS_MAIN, SYSCALL_OS_MAIN_EVENTQ, SYSCALL_OS_MAIN_EVTQ_RETAIN_SHARED));
+}
+
+static inline void eOsReleaseSharedEvent(struct OsSharedEvt *sharedEvt)
+{
+    (void)syscallDo1P(SYSCALL_NO(SYSCALL_DOMAIN_OS, SYSCALL_OS_MAIN, SYSCALL_OS_MAIN_EVENTQ, SYSCALL_OS_MAIN_EVTQ_RELEASE_SHARED), sharedEvt);
+}
+
 static inline void eOsLogvInternal(enum LogLevel level, const char *str, uintptr_t args_list)
 {
     (void)syscallDo3P(SYSCALL_NO(SYSCALL_DOMAIN_OS, SYSCALL_OS_MAIN, SYSCALL_OS_MAIN_LOGGING, SYSCALL_OS_MAIN_LOG_LOGV), level, str, args_list);
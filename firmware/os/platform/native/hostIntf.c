@@ -14,13 +14,236 @@
  * limitations under the License.
  */
 
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <hostIntf.h>
 #include <hostIntf_priv.h>
+#include <nanohubPacket.h>
+#include <plat/plat.h>
+
+/*
+ * Host link for the native platform. Every transfer in either direction is one frame on a byte
+ * stream (pipe or socket): a 32-bit little-endian length followed by that many bytes. A frame from
+ * the host plays the role of one host bus transaction framed by the wakeup line.
+ */
+
+#define NATIVE_RX_FRAMES        8
+#define NATIVE_FRAME_MAX        NANOHUB_PACKET_SIZE_MAX
+
+struct NativeFrame {
+    uint32_t len;
+    uint8_t data[NATIVE_FRAME_MAX];
+};
+
+static int mRxFd = -1, mTxFd = -1;
+static pthread_t mReader;
+static bool mReaderRunning;
+
+//shared with the reader thread
+static pthread_mutex_t mFramesLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mFramesSpace = PTHREAD_COND_INITIALIZER;
+static struct NativeFrame mFrames[NATIVE_RX_FRAMES];
+static uint32_t mFramesHead, mFramesCount;
+
+//main thread only
+static bool mRequested;
+static void *mRxBuf;
+static size_t mRxSize;
+static HostIntfCommCallbackF mRxCallback;
+static size_t mTxSize;
+static int mTxErr;
+static HostIntfCommCallbackF mTxCallback;
+
+static bool hostIntfNativeReadAll(void *buf, size_t len)
+{
+    uint8_t *dst = buf;
+    ssize_t ret;
+
+    while (len) {
+        ret = read(mRxFd, dst, len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+        dst += ret;
+        len -= ret;
+    }
+
+    return true;
+}
+
+static bool hostIntfNativeWriteAll(const void *buf, size_t len)
+{
+    const uint8_t *src = buf;
+    ssize_t ret;
 
+    while (len) {
+        ret = write(mTxFd, src, len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+        src += ret;
+        len -= ret;
+    }
+
+    return true;
+}
+
+static void *hostIntfNativeReader(void *arg)
+{
+    struct NativeFrame *frame;
+    uint8_t hdr[4], discard[64];
+    uint32_t len, keep, left;
+
+    while (hostIntfNativeReadAll(hdr, sizeof(hdr))) {
+        len = hdr[0] | (hdr[1] << 8) | (hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+        keep = len > NATIVE_FRAME_MAX ? NATIVE_FRAME_MAX : len;
+
+        pthread_mutex_lock(&mFramesLock);
+        while (mFramesCount == NATIVE_RX_FRAMES)
+            pthread_cond_wait(&mFramesSpace, &mFramesLock);
+        frame = &mFrames[(mFramesHead + mFramesCount) % NATIVE_RX_FRAMES];
+        pthread_mutex_unlock(&mFramesLock);
+
+        //the slot is ours until we publish it; oversized frames are truncated like a short rx buffer would
+        if (!hostIntfNativeReadAll(frame->data, keep))
+            break;
+        for (left = len - keep; left; left -= keep) {
+            keep = left > sizeof(discard) ? sizeof(discard) : left;
+            if (!hostIntfNativeReadAll(discard, keep))
+                return NULL;
+        }
+        frame->len = len > NATIVE_FRAME_MAX ? NATIVE_FRAME_MAX : len;
+
+        pthread_mutex_lock(&mFramesLock);
+        mFramesCount++;
+        pthread_mutex_unlock(&mFramesLock);
+
+        platWake();
+    }
+
+    return NULL;
+}
+
+static int hostIntfNativeRequest()
+{
+    if (mRxFd < 0)
+        return -ENODEV;
+
+    if (!mReaderRunning) {
+        if (pthread_create(&mReader, NULL, hostIntfNativeReader, NULL))
+            return -ENOMEM;
+        mReaderRunning = true;
+    }
+    mRequested = true;
+
+    return 0;
+}
+
+static int hostIntfNativeRxPacket(void *rxBuf, size_t rxSize,
+        HostIntfCommCallbackF callback)
+{
+    mRxBuf = rxBuf;
+    mRxSize = rxSize;
+    mRxCallback = callback;
+    platWake();
+    return 0;
+}
+
+static int hostIntfNativeTxPacket(const void *txBuf, size_t txSize,
+        HostIntfCommCallbackF callback)
+{
+    uint8_t hdr[4] = {txSize, txSize >> 8, txSize >> 16, txSize >> 24};
+
+    if (mTxCallback)
+        return -EBUSY;
+
+    //the write itself is synchronous, but completion is reported later like a dma interrupt would be
+    mTxErr = hostIntfNativeWriteAll(hdr, sizeof(hdr)) && hostIntfNativeWriteAll(txBuf, txSize) ? 0 : -EIO;
+    mTxSize = mTxErr ? 0 : txSize;
+    mTxCallback = callback;
+    platWake();
+    return 0;
+}
+
+static int hostIntfNativeRelease(void)
+{
+    mRequested = false;
+    mRxCallback = NULL;
+    return 0;
+}
+
+static const struct HostIntfComm gNativeComm = {
+   .request = hostIntfNativeRequest,
+   .rxPacket = hostIntfNativeRxPacket,
+   .txPacket = hostIntfNativeTxPacket,
+   .release = hostIntfNativeRelease,
+};
+
+void platHostIntfSetFds(int rxFd, int txFd)
+{
+    mRxFd = rxFd;
+    mTxFd = txFd;
+}
+
+void platHostIntfService(void)
+{
+    HostIntfCommCallbackF callback;
+    struct NativeFrame *frame;
+    uint32_t pending;
+    size_t len;
+
+    if (!mRequested)
+        return;
+
+    if (mTxCallback) {
+        callback = mTxCallback;
+        mTxCallback = NULL;
+        callback(mTxSize, mTxErr);
+    }
+
+    pthread_mutex_lock(&mFramesLock);
+    pending = mFramesCount;
+    pthread_mutex_unlock(&mFramesLock);
+
+    //only start a new host transaction once the previous reply is fully out
+    if (mTxCallback || !pending)
+        return;
+
+    //host raises the wakeup line; this is also what re-arms rx when it went idle
+    hostIntfRxPacket(true);
+
+    if (mRxCallback) {
+        pthread_mutex_lock(&mFramesLock);
+        frame = &mFrames[mFramesHead];
+        pthread_mutex_unlock(&mFramesLock);
+
+        len = frame->len < mRxSize ? frame->len : mRxSize;
+        memcpy(mRxBuf, frame->data, len);
+
+        pthread_mutex_lock(&mFramesLock);
+        mFramesHead = (mFramesHead + 1) % NATIVE_RX_FRAMES;
+        mFramesCount--;
+        pthread_cond_signal(&mFramesSpace);
+        pthread_mutex_unlock(&mFramesLock);
+
+        callback = mRxCallback;
+        mRxCallback = NULL;
+        callback(len, 0);
+    }
+
+    hostIntfRxPacket(false);
+}
 
-I2cBus platHostIntfI2cBus(void)
+const struct HostIntfComm *platHostIntfInit()
 {
-    return PLATFORM_HOST_INTF_I2C_BUS;
+    return &gNativeComm;
 }
 
 uint16_t platHwType(void)
@@ -26,45 +26,55 @@
 
 
 
-int i2cMasterRequest(I2cBus busId, I2cSpeed speed)
+int i2cMasterRequest(uint32_t busId, uint32_t speedInHz)
 {
     return -EINVAL;
 }
 
-int i2cMasterRelease(I2cBus busId)
+int i2cMasterRelease(uint32_t busId)
 {
     return -EINVAL;
 }
 
-int i2cMasterTxRx(I2cBus busId, I2cAddr addr,
+int i2cMasterTxRx(uint32_t busId, uint32_t addr,
         const void *txBuf, size_t txSize, void *rxBuf, size_t rxSize,
         I2cCallbackF callback, void *cookie)
 {
     return -EINVAL;
 }
 
-int i2cSlaveRequest(I2cBus busId, I2cAddr addr)
+int i2cMasterSetPriority(uint32_t busId, uint32_t addr, uint8_t prio)
 {
     return -EINVAL;
 }
 
-int i2cSlaveRelease(I2cBus busId)
+int i2cMasterGetStats(uint32_t busId, struct I2cMasterStats *stats)
 {
     return -EINVAL;
 }
 
-void i2cSlaveEnableRx(I2cBus busId, void *rxBuf, size_t rxSize,
+int i2cSlaveRequest(uint32_t busId, uint32_t addr)
+{
+    return -EINVAL;
+}
+
+int i2cSlaveRelease(uint32_t busId)
+{
+    return -EINVAL;
+}
+
+void i2cSlaveEnableRx(uint32_t busId, void *rxBuf, size_t rxSize,
         I2cCallbackF callback, void *cookie)
 {
     //
 }
 
-int i2cSlaveTxPreamble(I2cBus busId, uint8_t byte, I2cCallbackF callback, void *cookie)
+int i2cSlaveTxPreamble(uint32_t busId, uint8_t byte, I2cCallbackF callback, void *cookie)
 {
     return -EBUSY;
 }
 
-int i2cSlaveTxPacket(I2cBus busId, const void *txBuf, size_t txSize, I2cCallbackF callback, void *cookie)
+int i2cSlaveTxPacket(uint32_t busId, const void *txBuf, size_t txSize, I2cCallbackF callback, void *cookie)
 {
     return -EBUSY;
 }
@@ -35,7 +35,13 @@ static inline uint8_t* platGetSharedAreaInfo(uint32_t *areaSzP)
     return appHdr;
 }
 
-static inline void platWake(void) {}
+// wake platSleep() up early; safe to call from any host thread
+void platWake(void);
+
+// host-side plumbing for the native platform. these may be called before osMain()
+// and stand in for the board wiring a real platform would have
+void platHostIntfSetFds(int rxFd, int txFd);
+void platHostIntfService(void);
 
 #ifdef __cplusplus
 }
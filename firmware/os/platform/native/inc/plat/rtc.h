@@ -32,6 +32,7 @@ extern "C" {
 void rtcInit(void);
 int rtcSetWakeupTimer(uint64_t delay, int ppm);
 uint64_t rtcGetTime(void);
+uint64_t rtcGetWakeupTime(void);
 
 #ifdef __cplusplus
 }
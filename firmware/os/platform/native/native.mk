@@ -17,7 +17,7 @@
 DELIVERABLES = $(APP).bin
 LKR = os/platform/$(PLATFORM)/lkr/native.extra.lkr
 
-FLAGS += -I. -fno-unwind-tables -fstack-reuse=all -ffunction-sections -fdata-sections -m32
+FLAGS += -I. -fno-unwind-tables -fstack-reuse=all -ffunction-sections -fdata-sections -m32 -pthread
 FLAGS += -Wl,-T $(LKR) -Wl,--gc-sections
 
 
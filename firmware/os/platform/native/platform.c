@@ -14,12 +14,19 @@
  * limitations under the License.
  */
 
+
+#include <plat/plat.h>
 #include <plat/rtc.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <platform.h>
 #include <seos.h>
 #include <timer.h>
@@ -29,35 +36,179 @@
 #include <mpu.h>
 #include <cpu.h>
 
+/*
+ * Native platform: the OS runs single-threaded on the host main thread, exactly as it would on
+ * the MCU. "Interrupts" (host traffic) arrive on helper threads that only ever queue data and call
+ * platWake(); all OS code, including hostIntf completion callbacks, runs from platSleep() and
+ * platPeriodic() on the main thread.
+ *
+ * With -t the platform runs on virtual time: the clock only moves when the OS sleeps, and it jumps
+ * straight to the next wakeup. Timer-driven workloads then replay identically on every run and
+ * take no wall-clock time to do so.
+ */
+
+static pthread_mutex_t mSleepLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mSleepCond;
+static bool mWakePending;
+static uint64_t mWakeupTime;
+static uint64_t mTimeBase;
+static bool mVirtualTime;
+static uint64_t mVirtualNow;
+
+static uint64_t platHostNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
 void platUninitialize(void)
 {
-    //TODO
+    fflush(stdout);
+}
+
+void platReset(void)
+{
+    fflush(stdout);
+    exit(0);
+}
+
+static uint64_t platNextWakeup(void)
+{
+    uint64_t wakeup = mWakeupTime, rtcWakeup = rtcGetWakeupTime(), rtcNow;
+
+    //rtc alarm is in rtc time; move it to our timebase the same way timer.c does. it is one-shot,
+    //so once it is due it is consumed
+    if (rtcWakeup) {
+        rtcNow = rtcGetTime();
+        if (rtcWakeup > rtcNow) {
+            rtcWakeup = rtcWakeup - rtcNow + platGetTicks();
+        } else {
+            rtcSetWakeupTimer(0, 0);
+            rtcWakeup = platGetTicks();
+        }
+        if (!wakeup || rtcWakeup < wakeup)
+            wakeup = rtcWakeup;
+    }
+
+    return wakeup;
 }
 
 void platSleep(void)
 {
-    //TODO
+    uint64_t wakeup, now, abs;
+    struct timespec ts;
+
+    pthread_mutex_lock(&mSleepLock);
+    while (!mWakePending) {
+        wakeup = platNextWakeup();
+        now = platGetTicks();
+
+        if (wakeup && now >= wakeup)
+            break;
+
+        if (mVirtualTime && wakeup) {
+            mVirtualNow = wakeup;
+            break;
+        }
+
+        if (wakeup) {
+            abs = mTimeBase + wakeup;
+            ts.tv_sec = abs / 1000000000ULL;
+            ts.tv_nsec = abs % 1000000000ULL;
+            pthread_cond_timedwait(&mSleepCond, &mSleepLock, &ts);
+        } else {
+            pthread_cond_wait(&mSleepCond, &mSleepLock);
+        }
+    }
+    mWakePending = false;
+    pthread_mutex_unlock(&mSleepLock);
+
+    //this is where interrupts would have fired
+    platHostIntfService();
+}
+
+void platWake(void)
+{
+    pthread_mutex_lock(&mSleepLock);
+    mWakePending = true;
+    pthread_cond_signal(&mSleepCond);
+    pthread_mutex_unlock(&mSleepLock);
+}
+
+bool platSleepClockRequest(uint64_t wakeupTime, uint32_t maxJitterPpm, uint32_t maxDriftPpm, uint32_t maxErrTotalPpm)
+{
+    if (wakeupTime && platGetTicks() >= wakeupTime)
+        return false;
+
+    pthread_mutex_lock(&mSleepLock);
+    mWakeupTime = wakeupTime;
+    pthread_mutex_unlock(&mSleepLock);
+
+    return true;
+}
+
+bool platRequestDevInSleepMode(uint32_t sleepDevID, uint32_t maxWakeupTime)
+{
+    return true;
+}
+
+bool platAdjustDevInSleepMode(uint32_t sleepDevID, uint32_t maxWakeupTime)
+{
+    return true;
+}
+
+bool platReleaseDevInSleepMode(uint32_t sleepDevID)
+{
+    return true;
 }
 
-void platLogPutchar(char ch)
+void *platLogAllocUserData()
+{
+    return NULL;
+}
+
+bool platLogPutcharF(void *userData, char ch)
+{
+    putchar(ch);
+    return true;
+}
+
+void platLogFlush(void *userData)
+{
+    fflush(stdout);
+}
+
+void platEarlyLogFlush(void)
 {
-     putchar(ch);
 }
 
 void platInitialize(void)
 {
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mSleepCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (!mTimeBase)
+        mTimeBase = platHostNs();
+
     /* set up RTC */
     rtcInit();
-
-    //TODO
 }
 
 uint64_t platGetTicks(void)
 {
-    //TODO
+    if (mVirtualTime)
+        return mVirtualNow;
 
-    return 0;
+    if (!mTimeBase)
+        mTimeBase = platHostNs();
+
+    return platHostNs() - mTimeBase;
 }
 
 uint32_t platFreeResources(uint32_t tid)
@@ -67,10 +218,77 @@ uint32_t platFreeResources(uint32_t tid)
 
 void platPeriodic()
 {
+    platHostIntfService();
+}
+
+static int platHostListen(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd, conn;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    fprintf(stderr, "waiting for host on %s\n", path);
+    do {
+        conn = accept(fd, NULL, NULL);
+    } while (conn < 0 && errno == EINTR);
+    close(fd);
+
+    return conn;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-t] [-s <socket path> | -p <rx fd>,<tx fd>]\n"
+                    "    -t        run on virtual time\n"
+                    "    -s path   accept one host connection on this unix socket\n"
+                    "    -p rx,tx  talk to the host over inherited fds (pipes or a socketpair)\n",
+                    name);
+    exit(1);
 }
 
 int main(int argc, char** argv)
 {
+    int opt, fd, rxFd = -1, txFd = -1;
+
+    while ((opt = getopt(argc, argv, "ts:p:")) != -1) {
+        switch (opt) {
+        case 't':
+            mVirtualTime = true;
+            break;
+        case 's':
+            fd = platHostListen(optarg);
+            if (fd < 0)
+                return 1;
+            rxFd = txFd = fd;
+            break;
+        case 'p':
+            if (sscanf(optarg, "%d,%d", &rxFd, &txFd) != 2)
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (rxFd >= 0)
+        platHostIntfSetFds(rxFd, txFd);
+
     osMain();
 
     return 0;
@@ -20,9 +20,13 @@
 #include <platform.h>
 
 
+/* the virtual rtc shares the platform timebase, so it follows virtual time when that is in use */
+
+static uint64_t mRtcWakeup;
+
 void rtcInit(void)
 {
-    /* nope */
+    mRtcWakeup = 0;
 }
 
 /* Set calendar alarm to go off after delay has expired. uint64_t delay must
@@ -30,12 +34,17 @@ void rtcInit(void)
  * for the 'ppm' param indicates the alarm has no accuracy requirements. */
 int rtcSetWakeupTimer(uint64_t delay, int ppm)
 {
-    //TODO
+    mRtcWakeup = delay ? rtcGetTime() + delay : 0;
 
     return 0;
 }
 
 uint64_t rtcGetTime(void)
 {
-    return 0;
+    return platGetTicks();
+}
+
+uint64_t rtcGetWakeupTime(void)
+{
+    return mRtcWakeup;
 }
@@ -257,7 +257,7 @@ int dmaStart(uint8_t busId, uint8_t stream, const void *buf, uint16_t size,
     regs->M0AR = (uintptr_t)buf;
     regs->FCR = 0;
     regs->CR = STM_DMA_CR_TEIE |
-            STM_DMA_CR_TCIE |
+            (mode->errIrqOnly ? 0 : STM_DMA_CR_TCIE) |
             STM_DMA_CR_DIR(mode->direction) |
             STM_DMA_CR_PSIZE(mode->psize) |
             STM_DMA_CR_MSIZE(mode->msize) |
@@ -274,6 +274,52 @@ int dmaStart(uint8_t busId, uint8_t stream, const void *buf, uint16_t size,
     return 0;
 }
 
+/* Run a stream again with the mode and callback of its last dmaStart(), only
+ * reloading the buffer.  Meant to be called from the completion callback to
+ * chain transfers without redoing the whole setup.
+ */
+int dmaRestart(uint8_t busId, uint8_t stream, const void *buf, uint16_t size,
+        bool minc)
+{
+    if (busId >= STM_DMA_NUM_DEVS || stream >= STM_DMA_NUM_STREAMS)
+        return -EINVAL;
+
+    struct StmDmaStreamState *state = dmaGetStreamState(busId, stream);
+    struct StmDmaStreamRegs *regs = dmaGetStreamRegs(busId, stream);
+
+    if (regs->CR & STM_DMA_CR_EN)
+        return -EBUSY;
+
+    state->tid = osGetCurrentTid();
+    dmaClearIsr(busId, stream, STM_DMA_ISR_TEIFx);
+    dmaClearIsr(busId, stream, STM_DMA_ISR_TCIFx);
+
+    regs->NDTR = size;
+    regs->M0AR = (uintptr_t)buf;
+    if (minc)
+        regs->CR |= STM_DMA_CR_MINC;
+    else
+        regs->CR &= ~STM_DMA_CR_MINC;
+
+    NVIC_EnableIRQ(STM_DMA_IRQ[busId][stream]);
+
+    regs->CR |= STM_DMA_CR_EN;
+    return 0;
+}
+
+// 0 once the stream has completed, -EBUSY while it is running, -EIO on error
+int dmaStatus(uint8_t busId, uint8_t stream)
+{
+    uint8_t isr = dmaGetIsr(busId, stream);
+
+    if (isr & STM_DMA_ISR_TEIFx)
+        return -EIO;
+    else if (dmaGetStreamRegs(busId, stream)->CR & STM_DMA_CR_EN)
+        return -EBUSY;
+    else
+        return 0;
+}
+
 uint16_t dmaBytesLeft(uint8_t busId, uint8_t stream)
 {
     struct StmDmaStreamRegs *regs = dmaGetStreamRegs(busId, stream);
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <cpu.h>
 #include <gpio.h>
 #include <i2c.h>
 #include <seos.h>
@@ -39,6 +40,7 @@
 
 #define I2C_VERBOSE_DEBUG       0
 #define I2C_MAX_QUEUE_DEPTH     5
+#define I2C_MAX_PRIO_DEVS       4
 
 #if I2C_VERBOSE_DEBUG
 #define i2c_log_debug(x) osLog(LOG_DEBUG, x "\n")
@@ -177,8 +179,14 @@ struct StmI2cDev {
     const struct StmI2cBoardCfg *board;
     struct I2cStmState state;
 
-    uint32_t next;
     uint32_t last;
+    uint32_t queued;
+
+    // devices on this bus whose transfers go ahead of the default priority
+    uint8_t prioAddr[I2C_MAX_PRIO_DEVS];
+    uint8_t prio[I2C_MAX_PRIO_DEVS];
+
+    struct I2cMasterStats stats;
 
     struct Gpio *scl;
     struct Gpio *sda;
@@ -227,6 +235,8 @@ struct StmI2cXfer
     uint8_t         busId; /* for us these are both fine in a uint 8 */
     uint8_t         addr;
     uint16_t        tid;
+    uint8_t         prio;
+    uint64_t        queued;
 };
 
 ATOMIC_BITSET_DECL(mXfersValid, I2C_MAX_QUEUE_DEPTH, static);
@@ -248,6 +258,87 @@ static inline void stmI2cPutXfer(struct StmI2cXfer *xfer)
         atomicBitsetClearBit(mXfersValid, xfer - mXfers);
 }
 
+static uint8_t stmI2cGetPrio(struct StmI2cDev *pdev, uint8_t addr)
+{
+    int i;
+
+    for (i = 0; i < I2C_MAX_PRIO_DEVS; i++) {
+        if (pdev->prio[i] && pdev->prioAddr[i] == addr)
+            return pdev->prio[i];
+    }
+
+    return I2C_PRIO_DEFAULT;
+}
+
+// The queued transfer that should go on the bus next: the highest priority
+// one, and the oldest one among equals.
+static struct StmI2cXfer *stmI2cPeekXfer(struct StmI2cDev *pdev, uint32_t *idOut)
+{
+    uint8_t busId = pdev - mStmI2cDevs;
+    struct StmI2cXfer *xfer, *best = NULL;
+    uint32_t id, bestId = 0;
+    int i;
+
+    for (i = 0; i < I2C_MAX_QUEUE_DEPTH; i++) {
+        xfer = &mXfers[i];
+        id = atomicRead32bits(&xfer->id);
+
+        if (!id || xfer->busId != busId)
+            continue;
+
+        if (!best || xfer->prio > best->prio ||
+                (xfer->prio == best->prio && (int32_t)(id - bestId) < 0)) {
+            best = xfer;
+            bestId = id;
+        }
+    }
+
+    *idOut = bestId;
+    return best;
+}
+
+/* Only whoever moved masterState out of IDLE gets to claim, so nothing else
+ * can take the transfer between the scan and the cmpxchg (a new one may get
+ * queued, which is fine).
+ */
+static struct StmI2cXfer *stmI2cClaimXfer(struct StmI2cDev *pdev)
+{
+    uint32_t id;
+    struct StmI2cXfer *xfer = stmI2cPeekXfer(pdev, &id);
+
+    if (xfer && atomicCmpXchg32bits(&xfer->id, id, 0)) {
+        atomicAdd32bits(&pdev->queued, -1);
+        return xfer;
+    }
+
+    return NULL;
+}
+
+static void stmI2cMasterLoadXfer(struct StmI2cDev *pdev, struct StmI2cXfer *xfer)
+{
+    struct I2cStmState *state = &pdev->state;
+    uint64_t wait = timGetTime() - xfer->queued;
+
+    pdev->addr = xfer->addr;
+    state->tx.cbuf = xfer->txBuf;
+    state->tx.offset = 0;
+    state->tx.size = xfer->txSize;
+    state->tx.callback = xfer->callback;
+    state->tx.cookie = xfer->cookie;
+    state->rx.buf = xfer->rxBuf;
+    state->rx.offset = 0;
+    state->rx.size = xfer->rxSize;
+    state->rx.callback = NULL;
+    state->rx.cookie = NULL;
+    state->tid = xfer->tid;
+    stmI2cPutXfer(xfer);
+
+    pdev->stats.xfers++;
+    pdev->stats.waitTotal += wait;
+    if (wait > pdev->stats.waitMax)
+        pdev->stats.waitMax = wait;
+}
+
 static inline void stmI2cAckEnable(struct StmI2cDev *pdev)
 {
     pdev->cfg->regs->CR1 |= I2C_CR1_ACK;
@@ -486,14 +577,31 @@ static void stmI2cSlaveNakRxed(struct StmI2cDev *pdev)
     regs->SR1 &= ~I2C_SR1_AF;
 }
 
-static inline void stmI2cMasterTxRxDone(struct StmI2cDev *pdev, int err)
+/* Without stopped the finished transfer has not been ended on the bus yet.
+ * That has to happen before the callback runs (a master receiver would clock
+ * in another byte otherwise), so the choice between a stop and a repeated
+ * start for the next transfer to the same device is made on what is queued
+ * right now.
+ */
+static inline void stmI2cMasterTxRxDone(struct StmI2cDev *pdev, int err, bool stopped)
 {
     struct I2cStmState *state = &pdev->state;
     size_t txOffst = state->tx.offset;
     size_t rxOffst = state->rx.offset;
-    uint32_t id;
-    int i;
+    bool restarted = false;
     struct StmI2cXfer *xfer;
+    uint32_t id;
+
+    if (!stopped) {
+        xfer = err ? NULL : stmI2cPeekXfer(pdev, &id);
+        if (xfer && xfer->addr == pdev->addr) {
+            stmI2cStartEnable(pdev);
+            pdev->stats.merged++;
+            restarted = true;
+        } else {
+            stmI2cStopEnable(pdev);
+        }
+    }
 
     if (pdev->board->sleepDev >= 0)
         platReleaseDevInSleepMode(pdev->board->sleepDev);
@@ -502,36 +610,21 @@ static inline void stmI2cMasterTxRxDone(struct StmI2cDev *pdev, int err)
     state->rx.offset = 0;
     stmI2cInvokeTxCallback(state, txOffst, rxOffst, err);
 
-    do {
-        id = atomicAdd32bits(&pdev->next, 1);
-    } while (!id);
-
-    for (i=0; i<I2C_MAX_QUEUE_DEPTH; i++) {
-        xfer = &mXfers[i];
-
-        if (xfer->busId == (pdev - mStmI2cDevs) &&
-                atomicCmpXchg32bits(&xfer->id, id, 0)) {
-            pdev->addr = xfer->addr;
-            state->tx.cbuf = xfer->txBuf;
-            state->tx.offset = 0;
-            state->tx.size = xfer->txSize;
-            state->tx.callback = xfer->callback;
-            state->tx.cookie = xfer->cookie;
-            state->rx.buf = xfer->rxBuf;
-            state->rx.offset = 0;
-            state->rx.size = xfer->rxSize;
-            state->rx.callback = NULL;
-            state->rx.cookie = NULL;
-            state->tid = xfer->tid;
-            atomicWriteByte(&state->masterState, STM_I2C_MASTER_START);
-            if (pdev->board->sleepDev >= 0)
-                platRequestDevInSleepMode(pdev->board->sleepDev, 12);
-            stmI2cPutXfer(xfer);
+    // this may be a higher priority transfer the callback just queued; a
+    // repeated start can be followed by any address
+    xfer = stmI2cClaimXfer(pdev);
+    if (xfer) {
+        stmI2cMasterLoadXfer(pdev, xfer);
+        atomicWriteByte(&state->masterState, STM_I2C_MASTER_START);
+        if (pdev->board->sleepDev >= 0)
+            platRequestDevInSleepMode(pdev->board->sleepDev, 12);
+        if (!restarted)
             stmI2cStartEnable(pdev);
-            return;
-        }
+        return;
     }
 
+    if (restarted)
+        stmI2cStopEnable(pdev);
     atomicWriteByte(&state->masterState, STM_I2C_MASTER_IDLE);
 }
 
@@ -551,8 +644,7 @@ static void stmI2cMasterDmaTxDone(void *cookie, uint16_t bytesLeft, int err)
         while (!(regs->SR1 & I2C_SR1_BTF))
             ;
 
-        stmI2cStopEnable(pdev);
-        stmI2cMasterTxRxDone(pdev, err);
+        stmI2cMasterTxRxDone(pdev, err, false);
     }
 }
 
@@ -565,8 +657,7 @@ static void stmI2cMasterDmaRxDone(void *cookie, uint16_t bytesLeft, int err)
     state->rx.size = 0;
 
     stmI2cDmaDisable(pdev);
-    stmI2cStopEnable(pdev);
-    stmI2cMasterTxRxDone(pdev, err);
+    stmI2cMasterTxRxDone(pdev, err, false);
 }
 
 static inline void stmI2cMasterDmaCancel(struct StmI2cDev *pdev)
@@ -665,7 +756,7 @@ static void stmI2cMasterNakRxed(struct StmI2cDev *pdev)
     if (err) {
         regs->SR1 &= ~I2C_SR1_AF;
         stmI2cStopEnable(pdev);
-        stmI2cMasterTxRxDone(pdev, err);
+        stmI2cMasterTxRxDone(pdev, err, true);
     }
 }
 
@@ -675,7 +766,7 @@ static void stmI2cMasterBusError(struct StmI2cDev *pdev)
 
     stmI2cMasterDmaCancel(pdev);
     regs->SR1 &= ~I2C_SR1_BERR;
-    stmI2cMasterTxRxDone(pdev, -EIO);
+    stmI2cMasterTxRxDone(pdev, -EIO, true);
 }
 
 static void stmI2cMasterArbitrationLoss(struct StmI2cDev *pdev)
@@ -684,7 +775,7 @@ static void stmI2cMasterArbitrationLoss(struct StmI2cDev *pdev)
 
     stmI2cMasterDmaCancel(pdev);
     regs->SR1 &= ~I2C_SR1_ARLO;
-    stmI2cMasterTxRxDone(pdev, -EBUSY);
+    stmI2cMasterTxRxDone(pdev, -EBUSY, true);
 }
 
 static void stmI2cMasterUnexpectedError(struct StmI2cDev *pdev)
@@ -696,7 +787,7 @@ static void stmI2cMasterUnexpectedError(struct StmI2cDev *pdev)
 
     stmI2cMasterDmaCancel(pdev);
     regs->SR1 = 0;
-    stmI2cMasterTxRxDone(pdev, -EIO);
+    stmI2cMasterTxRxDone(pdev, -EIO, true);
 }
 
 static void stmI2cIsrEvent(struct StmI2cDev *pdev)
@@ -837,8 +928,9 @@ int i2cMasterRequest(uint32_t busId, uint32_t speed)
 
         pdev->cfg = cfg;
         pdev->board = board;
-        pdev->next = 2;
         pdev->last = 1;
+        pdev->queued = 0;
+        memset(&pdev->stats, 0, sizeof(pdev->stats));
         atomicBitsetInit(mXfersValid, I2C_MAX_QUEUE_DEPTH);
 
         i2cMasterReset(busId, speed);
@@ -900,7 +992,7 @@ int i2cMasterTxRx(uint32_t busId, uint32_t addr,
         const void *txBuf, size_t txSize, void *rxBuf, size_t rxSize,
         I2cCallbackF callback, void *cookie)
 {
-    uint32_t id;
+    uint32_t id, depth;
 
     if (busId >= ARRAY_SIZE(mStmI2cDevs))
         return -EINVAL;
@@ -925,11 +1017,17 @@ int i2cMasterTxRx(uint32_t busId, uint32_t addr,
         xfer->callback = callback;
         xfer->cookie = cookie;
         xfer->tid = osGetCurrentTid();
+        xfer->prio = stmI2cGetPrio(pdev, addr);
+        xfer->queued = timGetTime();
 
         do {
             id = atomicAdd32bits(&pdev->last, 1);
         } while (!id);
 
+        depth = atomicAdd32bits(&pdev->queued, 1) + 1;
+        if (depth > pdev->stats.maxDepth)
+            pdev->stats.maxDepth = depth;
+
         // after this point the transfer can be picked up by the transfer
         // complete interrupt
         atomicWrite32bits(&xfer->id, id);
@@ -940,24 +1038,15 @@ int i2cMasterTxRx(uint32_t busId, uint32_t addr,
         if (atomicCmpXchgByte((uint8_t *)&state->masterState,
                 STM_I2C_MASTER_IDLE, STM_I2C_MASTER_START)) {
             // it is possible for this transfer to already be complete by the
-            // time we get here. if so, transfer->id will have been set to 0.
-            if (atomicCmpXchg32bits(&xfer->id, id, 0)) {
-                pdev->addr = xfer->addr;
-                state->tx.cbuf = xfer->txBuf;
-                state->tx.offset = 0;
-                state->tx.size = xfer->txSize;
-                state->tx.callback = xfer->callback;
-                state->tx.cookie = xfer->cookie;
-                state->rx.buf = xfer->rxBuf;
-                state->rx.offset = 0;
-                state->rx.size = xfer->rxSize;
-                state->rx.callback = NULL;
-                state->rx.cookie = NULL;
-                state->tid = xfer->tid;
+            // time we get here, and for others to have been queued meanwhile
+            xfer = stmI2cClaimXfer(pdev);
+            if (xfer) {
+                stmI2cMasterLoadXfer(pdev, xfer);
                 if (pdev->board->sleepDev >= 0)
                     platRequestDevInSleepMode(pdev->board->sleepDev, 12);
-                stmI2cPutXfer(xfer);
                 stmI2cStartEnable(pdev);
+            } else {
+                atomicWriteByte(&state->masterState, STM_I2C_MASTER_IDLE);
             }
         }
         return 0;
@@ -966,6 +1055,55 @@ int i2cMasterTxRx(uint32_t busId, uint32_t addr,
     }
 }
 
+int i2cMasterSetPriority(uint32_t busId, uint32_t addr, uint8_t prio)
+{
+    int i, slot = -1;
+
+    if (busId >= ARRAY_SIZE(mStmI2cDevs))
+        return -EINVAL;
+    else if (addr & 0x80)
+        return -ENXIO;
+
+    struct StmI2cDev *pdev = &mStmI2cDevs[busId];
+
+    if (pdev->state.mode != STM_I2C_MASTER)
+        return -EINVAL;
+
+    for (i = 0; i < I2C_MAX_PRIO_DEVS; i++) {
+        if (pdev->prio[i] && pdev->prioAddr[i] == addr) {
+            slot = i;
+            break;
+        } else if (!pdev->prio[i] && slot < 0) {
+            slot = i;
+        }
+    }
+
+    if (slot < 0)
+        return prio == I2C_PRIO_DEFAULT ? 0 : -ENOSPC;
+
+    // applies to transfers queued from now on
+    pdev->prioAddr[slot] = addr;
+    pdev->prio[slot] = prio;
+    return 0;
+}
+
+int i2cMasterGetStats(uint32_t busId, struct I2cMasterStats *stats)
+{
+    if (busId >= ARRAY_SIZE(mStmI2cDevs))
+        return -EINVAL;
+
+    struct StmI2cDev *pdev = &mStmI2cDevs[busId];
+
+    if (pdev->state.mode != STM_I2C_MASTER)
+        return -EINVAL;
+
+    uint64_t flags = cpuIntsOff();
+    *stats = pdev->stats;
+    cpuIntsRestore(flags);
+
+    return 0;
+}
+
 int i2cSlaveRequest(uint32_t busId, uint32_t addr)
 {
     if (busId >= ARRAY_SIZE(mStmI2cDevs))
@@ -48,6 +48,7 @@ struct dmaMode {
     } direction;
 
     bool minc;
+    bool errIrqOnly; // completion is picked up through dmaStatus() instead
 
     uint32_t periphAddr;
     uint8_t channel;
@@ -55,6 +56,9 @@ struct dmaMode {
 
 int dmaStart(uint8_t busId, uint8_t stream, const void *buf, uint16_t size,
         const struct dmaMode *mode, DmaCallbackF callback, void *cookie);
+int dmaRestart(uint8_t busId, uint8_t stream, const void *buf, uint16_t size,
+        bool minc);
+int dmaStatus(uint8_t busId, uint8_t stream);
 uint16_t dmaBytesLeft(uint8_t busId, uint8_t stream);
 void dmaStop(uint8_t busId, uint8_t stream);
 const enum IRQn dmaIrq(uint8_t busId, uint8_t stream);
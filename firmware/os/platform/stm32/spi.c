@@ -90,6 +90,10 @@ struct StmSpiState {
     struct ChainedIsr isrNss;
 
     bool nssChange;
+
+    const struct SpiPacket *packets;
+    size_t n;
+    size_t currentBuf;
 };
 
 struct StmSpiCfg {
@@ -138,7 +142,7 @@ static inline void stmSpiSckPullMode(struct StmSpiDev *pdev, enum StmGpioSpeed s
 
 static inline void stmSpiStartDma(struct StmSpiDev *pdev,
         const struct StmSpiDmaCfg *dmaCfg, const void *buf, uint8_t bitsPerWord,
-        bool minc, size_t size, DmaCallbackF callback, bool rx)
+        bool minc, size_t size, DmaCallbackF callback, bool rx, bool tcIrq)
 {
     struct StmSpi *regs = pdev->cfg->regs;
     struct dmaMode mode;
@@ -157,6 +161,7 @@ static inline void stmSpiStartDma(struct StmSpiDev *pdev,
             DMA_DIRECTION_MEM_TO_PERIPH;
     mode.periphAddr = (uintptr_t)&regs->DR;
     mode.minc = minc;
+    mode.errIrqOnly = !tcIrq;
     mode.channel = dmaCfg->channel;
 
     dmaStart(pdev->cfg->dmaBus, dmaCfg->stream, buf, size, &mode, callback,
@@ -357,7 +362,7 @@ static int stmSpiRxTx(struct SpiDevice *dev, void *rxBuf, const void *txBuf,
 
     if (rxBuf) {
         stmSpiStartDma(pdev, &pdev->board->dmaRx, rxBuf, mode->bitsPerWord,
-                rxMinc, size, stmSpiRxDone, true);
+                rxMinc, size, stmSpiRxDone, true, true);
         cr2 |= SPI_CR2_RXDMAEN;
     } else {
         state->rxDone = true;
@@ -368,7 +373,7 @@ static int stmSpiRxTx(struct SpiDevice *dev, void *rxBuf, const void *txBuf,
         txMinc = false;
     }
     stmSpiStartDma(pdev, &pdev->board->dmaTx, txBuf, mode->bitsPerWord, txMinc,
-            size, stmSpiTxDone, false);
+            size, stmSpiTxDone, false, true);
 
     /* Ensure the TXE and RXNE bits are cleared; otherwise the DMA controller
      * may "receive" the byte sitting in the SPI controller's FIFO right now,
@@ -396,6 +401,152 @@ static int stmSpiRxTx(struct SpiDevice *dev, void *rxBuf, const void *txBuf,
     return 0;
 }
 
+static void stmSpiChainRxDone(void *cookie, uint16_t bytesLeft, int err);
+static void stmSpiChainTxErr(void *cookie, uint16_t bytesLeft, int err);
+
+static int stmSpiChainXfer(struct StmSpiDev *pdev, bool first)
+{
+    struct StmSpi *regs = pdev->cfg->regs;
+    struct StmSpiState *state = &pdev->state;
+    const struct SpiPacket *packet = &state->packets[state->currentBuf];
+    void *rxBuf = packet->rxBuf;
+    const void *txBuf = packet->txBuf;
+    bool rxMinc = true, txMinc = true;
+    int ret;
+
+    /* Same throwaway RX word WAR as stmSpiRxTx(); it also means every packet
+     * completes on the RX stream, so the TX stream only has to interrupt on
+     * a transfer error.
+     */
+    if (!rxBuf) {
+        rxBuf = &state->rxWord;
+        rxMinc = false;
+    }
+
+    if (!txBuf) {
+        txBuf = &state->txWord;
+        txMinc = false;
+    }
+
+    if (first) {
+        stmSpiStartDma(pdev, &pdev->board->dmaRx, rxBuf, state->bitsPerWord,
+                rxMinc, packet->size, stmSpiChainRxDone, true, true);
+        stmSpiStartDma(pdev, &pdev->board->dmaTx, txBuf, state->bitsPerWord,
+                txMinc, packet->size, stmSpiChainTxErr, false, false);
+    } else {
+        ret = dmaRestart(pdev->cfg->dmaBus, pdev->board->dmaRx.stream, rxBuf,
+                packet->size, rxMinc);
+        if (ret)
+            return ret;
+
+        ret = dmaRestart(pdev->cfg->dmaBus, pdev->board->dmaTx.stream, txBuf,
+                packet->size, txMinc);
+        if (ret) {
+            dmaStop(pdev->cfg->dmaBus, pdev->board->dmaRx.stream);
+            return ret;
+        }
+    }
+
+    /* Only select the device once both streams are set up, so that a failed
+     * restart does not leave CS low on the way out.
+     */
+    if (pdev->nss)
+        gpioSet(pdev->nss, 0);
+
+    regs->CR2 = SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+    regs->CR1 |= SPI_CR1_SPE;
+
+    return 0;
+}
+
+static void stmSpiChainDone(struct StmSpiDev *pdev, int err)
+{
+    struct StmSpiState *state = &pdev->state;
+
+    dmaStop(pdev->cfg->dmaBus, pdev->board->dmaRx.stream);
+    dmaStop(pdev->cfg->dmaBus, pdev->board->dmaTx.stream);
+    state->packets = NULL;
+    atomicWriteByte(&state->xferEnable, false);
+
+    if (pdev->board->sleepDev >= 0)
+        platReleaseDevInSleepMode(pdev->board->sleepDev);
+
+    spiMasterRxTxDone(pdev->base, err);
+}
+
+static void stmSpiChainRxDone(void *cookie, uint16_t bytesLeft, int err)
+{
+    struct StmSpiDev *pdev = cookie;
+    struct StmSpi *regs = pdev->cfg->regs;
+    struct StmSpiState *state = &pdev->state;
+
+    regs->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+
+    // the last TX word always goes out before the last RX word comes in
+    if (!err)
+        err = dmaStatus(pdev->cfg->dmaBus, pdev->board->dmaTx.stream);
+
+    while (regs->SR & SPI_SR_BSY)
+        ;
+
+    if (state->nssChange && pdev->nss)
+        gpioSet(pdev->nss, 1);
+
+    if (!err && ++state->currentBuf < state->n) {
+        err = stmSpiChainXfer(pdev, false);
+        if (!err)
+            return;
+    }
+
+    stmSpiChainDone(pdev, err);
+}
+
+/* A TX error stops the clock, so the RX stream would never complete; abort
+ * the batch from here instead.
+ */
+static void stmSpiChainTxErr(void *cookie, uint16_t bytesLeft, int err)
+{
+    struct StmSpiDev *pdev = cookie;
+    struct StmSpi *regs = pdev->cfg->regs;
+    struct StmSpiState *state = &pdev->state;
+
+    regs->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+
+    if (state->nssChange && pdev->nss)
+        gpioSet(pdev->nss, 1);
+
+    stmSpiChainDone(pdev, err);
+}
+
+/* Runs a batch of packets with one DMA completion interrupt per packet (on the
+ * RX stream only) and none of the per-packet trips through the SPI core.  The
+ * F4 DMA cannot chain descriptors and CS has to be toggled between register
+ * accesses anyway, so each following packet is started right from the RX
+ * completion by reloading the two streams.
+ */
+static int stmSpiRxTxChain(struct SpiDevice *dev,
+        const struct SpiPacket packets[], size_t n,
+        const struct SpiMode *mode)
+{
+    struct StmSpiDev *pdev = dev->pdata;
+    struct StmSpiState *state = &pdev->state;
+
+    if (atomicXchgByte(&state->xferEnable, true) == true)
+        return -EBUSY;
+
+    state->packets = packets;
+    state->n = n;
+    state->currentBuf = 0;
+    state->nssChange = mode->nssChange;
+
+    if (pdev->board->sleepDev >= 0)
+        platRequestDevInSleepMode(pdev->board->sleepDev, 12);
+
+    stmSpiChainXfer(pdev, true);
+
+    return 0;
+}
+
 static int stmSpiSlaveIdle(struct SpiDevice *dev, const struct SpiMode *mode)
 {
     struct StmSpiDev *pdev = dev->pdata;
@@ -539,6 +690,7 @@ static int stmSpiRelease(struct SpiDevice *dev)
 const struct SpiDevice_ops mStmSpiOps = {
     .masterStartSync = stmSpiMasterStartSync,
     .masterRxTx = stmSpiRxTx,
+    .masterRxTxChain = stmSpiRxTxChain,
     .masterStopSync = stmSpiMasterStopSync,
 
     .slaveStartSync = stmSpiSlaveStartSync,
@@ -24,6 +24,8 @@ BL_FILE = $(OUT)/bl.unchecked.bin
 OS_FILE = $(OUT)/os.checked.bin
 
 DELIVERABLES += showsizes
+# osLogT() dictionary for the host, see os/inc/logToken.h
+DELIVERABLES += $(OUT)/os.checked.logstr
 FLAGS += -I. -fno-unwind-tables -fstack-reuse=all -ffunction-sections -fdata-sections
 FLAGS += -Wl,--gc-sections -nostartfiles
 FLAGS += -nostdlib
@@ -78,7 +80,10 @@ $(OUT)/bl.%.bin : $(OUT)/bl.%.elf
 	$(OBJCOPY) -j .bl -j .data -j .eedata $(OBJCOPY_PARAMS) $< $@
 
 $(OUT)/os.%.bin : $(OUT)/os.%.elf
-	$(OBJCOPY) -j .data -j .text $(OBJCOPY_PARAMS) $< $@
+	$(OBJCOPY) -j .data -j .text -j .logstr $(OBJCOPY_PARAMS) $< $@
+
+$(OUT)/os.%.logstr : $(OUT)/os.%.elf
+	$(OBJCOPY) -j .logstr $(OBJCOPY_PARAMS) $< $@
 
 showsizes: $(OUT)/os.unchecked.elf
 	os/platform/$(PLATFORM)/misc/showsizes.sh $<
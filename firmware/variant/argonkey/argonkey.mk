@@ -72,6 +72,9 @@ SRCS_os += os/drivers/leds/leds_gpio.c
 # LP3943 LED controller
 SRCS_os += os/drivers/leds/leds_lp3943.c
 
+# Accel aggregation for derived sensors (tilt, window orientation)
+SRCS_os += os/drivers/sensor_agg/sensor_agg.c
+
 # Tilt detection
 SRCS_os += os/drivers/tilt_detection/tilt_detection.c
 
@@ -17,8 +17,12 @@
 #variant makefile for generic linux
 
 
-ifneq ($(PLATFORM),linux)
+ifneq ($(PLATFORM),native)
         $(error "linux variant cannot be build on a platform that is not linux")
 endif
 
 FLAGS += -DHEAP_SIZE=102400           #100K heap
+
+#drivers
+# Trace replay accel/gyro/mag/baro
+SRCS_os += os/drivers/trace_replay/trace_replay.c
@@ -36,6 +36,8 @@ extern "C" {
 
 //enable logging through nanohub driver
 #define DEBUG_LOG_EVT               0x3B474F4C
+//and send osLogT() lines as tokens, see os/inc/logToken.h
+#define LOG_TOKENIZED
 
 #define DEBUG_UART_UNITNO           1
 #define DEBUG_UART_GPIO_TX          GPIO_PA(9)
@@ -62,6 +62,9 @@ SRCS_os += os/drivers/bosch_bmi160/bosch_bmi160.c \
 # Hall effect sensor driver
 SRCS_os += os/drivers/hall/hall.c
 
+# Accel aggregation for derived sensors (tilt, window orientation)
+SRCS_os += os/drivers/sensor_agg/sensor_agg.c
+
 # Tilt detection
 SRCS_os += os/drivers/tilt_detection/tilt_detection.c
 
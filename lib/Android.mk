@@ -54,6 +54,7 @@ LOCAL_SRC_FILES := \
     $(src_files) \
     nanohub/softcrc.c \
     nanohub/nanoapp.c \
+    nanohub/batch.c \
 
 LOCAL_CFLAGS := \
     -DHOST_BUILD \
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _NANOHUB_BATCH_H_
+#define _NANOHUB_BATCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//batch processing of a list of files by a pool of worker threads (host tools only)
+struct BatchOps {
+    //optional; called once in every worker before its first job, returns the ctx passed to job(); arg is used if NULL
+    void *(*workerInit)(void *arg);
+    //optional; called once in every worker after its last job
+    void (*workerExit)(void *ctx);
+    //process one list entry; outName is NULL if the line only names an input. returns 0 on success
+    int (*job)(void *ctx, const char *inName, const char *outName);
+};
+
+//parse the argument of -j; NULL means one thread per online CPU. returns false if arg is not a positive decimal number
+bool batchParseThreads(const char *arg, uint32_t *numThreads);
+
+//every non-empty line of the list file is "<input file> [<output file>]"; lines starting with '#' are ignored.
+//returns 0 if all jobs succeeded, otherwise the return value of one of the failed jobs
+int batchRun(const char *listFile, uint32_t numThreads, const struct BatchOps *ops, void *arg);
+
+#ifdef __cplusplus
+}; /* extern "C" */
+#endif
+
+#endif /* _NANOHUB_BATCH_H_ */
@@ -18,6 +18,7 @@
 #define _NANOHUB_RSA_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define RSA_LEN     2048
 #define RSA_LIMBS   ((RSA_LEN + 31)/ 32)
@@ -43,6 +44,24 @@ const uint32_t* rsaPubOpIterative(struct RsaState* state, const uint32_t *a, con
 const uint32_t* rsaPrivOp(struct RsaState* state, const uint32_t *a, const uint32_t *b, const uint32_t *c);
 const uint32_t* rsaPubOp(struct RsaState* state, const uint32_t *a, const uint32_t *c);
 
+//CRT form of the private key; each component is RSA_LEN / 2 bits long, little-endian limbs
+#define RSA_CRT_LIMBS   (RSA_LIMBS / 2)
+#define RSA_CRT_BYTES   sizeof(uint32_t[RSA_CRT_LIMBS])
+
+struct RsaCrtKey {
+    uint32_t p[RSA_CRT_LIMBS];
+    uint32_t q[RSA_CRT_LIMBS];
+    uint32_t dp[RSA_CRT_LIMBS];   // d mod (p - 1)
+    uint32_t dq[RSA_CRT_LIMBS];   // d mod (q - 1)
+    uint32_t qinv[RSA_CRT_LIMBS]; // q ^ -1 mod p
+};
+
+//check that p * q == c; p and q must both have their top bit set
+bool rsaCrtKeyCheck(const struct RsaCrtKey *key, const uint32_t *c);
+
+//calculate a ^ d mod (p * q) using CRT; same result as rsaPrivOp() with matching key, only faster. result is only valid as long as state is
+const uint32_t* rsaPrivOpCrt(struct RsaState* state, const uint32_t *a, const struct RsaCrtKey *key);
+
 #ifdef ARM
 #error "RSA private ops must never be compiled into firmware."
 #endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <nanohub/batch.h>
+#include <nanohub/nanoapp.h>
+
+struct BatchJob {
+    const char *inName;
+    const char *outName;
+};
+
+struct Batch {
+    pthread_mutex_t lock;
+    const struct BatchJob *jobs;
+    uint32_t numJobs;
+    uint32_t nextJob;
+    int ret;
+    const struct BatchOps *ops;
+    void *arg;
+};
+
+bool batchParseThreads(const char *arg, uint32_t *numThreads)
+{
+    char *end = NULL;
+    unsigned long val;
+    long cpus;
+
+    if (!arg) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        *numThreads = cpus > 0 ? cpus : 1;
+        return true;
+    }
+
+    val = strtoul(arg, &end, 10);
+    if (*end != '\0' || !val || val > UINT32_MAX)
+        return false;
+
+    *numThreads = val;
+    return true;
+}
+
+static void *batchWorker(void *arg)
+{
+    struct Batch *batch = arg;
+    const struct BatchOps *ops = batch->ops;
+    const struct BatchJob *job;
+    void *ctx = ops->workerInit ? ops->workerInit(batch->arg) : batch->arg;
+    int ret;
+
+    while (1) {
+        pthread_mutex_lock(&batch->lock);
+        job = batch->nextJob < batch->numJobs ? &batch->jobs[batch->nextJob++] : NULL;
+        pthread_mutex_unlock(&batch->lock);
+        if (!job)
+            break;
+
+        ret = ops->job(ctx, job->inName, job->outName);
+        fprintf(stderr, "%s: %s (%d)\n", job->inName, ret == 0 ? "success" : "failed", ret);
+
+        if (ret) {
+            pthread_mutex_lock(&batch->lock);
+            batch->ret = ret;
+            pthread_mutex_unlock(&batch->lock);
+        }
+    }
+
+    if (ops->workerExit)
+        ops->workerExit(ctx);
+
+    return NULL;
+}
+
+int batchRun(const char *listFile, uint32_t numThreads, const struct BatchOps *ops, void *arg)
+{
+    struct BatchJob *jobs = NULL;
+    pthread_t *threads;
+    struct Batch batch;
+    uint32_t listSize, numJobs = 0, i;
+    char *list, *line, *linePos = NULL, *tokPos;
+
+    list = loadFile(listFile, &listSize);
+    list = reallocOrDie(list, listSize + 1);
+    list[listSize] = 0;
+
+    for (line = strtok_r(list, "\n", &linePos); line; line = strtok_r(NULL, "\n", &linePos)) {
+        const char *inName = strtok_r(line, " \t\r", &tokPos);
+        if (!inName || inName[0] == '#')
+            continue;
+        jobs = reallocOrDie(jobs, sizeof(*jobs) * (numJobs + 1));
+        jobs[numJobs].inName = inName;
+        jobs[numJobs].outName = strtok_r(NULL, " \t\r", &tokPos);
+        numJobs++;
+    }
+
+    if (numThreads > numJobs)
+        numThreads = numJobs;
+    fprintf(stderr, "Processing %" PRIu32 " files with %" PRIu32 " threads\n", numJobs, numThreads);
+
+    memset(&batch, 0, sizeof(batch));
+    pthread_mutex_init(&batch.lock, NULL);
+    batch.jobs = jobs;
+    batch.numJobs = numJobs;
+    batch.ops = ops;
+    batch.arg = arg;
+
+    threads = reallocOrDie(NULL, sizeof(*threads) * (numThreads ? numThreads : 1));
+    for (i = 0; i < numThreads; i++) {
+        if (pthread_create(&threads[i], NULL, batchWorker, &batch)) {
+            fprintf(stderr, "Failed to start worker thread\n");
+            exit(2);
+        }
+    }
+    for (i = 0; i < numThreads; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&batch.lock);
+    free(threads);
+    free(jobs);
+    free(list);
+
+    return batch.ret;
+}
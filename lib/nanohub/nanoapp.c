@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include <nanohub/nanoapp.h>
 
@@ -71,12 +72,18 @@ void *loadFile(const char *fileName, uint32_t *size)
     uint8_t *dst = NULL;
     uint32_t len = 0, grow = 16384, total = 0;
     uint32_t block;
+    struct stat st;
 
     if (!f) {
         fprintf(stderr, "couldn't open %s: %s\n", fileName, strerror(errno));
         exit(2);
     }
 
+    // for regular files, size the buffer up front so the whole file is read with one allocation;
+    // one extra byte lets the first read hit EOF
+    if (!stat(fileName, &st) && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size < UINT32_MAX)
+        grow = st.st_size + 1;
+
     do {
         len += grow; dst = reallocOrDie(dst, len);
 
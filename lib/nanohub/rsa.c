@@ -274,6 +274,239 @@ const uint32_t* rsaPrivOp(struct RsaState* state, const uint32_t *a, const uint3
 
     return state->tmpA;
 }
+
+/*
+ * CRT private op:
+ * m1 = a ^ dp mod p, m2 = a ^ dq mod q, h = qinv * (m1 - m2) mod p, result = m2 + h * q
+ * Each half exponentiation works on RSA_LEN / 2 bit numbers using Montgomery multiplication
+ * (R = 2 ^ (RSA_LEN / 2)), so it needs no divisions at all. This requires p and q to have
+ * their top bits set, which is always true for RSA_LEN-bit moduli generated by OpenSSL.
+ */
+
+#define CRT_WINDOW_BITS   4
+
+static uint32_t biCrtSub(uint32_t *ret, const uint32_t *a, const uint32_t *b) //ret = a - b, returns borrow
+{
+    int64_t t = 0;
+    uint32_t i;
+
+    for (i = 0; i < RSA_CRT_LIMBS; i++) {
+        t += (uint64_t)a[i];
+        t -= (uint64_t)b[i];
+        ret[i] = t;
+        t >>= 32;
+    }
+
+    return t ? 1 : 0;
+}
+
+static uint32_t biCrtAdd(uint32_t *ret, const uint32_t *a, const uint32_t *b) //ret = a + b, returns carry
+{
+    uint64_t t = 0;
+    uint32_t i;
+
+    for (i = 0; i < RSA_CRT_LIMBS; i++) {
+        t += (uint64_t)a[i] + b[i];
+        ret[i] = t;
+        t >>= 32;
+    }
+
+    return t;
+}
+
+static bool biCrtLess(const uint32_t *a, const uint32_t *b)
+{
+    int32_t i;
+
+    for (i = RSA_CRT_LIMBS - 1; i >= 0; i--) {
+        if (a[i] != b[i])
+            return a[i] < b[i];
+    }
+
+    return false;
+}
+
+static uint32_t montInv(uint32_t m0) //calculate -(m0 ^ -1) mod 2^32 for odd m0
+{
+    uint32_t inv = 1;
+    uint32_t i;
+
+    //newton's iteration doubles the number of correct bits each time
+    for (i = 0; i < 5; i++)
+        inv *= 2 - m0 * inv;
+
+    return -inv;
+}
+
+static void montR2(uint32_t *ret, const uint32_t *m) //ret = R^2 mod m
+{
+    uint32_t i, carry;
+
+    memset(ret, 0, RSA_CRT_BYTES);
+    ret[0] = 1;
+
+    for (i = 0; i < RSA_LEN; i++) {
+        carry = biCrtAdd(ret, ret, ret);
+        if (carry || !biCrtLess(ret, m))
+            biCrtSub(ret, ret, m);
+    }
+}
+
+static void montMul(uint32_t *ret, const uint32_t *a, const uint32_t *b, const uint32_t *m, uint32_t mInv) //ret = a * b / R mod m (CIOS)
+{
+    uint32_t t[RSA_CRT_LIMBS + 2];
+    uint32_t i, j, u;
+    uint64_t r;
+
+    memset(t, 0, sizeof(t));
+
+    for (i = 0; i < RSA_CRT_LIMBS; i++) {
+        r = 0;
+        for (j = 0; j < RSA_CRT_LIMBS; j++) {
+            r = (uint64_t)a[j] * b[i] + t[j] + (r >> 32);
+            t[j] = r;
+        }
+        r = (uint64_t)t[RSA_CRT_LIMBS] + (r >> 32);
+        t[RSA_CRT_LIMBS] = r;
+        t[RSA_CRT_LIMBS + 1] = r >> 32;
+
+        u = t[0] * mInv;
+        r = (uint64_t)u * m[0] + t[0];
+        for (j = 1; j < RSA_CRT_LIMBS; j++) {
+            r = (uint64_t)u * m[j] + t[j] + (r >> 32);
+            t[j - 1] = r;
+        }
+        r = (uint64_t)t[RSA_CRT_LIMBS] + (r >> 32);
+        t[RSA_CRT_LIMBS - 1] = r;
+        t[RSA_CRT_LIMBS] = t[RSA_CRT_LIMBS + 1] + (uint32_t)(r >> 32);
+    }
+
+    if (t[RSA_CRT_LIMBS] || !biCrtLess(t, m))
+        biCrtSub(ret, t, m);
+    else
+        memcpy(ret, t, RSA_CRT_BYTES);
+}
+
+static void biCrtReduce(uint32_t *ret, const uint32_t *a, const uint32_t *m, const uint32_t *r2, uint32_t mInv) //ret = a mod m, a is RSA_LEN bits
+{
+    uint32_t lo[RSA_CRT_LIMBS];
+
+    //a = hi * R + lo; hi * R mod m is a single montgomery multiplication by R^2
+    montMul(ret, a + RSA_CRT_LIMBS, r2, m, mInv);
+
+    //lo < R <= 2 * m, so one subtraction is always enough
+    memcpy(lo, a, RSA_CRT_BYTES);
+    if (!biCrtLess(lo, m))
+        biCrtSub(lo, lo, m);
+
+    if (biCrtAdd(ret, ret, lo) || !biCrtLess(ret, m))
+        biCrtSub(ret, ret, m);
+}
+
+static void montExp(uint32_t *ret, const uint32_t *a, const uint32_t *e, const uint32_t *m) //ret = a ^ e mod m, for a < m
+{
+    uint32_t table[1 << CRT_WINDOW_BITS][RSA_CRT_LIMBS];
+    uint32_t r2[RSA_CRT_LIMBS];
+    uint32_t mInv = montInv(m[0]);
+    int32_t i, j;
+    uint32_t w;
+
+    montR2(r2, m);
+
+    //table[i] = a ^ i in montgomery form; ret may alias a, so do not touch it before table[1] is ready
+    montMul(table[1], a, r2, m, mInv);
+    memset(ret, 0, RSA_CRT_BYTES);
+    ret[0] = 1;
+    montMul(table[0], ret, r2, m, mInv);
+    for (i = 2; i < (1 << CRT_WINDOW_BITS); i++)
+        montMul(table[i], table[i - 1], table[1], m, mInv);
+
+    //fixed window, most significant bits first
+    memcpy(ret, table[0], RSA_CRT_BYTES);
+    for (i = RSA_LEN / 2 - CRT_WINDOW_BITS; i >= 0; i -= CRT_WINDOW_BITS) {
+        for (j = 0; j < CRT_WINDOW_BITS; j++)
+            montMul(ret, ret, ret, m, mInv);
+        w = (e[i / 32] >> (i % 32)) & ((1 << CRT_WINDOW_BITS) - 1);
+        if (w)
+            montMul(ret, ret, table[w], m, mInv);
+    }
+
+    //out of montgomery form
+    memset(r2, 0, RSA_CRT_BYTES);
+    r2[0] = 1;
+    montMul(ret, ret, r2, m, mInv);
+}
+
+static void biCrtMul(uint32_t *ret, const uint32_t *a, const uint32_t *b) //ret = a * b, ret is RSA_LIMBS long
+{
+    uint32_t i, j;
+    uint64_t r;
+
+    memset(ret, 0, RSA_BYTES);
+
+    for (i = 0; i < RSA_CRT_LIMBS; i++) {
+        r = 0;
+        for (j = 0; j < RSA_CRT_LIMBS; j++) {
+            r = (uint64_t)a[i] * b[j] + ret[i + j] + (r >> 32);
+            ret[i + j] = r;
+        }
+        ret[i + RSA_CRT_LIMBS] = r >> 32;
+    }
+}
+
+bool rsaCrtKeyCheck(const struct RsaCrtKey *key, const uint32_t *c)
+{
+    uint32_t n[RSA_LIMBS];
+
+    if (!(key->p[RSA_CRT_LIMBS - 1] & 0x80000000) || !(key->q[RSA_CRT_LIMBS - 1] & 0x80000000))
+        return false;
+
+    biCrtMul(n, key->p, key->q);
+
+    return !memcmp(n, c, RSA_BYTES);
+}
+
+const uint32_t* rsaPrivOpCrt(struct RsaState* state, const uint32_t *a, const struct RsaCrtKey *key)
+{
+    uint32_t m1[RSA_CRT_LIMBS], m2[RSA_CRT_LIMBS], h[RSA_CRT_LIMBS], r2[RSA_CRT_LIMBS];
+    uint32_t mInv;
+    uint64_t t;
+    uint32_t i;
+
+    //m1 = (a mod p) ^ dp mod p
+    mInv = montInv(key->p[0]);
+    montR2(r2, key->p);
+    biCrtReduce(h, a, key->p, r2, mInv);
+    montExp(m1, h, key->dp, key->p);
+
+    //m2 = (a mod q) ^ dq mod q
+    mInv = montInv(key->q[0]);
+    montR2(h, key->q);
+    biCrtReduce(m2, a, key->q, h, mInv);
+    montExp(m2, m2, key->dq, key->q);
+
+    //h = qinv * (m1 - m2) mod p; m2 < q < 2 * p
+    mInv = montInv(key->p[0]);
+    memcpy(h, m2, RSA_CRT_BYTES);
+    if (!biCrtLess(h, key->p))
+        biCrtSub(h, h, key->p);
+    if (biCrtSub(h, m1, h))
+        biCrtAdd(h, h, key->p);
+    montMul(h, h, key->qinv, key->p, mInv);
+    montMul(h, h, r2, key->p, mInv);
+
+    //result = m2 + h * q
+    memset(state->tmpA, 0, RSA_BYTES * 2);
+    biCrtMul(state->tmpA, h, key->q);
+    t = 0;
+    for (i = 0; i < RSA_LIMBS; i++) {
+        t += (uint64_t)state->tmpA[i] + (i < RSA_CRT_LIMBS ? m2[i] : 0);
+        state->tmpA[i] = t;
+        t >>= 32;
+    }
+
+    return state->tmpA;
+}
 #endif
 
 
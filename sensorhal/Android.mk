@@ -176,6 +176,89 @@ LOCAL_SHARED_LIBRARIES := \
 
 include $(BUILD_SHARED_LIBRARY)
 
+################################################################################
+#
+# Replays nanohub captures through the HAL above; see replaybench.cpp.
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := nanohub_replaybench
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_OWNER := google
+LOCAL_PROPRIETARY_MODULE := true
+
+LOCAL_CFLAGS += $(COMMON_CFLAGS)
+
+LOCAL_C_INCLUDES += \
+    device/google/contexthub/firmware/os/inc \
+    device/google/contexthub/util/common
+
+LOCAL_SRC_FILES := \
+    replaybench.cpp
+
+LOCAL_HEADER_LIBRARIES := \
+    libhardware_headers
+
+LOCAL_STATIC_LIBRARIES := \
+    libhubutilcommon
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libhardware \
+    libhubconnection \
+    liblog \
+    libstagefright_foundation \
+    libutils
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+#
+# The same replay on the build host: the HAL, HubConnection and the device's
+# sensor list are linked in, and hoststub/ replaces libhardware_legacy.
+# Lid state, USB mag bias and double touch stay off, so neither uinput nor
+# their sysfs nodes are touched.
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := nanohub_replaybench_host
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS += $(COMMON_CFLAGS) -DREPLAYBENCH_LINKED_HAL
+
+LOCAL_C_INCLUDES += \
+    device/google/contexthub/firmware/os/inc \
+    device/google/contexthub/util/common \
+    device/google/contexthub/sensorhal/hoststub
+
+LOCAL_SRC_FILES := \
+    replaybench.cpp \
+    sensors.cpp \
+    hubconnection.cpp \
+    directchannel.cpp \
+    ../util/common/capturefile.cpp \
+    ../util/common/file.cpp \
+    ../util/common/JSONObject.cpp \
+    ../util/common/logtokendict.cpp \
+    ../util/common/ring.cpp \
+    ../../../../$(NANOHUB_SENSORHAL_SENSORLIST)
+
+LOCAL_HEADER_LIBRARIES := \
+    libhardware_headers \
+    libstagefright_foundation_headers \
+    libstagefright_headers \
+    libutils_headers
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    liblog \
+    libstagefright_foundation \
+    libutils
+
+include $(BUILD_HOST_EXECUTABLE)
+
 ################################################################################
 
 endif
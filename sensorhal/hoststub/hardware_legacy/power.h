@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HOSTSTUB_HARDWARE_LEGACY_POWER_H_
+
+#define HOSTSTUB_HARDWARE_LEGACY_POWER_H_
+
+/*
+ * Stands in for libhardware_legacy's power.h in the host build of
+ * nanohub_replaybench. There, HubConnection reads a socket handed to it
+ * through useDeviceFd() instead of /dev/nanohub, and there is no kernel wake
+ * lock to hold while it does.
+ */
+
+enum {
+    PARTIAL_WAKE_LOCK = 1,
+    FULL_WAKE_LOCK = 2
+};
+
+static inline int acquire_wake_lock(int /* lock */, const char * /* id */) {
+    return 0;
+}
+
+static inline int release_wake_lock(const char * /* id */) {
+    return 0;
+}
+
+#endif  // HOSTSTUB_HARDWARE_LEGACY_POWER_H_
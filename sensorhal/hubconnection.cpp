@@ -52,6 +52,7 @@
 #define SENS_TYPE_TO_EVENT(_sensorType) (EVT_NO_FIRST_SENSOR_EVENT + (_sensorType))
 
 #define NANOHUB_FILE_PATH       "/dev/nanohub"
+#define NANOHUB_LOGSTR_PATH     "/vendor/firmware/nanohub.logstr"
 #define NANOHUB_LOCK_DIR        "/data/vendor/sensor/nanohub_lock"
 #define NANOHUB_LOCK_FILE       NANOHUB_LOCK_DIR "/lock"
 #define MAG_BIAS_FILE_PATH      "/sys/class/power_supply/battery/compass_compensation"
@@ -89,6 +90,9 @@ Mutex HubConnection::sInstanceLock;
 // static
 HubConnection *HubConnection::sInstance = NULL;
 
+// static
+int HubConnection::sDeviceFd = -1;
+
 HubConnection *HubConnection::getInstance()
 {
     Mutex::Autolock autoLock(sInstanceLock);
@@ -98,6 +102,45 @@ HubConnection *HubConnection::getInstance()
     return sInstance;
 }
 
+void HubConnection::useDeviceFd(int fd)
+{
+    Mutex::Autolock autoLock(sInstanceLock);
+    if (sInstance != NULL) {
+        ALOGW("useDeviceFd: too late, already connected");
+        return;
+    }
+    sDeviceFd = fd;
+}
+
+void HubConnection::getStats(Stats *stats) const
+{
+    stats->pollWakeups = mPollWakeups;
+    stats->bytesRead = mBytesRead;
+    stats->lockAcquired = mLockAcquired;
+    stats->lockContended = mLockContended;
+}
+
+// Mutex::Autolock that also counts how often the lock was found taken
+class CountingAutolock {
+public:
+    CountingAutolock(Mutex &lock, std::atomic<uint64_t> &acquired,
+            std::atomic<uint64_t> &contended)
+        : mLock(lock) {
+        if (mLock.tryLock() != NO_ERROR) {
+            contended++;
+            mLock.lock();
+        }
+        acquired++;
+    }
+
+    ~CountingAutolock() {
+        mLock.unlock();
+    }
+
+private:
+    Mutex &mLock;
+};
+
 static bool isActivitySensor(int sensorIndex) {
     return sensorIndex >= COMMS_SENSOR_ACTIVITY_FIRST
         && sensorIndex <= COMMS_SENSOR_ACTIVITY_LAST;
@@ -125,7 +168,11 @@ HubConnection::HubConnection()
       mScaleAccel(1.0f),
       mScaleMag(1.0f),
       mStepCounterOffset(0ull),
-      mLastStepCount(0ull)
+      mLastStepCount(0ull),
+      mPollWakeups(0ull),
+      mBytesRead(0ull),
+      mLockAcquired(0ull),
+      mLockContended(0ull)
 {
     mMagBias[0] = mMagBias[1] = mMagBias[2] = 0.0f;
     mMagAccuracy = SENSOR_STATUS_UNRELIABLE;
@@ -141,7 +188,7 @@ HubConnection::HubConnection()
     mLefty.hub = false;
 
     memset(&mSensorState, 0x00, sizeof(mSensorState));
-    mFd = open(NANOHUB_FILE_PATH, O_RDWR);
+    mFd = sDeviceFd >= 0 ? sDeviceFd : open(NANOHUB_FILE_PATH, O_RDWR);
     mPollFds[0].fd = mFd;
     mPollFds[0].events = POLLIN;
     mPollFds[0].revents = 0;
@@ -151,6 +198,9 @@ HubConnection::HubConnection()
     mWakeEventCount = 0;
     mWriteFailures = 0;
 
+    // only needed to read tokenized hub logs; those print raw without it
+    mLogTokenDict.load(NANOHUB_LOGSTR_PATH);
+
     initNanohubLock();
 
 #ifdef USB_MAG_BIAS_REPORTING_ENABLED
@@ -1078,34 +1128,46 @@ void HubConnection::restoreSensorState()
     }
 }
 
-void HubConnection::postOsLog(uint8_t *buf, ssize_t len)
+static void postOsLogLine(char level, const char *msg)
 {
-    // if len is less than 6, it's either an invalid or an empty log message.
-    if (len < 6)
-        return;
-
-    buf[len] = 0x00;
-    switch (buf[4]) {
+    switch (level) {
     case 'E':
-        ALOGE("osLog: %s", &buf[5]);
+        ALOGE("osLog: %s", msg);
         break;
     case 'W':
-        ALOGW("osLog: %s", &buf[5]);
+        ALOGW("osLog: %s", msg);
         break;
     case 'I':
-        ALOGI("osLog: %s", &buf[5]);
+        ALOGI("osLog: %s", msg);
         break;
     case 'D':
-        ALOGD("osLog: %s", &buf[5]);
+        ALOGD("osLog: %s", msg);
         break;
     case 'V':
-        ALOGV("osLog: %s", &buf[5]);
+        ALOGV("osLog: %s", msg);
         break;
     default:
         break;
     }
 }
 
+void HubConnection::postOsLog(uint8_t *buf, ssize_t len)
+{
+    // if len is less than 6, it's either an invalid or an empty log message.
+    if (len < 6)
+        return;
+
+    if (buf[4] == LOG_TOKEN_MARK) {
+        mLogTokenDict.decode(&buf[5], len - 5, [](char level, const std::string &text) {
+            postOsLogLine(level, text.c_str());
+        });
+        return;
+    }
+
+    buf[len] = 0x00;
+    postOsLogLine(buf[4], (const char *)&buf[5]);
+}
+
 void HubConnection::processAppData(uint8_t *buf, ssize_t len) {
     if (len < static_cast<ssize_t>(sizeof(AppToSensorHalDataBuffer)))
         return;
@@ -1595,6 +1657,7 @@ bool HubConnection::threadLoop() {
         do {
             ret = poll(mPollFds, mNumPollFds, -1);
         } while (ret < 0 && errno == EINTR);
+        mPollWakeups++;
 
         if (mInotifyPollIndex >= 0 && mPollFds[mInotifyPollIndex].revents & POLLIN) {
             discardInotifyEvent();
@@ -1630,6 +1693,7 @@ bool HubConnection::threadLoop() {
             ssize_t len = ::read(mFd, recv, sizeof(recv));
 
             if (len >= 0) {
+                mBytesRead += len;
                 for (ssize_t offset = 0; offset < len;) {
                     ret = processBuf(recv + offset, len - offset);
 
@@ -1904,7 +1968,7 @@ void HubConnection::initNanohubLock() {
 ssize_t HubConnection::read(sensors_event_t *ev, size_t size) {
     ssize_t n = mRing.read(ev, size);
 
-    Mutex::Autolock autoLock(mLock);
+    CountingAutolock autoLock(mLock, mLockAcquired, mLockContended);
 
     // We log the first failure in write, so only log 2+ errors
     if (mWriteFailures > 1) {
@@ -1923,7 +1987,7 @@ ssize_t HubConnection::read(sensors_event_t *ev, size_t size) {
 ssize_t HubConnection::write(const sensors_event_t *ev, size_t n) {
     ssize_t ret = 0;
 
-    Mutex::Autolock autoLock(mLock);
+    CountingAutolock autoLock(mLock, mLockAcquired, mLockContended);
 
     for (size_t i=0; i<n; i++) {
         if (mRing.write(&ev[i], 1) == 1) {
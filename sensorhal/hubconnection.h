@@ -27,6 +27,7 @@
 #include <utils/Mutex.h>
 #include <utils/Thread.h>
 
+#include <atomic>
 #include <list>
 
 #include "activityeventhandler.h"
@@ -34,6 +35,7 @@
 #include "eventnums.h"
 #include "halIntf.h"
 #include "hubdefs.h"
+#include "logtokendict.h"
 #include "ring.h"
 
 #include <unordered_map>
@@ -54,6 +56,19 @@ namespace android {
 struct HubConnection : public Thread {
     static HubConnection *getInstance();
 
+    // Talk to fd instead of opening NANOHUB_FILE_PATH; only for replay and
+    // benchmark harnesses, and only before the first getInstance().
+    static void useDeviceFd(int fd);
+
+    struct Stats {
+        uint64_t pollWakeups;    // poll() returns in threadLoop
+        uint64_t bytesRead;      // bytes read from the nanohub fd
+        uint64_t lockAcquired;   // mLock taken by read()/write()
+        uint64_t lockContended;  // ... of which had to wait for the other side
+    };
+
+    void getStats(Stats *stats) const;
+
     status_t initCheck() const;
 
     enum ProximitySensorType {
@@ -233,6 +248,7 @@ private:
 
     static Mutex sInstanceLock;
     static HubConnection *sInstance;
+    static int sDeviceFd;
 
     // This lock is used for synchronization between the write thread (from
     // sensorservice) and the read thread polling from the nanohub driver.
@@ -263,6 +279,11 @@ private:
 
     int mFd;
     int mInotifyPollIndex;
+    std::atomic<uint64_t> mPollWakeups;
+    std::atomic<uint64_t> mBytesRead;
+    std::atomic<uint64_t> mLockAcquired;
+    std::atomic<uint64_t> mLockContended;
+    LogTokenDict mLogTokenDict;
     struct pollfd mPollFds[4];
     int mNumPollFds;
 
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays captured nanohub reads into the sensor HAL and reports how it coped.
+ *
+ * The HAL is loaded as sensorservice would load it, but HubConnection talks
+ * to one end of a SOCK_SEQPACKET socketpair instead of /dev/nanohub (see
+ * HubConnection::useDeviceFd()). nanohub_replaybench_host links the HAL in
+ * instead, with the wake lock calls stubbed out (hoststub/), so the same
+ * replay runs on the build host as a Linux benchmark. Every sensor in the list is enabled at its
+ * fastest rate, then the capture is written to the other end, back to back
+ * unless an interval is given, while a second thread drains events through
+ * the device's poll(), i.e. SensorContext::poll.
+ *
+ * The capture is either a nanotool capture file (nanotool --record, see
+ * capturefile.h) or a plain sequence of records, each a uint32_t length
+ * followed by that many bytes, exactly as one read() of /dev/nanohub returned
+ * them. Captured host times are not used for pacing; see -i.
+ *
+ * To attribute every event to the record it came from, the referenceTime of
+ * sensor data records is rewritten to (record number << kSeqShift); samples
+ * in a record keep their captured deltas, which stay well below 1 << kSeqShift.
+ */
+
+#include "hubconnection.h"
+
+#include "capturefile.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/hardware.h>
+#include <hardware/sensors.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace android;
+
+#ifdef REPLAYBENCH_LINKED_HAL
+extern struct sensors_module_t HAL_MODULE_INFO_SYM;
+#endif
+
+namespace {
+
+const int kSeqShift = 36;           // ~68s of sample deltas per record
+const size_t kMaxRecord = 256;      // HubConnection::threadLoop() read size
+const size_t kPollEvents = 64;
+
+struct Record {
+    std::vector<uint8_t> data;
+    bool stamp;
+};
+
+struct Options {
+    const char *path = nullptr;
+    int loops = 1;
+    useconds_t intervalUs = 0;
+    double minEventsPerSec = 0.0;
+};
+
+int64_t nowNs() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+bool isSensorData(uint32_t evtType) {
+    return evtType >= EVT_NO_FIRST_SENSOR_EVENT && evtType < EVT_NO_SENSOR_CONFIG_EVENT;
+}
+
+bool addRecord(const char *path, const uint8_t *data, uint32_t len,
+               std::vector<Record> *records) {
+    uint32_t evtType;
+    Record rec;
+
+    if (len > kMaxRecord || len < sizeof(evtType)) {
+        fprintf(stderr, "%s: skipping record %zu of %" PRIu32 " bytes\n",
+                path, records->size(), len);
+        return false;
+    }
+
+    memcpy(&evtType, data, sizeof(evtType));
+    rec.data.assign(data, data + len);
+    rec.stamp = isSensorData(evtType)
+            && len >= sizeof(evtType) + sizeof(uint64_t) + sizeof(uint32_t);
+    records->push_back(std::move(rec));
+
+    return true;
+}
+
+bool loadCaptureFile(const char *path, std::vector<Record> *records) {
+    CaptureReader capture;
+    status_t err = capture.open(path);
+
+    if (err != OK) {
+        fprintf(stderr, "%s: %s\n", path, strerror(-err));
+        return false;
+    }
+
+    capture.forEach(0, UINT64_MAX, ~0ull,
+            [path, records](uint64_t, const uint8_t *data, size_t len) {
+                addRecord(path, data, len, records);
+                return true;
+            });
+
+    return !records->empty();
+}
+
+bool loadCapture(const char *path, std::vector<Record> *records) {
+    FILE *f = fopen(path, "rb");
+    std::vector<uint8_t> data;
+    uint32_t len;
+
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    // no plain record is anywhere near that long, so the magic can't be one
+    if (fread(&len, sizeof(len), 1, f) == 1 && len == CAPTURE_FILE_MAGIC) {
+        fclose(f);
+        return loadCaptureFile(path, records);
+    }
+    rewind(f);
+
+    while (fread(&len, sizeof(len), 1, f) == 1) {
+        data.resize(len);
+        if (len && fread(data.data(), len, 1, f) != 1) {
+            fprintf(stderr, "%s: truncated record %zu\n", path, records->size());
+            break;
+        }
+        addRecord(path, data.data(), len, records);
+    }
+
+    fclose(f);
+    return !records->empty();
+}
+
+// the HAL's commands go nowhere; reading them keeps sendCmd() from blocking
+void drainCommands(int fd) {
+    uint8_t buf[512];
+
+    while (::read(fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+int64_t percentile(const std::vector<int64_t> &sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-n loops] [-i interval_us] [-m min_events_per_sec] capture\n"
+            "  -n  replay the capture this many times (default 1)\n"
+            "  -i  wait this long between records (default 0: as fast as possible)\n"
+            "  -m  exit with 1 if fewer events per second than this reach poll()\n",
+            name);
+}
+
+bool parseOptions(int argc, char **argv, Options *opts) {
+    int c;
+
+    while ((c = getopt(argc, argv, "n:i:m:h")) != -1) {
+        switch (c) {
+        case 'n':
+            opts->loops = atoi(optarg);
+            break;
+        case 'i':
+            opts->intervalUs = atoi(optarg);
+            break;
+        case 'm':
+            opts->minEventsPerSec = atof(optarg);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (optind != argc - 1 || opts->loops < 1)
+        return false;
+    opts->path = argv[optind];
+
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options opts;
+    std::vector<Record> records;
+    const struct sensors_module_t *module;
+    struct sensors_poll_device_1 *dev;
+    struct sensor_t const *list;
+    int sv[2];
+
+    if (!parseOptions(argc, argv, &opts)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!loadCapture(opts.path, &records)) {
+        fprintf(stderr, "%s: no records\n", opts.path);
+        return 2;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        perror("socketpair");
+        return 2;
+    }
+
+    HubConnection::useDeviceFd(sv[0]);
+
+#ifdef REPLAYBENCH_LINKED_HAL
+    module = &HAL_MODULE_INFO_SYM;
+    if (sensors_open_1(&module->common, &dev) != 0) {
+#else
+    if (hw_get_module(SENSORS_HARDWARE_MODULE_ID, (const hw_module_t **)&module) != 0
+            || sensors_open_1(&module->common, &dev) != 0) {
+#endif
+        fprintf(stderr, "could not open the sensor HAL\n");
+        return 2;
+    }
+
+    std::thread drainer(drainCommands, sv[1]);
+
+    int numSensors = module->get_sensors_list(const_cast<sensors_module_t *>(module), &list);
+    for (int i = 0; i < numSensors; i++) {
+        uint32_t mode = list[i].flags & REPORTING_MODE_MASK;
+
+        if (mode == SENSOR_FLAG_ONE_SHOT_MODE || mode == SENSOR_FLAG_SPECIAL_REPORTING_MODE)
+            continue;
+        dev->batch(dev, list[i].handle, 0, (int64_t)std::max(list[i].minDelay, 0) * 1000, 0);
+        dev->activate(&dev->v0, list[i].handle, 1);
+    }
+
+    size_t total = records.size() * opts.loops;
+    std::vector<std::atomic<int64_t>> writeTime(total);
+    std::vector<int64_t> latency;
+    uint64_t pollCalls = 0, events = 0;
+    std::atomic<bool> done(false);
+    HubConnection::Stats before, after;
+
+    sp<HubConnection> hub = HubConnection::getInstance();
+    hub->getStats(&before);
+
+    latency.reserve(total * 4);
+
+    // the sentinel is queued behind the last replayed event, so seeing it
+    // means everything the HAL made of the capture has been read
+    std::thread poller([&]() {
+        sensors_event_t buf[kPollEvents];
+
+        while (!done) {
+            int n = dev->poll(&dev->v0, buf, kPollEvents);
+            int64_t t = nowNs();
+
+            pollCalls++;
+            for (int i = 0; i < n; i++) {
+                if (buf[i].type == SENSOR_TYPE_META_DATA) {
+                    if (buf[i].meta_data.sensor == -1)
+                        done = true;
+                    continue;
+                }
+
+                uint64_t seq = (uint64_t)buf[i].timestamp >> kSeqShift;
+                events++;
+                int64_t sent = seq < total ? writeTime[seq].load() : 0;
+                if (sent)
+                    latency.push_back(t - sent);
+            }
+        }
+    });
+
+    uint64_t bytes = 0;
+    bool sendFailed = false;
+    int64_t start = nowNs();
+
+    for (size_t seq = 0; seq < total; seq++) {
+        Record &rec = records[seq % records.size()];
+
+        if (rec.stamp) {
+            uint64_t referenceTime = (uint64_t)seq << kSeqShift;
+            memcpy(rec.data.data() + sizeof(uint32_t), &referenceTime, sizeof(referenceTime));
+        }
+
+        writeTime[seq].store(nowNs());
+        if (send(sv[1], rec.data.data(), rec.data.size(), 0) < 0) {
+            perror("send");
+            sendFailed = true;
+            break;
+        }
+        bytes += rec.data.size();
+
+        if (opts.intervalUs)
+            usleep(opts.intervalUs);
+    }
+
+    // wait for the HAL thread to consume it all before queueing the sentinel;
+    // after a failed send() this still runs, so the poller can be joined
+    do {
+        hub->getStats(&after);
+        if (after.bytesRead - before.bytesRead < bytes)
+            usleep(1000);
+    } while (after.bytesRead - before.bytesRead < bytes);
+
+    sensors_event_t sentinel;
+    memset(&sentinel, 0, sizeof(sentinel));
+    sentinel.version = META_DATA_VERSION;
+    sentinel.type = SENSOR_TYPE_META_DATA;
+    sentinel.meta_data.what = META_DATA_FLUSH_COMPLETE;
+    sentinel.meta_data.sensor = -1;
+    hub->write(&sentinel, 1);
+
+    poller.join();
+    int64_t elapsed = nowNs() - start;
+    hub->getStats(&after);
+
+    // leave the HAL and its threads to process exit; closing the socket
+    // would only make HubConnection spin on a dead fd
+    drainer.detach();
+
+    if (sendFailed)
+        return 2;
+
+    std::sort(latency.begin(), latency.end());
+
+    double secs = elapsed / 1e9;
+    double eventsPerSec = events / secs;
+    uint64_t acquired = after.lockAcquired - before.lockAcquired;
+    uint64_t contended = after.lockContended - before.lockContended;
+    uint64_t wakeups = after.pollWakeups - before.pollWakeups;
+
+    printf("records:           %zu (%" PRIu64 " bytes) in %.3f s\n", total, bytes, secs);
+    printf("events:            %" PRIu64 " (%.0f/s)\n", events, eventsPerSec);
+    printf("latency us:        p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           percentile(latency, 0.50) / 1e3, percentile(latency, 0.90) / 1e3,
+           percentile(latency, 0.99) / 1e3, percentile(latency, 0.999) / 1e3,
+           latency.empty() ? 0.0 : latency.back() / 1e3);
+    printf("poll() calls:      %" PRIu64 " (%.1f events/call)\n",
+           pollCalls, pollCalls ? (double)events / pollCalls : 0.0);
+    printf("HAL wakeups:       %" PRIu64 " (%.1f records/wakeup)\n",
+           wakeups, wakeups ? (double)total / wakeups : 0.0);
+    printf("lock contended:    %" PRIu64 " of %" PRIu64 " (%.2f%%)\n",
+           contended, acquired, acquired ? 100.0 * contended / acquired : 0.0);
+
+    if (opts.minEventsPerSec > 0.0 && eventsPerSec < opts.minEventsPerSec) {
+        fprintf(stderr, "FAIL: %.0f events/s is below %.0f\n", eventsPerSec, opts.minEventsPerSec);
+        return 1;
+    }
+
+    return 0;
+}
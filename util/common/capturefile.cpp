@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "capturefile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace android {
+
+// From eventnums.h
+#define EVT_NO_FIRST_SENSOR_EVENT   0x00000200
+#define EVT_NO_SENSOR_CONFIG_EVENT  0x00000300
+
+// Chunk buffers kept around for reuse once written
+static const size_t kMaxFreeChunks = 4;
+
+unsigned captureRecordType(const uint8_t *data, size_t len) {
+    uint32_t evtType;
+
+    if (len < sizeof(evtType)) {
+        return CAPTURE_TYPE_OTHER;
+    }
+
+    memcpy(&evtType, data, sizeof(evtType));
+    if (evtType >= EVT_NO_FIRST_SENSOR_EVENT && evtType < EVT_NO_SENSOR_CONFIG_EVENT
+            && evtType - EVT_NO_FIRST_SENSOR_EVENT < 64) {
+        return evtType - EVT_NO_FIRST_SENSOR_EVENT;
+    }
+
+    return CAPTURE_TYPE_OTHER;
+}
+
+uint64_t captureNow() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* CaptureWriter **************************************************************/
+
+CaptureWriter::CaptureWriter()
+    : mInitCheck(NO_INIT),
+      mFd(-1),
+      mBacklog(0),
+      mStop(false),
+      mWriteError(OK) {
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+status_t CaptureWriter::open(const char *path) {
+    CaptureFileHeader header;
+    struct timespec ts;
+
+    close();
+
+    mFd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd < 0) {
+        mInitCheck = -errno;
+        return mInitCheck;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_FILE_MAGIC;
+    header.version = CAPTURE_FILE_VERSION;
+    header.headerSize = sizeof(header);
+    header.startTime = captureNow();
+    header.startRealtime = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+    mInitCheck = writeAll(&header, sizeof(header));
+    if (mInitCheck != OK) {
+        ::close(mFd);
+        mFd = -1;
+        return mInitCheck;
+    }
+
+    memset(&mStats, 0, sizeof(mStats));
+    mStats.bytes = sizeof(header);
+    mIndex.clear();
+    mBacklog = 0;
+    mStop = false;
+    mWriteError = OK;
+
+    startChunk();
+    mThread = std::thread(&CaptureWriter::writerLoop, this);
+
+    return OK;
+}
+
+status_t CaptureWriter::initCheck() const {
+    return mInitCheck;
+}
+
+void CaptureWriter::append(uint64_t time, const void *data, size_t len) {
+    CaptureRecordHeader rec;
+
+    if (mInitCheck != OK) {
+        return;
+    }
+
+    if (mChunkHeader.recordCount
+            && (mChunk.size() + sizeof(rec) + len > kChunkSize
+                || time - mChunkHeader.firstTime >= kChunkSpan)) {
+        sealChunk();
+    }
+
+    rec.time = time;
+    rec.len = len;
+    mChunk.insert(mChunk.end(), (const uint8_t *)&rec, (const uint8_t *)&rec + sizeof(rec));
+    mChunk.insert(mChunk.end(), (const uint8_t *)data, (const uint8_t *)data + len);
+
+    if (!mChunkHeader.recordCount++) {
+        mChunkHeader.firstTime = time;
+    }
+    mChunkHeader.lastTime = time;
+    mChunkHeader.typeMask |= 1ull << captureRecordType((const uint8_t *)data, len);
+}
+
+void CaptureWriter::flush() {
+    if (mInitCheck == OK) {
+        sealChunk();
+    }
+}
+
+status_t CaptureWriter::close() {
+    CaptureFileFooter footer;
+    status_t err;
+
+    if (mInitCheck != OK) {
+        return mInitCheck;
+    }
+
+    sealChunk();
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStop = true;
+    }
+    mCond.notify_one();
+    mThread.join();
+
+    err = mWriteError;
+    if (err == OK) {
+        footer.indexOffset = mStats.bytes;
+        footer.chunkCount = mIndex.size();
+        footer.magic = CAPTURE_INDEX_MAGIC;
+
+        err = writeAll(mIndex.data(), mIndex.size() * sizeof(CaptureIndexEntry));
+        if (err == OK) {
+            err = writeAll(&footer, sizeof(footer));
+        }
+    }
+
+    ::close(mFd);
+    mFd = -1;
+    mInitCheck = NO_INIT;
+
+    return err;
+}
+
+void CaptureWriter::getStats(Stats *stats) {
+    std::lock_guard<std::mutex> lock(mLock);
+    *stats = mStats;
+}
+
+void CaptureWriter::startChunk() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mFree.empty()) {
+            mChunk = std::move(mFree.back());
+            mFree.pop_back();
+        }
+    }
+
+    mChunk.reserve(kChunkSize);
+    mChunk.resize(sizeof(CaptureChunkHeader));
+    memset(&mChunkHeader, 0, sizeof(mChunkHeader));
+}
+
+void CaptureWriter::sealChunk() {
+    if (!mChunkHeader.recordCount) {
+        return;
+    }
+
+    mChunkHeader.magic = CAPTURE_CHUNK_MAGIC;
+    mChunkHeader.size = mChunk.size() - sizeof(mChunkHeader);
+    memcpy(mChunk.data(), &mChunkHeader, sizeof(mChunkHeader));
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mBacklog += mChunk.size();
+        mStats.maxBacklog = std::max(mStats.maxBacklog, mBacklog);
+        mStats.records += mChunkHeader.recordCount;
+        mQueue.push_back(std::move(mChunk));
+    }
+    mCond.notify_one();
+
+    startChunk();
+}
+
+void CaptureWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    CaptureIndexEntry entry;
+    CaptureChunkHeader header;
+    status_t err;
+
+    for (;;) {
+        mCond.wait(lock, [this] { return mStop || !mQueue.empty(); });
+        if (mQueue.empty()) {
+            break;
+        }
+
+        std::vector<uint8_t> chunk = std::move(mQueue.front());
+        mQueue.pop_front();
+
+        // a failed write leaves the file ending on the last good chunk
+        lock.unlock();
+        err = (mWriteError == OK) ? writeAll(chunk.data(), chunk.size()) : mWriteError;
+        lock.lock();
+
+        if (err == OK) {
+            memcpy(&header, chunk.data(), sizeof(header));
+            memset(&entry, 0, sizeof(entry));
+            entry.offset = mStats.bytes;
+            entry.firstTime = header.firstTime;
+            entry.lastTime = header.lastTime;
+            entry.typeMask = header.typeMask;
+            entry.recordCount = header.recordCount;
+            mIndex.push_back(entry);
+
+            mStats.bytes += chunk.size();
+            mStats.chunks++;
+        }
+        mWriteError = err;
+        mBacklog -= chunk.size();
+
+        if (mFree.size() < kMaxFreeChunks) {
+            chunk.clear();
+            mFree.push_back(std::move(chunk));
+        }
+    }
+}
+
+status_t CaptureWriter::writeAll(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = ::write(mFd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        p += n;
+        len -= n;
+    }
+
+    return OK;
+}
+
+/* CaptureReader **************************************************************/
+
+CaptureReader::CaptureReader()
+    : mInitCheck(NO_INIT),
+      mData(nullptr),
+      mSize(0) {
+}
+
+CaptureReader::~CaptureReader() {
+    if (mData) {
+        munmap(const_cast<uint8_t *>(mData), mSize);
+    }
+}
+
+status_t CaptureReader::open(const char *path) {
+    struct stat st;
+    void *addr;
+    int fd;
+
+    fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        mInitCheck = -errno;
+        return mInitCheck;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        mInitCheck = -errno;
+        ::close(fd);
+        return mInitCheck;
+    }
+
+    if ((size_t)st.st_size < sizeof(CaptureFileHeader)) {
+        ::close(fd);
+        mInitCheck = BAD_VALUE;
+        return mInitCheck;
+    }
+
+    addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        mInitCheck = -errno;
+        return mInitCheck;
+    }
+
+    mData = (const uint8_t *)addr;
+    mSize = st.st_size;
+
+    const CaptureFileHeader &hdr = header();
+    if (hdr.magic != CAPTURE_FILE_MAGIC || hdr.version != CAPTURE_FILE_VERSION
+            || hdr.headerSize < sizeof(CaptureFileHeader) || hdr.headerSize > mSize) {
+        mInitCheck = BAD_VALUE;
+        return mInitCheck;
+    }
+
+    // a capture that wasn't closed has no index; rebuild it
+    if (!loadIndex()) {
+        scanChunks();
+    }
+
+    mInitCheck = OK;
+    return mInitCheck;
+}
+
+status_t CaptureReader::initCheck() const {
+    return mInitCheck;
+}
+
+const CaptureFileHeader &CaptureReader::header() const {
+    return *(const CaptureFileHeader *)mData;
+}
+
+const std::vector<CaptureIndexEntry> &CaptureReader::chunks() const {
+    return mIndex;
+}
+
+void CaptureReader::forEach(uint64_t from, uint64_t to, uint64_t typeMask,
+        const RecordFunc &func) const {
+    CaptureRecordHeader rec;
+
+    // chunks are in time order; find the first that could hold <from>
+    auto it = std::lower_bound(mIndex.begin(), mIndex.end(), from,
+            [](const CaptureIndexEntry &entry, uint64_t time) {
+                return entry.lastTime < time;
+            });
+
+    for (; it != mIndex.end() && it->firstTime < to; ++it) {
+        if (!(it->typeMask & typeMask)) {
+            continue;
+        }
+
+        const CaptureChunkHeader *chunk = (const CaptureChunkHeader *)(mData + it->offset);
+        const uint8_t *p = (const uint8_t *)(chunk + 1);
+        const uint8_t *end = p + chunk->size;
+
+        while (p + sizeof(rec) <= end) {
+            memcpy(&rec, p, sizeof(rec));
+            p += sizeof(rec);
+            if (rec.len > (size_t)(end - p) || rec.time >= to) {
+                break;
+            }
+
+            if (rec.time >= from && (typeMask & (1ull << captureRecordType(p, rec.len)))
+                    && !func(rec.time, p, rec.len)) {
+                return;
+            }
+            p += rec.len;
+        }
+    }
+}
+
+bool CaptureReader::loadIndex() {
+    CaptureFileFooter footer;
+    CaptureChunkHeader chunk;
+    size_t indexSize;
+
+    if (mSize < header().headerSize + sizeof(footer)) {
+        return false;
+    }
+
+    memcpy(&footer, mData + mSize - sizeof(footer), sizeof(footer));
+    indexSize = (size_t)footer.chunkCount * sizeof(CaptureIndexEntry);
+    if (footer.magic != CAPTURE_INDEX_MAGIC || footer.indexOffset < header().headerSize
+            || footer.indexOffset + indexSize + sizeof(footer) != mSize) {
+        return false;
+    }
+
+    mIndex.resize(footer.chunkCount);
+    memcpy(mIndex.data(), mData + footer.indexOffset, indexSize);
+
+    for (const CaptureIndexEntry &entry : mIndex) {
+        if (entry.offset + sizeof(chunk) > footer.indexOffset) {
+            mIndex.clear();
+            return false;
+        }
+        memcpy(&chunk, mData + entry.offset, sizeof(chunk));
+        if (chunk.magic != CAPTURE_CHUNK_MAGIC
+                || entry.offset + sizeof(chunk) + chunk.size > footer.indexOffset) {
+            mIndex.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CaptureReader::scanChunks() {
+    CaptureChunkHeader chunk;
+    CaptureIndexEntry entry;
+    size_t offset = header().headerSize;
+
+    mIndex.clear();
+    while (offset + sizeof(chunk) <= mSize) {
+        memcpy(&chunk, mData + offset, sizeof(chunk));
+        if (chunk.magic != CAPTURE_CHUNK_MAGIC || chunk.size > mSize - offset - sizeof(chunk)) {
+            break;
+        }
+
+        memset(&entry, 0, sizeof(entry));
+        entry.offset = offset;
+        entry.firstTime = chunk.firstTime;
+        entry.lastTime = chunk.lastTime;
+        entry.typeMask = chunk.typeMask;
+        entry.recordCount = chunk.recordCount;
+        mIndex.push_back(entry);
+
+        offset += sizeof(chunk) + chunk.size;
+    }
+}
+
+}  // namespace android
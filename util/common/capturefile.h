@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAPTURE_FILE_H_
+
+#define CAPTURE_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+/*
+ * Nanohub capture files: every read() of the hub's device file, bytes as
+ * returned, with the host time it returned at.
+ *
+ *   CaptureFileHeader
+ *   chunk 0 .. n-1   CaptureChunkHeader, then recordCount records, each a
+ *                    CaptureRecordHeader followed by len bytes
+ *   CaptureIndexEntry[n]
+ *   CaptureFileFooter
+ *
+ * Chunks are only ever written whole, so a capture whose writer died is still
+ * readable up to its last chunk by walking the chunk headers; the index and
+ * footer written on close just save that walk. Each chunk carries its host
+ * time range and a mask of the sensor types in it, letting a reader go
+ * straight to a point in time or skip chunks without the sensors it wants.
+ * All fields are little endian, packed.
+ */
+
+#define CAPTURE_FILE_MAGIC      0x5041434e  // "NCAP"
+#define CAPTURE_CHUNK_MAGIC     0x4b4e4843  // "CHNK"
+#define CAPTURE_INDEX_MAGIC     0x58444e49  // "INDX"
+#define CAPTURE_FILE_VERSION    1
+
+// Type mask bit used for anything that isn't sensor data (logs, app events...)
+#define CAPTURE_TYPE_OTHER      0
+
+struct CaptureFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint64_t startTime;         // ns, CLOCK_BOOTTIME when the capture began
+    uint64_t startRealtime;     // ns since the epoch, at the same instant
+} __attribute__((packed));
+
+struct CaptureChunkHeader {
+    uint32_t magic;
+    uint32_t recordCount;
+    uint32_t size;              // bytes of records following this header
+    uint32_t reserved;
+    uint64_t firstTime;         // host time of the first and last record
+    uint64_t lastTime;
+    uint64_t typeMask;          // 1 << captureRecordType() of every record
+} __attribute__((packed));
+
+struct CaptureRecordHeader {
+    uint64_t time;              // ns, CLOCK_BOOTTIME when read() returned
+    uint32_t len;
+} __attribute__((packed));
+
+struct CaptureIndexEntry {
+    uint64_t offset;            // of the chunk header
+    uint64_t firstTime;
+    uint64_t lastTime;
+    uint64_t typeMask;
+    uint32_t recordCount;
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct CaptureFileFooter {
+    uint64_t indexOffset;
+    uint32_t chunkCount;
+    uint32_t magic;
+} __attribute__((packed));
+
+// Sensor type of a sensor data event, CAPTURE_TYPE_OTHER for anything else
+unsigned captureRecordType(const uint8_t *data, size_t len);
+
+// CLOCK_BOOTTIME in ns, the clock capture times are taken on
+uint64_t captureNow();
+
+/*
+ * Writes a capture. append() is meant to be called straight from the loop
+ * reading the hub and only copies the record into the chunk being filled;
+ * full chunks are written out by a thread of our own, so a stalled disk
+ * costs memory rather than records.
+ */
+struct CaptureWriter {
+    struct Stats {
+        uint64_t records;
+        uint64_t bytes;         // written to the file so far
+        uint32_t chunks;
+        size_t maxBacklog;      // most bytes ever waiting on the disk
+    };
+
+    CaptureWriter();
+    ~CaptureWriter();
+
+    status_t open(const char *path);
+    status_t initCheck() const;
+
+    void append(uint64_t time, const void *data, size_t len);
+
+    // Hands the chunk being filled to the disk thread now, e.g. while the
+    // hub is quiet, instead of when it's full or spans kChunkSpan
+    void flush();
+
+    // Writes out everything pending, then the index and footer
+    status_t close();
+
+    void getStats(Stats *stats);
+
+private:
+    static const size_t kChunkSize = 64 * 1024;
+    static const uint64_t kChunkSpan = 1000000000ull;  // 1s of host time
+
+    status_t mInitCheck;
+    int mFd;
+
+    std::vector<uint8_t> mChunk;
+    CaptureChunkHeader mChunkHeader;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::deque<std::vector<uint8_t>> mQueue;
+    std::vector<std::vector<uint8_t>> mFree;
+    size_t mBacklog;
+    bool mStop;
+    status_t mWriteError;
+    std::vector<CaptureIndexEntry> mIndex;
+    Stats mStats;
+    std::thread mThread;
+
+    void startChunk();
+    void sealChunk();
+    void writerLoop();
+    status_t writeAll(const void *data, size_t len);
+
+    DISALLOW_EVIL_CONSTRUCTORS(CaptureWriter);
+};
+
+/*
+ * Reads a capture through a read-only mapping of the whole file.
+ */
+struct CaptureReader {
+    typedef std::function<bool(uint64_t time, const uint8_t *data, size_t len)> RecordFunc;
+
+    CaptureReader();
+    ~CaptureReader();
+
+    status_t open(const char *path);
+    status_t initCheck() const;
+
+    const CaptureFileHeader &header() const;
+    const std::vector<CaptureIndexEntry> &chunks() const;
+
+    // Calls func, in capture order, for every record with from <= time < to
+    // whose type is in typeMask, until func returns false. Chunks outside the
+    // time range or without any of the types are skipped unread.
+    void forEach(uint64_t from, uint64_t to, uint64_t typeMask, const RecordFunc &func) const;
+
+private:
+    status_t mInitCheck;
+    const uint8_t *mData;
+    size_t mSize;
+    std::vector<CaptureIndexEntry> mIndex;
+
+    bool loadIndex();
+    void scanChunks();
+
+    DISALLOW_EVIL_CONSTRUCTORS(CaptureReader);
+};
+
+}  // namespace android
+
+#endif  // CAPTURE_FILE_H_
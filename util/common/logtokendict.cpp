@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "logtokendict.h"
+
+#include "file.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace android {
+
+LogTokenDict::LogTokenDict()
+    : mInitCheck(NO_INIT) {
+}
+
+status_t LogTokenDict::load(const char *path) {
+    File file(path, "r");
+    char buf[1024];
+    ssize_t n;
+
+    mStrings.clear();
+    mInitCheck = file.initCheck();
+    if (mInitCheck != OK) {
+        return mInitCheck;
+    }
+
+    while ((n = file.read(buf, sizeof(buf))) > 0) {
+        mStrings.insert(mStrings.end(), buf, buf + n);
+    }
+
+    // make sure a lookup can never run off the end
+    mStrings.push_back('\0');
+    mInitCheck = (n < 0) ? -errno : OK;
+
+    return mInitCheck;
+}
+
+status_t LogTokenDict::initCheck() const {
+    return mInitCheck;
+}
+
+void LogTokenDict::decode(const uint8_t *buf, size_t len, const EmitFunc &emit) const {
+    LogTokenRecord rec;
+    std::vector<uint32_t> args;
+    size_t argsSize;
+
+    while (len >= sizeof(rec)) {
+        memcpy(&rec, buf, sizeof(rec));
+        argsSize = rec.numWords * sizeof(uint32_t);
+        if (len < sizeof(rec) + argsSize) {
+            break;
+        }
+
+        args.resize(rec.numWords);
+        memcpy(args.data(), buf + sizeof(rec), argsSize);
+        emit(rec.level, format(rec, args.data()));
+
+        buf += sizeof(rec) + argsSize;
+        len -= sizeof(rec) + argsSize;
+    }
+}
+
+// Mirrors the way cvprintf() on the hub consumes its arguments; see
+// logTokenCollect() in logToken.c.
+std::string LogTokenDict::format(const LogTokenRecord &rec, const uint32_t *args) const {
+    const bool lp64 = rec.flags & LOG_TOKEN_FLAG_LP64;
+    std::string out;
+    char tmp[128];
+    size_t word = 0;
+
+    if (rec.token == LOG_TOKEN_DROPPED) {
+        snprintf(tmp, sizeof(tmp), "%u log messages dropped\n", rec.numWords ? args[0] : 0);
+        return tmp;
+    }
+
+    if (mInitCheck != OK || rec.token >= mStrings.size()) {
+        snprintf(tmp, sizeof(tmp), "<token 0x%08x>", rec.token);
+        out = tmp;
+        for (size_t i = 0; i < rec.numWords; i++) {
+            snprintf(tmp, sizeof(tmp), " %08x", args[i]);
+            out += tmp;
+        }
+        return out + "\n";
+    }
+
+    for (const char *fmt = &mStrings[rec.token]; *fmt; fmt++) {
+        if (*fmt != '%') {
+            out += *fmt;
+            continue;
+        }
+
+        const char *start = fmt;
+        std::string spec("%");
+        int numLong = 0, numShort = 0;
+        bool useSizeT = false;
+        bool wide;
+        uint64_t val;
+
+        while (*++fmt && strchr("0123456789.#-+ hlLzt", *fmt)) {
+            if (*fmt == 'l') {
+                numLong++;
+            } else if (*fmt == 'h') {
+                numShort++;
+            } else if (*fmt == 'z' || *fmt == 't') {
+                useSizeT = true;
+            } else if (*fmt != 'L') {
+                spec += *fmt;
+            }
+        }
+
+        switch (*fmt) {
+        case '%':
+            out += '%';
+            continue;
+        case 'c': case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'p':
+            if (*fmt == 'p') {
+                wide = lp64;
+            } else {
+                wide = numLong > 1 || (numLong && lp64) || (useSizeT && lp64);
+            }
+            if (word + (wide ? 2 : 1) > rec.numWords) {
+                // truncated on the hub; show the rest of the format as is
+                return out + start;
+            }
+            val = args[word++];
+            if (wide) {
+                val |= (uint64_t)args[word++] << 32;
+            }
+            break;
+        case 's':
+            if (word < rec.numWords) {
+                const uint8_t *bytes = reinterpret_cast<const uint8_t *>(args + word);
+                size_t strLen = bytes[0];
+                size_t words = (1 + strLen + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+                if (word + words <= rec.numWords) {
+                    std::string str(reinterpret_cast<const char *>(bytes + 1), strLen);
+                    snprintf(tmp, sizeof(tmp), (spec + "s").c_str(), str.c_str());
+                    out += tmp;
+                    word += words;
+                    continue;
+                }
+            }
+            return out + start;
+        case '\0':
+            return out;
+        default:
+            // %f stops cvprintf(); anything else is printed literally
+            if (*fmt == 'f' || *fmt == 'F') {
+                return out;
+            }
+            out += *fmt;
+            continue;
+        }
+
+        if (*fmt == 'c') {
+            out += static_cast<char>(val);
+        } else if (*fmt == 'p') {
+            snprintf(tmp, sizeof(tmp), "0x%llx", static_cast<unsigned long long>(val));
+            out += tmp;
+        } else if (*fmt == 'd' || *fmt == 'i') {
+            long long sval = wide ? (int64_t)val
+                : numShort > 1 ? (int8_t)val
+                : numShort ? (int16_t)val
+                : (int32_t)val;
+            snprintf(tmp, sizeof(tmp), (spec + "ll" + *fmt).c_str(), sval);
+            out += tmp;
+        } else {
+            unsigned long long uval = wide ? val
+                : numShort > 1 ? (uint8_t)val
+                : numShort ? (uint16_t)val
+                : (uint32_t)val;
+            snprintf(tmp, sizeof(tmp), (spec + "ll" + *fmt).c_str(), uval);
+            out += tmp;
+        }
+    }
+
+    return out;
+}
+
+}  // namespace android
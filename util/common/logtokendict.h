@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_TOKEN_DICT_H_
+
+#define LOG_TOKEN_DICT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+// From logToken.h
+#define LOG_TOKEN_MARK              'T'
+#define LOG_TOKEN_FLAG_LP64         0x0002
+#define LOG_TOKEN_DROPPED           0xFFFFFFFF
+
+struct LogTokenRecord {
+    uint8_t level;
+    uint8_t numWords;
+    uint16_t flags;
+    uint32_t token;
+} __attribute__((packed));
+
+/*
+ * Rebuilds the text of tokenized hub logs (osLogT()). The dictionary is the
+ * .logstr section of the OS ELF the hub runs (os.*.logstr); tokens are offsets
+ * into it. Without a dictionary, records are printed as raw token and words.
+ */
+struct LogTokenDict {
+    typedef std::function<void(char level, const std::string &text)> EmitFunc;
+
+    LogTokenDict();
+
+    status_t load(const char *path);
+    status_t initCheck() const;
+
+    // Decodes a tokenized log payload, i.e. what follows LOG_TOKEN_MARK,
+    // calling emit once per record.
+    void decode(const uint8_t *buf, size_t len, const EmitFunc &emit) const;
+
+private:
+    status_t mInitCheck;
+    std::vector<char> mStrings;
+
+    std::string format(const LogTokenRecord &rec, const uint32_t *args) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(LogTokenDict);
+};
+
+}  // namespace android
+
+#endif  // LOG_TOKEN_DICT_H_
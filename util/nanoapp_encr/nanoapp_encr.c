@@ -24,6 +24,7 @@
 #include <nanohub/aes.h>
 #include <nanohub/sha2.h>
 #include <nanohub/nanohub.h>
+#include <nanohub/batch.h>
 #include <nanohub/nanoapp.h>
 
 static FILE* urandom = NULL;
@@ -34,7 +35,15 @@ static void cleanup(void)
         fclose(urandom);
 }
 
-static void rand_bytes(void *dst, uint32_t len)
+struct EncrOpts {
+    bool encrypt;
+    bool decrypt;
+    uint64_t keyId;
+    const uint32_t *key;
+};
+
+//open the random source; must be done before any worker threads are started
+static void openRandom(void)
 {
     if (!urandom) {
         urandom = fopen("/dev/urandom", "rb");
@@ -46,6 +55,11 @@ static void rand_bytes(void *dst, uint32_t len)
         //it might not matter, but we still like to try to cleanup after ourselves
         (void)atexit(cleanup);
     }
+}
+
+static void rand_bytes(void *dst, uint32_t len)
+{
+    openRandom();
 
     if (len != fread(dst, 1, len, urandom)) {
         fprintf(stderr, "Failed to read /dev/urandom. Cannot procceed!\n");
@@ -53,7 +67,7 @@ static void rand_bytes(void *dst, uint32_t len)
     }
 }
 
-static int handleEncrypt(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint64_t keyId, uint32_t *key)
+static int handleEncrypt(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint64_t keyId, const uint32_t *key)
 {
     uint32_t i;
     struct AesCbcContext ctx;
@@ -90,7 +104,7 @@ static int handleEncrypt(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint64_t k
         padLen = AES_BLOCK_SIZE - ((bufUsed - sizeof(*image)) % AES_BLOCK_SIZE);
 
     if (padLen) {
-        reallocOrDie(buf, bufUsed + padLen);
+        buf = reallocOrDie(buf, bufUsed + padLen);
         rand_bytes(buf + bufUsed, padLen);
         bufUsed += padLen;
         fprintf(stderr, "Padded to %" PRIu32 " bytes\n", bufUsed);
@@ -150,7 +164,7 @@ static int handleEncrypt(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint64_t k
     return err ? 2 : 0;
 }
 
-static int handleDecrypt(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint32_t *key)
+static int handleDecrypt(uint8_t **pbuf, uint32_t bufUsed, FILE *out, const uint32_t *key)
 {
     struct AesCbcContext ctx;
     struct ImageHeader *image;
@@ -232,6 +246,46 @@ static int handleDecrypt(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint32_t *
     return err ? 2 : 0;
 }
 
+static int handleInput(uint8_t **pbuf, uint32_t bufUsed, FILE *out, const struct EncrOpts *opts)
+{
+    if (opts->encrypt)
+        return handleEncrypt(pbuf, bufUsed, out, opts->keyId, opts->key);
+    else if (opts->decrypt)
+        return handleDecrypt(pbuf, bufUsed, out, opts->key);
+
+    return -1;
+}
+
+static int encrJob(void *ctx, const char *inName, const char *outName)
+{
+    const struct EncrOpts *opts = ctx;
+    uint32_t bufUsed = 0;
+    uint8_t *buf;
+    FILE *out;
+    int ret;
+
+    buf = loadFile(inName, &bufUsed);
+    fprintf(stderr, "Read %" PRIu32 " bytes\n", bufUsed);
+
+    if (!outName) {
+        fprintf(stderr, "No output file given for %s\n", inName);
+        ret = 2;
+    } else if (!(out = fopen(outName, "w"))) {
+        fprintf(stderr, "Failed to create/open output file: %s\n", outName);
+        ret = 2;
+    } else {
+        ret = handleInput(&buf, bufUsed, out, opts);
+        fclose(out);
+    }
+    free(buf);
+
+    return ret;
+}
+
+static const struct BatchOps encrBatchOps = {
+    .job = encrJob,
+};
+
 static void fatalUsage(const char *name, const char *msg, const char *arg)
 {
     if (msg && arg)
@@ -240,11 +294,14 @@ static void fatalUsage(const char *name, const char *msg, const char *arg)
         fprintf(stderr, "Error: %s\n\n", msg);
 
     fprintf(stderr, "USAGE: %s [-e] [-d] [-i <key id>] [-k <key file>] <input file> [<output file>]\n"
+                    "       %s [options] -l <list file> [-j <threads>]\n"
                     "       -i : 64-bit hex number != 0\n"
                     "       -e : encrypt post-processed file\n"
                     "       -d : decrypt encrypted post-processed file\n"
                     "       -k : binary file (32 byte size) containing AES-256 secret key\n"
-                    , name);
+                    "       -l : process all the files in the list file; each line is <input file> <output file>\n"
+                    "       -j : number of worker threads to use with -l (default: number of CPUs)\n"
+                    , name, name);
     exit(1);
 }
 
@@ -265,8 +322,12 @@ int main(int argc, char **argv)
     bool decrypt = false;
     bool encrypt = false;
     const char *keyFile = NULL;
+    const char *listFile = NULL;
+    const char *threadsArg = NULL;
+    uint32_t numThreads;
     int multi = 0;
     uint32_t key[AES_KEY_WORDS];
+    struct EncrOpts opts;
 
     for (int i = 1; i < argc; i++) {
         char *end = NULL;
@@ -280,6 +341,10 @@ int main(int argc, char **argv)
                 strArg = &keyFile;
             else if (!strcmp(argv[i], "-i"))
                 u64Arg = &keyId;
+            else if (!strcmp(argv[i], "-l"))
+                strArg = &listFile;
+            else if (!strcmp(argv[i], "-j"))
+                strArg = &threadsArg;
             else
                 fatalUsage(appName, "unknown argument", argv[i]);
         } else {
@@ -308,9 +373,12 @@ int main(int argc, char **argv)
     if (prev)
         fatalUsage(appName, "missing argument after", prev);
 
-    if (!posArgCnt)
+    if (!posArgCnt && !listFile)
         fatalUsage(appName, "missing input file name", NULL);
 
+    if (posArgCnt && listFile)
+        fatalUsage(appName, "positional arguments are not allowed with", "-l");
+
     if (encrypt)
         multi++;
     if (decrypt)
@@ -329,6 +397,20 @@ int main(int argc, char **argv)
     if (!readFile(key, sizeof(key), keyFile))
         fatalUsage(appName, "Key file does not exist or has incorrect size", keyFile);
 
+    opts.encrypt = encrypt;
+    opts.decrypt = decrypt;
+    opts.keyId = keyId;
+    opts.key = key;
+
+    if (!batchParseThreads(threadsArg, &numThreads))
+        fatalUsage(appName, "invalid number of threads", threadsArg);
+
+    if (listFile) {
+        // the random source is shared by all the workers; make sure it is there before they start
+        openRandom();
+        return batchRun(listFile, numThreads, &encrBatchOps, &opts);
+    }
+
     buf = loadFile(posArg[0], &bufUsed);
     fprintf(stderr, "Read %" PRIu32 " bytes\n", bufUsed);
 
@@ -339,10 +421,7 @@ int main(int argc, char **argv)
     if (!out)
         fatalUsage(appName, "failed to create/open output file", posArg[1]);
 
-    if (encrypt)
-        ret = handleEncrypt(&buf, bufUsed, out, keyId, key);
-    else if (decrypt)
-        ret = handleDecrypt(&buf, bufUsed, out, key);
+    ret = handleInput(&buf, bufUsed, out, &opts);
 
     free(buf);
     fclose(out);
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Writes a synthetic nanoapp .bin image, as objcopy leaves it for
+ * nanoapp_postprocess: BinHdr, code, initial .data, relocs and symtab.
+ *
+ * The relocs are a mix of the ones real apps have: in-header vector relocs,
+ * runs over consecutive .data words (tables of pointers), and scattered
+ * absolute and section relocs to both flash and RAM, in no particular order.
+ * The image only depends on the arguments, so outputs can be compared across
+ * builds of the tool.
+ */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nanohub/nanohub.h>
+
+#define FLASH_BASE  0x10000000u
+#define RAM_BASE    0x80000000u
+
+#define RELOC_TYPE_ABS_D    21
+#define RELOC_TYPE_SECT     23
+
+struct RelocEntry {
+    uint32_t where;
+    uint32_t info;  //bottom 8 bits is type, top 24 is sym idx
+};
+
+struct SymtabEntry {
+    uint32_t a;
+    uint32_t addr;
+    uint32_t b, c;
+};
+
+#define NUM_SYMS    64
+
+static uint32_t mRandState;
+
+static uint32_t rnd(void)
+{
+    // xorshift32, so the images do not depend on the libc rand()
+    mRandState ^= mRandState << 13;
+    mRandState ^= mRandState >> 17;
+    mRandState ^= mRandState << 5;
+    return mRandState;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t codeSz, dataWords, numRelocs, bssSz, i, n;
+    uint32_t dataData, relStart, relEnd, fileSz, codeEnd;
+    struct SymtabEntry *syms;
+    struct RelocEntry *relocs;
+    struct BinHdr *bin;
+    uint32_t *data;
+    uint8_t *buf, *used;
+    FILE *out;
+
+    if (argc != 6) {
+        fprintf(stderr, "USAGE: %s <seed> <code bytes> <data words> <relocs> <output file>\n", argv[0]);
+        return 1;
+    }
+
+    mRandState = strtoul(argv[1], NULL, 0) | 1;
+    codeSz = (strtoul(argv[2], NULL, 0) + 3) & ~3u;
+    dataWords = strtoul(argv[3], NULL, 0);
+    numRelocs = strtoul(argv[4], NULL, 0);
+    bssSz = 1024;
+
+    // one reloc per .data word at most, plus the three in the header
+    if (!dataWords || numRelocs < 3 || numRelocs - 3 > dataWords) {
+        fprintf(stderr, "Need 3 to <data words> + 3 relocs\n");
+        return 1;
+    }
+
+    dataData = FLASH_BASE + sizeof(struct BinHdr) + codeSz;
+    relStart = dataData + dataWords * sizeof(uint32_t);
+    relEnd = relStart + numRelocs * sizeof(struct RelocEntry);
+    fileSz = relEnd + NUM_SYMS * sizeof(struct SymtabEntry) - FLASH_BASE;
+    codeEnd = FLASH_BASE + sizeof(struct BinHdr) + codeSz;
+
+    buf = calloc(1, fileSz);
+    used = calloc(1, dataWords);
+    if (!buf || !used) {
+        fprintf(stderr, "Failed to allocate %" PRIu32 " bytes\n", fileSz);
+        return 1;
+    }
+
+    bin = (struct BinHdr *)buf;
+    data = (uint32_t *)(buf + dataData - FLASH_BASE);
+    relocs = (struct RelocEntry *)(buf + relStart - FLASH_BASE);
+    syms = (struct SymtabEntry *)(buf + relEnd - FLASH_BASE);
+
+    bin->hdr.magic = NANOAPP_FW_MAGIC;
+    bin->sect.data_start = RAM_BASE;
+    bin->sect.data_end = RAM_BASE + dataWords * sizeof(uint32_t);
+    bin->sect.data_data = dataData;
+    bin->sect.got_start = bin->sect.data_end;
+    bin->sect.got_end = bin->sect.data_end;
+    bin->sect.bss_start = bin->sect.data_end;
+    bin->sect.bss_end = bin->sect.bss_start + bssSz;
+    bin->sect.rel_start = relStart;
+    bin->sect.rel_end = relEnd;
+    bin->vec.init = codeEnd - codeSz + 1;
+    bin->vec.end = codeEnd - codeSz / 2 + 1;
+    bin->vec.handle = codeEnd - 4 + 1;
+
+    for (i = sizeof(struct BinHdr); i < dataData - FLASH_BASE; i++)
+        buf[i] = rnd();
+
+    // symbol 0 is the section symbol; the others point into code, .data or .bss
+    for (i = 1; i < NUM_SYMS; i++) {
+        switch (rnd() % 3) {
+        case 0:
+            syms[i].addr = FLASH_BASE + sizeof(struct BinHdr) + (rnd() % codeSz) / 4 * 4;
+            break;
+        case 1:
+            syms[i].addr = RAM_BASE + rnd() % (dataWords * sizeof(uint32_t)) / 4 * 4;
+            break;
+        default:
+            syms[i].addr = bin->sect.bss_start + rnd() % bssSz / 4 * 4;
+            break;
+        }
+    }
+
+    // values a section reloc fixes up already hold the full address
+    for (i = 0; i < dataWords; i++)
+        data[i] = (rnd() & 1) ? codeEnd - rnd() % codeSz : RAM_BASE + rnd() % (dataWords * 4);
+
+    // the three vectors
+    for (i = 0; i < 3; i++) {
+        relocs[i].where = FLASH_BASE + offsetof(struct BinHdr, vec) + i * sizeof(uint32_t);
+        relocs[i].info = RELOC_TYPE_SECT;
+    }
+
+    while (i < numRelocs) {
+        uint32_t where = rnd() % dataWords;
+        uint32_t type = (rnd() & 1) ? RELOC_TYPE_ABS_D : RELOC_TYPE_SECT;
+
+        // a run over a pointer table half the time, else a single reloc
+        n = (rnd() & 1) ? 1 + rnd() % 64 : 1;
+        for (; n && i < numRelocs && where < dataWords && !used[where]; n--, i++, where++) {
+            used[where] = 1;
+            relocs[i].where = RAM_BASE + where * sizeof(uint32_t);
+            if (type == RELOC_TYPE_SECT) {
+                relocs[i].info = RELOC_TYPE_SECT;
+            } else {
+                relocs[i].info = (1 + rnd() % (NUM_SYMS - 1)) << 8 | RELOC_TYPE_ABS_D;
+                data[where] = rnd() % 64;
+            }
+        }
+    }
+
+    out = fopen(argv[5], "w");
+    if (!out || fwrite(buf, fileSz, 1, out) != 1 || fclose(out)) {
+        perror(argv[5]);
+        return 1;
+    }
+
+    free(used);
+    free(buf);
+    return 0;
+}
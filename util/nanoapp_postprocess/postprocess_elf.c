@@ -72,6 +72,9 @@ struct NanoRelocEntry {
     uint8_t type;
 };
 
+//worst case packed size of one nano reloc: type change token + byte, then a 32-bit offset token + 4 bytes
+#define MAX_PACKED_RELOC_SZ 7
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(ary) (sizeof(ary) / sizeof((ary)[0]))
 #endif
@@ -120,33 +123,66 @@ static void fatalUsage(const char *name, const char *msg, const char *arg)
     exit(1);
 }
 
-static uint8_t *packNanoRelocs(struct NanoRelocEntry *nanoRelocs, uint32_t outNumRelocs, uint32_t *finalPackedNanoRelocSz, bool verbose)
+static uint8_t nanoRelocSortDigit(const struct NanoRelocEntry *reloc, uint32_t pass)
 {
-    uint32_t i, j, k;
-    uint8_t *packedNanoRelocs;
-    uint32_t packedNanoRelocSz;
-    uint32_t lastOutType = 0, origin = 0;
+    return pass < sizeof(reloc->ofstInRam) ? reloc->ofstInRam >> (pass * 8) : reloc->type;
+}
 
-    //sort by type and then offset
-    for (i = 0; i < outNumRelocs; i++) {
-        struct NanoRelocEntry t;
+//sort by type and then offset; LSD radix sort, linear in the number of relocs
+static void sortNanoRelocs(struct NanoRelocEntry *nanoRelocs, uint32_t numRelocs)
+{
+    struct NanoRelocEntry *src = nanoRelocs, *dst, *tmp, *t;
+    uint32_t count[256];
+    uint32_t i, pass, pos, n;
 
-        for (k = i, j = k + 1; j < outNumRelocs; j++) {
-            if (nanoRelocs[j].type > nanoRelocs[k].type)
-                continue;
-            if ((nanoRelocs[j].type < nanoRelocs[k].type) || (nanoRelocs[j].ofstInRam < nanoRelocs[k].ofstInRam))
-                k = j;
+    if (numRelocs < 2)
+        return;
+
+    tmp = reallocOrDie(NULL, sizeof(struct NanoRelocEntry[numRelocs]));
+    dst = tmp;
+
+    //offset bytes from least significant up, then type
+    for (pass = 0; pass <= sizeof(src->ofstInRam); pass++) {
+        memset(count, 0, sizeof(count));
+        for (i = 0; i < numRelocs; i++)
+            count[nanoRelocSortDigit(src + i, pass)]++;
+
+        //all relocs share this digit (usual for the top bytes), so this pass would not move anything
+        if (count[nanoRelocSortDigit(src, pass)] == numRelocs)
+            continue;
+
+        for (i = 0, pos = 0; i < ARRAY_SIZE(count); i++) {
+            n = count[i];
+            count[i] = pos;
+            pos += n;
         }
-        memcpy(&t, nanoRelocs + i, sizeof(struct NanoRelocEntry));
-        memcpy(nanoRelocs + i, nanoRelocs + k, sizeof(struct NanoRelocEntry));
-        memcpy(nanoRelocs + k, &t, sizeof(struct NanoRelocEntry));
+        for (i = 0; i < numRelocs; i++)
+            dst[count[nanoRelocSortDigit(src + i, pass)]++] = src[i];
 
-        if (verbose)
+        t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if (src != nanoRelocs)
+        memcpy(nanoRelocs, src, sizeof(struct NanoRelocEntry[numRelocs]));
+    free(tmp);
+}
+
+//produce output nanorelocs in packed format into a buffer of at least MAX_PACKED_RELOC_SZ bytes per reloc; returns bytes used
+static uint32_t packNanoRelocs(struct NanoRelocEntry *nanoRelocs, uint32_t outNumRelocs, uint8_t *packedNanoRelocs, bool verbose)
+{
+    uint32_t i, j;
+    uint32_t packedNanoRelocSz;
+    uint32_t lastOutType = 0, origin = 0;
+
+    sortNanoRelocs(nanoRelocs, outNumRelocs);
+
+    if (verbose) {
+        for (i = 0; i < outNumRelocs; i++)
             fprintf(stderr, "SortedReloc[%3" PRIu32 "] = {0x%08" PRIX32 ",0x%02" PRIX8 "}\n", i, nanoRelocs[i].ofstInRam, nanoRelocs[i].type);
     }
 
-    //produce output nanorelocs in packed format
-    packedNanoRelocs = malloc(outNumRelocs * 6); //definitely big enough
     packedNanoRelocSz = 0;
     for (i = 0; i < outNumRelocs; i++) {
         uint32_t displacement;
@@ -222,16 +258,16 @@ static uint8_t *packNanoRelocs(struct NanoRelocEntry *nanoRelocs, uint32_t outNu
         }
     }
 
-    *finalPackedNanoRelocSz = packedNanoRelocSz;
-    return packedNanoRelocs;
+    return packedNanoRelocSz;
 }
 
-static int finalizeAndWrite(uint8_t *buf, uint32_t bufUsed, uint32_t bufSz, FILE *out, uint32_t layoutFlags, uint64_t appId, uint32_t chreApi)
+//writes headers and payload out separately, so buf needs no room for the headers growing
+static int finalizeAndWrite(const uint8_t *buf, uint32_t bufUsed, FILE *out, uint32_t layoutFlags, uint64_t appId, uint32_t chreApi)
 {
     int ret;
     struct AppInfo app;
     struct SectInfo *sect;
-    struct BinHdr *bin = (struct BinHdr *) buf;
+    const struct BinHdr *bin = (const struct BinHdr *) buf;
     struct ImageHeader outHeader = {
         .aosp = (struct nano_app_binary_t) {
             .header_version = 1,
@@ -249,17 +285,11 @@ static int finalizeAndWrite(uint8_t *buf, uint32_t bufUsed, uint32_t bufSz, FILE
             .flags = layoutFlags | (chreApi ? 0x0010 : 0x0000),
         },
     };
-    uint32_t dataOffset = sizeof(outHeader) + sizeof(app);
-    uint32_t hdrDiff = dataOffset - sizeof(*bin);
+    uint32_t payloadSz = bufUsed - sizeof(*bin);
     app.sect = bin->sect;
     app.vec  = bin->vec;
 
-    assertMem(bufUsed + hdrDiff, bufSz);
-
-    memmove(buf + dataOffset, buf + sizeof(*bin), bufUsed - sizeof(*bin));
-    bufUsed += hdrDiff;
-    memcpy(buf, &outHeader, sizeof(outHeader));
-    memcpy(buf + sizeof(outHeader), &app, sizeof(app));
+    bufUsed = sizeof(outHeader) + sizeof(app) + payloadSz;
     sect = &app.sect;
 
     //if we have any bytes to output, show stats
@@ -281,7 +311,9 @@ static int finalizeAndWrite(uint8_t *buf, uint32_t bufUsed, uint32_t bufSz, FILE
         fprintf(stderr,"Runtime RAM use: %" PRIu32 " bytes\n", gotSz + bssSz);
     }
 
-    ret = fwrite(buf, bufUsed, 1, out) == 1 ? 0 : 2;
+    ret = fwrite(&outHeader, sizeof(outHeader), 1, out) == 1 &&
+          fwrite(&app, sizeof(app), 1, out) == 1 &&
+          fwrite(buf + sizeof(*bin), payloadSz, 1, out) == 1 ? 0 : 2;
     if (ret)
         fprintf(stderr, "Failed to write output file: %s\n", strerror(errno));
 
@@ -294,17 +326,11 @@ static int handleApp(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint32_t layou
     struct NanoRelocEntry *nanoRelocs = NULL;
     struct RelocEntry *relocs;
     struct SymtabEntry *syms;
-    uint8_t *packedNanoRelocs;
     uint32_t t;
     struct BinHdr *bin;
     int ret = -1;
     struct SectInfo *sect;
     uint8_t *buf = *pbuf;
-    uint32_t bufSz = bufUsed * 3 /2;
-
-    //make buffer 50% bigger than bufUsed in case relocs grow out of hand
-    buf = reallocOrDie(buf, bufSz);
-    *pbuf = buf;
 
     //sanity checks
     bin = (struct BinHdr*)buf;
@@ -494,14 +520,12 @@ static int handleApp(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint32_t layou
         outNumRelocs++;
     }
 
-    packedNanoRelocs = packNanoRelocs(nanoRelocs, outNumRelocs, &packedNanoRelocSz, verbose);
-
-    //overwrite original relocs and symtab with nanorelocs and adjust sizes
-    memcpy(relocs, packedNanoRelocs, packedNanoRelocSz);
+    //overwrite original relocs and symtab with nanorelocs and adjust sizes; a packed reloc never
+    //takes more than the 8 byte RelocEntry it came from, so this can not outgrow the input
+    packedNanoRelocSz = packNanoRelocs(nanoRelocs, outNumRelocs, (uint8_t*)relocs, verbose);
     bufUsed -= sizeof(struct RelocEntry[numRelocs]);
     bufUsed -= sizeof(struct SymtabEntry[numSyms]);
     bufUsed += packedNanoRelocSz;
-    assertMem(bufUsed, bufSz);
     sect->rel_end = sect->rel_start + packedNanoRelocSz;
 
     //sanity
@@ -532,7 +556,7 @@ static int handleApp(uint8_t **pbuf, uint32_t bufUsed, FILE *out, uint32_t layou
     sect->rel_start -= FLASH_BASE + BINARY_RELOC_OFFSET;
     sect->rel_end -= FLASH_BASE + BINARY_RELOC_OFFSET;
 
-    ret = finalizeAndWrite(buf, bufUsed, bufSz, out, layoutFlags, appId, chreApi);
+    ret = finalizeAndWrite(buf, bufUsed, out, layoutFlags, appId, chreApi);
 out:
     free(nanoRelocs);
     return ret;
@@ -632,7 +656,7 @@ static bool loadNanoappElfFile(const char *fileName, struct ElfNanoApp *app)
         return false;
     }
 
-    elf = elf_begin(fd, ELF_C_READ, NULL);
+    elf = elf_begin(fd, ELF_C_READ_MMAP, NULL);
     if (elf == NULL) {
         ELF_ERR("Failed to open ELF");
         return false;
@@ -708,10 +732,25 @@ static bool fixupHeaderElf(const struct ElfNanoApp *app)
     return true;
 }
 
+// Upper bound on the number of nano relocs genElfNanoRelocs() will generate.
+// The app header must have already been fixed up.
+static size_t elfMaxNanoRelocs(const struct ElfNanoApp *app)
+{
+    const struct BinHdr *hdr = (const struct BinHdr *) app->flash.data;
+    const struct SectInfo *sect = &hdr->sect;
+
+    size_t numDataRelocs = app->relocs.size / sizeof(Elf32_Rel);
+    size_t gotCount = (sect->got_end - sect->got_start) / sizeof(uint32_t);
+    size_t numInitFuncs  = (sect->bss_start - sect->data_end) / sizeof(uint32_t);
+
+    return numDataRelocs + numInitFuncs + gotCount;
+}
+
 // Fixup addresses in .data, .init_array/.fini_array, and .got, and generates
-// packed array of nano reloc entries. The app header must have already been
-// fixed up.
-static bool genElfNanoRelocs(struct ElfNanoApp *app, bool verbose)
+// packed array of nano reloc entries into packed, which must have room for
+// MAX_PACKED_RELOC_SZ bytes per elfMaxNanoRelocs(). The app header must have
+// already been fixed up.
+static bool genElfNanoRelocs(struct ElfNanoApp *app, uint8_t *packed, bool verbose)
 {
     const struct BinHdr *hdr = (const struct BinHdr *) app->flash.data;
     const struct SectInfo *sect = &hdr->sect;
@@ -719,9 +758,8 @@ static bool genElfNanoRelocs(struct ElfNanoApp *app, bool verbose)
 
     size_t numDataRelocs = app->relocs.size / sizeof(Elf32_Rel);
     size_t gotCount = (sect->got_end - sect->got_start) / sizeof(uint32_t);
-    size_t numInitFuncs  = (sect->bss_start - sect->data_end) / sizeof(uint32_t);
 
-    size_t totalRelocCount = (numDataRelocs + numInitFuncs + gotCount);
+    size_t totalRelocCount = elfMaxNanoRelocs(app);
     struct NanoRelocEntry *nanoRelocs = malloc(
         totalRelocCount * sizeof(struct NanoRelocEntry));
     if (!nanoRelocs) {
@@ -779,10 +817,9 @@ static bool genElfNanoRelocs(struct ElfNanoApp *app, bool verbose)
         }
     }
 
-    uint32_t packedNanoRelocSz = 0;
-    app->packedNanoRelocs.data = packNanoRelocs(
-        nanoRelocs, numRelocs, &packedNanoRelocSz, verbose);
-    app->packedNanoRelocs.size = packedNanoRelocSz;
+    app->packedNanoRelocs.data = packed;
+    app->packedNanoRelocs.size = packNanoRelocs(
+        nanoRelocs, numRelocs, packed, verbose);
     success = true;
 out:
     free(nanoRelocs);
@@ -793,40 +830,37 @@ static int handleAppStatic(const char *fileName, FILE *out, uint32_t layoutFlags
 {
     struct ElfNanoApp app;
 
-    if (!loadNanoappElfFile(fileName, &app)
-            || !fixupHeaderElf(&app)
-            || !genElfNanoRelocs(&app, verbose)) {
+    if (!loadNanoappElfFile(fileName, &app) || !fixupHeaderElf(&app)) {
         exit(2);
     }
 
-    // Construct a single contiguous buffer, with extra room to fit the
-    // ImageHeader that will be prepended by finalizeAndWrite(). Note that this
-    // will allocate a bit more space than is needed, because some of the data
-    // from BinHdr will get discarded.
-    // TODO: this should be refactored to just write the binary components in
-    // order rather than allocating a big buffer, and moving data around
-    size_t bufSize = app.flash.size + app.data.size + app.packedNanoRelocs.size
-        + sizeof(struct ImageHeader);
+    // Construct a single contiguous buffer, sized up front for the worst case
+    // packed relocs, which are generated straight into their final place.
+    // finalizeAndWrite() writes the ImageHeader out separately, so no room is
+    // needed for it here.
+    size_t offset = app.flash.size + app.data.size;
+    size_t bufSize = offset + elfMaxNanoRelocs(&app) * MAX_PACKED_RELOC_SZ;
     uint8_t *buf = malloc(bufSize);
     if (!buf) {
         ERR("Failed to allocate %zu bytes for final app", bufSize);
         exit(2);
     }
 
-    size_t offset = 0;
-    memcpy(buf, app.flash.data, app.flash.size);
-    offset += app.flash.size;
-    memcpy(&buf[offset], app.data.data, app.data.size);
-    offset += app.data.size;
-    memcpy(&buf[offset], app.packedNanoRelocs.data, app.packedNanoRelocs.size);
+    if (!genElfNanoRelocs(&app, &buf[offset], verbose)) {
+        exit(2);
+    }
     offset += app.packedNanoRelocs.size;
 
+    // .data is only final once its relocs have been fixed up
+    memcpy(buf, app.flash.data, app.flash.size);
+    memcpy(&buf[app.flash.size], app.data.data, app.data.size);
+
     // Update rel_end in the header to reflect the packed reloc size
     struct BinHdr *hdr = (struct BinHdr *) buf;
     hdr->sect.rel_end = hdr->sect.rel_start + app.packedNanoRelocs.size;
     hdr->hdr.appVer = appVer;
 
-    return finalizeAndWrite(buf, offset, bufSize, out, layoutFlags, appId, chreApi);
+    return finalizeAndWrite(buf, offset, out, layoutFlags, appId, chreApi);
     // TODO: should free all memory we allocated... just letting the OS handle
     // it for now
 }
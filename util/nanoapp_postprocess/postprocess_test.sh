@@ -0,0 +1,95 @@
+#!/bin/bash
+
+#
+# Copyright (C) 2016 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Runs nanoapp_postprocess over a corpus of generated .bin images (see
+# gen_test_app.c) and checks the output against postprocess_test.md5, which
+# holds the output of the original tool. Given a second build of the tool,
+# the outputs of the two are compared as well, and both are timed.
+
+# Exit in error if we use an undefined variable (i.e. commit a typo).
+set -u
+
+postprocess=$(readlink -f "${1:-./nanoapp_postprocess}")
+gen=$(readlink -f "${GEN:-./gen_test_app}")
+sums=$(readlink -f "$(dirname "$0")/postprocess_test.md5")
+ref=""
+if [ -n "${2:-}" ]; then
+	ref=$(readlink -f "$2")
+fi
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir"
+
+failed=0
+
+# name seed code_bytes data_words relocs
+corpus="
+small 1 4000 200 100
+medium 2 32000 2000 1500
+large 3 65536 8000 3000
+huge 4 262144 20000 10000
+relocs 5 1048576 60000 40000
+code 6 2000000 1000 1003
+"
+
+now () { #now: monotonic-enough time in ms
+	echo $(( $(date +%s%N) / 1000000 ))
+}
+
+while read -r name seed code data relocs; do
+	[ -z "$name" ] && continue
+
+	"$gen" "$seed" "$code" "$data" "$relocs" "$name.bin" || exit 1
+
+	start=$(now)
+	"$postprocess" -a 4e616e6f00000001 "$name.bin" "$name.napp" > /dev/null 2>&1
+	ret=$?
+	ms=$(( $(now) - start ))
+
+	if [ $ret -ne 0 ]; then
+		echo "FAIL: $name: exit code $ret"
+		failed=1
+		continue
+	fi
+
+	sum=$(md5sum < "$name.napp" | cut -d' ' -f1)
+	if ! grep -q "^$sum  $name\$" "$sums"; then
+		echo "FAIL: $name: output differs from the original tool ($sum)"
+		failed=1
+		continue
+	fi
+
+	if [ -z "$ref" ]; then
+		echo "PASS: $name ($relocs relocs): ${ms}ms"
+		continue
+	fi
+
+	start=$(now)
+	"$ref" -a 4e616e6f00000001 "$name.bin" "$name.ref.napp" > /dev/null 2>&1
+	refMs=$(( $(now) - start ))
+
+	if ! cmp -s "$name.napp" "$name.ref.napp"; then
+		echo "FAIL: $name: output differs from $ref"
+		failed=1
+		continue
+	fi
+
+	echo "PASS: $name ($relocs relocs): ${ms}ms, reference ${refMs}ms"
+done <<< "$corpus"
+
+exit $failed
@@ -21,6 +21,7 @@
 #include <stdio.h>
 
 #include <nanohub/nanohub.h>
+#include <nanohub/batch.h>
 #include <nanohub/nanoapp.h>
 #include <nanohub/sha2.h>
 #include <nanohub/rsa.h>
@@ -80,12 +81,9 @@ static int getHexEncodedByte(uint8_t *buf, uint32_t *ppos, uint32_t size)
     return val;
 }
 
-//provide a random number for which the following property is true ((ret & 0xFF000000) && (ret & 0xFF0000) && (ret & 0xFF00) && (ret & 0xFF))
-static uint32_t rand32_no_zero_bytes(void)
+//open the random source; must be done before any worker threads are started
+static void openRandom(void)
 {
-    uint32_t i, v;
-    uint8_t byte;
-
     if (!urandom) {
         urandom = fopen("/dev/urandom", "rb");
         if (!urandom) {
@@ -93,6 +91,15 @@ static uint32_t rand32_no_zero_bytes(void)
             exit(-2);
         }
     }
+}
+
+//provide a random number for which the following property is true ((ret & 0xFF000000) && (ret & 0xFF0000) && (ret & 0xFF00) && (ret & 0xFF))
+static uint32_t rand32_no_zero_bytes(void)
+{
+    uint32_t i, v;
+    uint8_t byte;
+
+    openRandom();
 
     for (v = 0, i = 0; i < 4; i++) {
         do {
@@ -118,9 +125,30 @@ struct RsaData {
     uint32_t num[RSA_LIMBS];
     uint32_t exponent[RSA_LIMBS];
     uint32_t modulus[RSA_LIMBS];
+    struct RsaCrtKey crt;
+    bool haveCrt;
     struct RsaState state;
 };
 
+struct SignOpts {
+    bool verbose;
+    bool sign;
+    bool verify;
+    bool txt2bin;
+    bool crt2bin;
+    bool bareData;
+};
+
+struct SignBatch {
+    const struct RsaData *rsa;
+    const struct SignOpts *opts;
+};
+
+struct SignWorker {
+    struct RsaData rsa;
+    const struct SignOpts *opts;
+};
+
 static bool validateSignature(uint8_t *sigPack, struct RsaData *rsa, bool verbose, uint32_t *refHash, bool preset)
 {
     int i;
@@ -188,15 +216,17 @@ static bool validateSignature(uint8_t *sigPack, struct RsaData *rsa, bool verbos
 
 #define SIGNATURE_BLOCK_SIZE    (2 * RSA_BYTES)
 
-static int handleConvertKey(uint8_t **pbuf, uint32_t bufUsed, FILE *out, struct RsaData *rsa)
+static int handleConvertKey(uint8_t **pbuf, uint32_t bufUsed, FILE *out, struct RsaData *rsa, uint32_t limbs, bool pad)
 {
     bool  haveNonzero = false;
     uint8_t *buf = *pbuf;
+    uint8_t bytes[RSA_BYTES];
+    uint32_t size = sizeof(uint32_t[limbs]);
+    uint32_t pos = 0, len = 0, be32;
     int i, c;
-    uint32_t pos = 0;
     int ret;
 
-    for (i = 0; i < (int)RSA_BYTES; i++) {
+    while (len < size) {
 
         //get a byte, skipping all zeroes (openssl likes to prepend one at times)
         do {
@@ -204,20 +234,27 @@ static int handleConvertKey(uint8_t **pbuf, uint32_t bufUsed, FILE *out, struct
         } while (c == 0 && !haveNonzero);
         haveNonzero = true;
         if (c < 0) {
+            //CRT components may be a few bytes shorter than half the modulus; they get left-padded
+            if (pad && len && pos == bufUsed)
+                break;
             fprintf(stderr, "Invalid text RSA input data\n");
             return 2;
         }
 
-        buf[i] = c;
+        bytes[len++] = c;
     }
 
-    // change form BE to native; ignore alignment
-    uint32_t *be32Buf = (uint32_t*)buf;
-    for (i = 0; i < RSA_LIMBS; i++)
-        rsa->num[RSA_LIMBS - i - 1] = be32toh(be32Buf[i]);
+    memmove(bytes + size - len, bytes, len);
+    memset(bytes, 0, size - len);
+
+    // change form BE to native
+    for (i = 0; i < (int)limbs; i++) {
+        memcpy(&be32, bytes + i * sizeof(be32), sizeof(be32));
+        rsa->num[limbs - i - 1] = be32toh(be32);
+    }
 
     //output in our binary format (little-endian)
-    ret = fwrite(rsa->num, 1, RSA_BYTES, out) == RSA_BYTES ? 0 : 2;
+    ret = fwrite(rsa->num, 1, sizeof(uint32_t[limbs]), out) == sizeof(uint32_t[limbs]) ? 0 : 2;
     fprintf(stderr, "Conversion status: %d\n", ret);
 
     return ret;
@@ -381,7 +418,10 @@ static int handleSign(uint8_t **pbuf, uint32_t bufUsed, FILE *out, struct RsaDat
 
     //do the RSA thing
     fprintf(stderr, "Retriculating splines...");
-    rsaResult = rsaPrivOp(&rsa->state, rsa->num, rsa->exponent, rsa->modulus);
+    if (rsa->haveCrt)
+        rsaResult = rsaPrivOpCrt(&rsa->state, rsa->num, &rsa->crt);
+    else
+        rsaResult = rsaPrivOp(&rsa->state, rsa->num, rsa->exponent, rsa->modulus);
     fprintf(stderr, "DONE\n");
 
     //update the user
@@ -399,6 +439,91 @@ static int handleSign(uint8_t **pbuf, uint32_t bufUsed, FILE *out, struct RsaDat
 
 }
 
+//load input file and make sure it is something we know how to handle; returns NULL if not
+static uint8_t *loadInput(const char *fileName, uint32_t *pbufUsed, const struct SignOpts *opts)
+{
+    uint8_t *buf = loadFile(fileName, pbufUsed);
+    struct ImageHeader *image = (struct ImageHeader *)buf;
+    uint32_t bufUsed = *pbufUsed;
+
+    fprintf(stderr, "Read %" PRIu32 " bytes\n", bufUsed);
+
+    if (!opts->bareData && !opts->txt2bin && !opts->crt2bin) {
+        if (bufUsed >= sizeof(*image) &&
+            image->aosp.header_version == 1 &&
+            image->aosp.magic == NANOAPP_AOSP_MAGIC &&
+            image->layout.magic == GOOGLE_LAYOUT_MAGIC) {
+            fprintf(stderr, "Found AOSP header\n");
+        } else {
+            fprintf(stderr, "Unknown binary format\n");
+            free(buf);
+            return NULL;
+        }
+    }
+
+    return buf;
+}
+
+static int handleInput(uint8_t **pbuf, uint32_t bufUsed, FILE *out, struct RsaData *rsa, const struct SignOpts *opts)
+{
+    if (opts->sign)
+        return handleSign(pbuf, bufUsed, out, rsa, opts->verbose, opts->bareData);
+    else if (opts->verify)
+        return handleVerify(pbuf, bufUsed, rsa, opts->verbose, opts->bareData);
+    else if (opts->txt2bin)
+        return handleConvertKey(pbuf, bufUsed, out, rsa, RSA_LIMBS, false);
+    else if (opts->crt2bin)
+        return handleConvertKey(pbuf, bufUsed, out, rsa, RSA_CRT_LIMBS, true);
+
+    return -1;
+}
+
+static void *signWorkerInit(void *arg)
+{
+    const struct SignBatch *batch = arg;
+    struct SignWorker *worker = reallocOrDie(NULL, sizeof(*worker));
+
+    worker->rsa = *batch->rsa; //private scratch state; keys are copied once per thread
+    worker->opts = batch->opts;
+
+    return worker;
+}
+
+static int signJob(void *ctx, const char *inName, const char *outName)
+{
+    struct SignWorker *worker = ctx;
+    uint32_t bufUsed = 0;
+    uint8_t *buf;
+    FILE *out = NULL;
+    int ret;
+
+    buf = loadInput(inName, &bufUsed, worker->opts);
+    if (!buf)
+        return 2;
+
+    if (outName && !(out = fopen(outName, "w"))) {
+        fprintf(stderr, "Failed to create/open output file: %s\n", outName);
+        ret = 2;
+    } else if (!out && !worker->opts->verify) {
+        fprintf(stderr, "No output file given for %s\n", inName);
+        ret = 2;
+    } else {
+        ret = handleInput(&buf, bufUsed, out, &worker->rsa, worker->opts);
+    }
+
+    if (out)
+        fclose(out);
+    free(buf);
+
+    return ret;
+}
+
+static const struct BatchOps signBatchOps = {
+    .workerInit = signWorkerInit,
+    .workerExit = free,
+    .job = signJob,
+};
+
 static void fatalUsage(const char *name, const char *msg, const char *arg)
 {
     if (msg && arg)
@@ -406,15 +531,20 @@ static void fatalUsage(const char *name, const char *msg, const char *arg)
     else if (msg)
         fprintf(stderr, "Error: %s\n\n", msg);
 
-    fprintf(stderr, "USAGE: %s [-v] [-e <pvt key>] [-m <pub key>] [-t] [-s] [-b] <input file> [<output file>]\n"
+    fprintf(stderr, "USAGE: %s [-v] [-e <pvt key>] [-c <crt key>] [-m <pub key>] [-t] [-s] [-b] [-p] <input file> [<output file>]\n"
+                    "       %s [options] -l <list file> [-j <threads>]\n"
                     "       -v : be verbose\n"
                     "       -b : generate binary key from text file created by OpenSSL\n"
+                    "       -p : generate binary CRT key component (prime, exponent or coefficient) from text file created by OpenSSL\n"
                     "       -s : sign post-processed file\n"
                     "       -t : verify signature of signed post-processed file\n"
                     "       -e : RSA binary private key\n"
+                    "       -c : RSA binary private key in CRT form (p, q, dp, dq, qinv; as generated by -p); used instead of -e\n"
                     "       -m : RSA binary public key\n"
                     "       -r : do not parse headers, do not generate headers (with -t, -s)\n"
-                    , name);
+                    "       -l : process all the files in the list file; each line is <input file> [<output file>]\n"
+                    "       -j : number of worker threads to use with -l (default: number of CPUs)\n"
+                    , name, name);
     exit(1);
 }
 
@@ -429,16 +559,15 @@ int main(int argc, char **argv)
     uint32_t posArgCnt = 0;
     FILE *out = NULL;
     const char *prev = NULL;
-    bool verbose = false;
-    bool sign = false;
-    bool verify = false;
-    bool txt2bin = false;
-    bool bareData = false;
+    struct SignOpts opts = { 0 };
     const char *keyPvtFile = NULL;
+    const char *keyCrtFile = NULL;
     const char *keyPubFile = NULL;
+    const char *listFile = NULL;
+    const char *threadsArg = NULL;
+    uint32_t numThreads;
     int multi = 0;
     struct RsaData rsa;
-    struct ImageHeader *image;
 
     //it might not matter, but we still like to try to cleanup after ourselves
     (void)atexit(cleanup);
@@ -447,19 +576,27 @@ int main(int argc, char **argv)
         if (argv[i][0] == '-') {
             prev = argv[i];
             if (!strcmp(argv[i], "-v"))
-                verbose = true;
+                opts.verbose = true;
             else if (!strcmp(argv[i], "-s"))
-                sign = true;
+                opts.sign = true;
             else if (!strcmp(argv[i], "-t"))
-                verify = true;
+                opts.verify = true;
             else if (!strcmp(argv[i], "-b"))
-                txt2bin = true;
+                opts.txt2bin = true;
+            else if (!strcmp(argv[i], "-p"))
+                opts.crt2bin = true;
             else if (!strcmp(argv[i], "-e"))
                 strArg = &keyPvtFile;
+            else if (!strcmp(argv[i], "-c"))
+                strArg = &keyCrtFile;
             else if (!strcmp(argv[i], "-m"))
                 strArg = &keyPubFile;
             else if (!strcmp(argv[i], "-r"))
-                bareData = true;
+                opts.bareData = true;
+            else if (!strcmp(argv[i], "-l"))
+                strArg = &listFile;
+            else if (!strcmp(argv[i], "-j"))
+                strArg = &threadsArg;
             else
                 fatalUsage(appName, "unknown argument", argv[i]);
         } else {
@@ -478,32 +615,40 @@ int main(int argc, char **argv)
     if (prev)
         fatalUsage(appName, "missing argument after", prev);
 
-    if (!posArgCnt)
+    if (!posArgCnt && !listFile)
         fatalUsage(appName, "missing input file name", NULL);
 
-    if (sign)
+    if (posArgCnt && listFile)
+        fatalUsage(appName, "positional arguments are not allowed with", "-l");
+
+    if (opts.sign)
         multi++;
-    if (verify)
+    if (opts.verify)
         multi++;
-    if (txt2bin)
+    if (opts.txt2bin)
+        multi++;
+    if (opts.crt2bin)
         multi++;
 
     if (multi != 1)
-        fatalUsage(appName, "select either -s, -t, or -b", NULL);
+        fatalUsage(appName, "select either -s, -t, -b or -p", NULL);
 
     memset(&rsa, 0, sizeof(rsa));
 
-    if (sign && !(keyPvtFile && keyPubFile))
-        fatalUsage(appName, "We need both PUB (-m) and PVT (-e) keys for signing", NULL);
+    if (opts.sign && !((keyPvtFile || keyCrtFile) && keyPubFile))
+        fatalUsage(appName, "We need both PUB (-m) and PVT (-e or -c) keys for signing", NULL);
 
-    if (verify && (!keyPubFile || keyPvtFile))
+    if (opts.verify && (!keyPubFile || keyPvtFile || keyCrtFile))
         fatalUsage(appName, "We only need PUB (-m)  key for signature checking", NULL);
 
+    if (!batchParseThreads(threadsArg, &numThreads))
+        fatalUsage(appName, "invalid number of threads", threadsArg);
+
     if (keyPvtFile) {
         if (!readFile(rsa.exponent, sizeof(rsa.exponent), keyPvtFile))
             fatalUsage(appName, "Can't read PVT key from", keyPvtFile);
 #ifdef DEBUG_KEYS
-        else if (verbose)
+        else if (opts.verbose)
             printHashRev(stderr, "RSA exponent", rsa.exponent, RSA_LIMBS);
 #endif
     }
@@ -511,26 +656,30 @@ int main(int argc, char **argv)
     if (keyPubFile) {
         if (!readFile(rsa.modulus, sizeof(rsa.modulus), keyPubFile))
             fatalUsage(appName, "Can't read PUB key from", keyPubFile);
-        else if (verbose)
+        else if (opts.verbose)
             printHashRev(stderr, "RSA modulus", rsa.modulus, RSA_LIMBS);
     }
 
-    buf = loadFile(posArg[0], &bufUsed);
-    fprintf(stderr, "Read %" PRIu32 " bytes\n", bufUsed);
+    if (keyCrtFile) {
+        if (!readFile(&rsa.crt, sizeof(rsa.crt), keyCrtFile))
+            fatalUsage(appName, "Can't read CRT key from", keyCrtFile);
+        if (!rsaCrtKeyCheck(&rsa.crt, rsa.modulus))
+            fatalUsage(appName, "CRT key does not match PUB key", keyCrtFile);
+        rsa.haveCrt = true;
+    }
 
-    image = (struct ImageHeader *)buf;
-    if (!bareData && !txt2bin) {
-        if (bufUsed >= sizeof(*image) &&
-            image->aosp.header_version == 1 &&
-            image->aosp.magic == NANOAPP_AOSP_MAGIC &&
-            image->layout.magic == GOOGLE_LAYOUT_MAGIC) {
-            fprintf(stderr, "Found AOSP header\n");
-        } else {
-            fprintf(stderr, "Unknown binary format\n");
-            return 2;
-        }
+    if (listFile) {
+        struct SignBatch batch = { .rsa = &rsa, .opts = &opts };
+
+        // the random source is shared by all the workers; make sure it is there before they start
+        openRandom();
+        return batchRun(listFile, numThreads, &signBatchOps, &batch);
     }
 
+    buf = loadInput(posArg[0], &bufUsed, &opts);
+    if (!buf)
+        return 2;
+
     if (!posArg[1])
         out = stdout;
     else
@@ -538,12 +687,7 @@ int main(int argc, char **argv)
     if (!out)
         fatalUsage(appName, "failed to create/open output file", posArg[1]);
 
-    if (sign)
-        ret = handleSign(&buf, bufUsed, out, &rsa, verbose, bareData);
-    else if (verify)
-        ret = handleVerify(&buf, bufUsed, &rsa, verbose, bareData);
-    else if (txt2bin)
-        ret = handleConvertKey(&buf, bufUsed, out, &rsa);
+    ret = handleInput(&buf, bufUsed, out, &rsa, &opts);
 
     free(buf);
     fclose(out);
@@ -16,7 +16,7 @@
 
 LOCAL_PATH := $(call my-dir)
 
-NANOTOOL_VERSION := 1.2.0
+NANOTOOL_VERSION := 1.3.0
 
 include $(CLEAR_VARS)
 
@@ -35,8 +35,10 @@ LOCAL_SRC_FILES := \
 # JSON file handling from chinook
 COMMON_UTILS_DIR := ../common
 LOCAL_SRC_FILES += \
+    $(COMMON_UTILS_DIR)/capturefile.cpp \
     $(COMMON_UTILS_DIR)/file.cpp \
-    $(COMMON_UTILS_DIR)/JSONObject.cpp
+    $(COMMON_UTILS_DIR)/JSONObject.cpp \
+    $(COMMON_UTILS_DIR)/logtokendict.cpp
 
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH)/$(COMMON_UTILS_DIR)
@@ -70,6 +70,74 @@ constexpr uint64_t kAppIdSTMicroLps22hb    = MakeAppId(kAppIdVendorSTMicro, 1);
 constexpr uint64_t kAppIdSTMicroMag40      = MakeAppId(kAppIdVendorSTMicro, 3);
 
 constexpr uint64_t kAppIdBridge = MakeAppId(kAppIdVendorGoogle, 50);
+constexpr uint64_t kAppIdHostIntf = MakeAppId(kAppIdVendorGoogle, 0);
+
+// From nanohub.h
+struct HostMsgHdrChre {
+    uint32_t eventId;
+    uint64_t appId;
+    uint8_t len;
+    uint32_t appEventId;
+    uint16_t endpoint;
+} __attribute__((packed));
+
+// From nanohubPacket.h
+#define NANOHUB_HAL_TASK_STATS (0x19)
+#define NANOHUB_HAL_BATCH_STATS (0x1A)
+#define NANOHUB_HAL_I2C_STATS (0x1B)
+
+struct NanohubHalRet {
+    uint8_t msg;
+    uint32_t status;
+} __attribute__((packed));
+
+struct NanohubHalTaskStatsEntry {
+    uint64_t appId;
+    uint16_t tid;
+    uint32_t evtCount;
+    uint32_t timerCount;
+    uint64_t cycles;
+    uint32_t maxCycles;
+    uint32_t heapUse;
+} __attribute__((packed));
+
+// HAL responses use the CHRE header, which is HostHubRawPacket followed by
+// these two fields; dataLen counts from ret onwards
+struct NanohubHalTaskStatsRsp {
+    uint32_t transactionId;
+    uint16_t hostEndpoint;
+    struct NanohubHalRet ret;
+    uint32_t cycleRate;
+    uint8_t first;
+    uint8_t count;
+    uint8_t more;
+    struct NanohubHalTaskStatsEntry entries[];
+} __attribute__((packed));
+
+struct NanohubHalBatchStatsRsp {
+    uint32_t transactionId;
+    uint16_t hostEndpoint;
+    struct NanohubHalRet ret;
+    uint64_t time;
+    uint32_t dataEvents;
+    uint32_t latencyWakeups;
+    uint32_t fifoInterrupts;
+    uint32_t suspendRaises;
+} __attribute__((packed));
+
+// ret.status is 0 if bus is an I2C master; waits are in ns
+struct NanohubHalI2cStatsRsp {
+    uint32_t transactionId;
+    uint16_t hostEndpoint;
+    struct NanohubHalRet ret;
+    uint8_t bus;
+    uint64_t time;
+    uint32_t xfers;
+    uint32_t merged;
+    uint32_t maxDepth;
+    uint64_t waitTotal;
+    uint64_t waitMax;
+} __attribute__((packed));
 
 /*
  * These classes represent events sent with event type EVT_APP_TO_HOST. This is
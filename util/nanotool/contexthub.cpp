@@ -18,9 +18,13 @@
 
 #include <cstring>
 #include <errno.h>
+#include <inttypes.h>
+#include <map>
+#include <unistd.h>
 #include <vector>
 
 #include "apptohostevent.h"
+#include "capturefile.h"
 #include "log.h"
 #include "resetreasonevent.h"
 #include "sensorevent.h"
@@ -33,6 +37,11 @@ namespace android {
 constexpr int kCalibrationTimeoutMs(10000);
 constexpr int kTestTimeoutMs(10000);
 constexpr int kBridgeVersionTimeoutMs(500);
+constexpr int kTaskStatsTimeoutMs(500);
+constexpr int kTaskStatsRefreshUs(1000000);
+constexpr uint8_t kMaxI2cBuses(3);
+constexpr int kCaptureIdleMs(1000);
+constexpr size_t kMaxEventSize(256);
 
 struct SensorTypeNames {
     SensorType sensor_type;
@@ -326,6 +335,111 @@ bool ContextHub::PrintBridgeVersion() {
     return success;
 }
 
+bool ContextHub::PrintTaskStats(unsigned int limit) {
+    using Microseconds = std::chrono::microseconds;
+
+    bool continuous = (limit == 0);
+    std::map<uint16_t, uint64_t> prev_cycles;
+    SteadyClock prev_time;
+    NanohubHalBatchStatsRsp prev_batch = {};
+    bool have_batch = true;
+    std::map<uint8_t, NanohubHalI2cStatsRsp> prev_i2c;
+    bool have_i2c = true;
+
+    do {
+        std::vector<NanohubHalTaskStatsEntry> tasks;
+        uint32_t cycle_rate;
+
+        if (!ReadTaskStats(tasks, &cycle_rate)) {
+            return false;
+        }
+
+        // CPU% is over the interval since the previous refresh, so the first
+        // table only has the totals
+        SteadyClock now = std::chrono::steady_clock::now();
+        double interval_cycles = 0.0;
+        if (!prev_cycles.empty()) {
+            auto delta = std::chrono::duration_cast<Microseconds>(now - prev_time);
+            interval_cycles = delta.count() * (cycle_rate / 1e6);
+        }
+
+        printf("%5s %-16s %10s %10s %6s %12s %10s %8s\n", "TID", "APP ID",
+               "EVENTS", "TIMERS", "CPU%", "TOTAL(ms)", "MAX(us)", "HEAP");
+        for (const NanohubHalTaskStatsEntry& task : tasks) {
+            char cpu[16] = "-";
+            auto prev = prev_cycles.find(task.tid);
+            if (interval_cycles > 0.0 && prev != prev_cycles.end()) {
+                snprintf(cpu, sizeof(cpu), "%.1f",
+                         100.0 * (task.cycles - prev->second) / interval_cycles);
+            }
+
+            printf("%5u %016" PRIx64 " %10u %10u %6s %12.1f %10.1f %8u\n",
+                   task.tid, task.appId, task.evtCount, task.timerCount, cpu,
+                   task.cycles * 1e3 / cycle_rate,
+                   task.maxCycles * 1e6 / cycle_rate, task.heapUse);
+        }
+
+        // older firmware has no batching counters; stop asking after a miss
+        NanohubHalBatchStatsRsp batch;
+        if (have_batch && (have_batch = ReadBatchStats(&batch))) {
+            if (prev_batch.time && batch.time > prev_batch.time) {
+                double secs = (batch.time - prev_batch.time) / 1e9;
+                printf("batching: %.1f FIFO interrupts/s, %.1f data events/s, "
+                       "%.1f latency wakeups/s, %u suspend raises\n",
+                       (batch.fifoInterrupts - prev_batch.fifoInterrupts) / secs,
+                       (batch.dataEvents - prev_batch.dataEvents) / secs,
+                       (batch.latencyWakeups - prev_batch.latencyWakeups) / secs,
+                       batch.suspendRaises);
+            } else {
+                printf("batching: %u FIFO interrupts, %u data events, "
+                       "%u latency wakeups, %u suspend raises\n",
+                       batch.fifoInterrupts, batch.dataEvents,
+                       batch.latencyWakeups, batch.suspendRaises);
+            }
+            prev_batch = batch;
+        }
+
+        // likewise for the I2C counters, which only master buses have
+        for (uint8_t bus = 0; have_i2c && bus < kMaxI2cBuses; bus++) {
+            NanohubHalI2cStatsRsp i2c;
+            if (!(have_i2c = ReadI2cStats(bus, &i2c)) || i2c.ret.status) {
+                continue;
+            }
+
+            auto prev = prev_i2c.find(bus);
+            if (prev != prev_i2c.end() && i2c.time > prev->second.time) {
+                double secs = (i2c.time - prev->second.time) / 1e9;
+                uint32_t xfers = i2c.xfers - prev->second.xfers;
+                printf("i2c%u: %.1f xfers/s, %.1f merged/s, %.1f us wait, "
+                       "max %.1f us, max depth %u\n", bus, xfers / secs,
+                       (i2c.merged - prev->second.merged) / secs,
+                       xfers ? (i2c.waitTotal - prev->second.waitTotal) / 1e3 / xfers : 0.0,
+                       i2c.waitMax / 1e3, i2c.maxDepth);
+            } else {
+                printf("i2c%u: %u xfers, %u merged, %.1f us wait, max %.1f us, "
+                       "max depth %u\n", bus, i2c.xfers, i2c.merged,
+                       i2c.xfers ? i2c.waitTotal / 1e3 / i2c.xfers : 0.0,
+                       i2c.waitMax / 1e3, i2c.maxDepth);
+            }
+            prev_i2c[bus] = i2c;
+        }
+        printf("\n");
+        fflush(stdout);
+
+        prev_cycles.clear();
+        for (const NanohubHalTaskStatsEntry& task : tasks) {
+            prev_cycles[task.tid] = task.cycles;
+        }
+        prev_time = now;
+
+        if (continuous || limit > 1) {
+            usleep(kTaskStatsRefreshUs);
+        }
+    } while (continuous || --limit > 0);
+
+    return true;
+}
+
 void ContextHub::PrintSensorEvents(SensorType type, int limit) {
     bool continuous = (limit == 0);
     auto event_printer = [type, &limit, continuous](const SensorEvent& event) -> bool {
@@ -356,6 +470,96 @@ void ContextHub::PrintSensorEvents(const std::vector<SensorSpec>& sensors, int l
     ReadSensorEvents(event_printer);
 }
 
+bool ContextHub::RecordEvents(const std::string& filename, unsigned int limit) {
+    bool continuous = (limit == 0);
+    CaptureWriter capture;
+    CaptureWriter::Stats stats;
+    TransportResult result;
+
+    status_t err = capture.open(filename.c_str());
+    if (err != OK) {
+        LOGE("Couldn't create capture file %s: %s", filename.c_str(),
+             strerror(-err));
+        return false;
+    }
+
+    // Nothing but a copy happens between reads, so we keep up with the hub;
+    // the file is written from the capture's own thread
+    std::vector<uint8_t> buffer(kMaxEventSize);
+    do {
+        result = ReadEvent(buffer, kCaptureIdleMs);
+        if (result == TransportResult::Success) {
+            capture.append(captureNow(), buffer.data(), buffer.size());
+        } else if (result == TransportResult::Timeout) {
+            capture.flush();
+        } else {
+            break;
+        }
+    } while (result != TransportResult::Success || continuous || --limit > 0);
+
+    err = capture.close();
+    capture.getStats(&stats);
+    if (err != OK) {
+        LOGE("Error writing capture file %s: %s", filename.c_str(),
+             strerror(-err));
+        return false;
+    }
+
+    printf("Recorded %" PRIu64 " events in %u chunks (%" PRIu64 " bytes), "
+           "at most %zu bytes waiting on the disk\n",
+           stats.records, stats.chunks, stats.bytes, stats.maxBacklog);
+    return (result == TransportResult::Success
+            || result == TransportResult::Canceled);
+}
+
+bool ContextHub::ReplayEvents(const std::string& filename,
+        const std::vector<SensorSpec>& sensors, unsigned int limit,
+        uint64_t from_ms, uint64_t to_ms) {
+    bool continuous = (limit == 0);
+    CaptureReader capture;
+    uint64_t type_mask = 0;
+
+    status_t err = capture.open(filename.c_str());
+    if (err != OK) {
+        LOGE("Couldn't open capture file %s: %s", filename.c_str(),
+             strerror(-err));
+        return false;
+    }
+
+    if (sensors.empty()) {
+        type_mask = ~0ull;
+    }
+    for (unsigned int i = 0; i < sensors.size(); i++) {
+        for (int type = 1; type < 64; type++) {
+            SensorType event_source = static_cast<SensorType>(type);
+            if (sensors[i].sensor_type == event_source
+                    || SensorTypeIsAliasOf(sensors[i].sensor_type, event_source)) {
+                type_mask |= 1ull << type;
+            }
+        }
+    }
+
+    uint64_t start = capture.header().startTime;
+    uint64_t from = start + from_ms * 1000000;
+    uint64_t to = to_ms ? start + to_ms * 1000000 : UINT64_MAX;
+
+    auto event_printer = [start, &limit, continuous](uint64_t time,
+            const uint8_t *data, size_t len) -> bool {
+        std::vector<uint8_t> buffer(data, data + len);
+        std::unique_ptr<ReadEventResponse> event =
+            ReadEventResponse::FromBytes(buffer);
+        if (!event) {
+            LOGD("Skipping unparseable event of %zu bytes", len);
+            return true;
+        }
+        printf("%12.6f %s", (time - start) / 1e9, event->ToString().c_str());
+        return (continuous || --limit > 0);
+    };
+    capture.forEach(from, to, type_mask, event_printer);
+
+    return true;
+}
+
 // Protected methods -----------------------------------------------------------
 
 bool ContextHub::CalibrateSingleSensor(const SensorSpec& sensor) {
@@ -512,6 +716,155 @@ bool ContextHub::HandleTestResult(const SensorSpec& sensor,
     }
 }
 
+bool ContextHub::ReadTaskStats(std::vector<NanohubHalTaskStatsEntry>& tasks,
+        uint32_t *cycle_rate) {
+    static uint32_t transaction_id;
+    TaskStatsRequest request;
+    bool more = true;
+
+    request.first = 0;
+    while (more) {
+        request.transaction_id = ++transaction_id;
+        TransportResult result = WriteEvent(request);
+        if (result != TransportResult::Success) {
+            LOGE("Failed to send task stats request: %d",
+                 static_cast<int>(result));
+            return false;
+        }
+
+        bool success = false;
+        auto event_handler = [&](const AppToHostEvent &event) -> bool {
+            auto rsp = reinterpret_cast<const NanohubHalTaskStatsRsp *>(
+                event.GetDataPtr());
+            size_t hdr_len = sizeof(NanohubHalTaskStatsRsp)
+                - offsetof(NanohubHalTaskStatsRsp, ret);
+
+            if (event.GetAppId() != kAppIdHostIntf) {
+                LOGD("Ignored event from unexpected app");
+            } else if (event.GetDataLen() < hdr_len
+                       || rsp->ret.msg != NANOHUB_HAL_TASK_STATS
+                       || rsp->transactionId != request.transaction_id) {
+                LOGD("Ignored unrelated message from the OS");
+            } else if (event.GetDataLen() < hdr_len
+                           + rsp->count * sizeof(NanohubHalTaskStatsEntry)) {
+                LOGE("Got short task stats response: length %u, %u tasks",
+                     event.GetDataLen(), rsp->count);
+                return false;
+            } else {
+                *cycle_rate = rsp->cycleRate;
+                for (int i = 0; i < rsp->count; i++) {
+                    tasks.push_back(rsp->entries[i]);
+                }
+                request.first = rsp->first + rsp->count;
+                more = rsp->more && rsp->count;
+                success = true;
+                return false;
+            }
+
+            return true;
+        };
+
+        ReadAppEvents(event_handler, kTaskStatsTimeoutMs);
+        if (!success) {
+            LOGE("No task stats response from the hub");
+            return false;
+        }
+    }
+
+    return *cycle_rate != 0;
+}
+
+bool ContextHub::ReadBatchStats(NanohubHalBatchStatsRsp *stats) {
+    static uint32_t transaction_id;
+    BatchStatsRequest request;
+
+    request.transaction_id = ++transaction_id;
+    TransportResult result = WriteEvent(request);
+    if (result != TransportResult::Success) {
+        LOGE("Failed to send batch stats request: %d",
+             static_cast<int>(result));
+        return false;
+    }
+
+    bool success = false;
+    auto event_handler = [&](const AppToHostEvent &event) -> bool {
+        auto rsp = reinterpret_cast<const NanohubHalBatchStatsRsp *>(
+            event.GetDataPtr());
+        size_t rsp_len = sizeof(NanohubHalBatchStatsRsp)
+            - offsetof(NanohubHalBatchStatsRsp, ret);
+
+        if (event.GetAppId() != kAppIdHostIntf) {
+            LOGD("Ignored event from unexpected app");
+        } else if (event.GetDataLen() < sizeof(NanohubHalRet)
+                   || rsp->ret.msg != NANOHUB_HAL_BATCH_STATS
+                   || rsp->transactionId != request.transaction_id) {
+            LOGD("Ignored unrelated message from the OS");
+        } else if (event.GetDataLen() < rsp_len) {
+            LOGE("Got short batch stats response: length %u",
+                 event.GetDataLen());
+            return false;
+        } else {
+            *stats = *rsp;
+            success = true;
+            return false;
+        }
+
+        return true;
+    };
+
+    ReadAppEvents(event_handler, kTaskStatsTimeoutMs);
+    if (!success) {
+        LOGD("No batch stats response from the hub");
+    }
+    return success;
+}
+
+bool ContextHub::ReadI2cStats(uint8_t bus, NanohubHalI2cStatsRsp *stats) {
+    static uint32_t transaction_id;
+    I2cStatsRequest request;
+
+    request.transaction_id = ++transaction_id;
+    request.bus = bus;
+    TransportResult result = WriteEvent(request);
+    if (result != TransportResult::Success) {
+        LOGE("Failed to send I2C stats request: %d",
+             static_cast<int>(result));
+        return false;
+    }
+
+    bool success = false;
+    auto event_handler = [&](const AppToHostEvent &event) -> bool {
+        auto rsp = reinterpret_cast<const NanohubHalI2cStatsRsp *>(
+            event.GetDataPtr());
+        size_t rsp_len = sizeof(NanohubHalI2cStatsRsp)
+            - offsetof(NanohubHalI2cStatsRsp, ret);
+
+        if (event.GetAppId() != kAppIdHostIntf) {
+            LOGD("Ignored event from unexpected app");
+        } else if (event.GetDataLen() < sizeof(NanohubHalRet)
+                   || rsp->ret.msg != NANOHUB_HAL_I2C_STATS
+                   || rsp->transactionId != request.transaction_id) {
+            LOGD("Ignored unrelated message from the OS");
+        } else if (event.GetDataLen() < rsp_len) {
+            LOGE("Got short I2C stats response: length %u",
+                 event.GetDataLen());
+            return false;
+        } else {
+            *stats = *rsp;
+            success = true;
+            return false;
+        }
+
+        return true;
+    };
+
+    ReadAppEvents(event_handler, kTaskStatsTimeoutMs);
+    if (!success) {
+        LOGD("No I2C stats response from the hub");
+    }
+    return success;
+}
+
 ContextHub::TransportResult ContextHub::ReadAppEvents(
         std::function<bool(const AppToHostEvent&)> callback, int timeout_ms) {
     using Milliseconds = std::chrono::milliseconds;
@@ -598,7 +951,7 @@ ContextHub::TransportResult ContextHub::WriteEvent(
 
 ContextHub::TransportResult ContextHub::ReadEvent(
         std::unique_ptr<ReadEventResponse>* response, int timeout_ms) {
-    std::vector<uint8_t> responseBuf(256);
+    std::vector<uint8_t> responseBuf(kMaxEventSize);
     ContextHub::TransportResult result = ReadEvent(responseBuf, timeout_ms);
     if (result == TransportResult::Success) {
         *response = ReadEventResponse::FromBytes(responseBuf);
@@ -28,6 +28,9 @@ namespace android {
 
 class AppToHostEvent;
 class SensorEvent;
+struct NanohubHalTaskStatsEntry;
+struct NanohubHalBatchStatsRsp;
+struct NanohubHalI2cStatsRsp;
 
 // Array length helper macro
 #define ARRAY_LEN(arr) (sizeof(arr) / sizeof(arr[0]))
@@ -181,6 +184,12 @@ class ContextHub : public NonCopyable {
      */
     bool PrintBridgeVersion();
 
+    /*
+     * Prints a top-style table of per-task CPU usage, refreshed once a second,
+     * <limit> times. If limit is 0, then continues indefinitely.
+     */
+    bool PrintTaskStats(unsigned int limit);
+
     /*
      * Prints up to <sample_limit> incoming sensor samples corresponding to the
      * given SensorType, ignoring other events. If sample_limit is 0, then
@@ -190,6 +199,23 @@ class ContextHub : public NonCopyable {
     void PrintSensorEvents(const std::vector<SensorSpec>& sensors,
         int sample_limit);
 
+    /*
+     * Writes everything read from the hub, unparsed, to a capture file (see
+     * capturefile.h) until <limit> events have been recorded, the read is
+     * interrupted, or indefinitely if limit is 0.
+     */
+    bool RecordEvents(const std::string& filename, unsigned int limit);
+
+    /*
+     * Prints up to <limit> events from a capture file, or all of them if limit
+     * is 0. Only events of the given sensors are printed, unless none are
+     * given, and only those from_ms to to_ms after the capture started. No hub
+     * is needed for this.
+     */
+    static bool ReplayEvents(const std::string& filename,
+        const std::vector<SensorSpec>& sensors, unsigned int limit,
+        uint64_t from_ms, uint64_t to_ms);
+
   protected:
     enum class TransportResult {
         Success,
@@ -241,6 +267,24 @@ class ContextHub : public NonCopyable {
      */
     void ReadSensorEvents(std::function<bool(const SensorEvent&)> callback);
 
+    /*
+     * Fetches the per-task accounting counters from the hub, one page of tasks
+     * per request. cycle_rate is the rate of the hub's cycle counter in Hz.
+     */
+    bool ReadTaskStats(std::vector<NanohubHalTaskStatsEntry>& tasks,
+        uint32_t *cycle_rate);
+
+    /*
+     * Fetches the hub's sensor batching counters.
+     */
+    bool ReadBatchStats(NanohubHalBatchStatsRsp *stats);
+
+    /*
+     * Fetches the I2C master counters of the given bus. Returns true if the
+     * hub answered; stats->ret.status tells whether the bus had any.
+     */
+    bool ReadI2cStats(uint8_t bus, NanohubHalI2cStatsRsp *stats);
+
     /*
      * Sends the given calibration data down to the hub
      */
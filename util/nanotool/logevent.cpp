@@ -21,6 +21,8 @@ namespace android {
 
 /* LogEvent *******************************************************************/
 
+LogTokenDict LogEvent::token_dict_;
+
 std::unique_ptr<LogEvent> LogEvent::FromBytes(
         const std::vector<uint8_t>& buffer) {
     auto event = std::unique_ptr<LogEvent>(new LogEvent());
@@ -37,6 +39,14 @@ std::string LogEvent::GetMessage() const {
     if (event_data.size() < kHeaderSize) {
         LOGW("Invalid/short LogEvent event of size %zu", event_data.size());
         return std::string();
+    } else if (event_data[sizeof(uint32_t)] == LOG_TOKEN_MARK) {
+        std::string message;
+        auto append = [&message](char /* level */, const std::string& text) {
+            message += text;
+        };
+        token_dict_.decode(event_data.data() + sizeof(uint32_t) + sizeof(char),
+            event_data.size() - sizeof(uint32_t) - sizeof(char), append);
+        return message;
     } else {
         const char *message = reinterpret_cast<const char *>(
             event_data.data() + sizeof(uint32_t));
@@ -44,4 +54,8 @@ std::string LogEvent::GetMessage() const {
     }
 }
 
+bool LogEvent::LoadTokenDictionary(const char *path) {
+    return token_dict_.load(path) == OK;
+}
+
 }  // namespace android
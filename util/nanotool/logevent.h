@@ -17,6 +17,7 @@
 #ifndef LOG_EVENT_H_
 #define LOG_EVENT_H_
 
+#include "logtokendict.h"
 #include "nanomessage.h"
 
 namespace android {
@@ -34,6 +35,13 @@ class LogEvent : public ReadEventResponse {
 
     // Returns a string containing the contents of the log message.
     std::string GetMessage() const;
+
+    // Loads the dictionary used to rebuild tokenized log messages; see
+    // logtokendict.h.
+    static bool LoadTokenDictionary(const char *path);
+
+  private:
+    static LogTokenDict token_dict_;
 };
 
 }  // namespace android
@@ -262,4 +262,99 @@ std::string BridgeVersionInfoRequest::ToString() const {
     return std::string("Bridge version info request\n");
 }
 
+/* TaskStatsRequest ***********************************************************/
+
+std::vector<uint8_t> TaskStatsRequest::GetBytes() const {
+    struct TaskStatsRequestEvent {
+        struct HostMsgHdrChre hdr;
+        uint8_t msg;
+        uint8_t first;
+    } __attribute__((packed));
+
+    std::vector<uint8_t> buffer(sizeof(TaskStatsRequestEvent));
+
+    std::fill(buffer.begin(), buffer.end(), 0);
+    auto event = reinterpret_cast<TaskStatsRequestEvent *>(buffer.data());
+    event->hdr.eventId    = static_cast<uint32_t>(EventType::AppFromHostChreEvent);
+    event->hdr.appId      = kAppIdHostIntf;
+    event->hdr.len        = sizeof(event->msg) + sizeof(event->first);
+    event->hdr.appEventId = transaction_id;
+    event->msg            = NANOHUB_HAL_TASK_STATS;
+    event->first          = first;
+
+    return buffer;
+}
+
+EventType TaskStatsRequest::GetEventType() const {
+    return EventType::AppFromHostChreEvent;
+}
+
+std::string TaskStatsRequest::ToString() const {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "Task stats request from task %u\n", first);
+    return std::string(buffer);
+}
+
+/* BatchStatsRequest **********************************************************/
+
+std::vector<uint8_t> BatchStatsRequest::GetBytes() const {
+    struct BatchStatsRequestEvent {
+        struct HostMsgHdrChre hdr;
+        uint8_t msg;
+    } __attribute__((packed));
+
+    std::vector<uint8_t> buffer(sizeof(BatchStatsRequestEvent));
+
+    std::fill(buffer.begin(), buffer.end(), 0);
+    auto event = reinterpret_cast<BatchStatsRequestEvent *>(buffer.data());
+    event->hdr.eventId    = static_cast<uint32_t>(EventType::AppFromHostChreEvent);
+    event->hdr.appId      = kAppIdHostIntf;
+    event->hdr.len        = sizeof(event->msg);
+    event->hdr.appEventId = transaction_id;
+    event->msg            = NANOHUB_HAL_BATCH_STATS;
+
+    return buffer;
+}
+
+EventType BatchStatsRequest::GetEventType() const {
+    return EventType::AppFromHostChreEvent;
+}
+
+std::string BatchStatsRequest::ToString() const {
+    return std::string("Batch stats request\n");
+}
+
+/* I2cStatsRequest ************************************************************/
+
+std::vector<uint8_t> I2cStatsRequest::GetBytes() const {
+    struct I2cStatsRequestEvent {
+        struct HostMsgHdrChre hdr;
+        uint8_t msg;
+        uint8_t bus;
+    } __attribute__((packed));
+
+    std::vector<uint8_t> buffer(sizeof(I2cStatsRequestEvent));
+
+    std::fill(buffer.begin(), buffer.end(), 0);
+    auto event = reinterpret_cast<I2cStatsRequestEvent *>(buffer.data());
+    event->hdr.eventId    = static_cast<uint32_t>(EventType::AppFromHostChreEvent);
+    event->hdr.appId      = kAppIdHostIntf;
+    event->hdr.len        = sizeof(event->msg) + sizeof(event->bus);
+    event->hdr.appEventId = transaction_id;
+    event->msg            = NANOHUB_HAL_I2C_STATS;
+    event->bus            = bus;
+
+    return buffer;
+}
+
+EventType I2cStatsRequest::GetEventType() const {
+    return EventType::AppFromHostChreEvent;
+}
+
+std::string I2cStatsRequest::ToString() const {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "I2C stats request for bus %u\n", bus);
+    return std::string(buffer);
+}
+
 }  // namespace android
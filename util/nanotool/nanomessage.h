@@ -31,6 +31,7 @@ namespace android {
  */
 enum class EventType {
     AppFromHostEvent = 0x000000F8,
+    AppFromHostChreEvent = 0x000000F9,
     FirstSensorEvent = 0x00000200,
     LastSensorEvent  = 0x000002FF,
     ConfigureSensor  = 0x00000300,
@@ -202,6 +203,47 @@ class BridgeVersionInfoRequest : public WriteEventRequest {
     std::string ToString() const override;
 };
 
+/*
+ * Asks the OS for one page of per-task CPU accounting, starting at task index
+ * first. The response echoes transaction_id.
+ */
+class TaskStatsRequest : public WriteEventRequest {
+  public:
+    std::vector<uint8_t> GetBytes() const override;
+    EventType GetEventType() const override;
+    std::string ToString() const override;
+
+    uint32_t transaction_id = 0;
+    uint8_t first = 0;
+};
+
+/*
+ * Asks the OS for its sensor batching counters. The response echoes
+ * transaction_id.
+ */
+class BatchStatsRequest : public WriteEventRequest {
+  public:
+    std::vector<uint8_t> GetBytes() const override;
+    EventType GetEventType() const override;
+    std::string ToString() const override;
+
+    uint32_t transaction_id = 0;
+};
+
+/*
+ * Asks the OS for the master transfer counters of one I2C bus. The response
+ * echoes transaction_id.
+ */
+class I2cStatsRequest : public WriteEventRequest {
+  public:
+    std::vector<uint8_t> GetBytes() const override;
+    EventType GetEventType() const override;
+    std::string ToString() const override;
+
+    uint32_t transaction_id = 0;
+    uint8_t bus = 0;
+};
+
 }  // namespace android
 
 #endif  // NANOMESSAGE_H_
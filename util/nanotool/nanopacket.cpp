@@ -19,6 +19,7 @@
 namespace android {
 
 constexpr uint8_t kSyncByte(0x31);
+constexpr uint8_t kSyncByteJumbo(0x32);
 
 // CRC constants.
 constexpr uint32_t kInitialCrc(0xffffffff);
@@ -118,6 +119,8 @@ void NanoPacket::Reset() {
     parsing_progress_ = 0;
     sequence_number_ = 0;
     reason_ = 0;
+    jumbo_ = false;
+    length_ = 0;
     packet_content_.clear();
     crc_ = 0;
 }
@@ -142,6 +145,10 @@ const std::vector<uint8_t>& NanoPacket::packet_content() const {
     return packet_content_;
 }
 
+bool NanoPacket::is_jumbo() const {
+    return jumbo_;
+}
+
 NanoPacket::ParseResult NanoPacket::Parse(uint8_t *buffer, size_t length,
         size_t *bytes_parsed) {
     for (size_t i = 0; i < length; i++) {
@@ -152,8 +159,10 @@ NanoPacket::ParseResult NanoPacket::Parse(uint8_t *buffer, size_t length,
         }
 
         // Proceed through the various states of protocol parsing.
-        if (parsing_state_ == ParsingState::Idle && buffer[i] == kSyncByte) {
+        if (parsing_state_ == ParsingState::Idle
+                && (buffer[i] == kSyncByte || buffer[i] == kSyncByteJumbo)) {
             packet_buffer_.push_back(buffer[i]);
+            jumbo_ = (buffer[i] == kSyncByteJumbo);
             parsing_state_ = ParsingState::ParsingSequenceNumber;
         } else if (parsing_state_ == ParsingState::ParsingSequenceNumber
                 && DeserializeWord(&sequence_number_, buffer[i])) {
@@ -162,9 +171,15 @@ NanoPacket::ParseResult NanoPacket::Parse(uint8_t *buffer, size_t length,
                 && DeserializeWord(&reason_, buffer[i])) {
             parsing_state_ = ParsingState::ParsingLength;
         } else if (parsing_state_ == ParsingState::ParsingLength) {
-            uint8_t length = buffer[i];
-            if (length > 0) {
-                packet_content_.resize(buffer[i]);
+            // Jumbo packets carry a little-endian 16-bit length.
+            if (jumbo_ && !DeserializeWord(&length_, buffer[i])) {
+                continue;
+            } else if (!jumbo_) {
+                length_ = buffer[i];
+            }
+
+            if (length_ > 0) {
+                packet_content_.resize(length_);
                 parsing_state_ = ParsingState::ParsingContent;
             } else {
                 parsing_state_ = ParsingState::ParsingCrc;
@@ -35,6 +35,7 @@ enum class PacketReason : uint32_t {
     GetHardwareVersion = 0x00001000,
     ReadEventRequest   = 0x00001090,
     WriteEventRequest  = 0x00001091,
+    ReadEventJumboRequest = 0x00001092,
 };
 
 /*
@@ -81,6 +82,10 @@ class NanoPacket : public NonCopyable {
     // Obtains the data content of the packet.
     const std::vector<uint8_t>& packet_content() const;
 
+    // Indicates that the packet was framed with a 16-bit length, as only the
+    // replies to jumbo requests are.
+    bool is_jumbo() const;
+
   private:
     /*
      * The current state of the parser.
@@ -103,6 +108,8 @@ class NanoPacket : public NonCopyable {
     // Parsed protocol fields.
     uint32_t sequence_number_;
     uint32_t reason_;
+    bool jumbo_;
+    uint16_t length_;
     std::vector<uint8_t> packet_content_;
     uint32_t crc_;
 
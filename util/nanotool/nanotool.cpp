@@ -49,6 +49,15 @@ enum class NanotoolCommand {
     LoadCalibration,
     Flash,
     GetBridgeVer,
+    Top,
+    Record,
+    Replay,
+};
+
+// Long-only options
+enum {
+    kOptRecord = 256,
+    kOptReplay,
 };
 
 struct ParsedArgs {
@@ -58,6 +67,8 @@ struct ParsedArgs {
     bool logging_enabled = false;
     std::string filename;
     int device_index = 0;
+    uint64_t from_ms = 0;
+    uint64_t to_ms = 0;
 };
 
 static NanotoolCommand StrToCommand(const char *command_name) {
@@ -72,6 +83,9 @@ static NanotoolCommand StrToCommand(const char *command_name) {
         std::make_tuple("load_cal",    NanotoolCommand::LoadCalibration),
         std::make_tuple("flash",       NanotoolCommand::Flash),
         std::make_tuple("bridge_ver",  NanotoolCommand::GetBridgeVer),
+        std::make_tuple("top",         NanotoolCommand::Top),
+        std::make_tuple("record",      NanotoolCommand::Record),
+        std::make_tuple("replay",      NanotoolCommand::Replay),
     };
 
     if (!command_name) {
@@ -110,6 +124,14 @@ static void PrintUsage(const char *name) {
         "                           events, then disable the sensor before exiting\n"
         "                        read: output events for the given sensor, or all events\n"
         "                           if no sensor specified\n"
+        "                        record: write all events to a capture file (-f),\n"
+        "                           enabling the given sensors first, until the\n"
+        "                           count is reached or interrupted\n"
+        "                        replay: output events from a capture file (-f), for\n"
+        "                           the given sensors or all of them\n"
+        "                        top: show per-task event counts, CPU time and heap\n"
+        "                           use, FIFO interrupts, batching wakeups and I2C\n"
+        "                           transfers per second, refreshed once a second\n"
         "\n"
         "  -s, --sensor       Specify sensor type, and parameters for the command.\n"
         "                     Format is sensor_type[:rate[:latency_ms]][=cal_ref].\n"
@@ -125,10 +147,20 @@ static void PrintUsage(const char *name) {
         "                     multiple sensors.\n"
         "\n"
         "  -c, --count        Number of samples to read before exiting, or set to 0 to\n"
-        "                     read indefinitely (the default behavior)\n"
+        "                     read indefinitely (the default behavior). For top, the\n"
+        "                     number of refreshes; for record and replay, the number\n"
+        "                     of events.\n"
         "\n"
         "  -f, --file\n"
-        "                     Specifies the file to be used with flash.\n"
+        "                     Specifies the file to be used with flash, record and\n"
+        "                     replay.\n"
+        "\n"
+        "  --record FILE      Same as -x record -f FILE\n"
+        "  --replay FILE      Same as -x replay -f FILE\n"
+        "\n"
+        "  -t, --time         Replay window, as from_ms[:to_ms] after the capture\n"
+        "                     started. Seeks straight to it rather than reading the\n"
+        "                     whole file.\n"
         "\n"
         "  -l, --log          Outputs logs from the sensor hub as they become available.\n"
         "                     The logs will be printed inline with sensor samples.\n"
@@ -150,8 +182,10 @@ static void PrintUsage(const char *name) {
                     "  %s -s accel:50\n"
                     "  %s -s accel:50:1000 -s gyro:50:1000\n"
                     "  %s -s prox:onchange\n"
-                    "  %s -x calibrate -s baro=1000\n",
-            name, name, name, name);
+                    "  %s -x calibrate -s baro=1000\n"
+                    "  %s --record accel.cap -s accel:200\n"
+                    "  %s --replay accel.cap -t 60000:70000\n",
+            name, name, name, name, name, name);
 }
 
 /*
@@ -171,7 +205,9 @@ static bool ValidateArgs(std::unique_ptr<ParsedArgs>& args, const char *name) {
         return false;
     }
 
-    if (args->command == NanotoolCommand::Flash
+    if ((args->command == NanotoolCommand::Flash
+                || args->command == NanotoolCommand::Record
+                || args->command == NanotoolCommand::Replay)
             && args->filename.empty()) {
         fprintf(stderr, "%s: A filename must be specified for this command "
                         "(use -f)\n",
@@ -179,7 +215,8 @@ static bool ValidateArgs(std::unique_ptr<ParsedArgs>& args, const char *name) {
         return false;
     }
 
-    if (args->command == NanotoolCommand::Poll) {
+    if (args->command == NanotoolCommand::Poll
+            || args->command == NanotoolCommand::Record) {
         for (unsigned int i = 0; i < args->sensors.size(); i++) {
             if (args->sensors[i].special_rate == SensorSpecialRate::None
                   && args->sensors[i].rate_hz < 0) {
@@ -207,6 +244,11 @@ static bool ValidateArgs(std::unique_ptr<ParsedArgs>& args, const char *name) {
         }
     }
 
+    if (args->to_ms && args->to_ms <= args->from_ms) {
+        fprintf(stderr, "%s: Replay window must end after it starts\n", name);
+        return false;
+    }
+
     return true;
 }
 
@@ -294,6 +336,31 @@ static bool ParseSensorArg(std::vector<SensorSpec>& sensors, const char *arg_str
     return true;
 }
 
+// Parse a replay window in the form of "from_ms[:to_ms]"
+static bool ParseTimeArg(std::unique_ptr<ParsedArgs>& args, const char *arg_str,
+        const char *name) {
+    std::string param;
+    std::stringstream arg_ss(arg_str);
+    unsigned int index = 0;
+
+    while (std::getline(arg_ss, param, ':')) {
+        long long time_ms = std::stoll(param);
+        if (time_ms < 0 || index > 1) {
+            fprintf(stderr, "%s: Invalid time window %s\n", name, arg_str);
+            return false;
+        }
+
+        if (index == 0) {
+            args->from_ms = static_cast<uint64_t>(time_ms);
+        } else {
+            args->to_ms = static_cast<uint64_t>(time_ms);
+        }
+        index++;
+    }
+
+    return true;
+}
+
 static std::unique_ptr<ParsedArgs> ParseArgs(int argc, char **argv) {
     static const struct option long_opts[] = {
         {"cmd",     required_argument, nullptr, 'x'},
@@ -302,13 +369,16 @@ static std::unique_ptr<ParsedArgs> ParseArgs(int argc, char **argv) {
         {"flash",   required_argument, nullptr, 'f'},
         {"log",     no_argument,       nullptr, 'l'},
         {"index",   required_argument, nullptr, 'i'},
+        {"time",    required_argument, nullptr, 't'},
+        {"record",  required_argument, nullptr, kOptRecord},
+        {"replay",  required_argument, nullptr, kOptReplay},
         {}  // Indicates the end of the option list
     };
 
     auto args = std::unique_ptr<ParsedArgs>(new ParsedArgs());
     int index = 0;
     while (42) {
-        int c = getopt_long(argc, argv, "x:s:c:f:v::li:", long_opts, &index);
+        int c = getopt_long(argc, argv, "x:s:c:f:v::li:t:", long_opts, &index);
         if (c == -1) {
             break;
         }
@@ -367,6 +437,19 @@ static std::unique_ptr<ParsedArgs> ParseArgs(int argc, char **argv) {
             }
             break;
           }
+          case 't': {
+            if (!ParseTimeArg(args, optarg, argv[0])) {
+                return nullptr;
+            }
+            break;
+          }
+          case kOptRecord:
+          case kOptReplay: {
+            args->command = (c == kOptRecord) ? NanotoolCommand::Record
+                                              : NanotoolCommand::Replay;
+            args->filename = std::string(optarg);
+            break;
+          }
           default:
             return nullptr;
         }
@@ -429,6 +512,12 @@ int main(int argc, char **argv) {
     SetHandlers();
 #endif
 
+    // Replaying only needs the capture file, not a hub
+    if (args->command == NanotoolCommand::Replay) {
+        return ContextHub::ReplayEvents(args->filename, args->sensors,
+            args->count, args->from_ms, args->to_ms) ? 0 : -1;
+    }
+
     std::unique_ptr<ContextHub> hub = GetContextHub(args);
     if (!hub || !hub->Initialize()) {
         LOGE("Error initializing ContextHub");
@@ -488,6 +577,17 @@ int main(int argc, char **argv) {
         success = hub->PrintBridgeVersion();
         break;
       }
+      case NanotoolCommand::Top: {
+        success = hub->PrintTaskStats(args->count);
+        break;
+      }
+      case NanotoolCommand::Record: {
+        success = hub->EnableSensors(args->sensors);
+        if (success) {
+            success = hub->RecordEvents(args->filename, args->count);
+        }
+        break;
+      }
       default:
         LOGE("Command not implemented");
         return 1;
@@ -497,7 +597,9 @@ int main(int argc, char **argv) {
         LOGE("Command failed");
         return -1;
     } else if (args->command != NanotoolCommand::Read
-                   && args->command != NanotoolCommand::Poll) {
+                   && args->command != NanotoolCommand::Poll
+                   && args->command != NanotoolCommand::Top
+                   && args->command != NanotoolCommand::Record) {
         printf("Operation completed successfully\n");
     }
 
@@ -23,6 +23,7 @@ LOCAL_SHARED_LIBRARIES := libcutils libc
 LOCAL_SRC_FILES := \
         flash.c \
         i2c.c \
+        loopback.c \
         spi.c \
         stm32_bl.c \
         stm32f4_crc.c \
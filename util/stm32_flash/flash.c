@@ -30,13 +30,17 @@
 #include "stm32_bl.h"
 #include "stm32f4_crc.h"
 #include "i2c.h"
+#include "loopback.h"
 #include "spi.h"
 #include "uart.h"
 
+#define FLASH_BASE 0x08000000
+
 enum USE_INTERFACE {
     USE_SPI,
     USE_I2C,
     USE_UART,
+    USE_LOOPBACK,
 };
 
 static inline size_t pad(ssize_t length)
@@ -50,6 +54,135 @@ static inline size_t tot_len(ssize_t length)
     return sizeof(uint32_t) + pad(length) + sizeof(uint32_t);
 }
 
+/*
+ * STM32F4 flash layout: 4 x 16K, 1 x 64K, then 128K sectors
+ * returns sector number containing addr, or -1 if addr is not in flash
+ */
+static int flash_sector(uint32_t addr, uint32_t *start, uint32_t *size)
+{
+    uint32_t offset = addr - FLASH_BASE;
+
+    if (addr < FLASH_BASE || offset >= 0x00100000)
+        return -1;
+
+    if (offset < 0x00010000) {
+        *start = FLASH_BASE + (offset & ~0x3FFF);
+        *size = 0x4000;
+        return offset >> 14;
+    } else if (offset < 0x00020000) {
+        *start = FLASH_BASE + 0x00010000;
+        *size = 0x00010000;
+        return 4;
+    } else {
+        *start = FLASH_BASE + (offset & ~0x1FFFF);
+        *size = 0x00020000;
+        return 4 + (offset >> 17);
+    }
+}
+
+/*
+ * read back length bytes at address and compare them with data, one
+ * bootloader read at a time so a mismatch stops the read early.
+ * buffer must hold length bytes, and is left with what was read.
+ * returns 0 if they match, 1 if not, or -1 if a read failed
+ */
+static int compare_memory(handle_t *handle, uint32_t address,
+                          uint32_t length, uint8_t *data, uint8_t *buffer)
+{
+    uint32_t offset, chunk;
+
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = length - offset >= 256 ? 256 : length - offset;
+        if (read_memory(handle, address + offset, chunk, &buffer[offset]) != CMD_ACK)
+            return -1;
+        if (memcmp(&buffer[offset], &data[offset], chunk))
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * write only the sectors whose contents differ from the image. Only the
+ * part of each sector covered by the image is read back, up to the first
+ * difference; unchanged sectors are neither erased nor written. Changed
+ * sectors get the rest of their old contents read, then are erased and
+ * rewritten with the image merged in, skipping chunks left erased.
+ */
+static uint8_t write_changed_sectors(handle_t *handle, uint32_t address,
+                                     uint32_t length, uint8_t *data)
+{
+    uint32_t pos = address, end = address + length;
+    uint32_t start, size, chunk, tail;
+    uint8_t *sector_buf;
+    uint8_t ret = CMD_ACK;
+    int sector, diff;
+
+    while (ret == CMD_ACK && pos < end) {
+        sector = flash_sector(pos, &start, &size);
+        if (sector < 0) {
+            printf("Address 0x%08x is not in flash\n", pos);
+            return CMD_NACK;
+        }
+
+        sector_buf = malloc(size);
+        if (!sector_buf) {
+            perror("Error allocating sector buffer");
+            return CMD_NACK;
+        }
+
+        chunk = (end < start + size ? end : start + size) - pos;
+        tail = start + size - (pos + chunk);
+        diff = compare_memory(handle, pos, chunk, &data[pos - address],
+                              &sector_buf[pos - start]);
+        if (diff < 0) {
+            ret = CMD_NACK;
+        } else if (!diff) {
+            printf("Sector %d unchanged\n", sector);
+        } else {
+            /* keep whatever is in the sector around the image */
+            ret = read_memory(handle, start, pos - start, sector_buf);
+            if (ret == CMD_ACK)
+                ret = read_memory(handle, pos + chunk, tail,
+                                  &sector_buf[pos + chunk - start]);
+            if (ret == CMD_ACK) {
+                printf("Sector %d changed, rewriting\n", sector);
+                memcpy(&sector_buf[pos - start], &data[pos - address], chunk);
+                ret = erase_sector(handle, sector);
+                if (ret == CMD_ACK)
+                    ret = write_memory_erased(handle, start, size, sector_buf);
+            }
+        }
+        if (ret != CMD_ACK)
+            printf("Update of sector %d failed\n", sector);
+
+        free(sector_buf);
+        pos = start + size;
+    }
+
+    return ret;
+}
+
+/* read back what was written and compare it with the source data */
+static uint8_t verify_memory(handle_t *handle, uint32_t address,
+                             uint32_t length, uint8_t *data)
+{
+    uint8_t *read_buf;
+    uint8_t ret;
+
+    read_buf = malloc(length);
+    if (!read_buf) {
+        perror("Error allocating verify buffer");
+        return CMD_NACK;
+    }
+
+    ret = compare_memory(handle, address, length, data, read_buf) ? CMD_NACK : CMD_ACK;
+
+    free(read_buf);
+
+    return ret;
+}
+
 ssize_t write_byte(int fd, uint8_t byte)
 {
     ssize_t ret;
@@ -73,8 +206,9 @@ int main(int argc, char *argv[])
     i2c_handle_t i2c_handle;
     spi_handle_t spi_handle;
     uart_handle_t uart_handle;
+    loopback_handle_t loopback_handle;
     handle_t *handle;
-    char options[] = "d:e:w:a:t:r:l:g:csiu";
+    char options[] = "d:e:w:a:t:r:l:g:b:csiuxv";
     char *dev = device;
     int opt;
     uint32_t address = 0x08000000;
@@ -82,11 +216,15 @@ int main(int argc, char *argv[])
     char *read_filename = NULL;
     int sector = -1;
     int do_crc = 0;
+    int do_changed = 0;
+    int do_verify = 0;
+    uint8_t *write_buffer;
+    uint32_t write_length;
     uint8_t type = 0x11;
     ssize_t length = 0;
     uint8_t ret;
     int use_iface = USE_SPI;
-    int fd;
+    int fd = -1;
     int gpio;
     FILE *file;
     int val;
@@ -97,6 +235,7 @@ int main(int argc, char *argv[])
         printf("  -s (use spi. default)\n");
         printf("  -i (use i2c)\n");
         printf("  -u (use uart)\n");
+        printf("  -b <filename> (use a simulated bootloader with flash kept in filename)\n");
         printf("  -g <gpio> (reset gpio. default: %d)\n", gpio_nreset);
         printf("  -d <device> (device. default: %s)\n", device);
         printf("  -e <sector> (sector to erase)\n");
@@ -107,6 +246,8 @@ int main(int argc, char *argv[])
                address);
         printf("  -c (add type, length, file contents, and CRC)\n");
         printf("  -t <type> (type value for -c option. default: %d)\n", type);
+        printf("  -x (with -w: only erase and write sectors that differ from the file)\n");
+        printf("  -v (with -w: read back and compare written data)\n");
         return 0;
     }
 
@@ -145,32 +286,44 @@ int main(int argc, char *argv[])
         case 'u':
             use_iface = USE_UART;
             break;
+        case 'b':
+            use_iface = USE_LOOPBACK;
+            dev = optarg;
+            break;
         case 'g':
             gpio_nreset = strtol(optarg, NULL, 0);
             break;
+        case 'x':
+            do_changed = 1;
+            break;
+        case 'v':
+            do_verify = 1;
+            break;
         }
     }
 
     if (use_iface == USE_UART)
         fd = open(dev, O_RDWR | O_NOCTTY | O_NDELAY);
-    else
+    else if (use_iface != USE_LOOPBACK)
         fd = open(dev, O_RDWR);
-    if (fd < 0) {
+    if (fd < 0 && use_iface != USE_LOOPBACK) {
         perror("Error opening dev");
         return -1;
     }
 
     snprintf(gpio_dev, sizeof(gpio_dev), "/sys/class/gpio/gpio%d/value", gpio_nreset);
-    gpio = open(gpio_dev, O_WRONLY);
-    if (gpio < 0) {
-        perror("Error opening nreset gpio");
-    } else {
-        if (write_byte(gpio, '1') < 0)
-            perror("Failed to set gpio to 1");
-        close(gpio);
-        ts.tv_sec = 0;
-        ts.tv_nsec = 200000000;
-        nanosleep(&ts, NULL);
+    if (use_iface != USE_LOOPBACK) {
+        gpio = open(gpio_dev, O_WRONLY);
+        if (gpio < 0) {
+            perror("Error opening nreset gpio");
+        } else {
+            if (write_byte(gpio, '1') < 0)
+                perror("Failed to set gpio to 1");
+            close(gpio);
+            ts.tv_sec = 0;
+            ts.tv_nsec = 200000000;
+            nanosleep(&ts, NULL);
+        }
     }
 
     if (use_iface == USE_SPI) {
@@ -183,6 +336,11 @@ int main(int argc, char *argv[])
         uart_handle.fd = fd;
 
         val = uart_init(handle);
+    } else if (use_iface == USE_LOOPBACK) {
+        handle = &loopback_handle.handle;
+        loopback_handle.filename = dev;
+
+        val = loopback_init(handle);
     } else {
         handle = &i2c_handle.handle;
         i2c_handle.fd = fd;
@@ -248,19 +406,34 @@ int main(int argc, char *argv[])
             memcpy(&buffer[sizeof(uint32_t) + pad(length)],
                    &crc, sizeof(uint32_t));
 
-            ret = write_memory(handle, address,
-                               tot_len(length), buffer);
+            write_buffer = buffer;
+            write_length = tot_len(length);
         } else {
             /* Skip over space reserved for TYPE and LENGTH */
-            ret = write_memory(handle, address,
-                               length, &buffer[sizeof(uint32_t)]);
+            write_buffer = &buffer[sizeof(uint32_t)];
+            write_length = length;
         }
 
+        if (do_changed)
+            ret = write_changed_sectors(handle, address,
+                                        write_length, write_buffer);
+        else
+            ret = write_memory(handle, address,
+                               write_length, write_buffer);
+
         if (ret == CMD_ACK)
             printf("Write succeeded\n");
         else
             printf("Write failed\n");
 
+        if (ret == CMD_ACK && do_verify) {
+            ret = verify_memory(handle, address, write_length, write_buffer);
+            if (ret == CMD_ACK)
+                printf("Verify succeeded\n");
+            else
+                printf("Verify failed\n");
+        }
+
         free(buffer);
         fclose(file);
     }
@@ -325,6 +498,9 @@ int main(int argc, char *argv[])
         fclose(file);
     }
 
+    if (use_iface == USE_LOOPBACK)
+        return loopback_close(handle);
+
     gpio = open(gpio_dev, O_WRONLY);
     if (gpio < 0) {
         perror("Error opening nreset gpio");
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "loopback.h"
+
+enum LOOPBACK_STATE {
+    LB_IDLE,
+    LB_READ_ADDR,
+    LB_READ_LEN,
+    LB_READ_DATA,
+    LB_WRITE_ADDR,
+    LB_WRITE_DATA,
+    LB_ERASE_CNT,
+    LB_ERASE_SECTOR,
+};
+
+/* 4 x 16K, 1 x 64K, then 128K sectors */
+static int sector_range(uint16_t sector, uint32_t *offset, uint32_t *size)
+{
+    if (sector < 4) {
+        *offset = sector * 0x4000;
+        *size = 0x4000;
+    } else if (sector == 4) {
+        *offset = 0x00010000;
+        *size = 0x00010000;
+    } else if (sector < 12) {
+        *offset = (sector - 4) * 0x00020000;
+        *size = 0x00020000;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int in_flash(uint32_t addr, uint32_t len)
+{
+    return addr >= LOOPBACK_FLASH_BASE &&
+           len <= LOOPBACK_FLASH_SIZE &&
+           addr - LOOPBACK_FLASH_BASE <= LOOPBACK_FLASH_SIZE - len;
+}
+
+static uint32_t get_addr(uint8_t *buffer)
+{
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) |
+           ((uint32_t)buffer[2] <<  8) | buffer[3];
+}
+
+uint8_t loopback_write_data(handle_t *handle, uint8_t *buffer, int length)
+{
+    loopback_handle_t *lb_handle = (loopback_handle_t *)handle;
+    uint32_t offset, size;
+    uint16_t cnt;
+    int i;
+
+    buffer[length] = checksum(handle, buffer, length);
+    cnt = (buffer[0] << 8) | buffer[1];
+    lb_handle->bytes_tx += length + 1;
+
+    lb_handle->ack = CMD_NACK;
+    switch (lb_handle->state) {
+    case LB_READ_ADDR:
+    case LB_WRITE_ADDR:
+        lb_handle->addr = get_addr(buffer);
+        if (length == 4 && in_flash(lb_handle->addr, 1)) {
+            lb_handle->ack = CMD_ACK;
+            lb_handle->state++;
+            return CMD_ACK;
+        }
+        break;
+    case LB_READ_LEN:
+        lb_handle->len = buffer[0] + 1;
+        if (length == 1 && in_flash(lb_handle->addr, lb_handle->len)) {
+            lb_handle->ack = CMD_ACK;
+            lb_handle->state = LB_READ_DATA;
+            return CMD_ACK;
+        }
+        break;
+    case LB_WRITE_DATA:
+        lb_handle->len = buffer[0] + 1;
+        if (length == (int)lb_handle->len + 1 && in_flash(lb_handle->addr, lb_handle->len)) {
+            offset = lb_handle->addr - LOOPBACK_FLASH_BASE;
+            /* programming can only clear bits */
+            for (i = 0; i < (int)lb_handle->len; i++)
+                lb_handle->flash[offset + i] &= buffer[1 + i];
+            lb_handle->ack = CMD_ACK;
+        }
+        break;
+    case LB_ERASE_CNT:
+        if (length != 2)
+            break;
+        if (cnt == 0xFFFF) {
+            /* mass erase */
+            memset(lb_handle->flash, 0xFF, LOOPBACK_FLASH_SIZE);
+            lb_handle->erases++;
+            lb_handle->ack = CMD_ACK;
+        } else if (cnt == 0x0000) {
+            /* a single sector follows */
+            lb_handle->ack = CMD_ACK;
+            lb_handle->state = LB_ERASE_SECTOR;
+            return CMD_ACK;
+        }
+        break;
+    case LB_ERASE_SECTOR:
+        if (length == 2 && !sector_range(cnt, &offset, &size)) {
+            memset(&lb_handle->flash[offset], 0xFF, size);
+            lb_handle->erases++;
+            lb_handle->ack = CMD_ACK;
+        }
+        break;
+    }
+
+    lb_handle->state = LB_IDLE;
+
+    return CMD_ACK;
+}
+
+uint8_t loopback_write_cmd(handle_t *handle, uint8_t cmd)
+{
+    loopback_handle_t *lb_handle = (loopback_handle_t *)handle;
+
+    lb_handle->cmds++;
+    lb_handle->bytes_tx += 3;
+
+    lb_handle->ack = CMD_ACK;
+    if (cmd == CMD_READ_MEMORY) {
+        lb_handle->state = LB_READ_ADDR;
+    } else if (cmd == CMD_WRITE_MEMORY) {
+        lb_handle->state = LB_WRITE_ADDR;
+    } else if (cmd == CMD_ERASE) {
+        lb_handle->state = LB_ERASE_CNT;
+    } else {
+        lb_handle->ack = CMD_NACK;
+        lb_handle->state = LB_IDLE;
+    }
+
+    return CMD_ACK;
+}
+
+uint8_t loopback_read_data(handle_t *handle, uint8_t *data, int length)
+{
+    loopback_handle_t *lb_handle = (loopback_handle_t *)handle;
+
+    if (lb_handle->state != LB_READ_DATA || length != (int)lb_handle->len)
+        return CMD_NACK;
+
+    memcpy(data, &lb_handle->flash[lb_handle->addr - LOOPBACK_FLASH_BASE], length);
+    lb_handle->bytes_rx += length;
+    lb_handle->state = LB_IDLE;
+
+    return CMD_ACK;
+}
+
+uint8_t loopback_read_ack(handle_t *handle)
+{
+    loopback_handle_t *lb_handle = (loopback_handle_t *)handle;
+    uint8_t ret = lb_handle->ack;
+
+    lb_handle->bytes_rx++;
+    lb_handle->ack = CMD_NACK;
+
+    return ret;
+}
+
+int loopback_init(handle_t *handle)
+{
+    loopback_handle_t *lb_handle = (loopback_handle_t *)handle;
+    FILE *file;
+
+    handle->cmd_erase = CMD_ERASE;
+    handle->cmd_read_memory = CMD_READ_MEMORY;
+    handle->cmd_write_memory = CMD_WRITE_MEMORY;
+
+    handle->no_extra_sync = 0;
+
+    handle->write_data = loopback_write_data;
+    handle->write_cmd = loopback_write_cmd;
+    handle->read_data = loopback_read_data;
+    handle->read_ack = loopback_read_ack;
+
+    lb_handle->state = LB_IDLE;
+    lb_handle->ack = CMD_NACK;
+    lb_handle->cmds = lb_handle->erases = 0;
+    lb_handle->bytes_tx = lb_handle->bytes_rx = 0;
+
+    lb_handle->flash = malloc(LOOPBACK_FLASH_SIZE);
+    if (!lb_handle->flash) {
+        perror("Error allocating loopback flash");
+        return -1;
+    }
+    memset(lb_handle->flash, 0xFF, LOOPBACK_FLASH_SIZE);
+
+    /* a missing file is a blank part */
+    file = fopen(lb_handle->filename, "r");
+    if (file) {
+        if (fread(lb_handle->flash, 1, LOOPBACK_FLASH_SIZE, file) == 0 && ferror(file)) {
+            perror("Error reading loopback flash");
+            fclose(file);
+            return -1;
+        }
+        fclose(file);
+    }
+
+    return 0;
+}
+
+int loopback_close(handle_t *handle)
+{
+    loopback_handle_t *lb_handle = (loopback_handle_t *)handle;
+    FILE *file;
+    int ret = 0;
+
+    printf("Loopback: %" PRIu32 " commands, %" PRIu32 " erases, %" PRIu64
+           " bytes sent, %" PRIu64 " bytes received\n",
+           lb_handle->cmds, lb_handle->erases, lb_handle->bytes_tx,
+           lb_handle->bytes_rx);
+
+    file = fopen(lb_handle->filename, "w");
+    if (!file || fwrite(lb_handle->flash, 1, LOOPBACK_FLASH_SIZE, file) < LOOPBACK_FLASH_SIZE) {
+        perror("Error writing loopback flash");
+        ret = -1;
+    }
+    if (file)
+        fclose(file);
+
+    free(lb_handle->flash);
+
+    return ret;
+}
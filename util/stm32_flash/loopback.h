@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_H_
+#define _LOOPBACK_H_
+
+#include "stm32_bl.h"
+
+#define LOOPBACK_FLASH_BASE	0x08000000
+#define LOOPBACK_FLASH_SIZE	0x00100000
+
+/*
+ * stand-in for the SPI bootloader of a STM32F4 with 1MB of flash, kept in
+ * memory and loaded from / saved to a file. Programming can only clear bits,
+ * like real flash, so writing a sector that was not erased shows up in the
+ * result. Counts traffic, so runs can be compared without hardware.
+ */
+typedef struct loopback_handle
+{
+    handle_t handle;
+    const char *filename;
+    uint8_t *flash;
+
+    uint8_t state;
+    uint8_t ack;
+    uint32_t addr;
+    uint32_t len;
+
+    uint32_t cmds;
+    uint32_t erases;
+    uint64_t bytes_tx;
+    uint64_t bytes_rx;
+} loopback_handle_t;
+
+uint8_t loopback_write_data(handle_t *handle, uint8_t *buffer, int length);
+uint8_t loopback_write_cmd(handle_t *handle, uint8_t cmd);
+uint8_t loopback_read_data(handle_t *handle, uint8_t *data, int length);
+uint8_t loopback_read_ack(handle_t *handle);
+int loopback_init(handle_t *handle);
+int loopback_close(handle_t *handle);
+
+#endif /* _LOOPBACK_H_ */
@@ -0,0 +1,88 @@
+#!/bin/bash
+
+#
+# Copyright (C) 2016 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Runs stm32_flash against its simulated bootloader (-b) and checks the
+# flash contents it leaves behind.
+
+# Exit in error if we use an undefined variable (i.e. commit a typo).
+set -u
+
+flash=$(readlink -f "${1:-./stm32_flash}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir"
+
+failed=0
+
+check () { #check <description> <command...>: run command, report result
+	local what="$1"
+	shift
+	if "$@" > /dev/null 2>&1 ; then
+		echo "PASS: $what"
+	else
+		echo "FAIL: $what"
+		failed=1
+	fi
+}
+
+expect () { #expect <pattern>: last run's output must contain pattern
+	grep -q -- "$1" out.txt
+}
+
+run () { #run <args...>: run stm32_flash on the simulated part, keep output
+	"$flash" -b part.bin "$@" > out.txt 2>&1
+}
+
+# 300000 bytes, ending in sector 6, with no 0x00 bytes in it
+yes nanohub | head -c 300000 > img1.bin
+cp img1.bin img2.bin
+printf '\x00' | dd of=img2.bin bs=1 seek=$((0x48000)) conv=notrunc 2> /dev/null
+echo "not part of the image" > marker.bin
+
+run -w img1.bin -v
+check "write and verify" expect "Verify succeeded"
+check "flash matches image" cmp -n 300000 part.bin img1.bin
+
+run -w marker.bin -a 0x0804A000
+check "write past the image" expect "Write succeeded"
+
+run -w img1.bin -x -v
+check "unchanged image: verify" expect "Verify succeeded"
+check "unchanged image: no erase" expect " 0 erases"
+check "unchanged image: no sector rewritten" bash -c '! grep -q "changed, rewriting" out.txt'
+
+run -w img2.bin -x -v
+check "changed image: verify" expect "Verify succeeded"
+check "changed image: one sector rewritten" expect "Sector 6 changed, rewriting"
+check "changed image: one erase" expect " 1 erases"
+check "changed image: flash matches image" cmp -n 300000 part.bin img2.bin
+
+run -r readback.bin -a 0x0804A000 -l $(stat -c %s marker.bin)
+check "changed image: rest of sector kept" cmp readback.bin marker.bin
+
+run -w img1.bin -v
+check "write without erase: verify fails" expect "Verify failed"
+
+run -e 0
+check "erase" expect "Erase succeeded"
+run -w marker.bin -a 0x08000000 -c -t 0x12 -v
+check "crc write" expect "Verify succeeded"
+run -r readback.bin -a 0x08000000 -c
+check "crc read" expect "type 12, crc good"
+
+exit $failed
@@ -192,3 +192,25 @@ uint8_t write_memory(handle_t *handle, uint32_t addr, uint32_t length, uint8_t *
 
     return ret;
 }
+
+/*
+ * write memory that was erased beforehand - 256 byte chunks which are
+ * all 0xFF are already in the erased state, so they are skipped
+ */
+uint8_t write_memory_erased(handle_t *handle, uint32_t addr, uint32_t length, uint8_t *buffer)
+{
+    uint8_t ret = CMD_ACK;
+    uint32_t offset, chunk, i;
+
+    for (offset = 0; ret == CMD_ACK && length > offset; offset += chunk) {
+        chunk = length - offset >= 256 ? 256 : length - offset;
+
+        for (i = 0; i < chunk && buffer[offset + i] == 0xFF; i++)
+            ;
+
+        if (i < chunk)
+            ret = write_memory(handle, addr + offset, chunk, &buffer[offset]);
+    }
+
+    return ret;
+}
@@ -45,6 +45,7 @@ uint8_t checksum(handle_t *handle, uint8_t *bytes, int length);
 uint8_t erase_sector(handle_t *handle, uint16_t sector);
 uint8_t read_memory(handle_t *handle, uint32_t addr, uint32_t length, uint8_t *buffer);
 uint8_t write_memory(handle_t *handle, uint32_t addr, uint32_t length, uint8_t *buffer);
+uint8_t write_memory_erased(handle_t *handle, uint32_t addr, uint32_t length, uint8_t *buffer);
 
 /*
  * Bootloader commands